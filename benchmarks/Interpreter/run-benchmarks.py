@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+# -*- encoding: utf-8 -*-
+
+# ===-- run-benchmarks.py -------------------------------------------------===##
+#
+#                      The KLEE Symbolic Virtual Machine
+#
+#  This file is distributed under the University of Illinois Open Source
+#  License. See LICENSE.TXT for details.
+#
+# ===----------------------------------------------------------------------===##
+
+"""Run KLEE on the interpreter benchmark workloads and report throughput."""
+
+import argparse
+import json
+import os
+import platform
+import shutil
+import sqlite3
+import subprocess
+import sys
+import tempfile
+import time
+
+# Fixed instruction budget and arguments of every workload. Changing them
+# invalidates comparisons with earlier results, so bump SCHEMA_VERSION.
+SCHEMA_VERSION = 1
+Workloads = {
+    'parser': {'max_instructions': 2000000, 'klee_args': [], 'args': []},
+    'crypto': {'max_instructions': 5000000, 'klee_args': [], 'args': []},
+    'heap': {'max_instructions': 2000000, 'klee_args': [], 'args': []},
+    'wc': {
+        'max_instructions': 5000000,
+        'klee_args': ['--posix-runtime', '--libc=uclibc'],
+        'args': ['--sym-args', '0', '2', '2', '--sym-stdin', '8'],
+    },
+}
+
+
+def readStats(path):
+    """Return the final row and aggregates of a run.stats database."""
+    conn = sqlite3.connect(path)
+    conn.row_factory = sqlite3.Row
+    try:
+        last = conn.execute(
+            'SELECT * FROM stats ORDER BY rowid DESC LIMIT 1').fetchone()
+        aggregates = conn.execute(
+            'SELECT MAX(NumStates), AVG(NumStates), MAX(MallocUsage), '
+            'AVG(CAST(MallocUsage AS REAL) / NumStates) '
+            'FROM stats WHERE NumStates > 0').fetchone()
+    finally:
+        conn.close()
+    return dict(last) if last else {}, aggregates
+
+
+def runWorkload(klee, name, bitcode, workload, extraArgs, workDir):
+    outputDir = os.path.join(workDir, name)
+    budget = workload['max_instructions']
+    # sample the statistics at the same points regardless of machine speed
+    cmd = [klee, '--output-dir=' + outputDir, '--write-no-tests',
+           '--max-instructions=%d' % budget,
+           '--stats-write-interval=0s',
+           '--stats-write-after-instructions=%d' % max(budget // 100, 1)]
+    cmd += workload['klee_args'] + extraArgs + [bitcode] + workload['args']
+
+    start = time.monotonic()
+    with open(os.path.join(workDir, name + '.log'), 'w') as log:
+        proc = subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT)
+        _, status, usage = os.wait4(proc.pid, 0)
+    wallTime = time.monotonic() - start
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        print('{}: KLEE failed, see {}.log'.format(name, name),
+              file=sys.stderr)
+        return None
+
+    last, (maxStates, avgStates, maxMalloc, memPerState) = readStats(
+        os.path.join(outputDir, 'run.stats'))
+    instructions = last.get('Instructions', 0)
+    # every fork creates exactly one new state
+    forks = max(last.get('States', 1) - 1, 0)
+    kleeTime = last.get('WallTime', 0) / 1000000
+    return {
+        'max_instructions': budget,
+        'instructions': instructions,
+        'forks': forks,
+        'wall_time': wallTime,
+        'klee_wall_time': kleeTime,
+        'user_time': usage.ru_utime,
+        'instructions_per_second': instructions / kleeTime if kleeTime else 0,
+        'forks_per_second': forks / kleeTime if kleeTime else 0,
+        'peak_rss_bytes': usage.ru_maxrss * 1024,
+        'max_malloc_usage_bytes': maxMalloc or 0,
+        'avg_memory_per_state_bytes': memPerState or 0,
+        'max_active_states': maxStates or 0,
+        'avg_active_states': avgStates or 0,
+        'solver_time': last.get('SolverTime', 0) / 1000000,
+        'solver_queries': last.get('SolverQueries', 0),
+        'expr_memory_bytes': last.get('ExprMemory', 0),
+        'covered_instructions': last.get('CoveredInstructions', 0),
+    }
+
+
+def getKleeVersion(klee):
+    try:
+        out = subprocess.run([klee, '--version'], stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT,
+                             universal_newlines=True).stdout
+    except OSError:
+        return 'unknown'
+    return out.splitlines()[0].strip() if out else 'unknown'
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run KLEE on the interpreter benchmark workloads under '
+                    'fixed instruction budgets and write the results as '
+                    'JSON.',
+        epilog='Arguments after "--" are passed to every KLEE run, e.g. to '
+               'compare option sets.')
+    parser.add_argument('--klee', required=True, help='path to klee')
+    parser.add_argument('--workloads', required=True,
+                        help='directory with the workload bitcode files')
+    parser.add_argument('--output', default='-',
+                        help='JSON output file (default: stdout)')
+    parser.add_argument('--only', action='append', choices=sorted(Workloads),
+                        help='run only the given workload (repeatable)')
+    parser.add_argument('--keep-output', metavar='DIR',
+                        help='keep the KLEE output directories in DIR')
+    parser.add_argument('klee_args', nargs='*', help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    workDir = args.keep_output or tempfile.mkdtemp(prefix='klee-bench-')
+    os.makedirs(workDir, exist_ok=True)
+    results = {}
+    failed = False
+    try:
+        for name in args.only or sorted(Workloads):
+            bitcode = os.path.join(args.workloads, name + '.bc')
+            if not os.path.exists(bitcode):
+                print('{}: skipped, {} not found'.format(name, bitcode),
+                      file=sys.stderr)
+                continue
+            print('Running {}...'.format(name), file=sys.stderr)
+            result = runWorkload(args.klee, name, bitcode, Workloads[name],
+                                 args.klee_args, workDir)
+            if result is None:
+                failed = True
+            else:
+                results[name] = result
+    finally:
+        if not args.keep_output:
+            shutil.rmtree(workDir, ignore_errors=True)
+
+    report = {
+        'schema_version': SCHEMA_VERSION,
+        'timestamp': time.strftime('%Y-%m-%dT%H:%M:%S%z'),
+        'host': platform.node(),
+        'klee_version': getKleeVersion(args.klee),
+        'klee_args': args.klee_args,
+        'workloads': results,
+    }
+    text = json.dumps(report, indent=2, sort_keys=True) + '\n'
+    if args.output == '-':
+        sys.stdout.write(text)
+    else:
+        with open(args.output, 'w') as f:
+            f.write(text)
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,55 @@
+// Binary search tree of symbolic keys: every insertion forks on the key
+// comparisons and allocates, so the number of states and objects per state
+// grows quickly.
+
+#include "klee/klee.h"
+
+#include <stdlib.h>
+
+#define KEYS 7
+
+struct Node {
+  int key;
+  struct Node *left, *right;
+};
+
+static struct Node *insert(struct Node *root, int key) {
+  if (!root) {
+    struct Node *node = malloc(sizeof(*node));
+    node->key = key;
+    node->left = node->right = NULL;
+    return node;
+  }
+  if (key < root->key)
+    root->left = insert(root->left, key);
+  else if (key > root->key)
+    root->right = insert(root->right, key);
+  return root;
+}
+
+static unsigned height(const struct Node *node) {
+  if (!node)
+    return 0;
+  unsigned l = height(node->left), r = height(node->right);
+  return 1 + (l > r ? l : r);
+}
+
+static void destroy(struct Node *node) {
+  if (!node)
+    return;
+  destroy(node->left);
+  destroy(node->right);
+  free(node);
+}
+
+int main(void) {
+  int keys[KEYS];
+  klee_make_symbolic(keys, sizeof(keys), "keys");
+
+  struct Node *root = NULL;
+  for (unsigned i = 0; i < KEYS; ++i)
+    root = insert(root, keys[i]);
+  unsigned h = height(root);
+  destroy(root);
+  return h == KEYS;
+}
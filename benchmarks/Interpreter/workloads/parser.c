@@ -0,0 +1,56 @@
+// Recursive-descent parser and evaluator for arithmetic expressions over a
+// symbolic input string: many short paths that branch on every character.
+
+#include "klee/klee.h"
+
+#define LENGTH 12
+
+static const char *input;
+
+static int parseSum(void);
+
+static int parseAtom(void) {
+  if (*input == '(') {
+    ++input;
+    int value = parseSum();
+    if (*input == ')')
+      ++input;
+    return value;
+  }
+  int value = 0;
+  while (*input >= '0' && *input <= '9')
+    value = value * 10 + (*input++ - '0');
+  return value;
+}
+
+static int parseProduct(void) {
+  int value = parseAtom();
+  while (*input == '*' || *input == '/') {
+    char op = *input++;
+    int rhs = parseAtom();
+    value = op == '*' ? value * rhs : (rhs ? value / rhs : 0);
+  }
+  return value;
+}
+
+static int parseSum(void) {
+  int value = parseProduct();
+  while (*input == '+' || *input == '-') {
+    char op = *input++;
+    int rhs = parseProduct();
+    value = op == '+' ? value + rhs : value - rhs;
+  }
+  return value;
+}
+
+int main(void) {
+  char buffer[LENGTH];
+  klee_make_symbolic(buffer, sizeof(buffer), "buffer");
+  buffer[LENGTH - 1] = '\0';
+
+  input = buffer;
+  int value = parseSum();
+  if (*input != '\0')
+    return 1;
+  return value == 42 ? 2 : 0;
+}
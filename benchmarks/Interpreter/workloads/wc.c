@@ -0,0 +1,49 @@
+// Small coreutils-style program for the POSIX runtime: counts the lines,
+// words and bytes of its symbolic standard input, selected by symbolic
+// command-line options.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+  int lines = 0, words = 0, bytes = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-l"))
+      lines = 1;
+    else if (!strcmp(argv[i], "-w"))
+      words = 1;
+    else if (!strcmp(argv[i], "-c"))
+      bytes = 1;
+    else {
+      fprintf(stderr, "wc: invalid option '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+  if (!lines && !words && !bytes)
+    lines = words = bytes = 1;
+
+  unsigned long numLines = 0, numWords = 0, numBytes = 0;
+  int inWord = 0;
+  char c;
+  while (read(0, &c, 1) == 1) {
+    ++numBytes;
+    if (c == '\n')
+      ++numLines;
+    if (c == ' ' || c == '\t' || c == '\n') {
+      inWord = 0;
+    } else if (!inWord) {
+      inWord = 1;
+      ++numWords;
+    }
+  }
+
+  if (lines)
+    printf("%lu ", numLines);
+  if (words)
+    printf("%lu ", numWords);
+  if (bytes)
+    printf("%lu", numBytes);
+  printf("\n");
+  return 0;
+}
@@ -0,0 +1,402 @@
+//===-- SolverBenchmark.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Replays recorded .kquery logs through differently configured solver chains
+// and reports throughput, latency percentiles and cache hit rates. The
+// results can be stored as a baseline and later runs compared against it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/Parser/Parser.h"
+#include "klee/Solver/Common.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/LatencyHistogram.h"
+#include "klee/Statistics/Statistics.h"
+#include "klee/Support/OptionCategories.h"
+#include "klee/Support/PrintVersion.h"
+#include "klee/System/Time.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using namespace klee;
+using namespace klee::expr;
+
+namespace {
+cl::OptionCategory BenchCat("Benchmark options");
+
+cl::list<std::string> Inputs(cl::desc("<.kquery files or directories>"),
+                             cl::Positional, cl::OneOrMore,
+                             cl::cat(BenchCat));
+
+cl::list<std::string> Configs(
+    "config",
+    cl::desc("Solver chain configuration to benchmark; can be given several "
+             "times (default=all): full, no-independent, no-branch-cache, "
+             "no-cex-cache, fast-cex, core"),
+    cl::CommaSeparated, cl::cat(BenchCat));
+
+cl::opt<unsigned> Repetitions(
+    "repetitions",
+    cl::desc("Replay the corpus this many times per configuration and report "
+             "the fastest run (default=1)"),
+    cl::init(1), cl::cat(BenchCat));
+
+cl::opt<std::string> WriteBaseline(
+    "write-baseline", cl::desc("Store the results as baseline in this file"),
+    cl::cat(BenchCat));
+
+cl::opt<std::string>
+    Baseline("baseline",
+             cl::desc("Compare the results against the baseline in this file "
+                      "and fail on regressions (missing files are ignored)"),
+             cl::cat(BenchCat));
+
+cl::opt<double> MaxRegression(
+    "max-regression",
+    cl::desc("Tolerated slowdown against the baseline in percent "
+             "(default=10)"),
+    cl::init(10), cl::cat(BenchCat));
+
+/// A solver chain configuration, expressed through the usual chain options
+struct Config {
+  const char *name;
+  bool independent;
+  bool branchCache;
+  bool cexCache;
+  bool fastCex;
+};
+
+const Config AllConfigs[] = {
+    {"full", true, true, true, false},
+    {"no-independent", false, true, true, false},
+    {"no-branch-cache", true, false, true, false},
+    {"no-cex-cache", true, true, false, false},
+    {"fast-cex", true, true, true, true},
+    {"core", false, false, false, false},
+};
+
+/// A parsed input; the parser owns the arrays the queries refer to
+struct Corpus {
+  std::vector<std::unique_ptr<MemoryBuffer>> buffers;
+  std::vector<std::unique_ptr<Parser>> parsers;
+  std::vector<std::unique_ptr<Decl>> decls;
+  std::vector<const QueryCommand *> queries;
+};
+
+/// Metrics of one configuration; the order matches the baseline columns
+struct Result {
+  double seconds = 0;
+  double throughput = 0;
+  double p50 = 0;
+  double p99 = 0;
+  std::uint64_t coreQueries = 0;
+  std::uint64_t failures = 0;
+  double cacheHitRate = 0;
+  double cexCacheHitRate = 0;
+};
+
+const char *const ResultColumns[] = {
+    "Config",  "Time(s)",     "Queries/s", "P50(us)",     "P99(us)",
+    "CoreQ",   "Failures",    "Cache(%)",  "CexCache(%)",
+};
+} // namespace
+
+static bool collectInputs(const std::string &path,
+                          std::vector<std::string> &files) {
+  if (!sys::fs::is_directory(path)) {
+    files.push_back(path);
+    return true;
+  }
+  std::error_code ec;
+  for (sys::fs::recursive_directory_iterator it(path, ec), ie; it != ie && !ec;
+       it.increment(ec)) {
+    if (sys::path::extension(it->path()) == ".kquery")
+      files.push_back(it->path());
+  }
+  if (ec) {
+    errs() << path << ": " << ec.message() << "\n";
+    return false;
+  }
+  return true;
+}
+
+static bool parseCorpus(Corpus &corpus) {
+  std::vector<std::string> files;
+  for (const std::string &input : Inputs) {
+    if (!collectInputs(input, files))
+      return false;
+  }
+  // the order of directory entries is unspecified
+  std::sort(files.begin(), files.end());
+
+  for (const std::string &file : files) {
+    auto MBResult = MemoryBuffer::getFile(file);
+    if (!MBResult) {
+      errs() << file << ": " << MBResult.getError().message() << "\n";
+      return false;
+    }
+    corpus.buffers.push_back(std::move(*MBResult));
+    corpus.parsers.emplace_back(Parser::Create(
+        file, corpus.buffers.back().get(), exprBuilder, false));
+    Parser &P = *corpus.parsers.back();
+    P.SetMaxErrors(20);
+    while (Decl *D = P.ParseTopLevelDecl()) {
+      corpus.decls.emplace_back(D);
+      if (auto *QC = dyn_cast<QueryCommand>(D))
+        corpus.queries.push_back(QC);
+    }
+    if (unsigned N = P.GetNumErrors()) {
+      errs() << file << ": parse failure: " << N << " errors.\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+static std::unique_ptr<Solver> createSolver(const Config &config) {
+  UseIndependentSolver = config.independent;
+  UseBranchCache = config.branchCache;
+  UseCexCache = config.cexCache;
+  UseFastCexSolver = config.fastCex;
+
+  std::unique_ptr<Solver> coreSolver = createCoreSolver(CoreSolverToUse);
+  const time::Span maxCoreSolverTime(MaxCoreSolverTime);
+  if (maxCoreSolverTime)
+    coreSolver->setCoreSolverTimeout(maxCoreSolverTime);
+  return constructSolverChain(std::move(coreSolver), "", "", "", "", "", "");
+}
+
+/// Issues `QC` like kleaver does; returns false if the solver failed
+static bool runQuery(Solver &S, const QueryCommand &QC) {
+  const ConstraintSet constraints(QC.Constraints);
+  if (QC.Values.empty() && QC.Objects.empty()) {
+    bool result;
+    return S.mustBeTrue(Query(constraints, QC.Query), result);
+  }
+  if (!QC.Values.empty()) {
+    ref<ConstantExpr> result;
+    return S.getValue(Query(constraints, QC.Values[0]), result);
+  }
+  std::vector<std::vector<unsigned char>> result;
+  return S.getInitialValues(Query(constraints, QC.Query), QC.Objects, result);
+}
+
+static double getRate(std::uint64_t hits, std::uint64_t misses) {
+  return hits + misses ? 100.0 * hits / (hits + misses) : 0;
+}
+
+static Result runConfig(const Config &config, const Corpus &corpus) {
+  Result best;
+  for (unsigned rep = 0; rep < std::max(1u, Repetitions.getValue()); ++rep) {
+    // every repetition starts with empty caches
+    std::unique_ptr<Solver> S = createSolver(config);
+    const std::uint64_t coreQueries = stats::solverQueries;
+    const std::uint64_t cacheHits = stats::queryCacheHits;
+    const std::uint64_t cacheMisses = stats::queryCacheMisses;
+    const std::uint64_t cexHits = stats::queryCexCacheHits;
+    const std::uint64_t cexMisses = stats::queryCexCacheMisses;
+
+    LatencyHistogram latency;
+    Result result;
+    const auto start = std::chrono::steady_clock::now();
+    for (const QueryCommand *QC : corpus.queries) {
+      const auto queryStart = std::chrono::steady_clock::now();
+      if (!runQuery(*S, *QC))
+        ++result.failures;
+      latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - queryStart)
+                         .count());
+    }
+    result.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    result.throughput = corpus.queries.size() / std::max(result.seconds, 1e-9);
+    result.p50 = latency.getPercentile(50) / 1000.0;
+    result.p99 = latency.getPercentile(99) / 1000.0;
+    result.coreQueries = stats::solverQueries - coreQueries;
+    result.cacheHitRate = getRate(stats::queryCacheHits - cacheHits,
+                                  stats::queryCacheMisses - cacheMisses);
+    result.cexCacheHitRate = getRate(stats::queryCexCacheHits - cexHits,
+                                     stats::queryCexCacheMisses - cexMisses);
+    if (rep == 0 || result.seconds < best.seconds)
+      best = result;
+  }
+  return best;
+}
+
+static void printRow(raw_ostream &os, StringRef name, const Result &r,
+                     bool csv) {
+  if (csv) {
+    os << name << ',' << format("%.6f", r.seconds) << ','
+       << format("%.3f", r.throughput) << ',' << format("%.3f", r.p50) << ','
+       << format("%.3f", r.p99) << ',' << r.coreQueries << ',' << r.failures
+       << ',' << format("%.2f", r.cacheHitRate) << ','
+       << format("%.2f", r.cexCacheHitRate) << '\n';
+    return;
+  }
+  os << left_justify(name, 16)
+     << format("%10.3f %12.1f %10.1f %10.1f %8llu %8llu %9.2f %11.2f\n",
+               r.seconds, r.throughput, r.p50, r.p99,
+               static_cast<unsigned long long>(r.coreQueries),
+               static_cast<unsigned long long>(r.failures), r.cacheHitRate,
+               r.cexCacheHitRate);
+}
+
+static bool readBaseline(const std::string &path,
+                         std::map<std::string, Result> &baseline) {
+  auto MBResult = MemoryBuffer::getFile(path);
+  if (!MBResult)
+    return false;
+  SmallVector<StringRef, 16> lines, fields;
+  (*MBResult)->getBuffer().split(lines, '\n', -1, false);
+  for (StringRef line : lines) {
+    fields.clear();
+    line.split(fields, ',');
+    if (fields.size() != std::size(ResultColumns) || fields[0] == "Config")
+      continue;
+    Result r;
+    fields[1].getAsDouble(r.seconds);
+    fields[2].getAsDouble(r.throughput);
+    fields[3].getAsDouble(r.p50);
+    fields[4].getAsDouble(r.p99);
+    fields[5].getAsInteger(10, r.coreQueries);
+    fields[6].getAsInteger(10, r.failures);
+    fields[7].getAsDouble(r.cacheHitRate);
+    fields[8].getAsDouble(r.cexCacheHitRate);
+    baseline[fields[0].str()] = r;
+  }
+  return true;
+}
+
+/// Prints every metric of `r` that is worse than in `base`; returns the
+/// number of regressions
+static unsigned compare(StringRef name, const Result &r, const Result &base) {
+  const double factor = 1 + MaxRegression / 100;
+  unsigned regressions = 0;
+  auto report = [&](const char *metric, double value, double baseValue) {
+    outs() << "REGRESSION " << name << ": " << metric << " "
+           << format("%.3f", value) << " (baseline " << format("%.3f", baseValue)
+           << ")\n";
+    ++regressions;
+  };
+
+  // timings are noisy and only compared with a tolerance
+  if (r.seconds > base.seconds * factor)
+    report("Time(s)", r.seconds, base.seconds);
+  if (r.p50 > base.p50 * factor)
+    report("P50(us)", r.p50, base.p50);
+  if (r.p99 > base.p99 * factor)
+    report("P99(us)", r.p99, base.p99);
+  // the remaining metrics are deterministic for a given corpus
+  if (r.coreQueries > base.coreQueries)
+    report("CoreQ", r.coreQueries, base.coreQueries);
+  if (r.failures > base.failures)
+    report("Failures", r.failures, base.failures);
+  if (r.cacheHitRate < base.cacheHitRate - 0.005)
+    report("Cache(%)", r.cacheHitRate, base.cacheHitRate);
+  if (r.cexCacheHitRate < base.cexCacheHitRate - 0.005)
+    report("CexCache(%)", r.cexCacheHitRate, base.cexCacheHitRate);
+  return regressions;
+}
+
+int main(int argc, char **argv) {
+  KCommandLine::KeepOnlyCategories({&BenchCat, &SolvingCat});
+
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  cl::SetVersionPrinter(klee::printVersion);
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Benchmark KLEE solver chains on query logs\n");
+
+  std::vector<Config> configs;
+  for (const std::string &name : Configs) {
+    auto it = std::find_if(std::begin(AllConfigs), std::end(AllConfigs),
+                           [&](const Config &c) { return name == c.name; });
+    if (it == std::end(AllConfigs)) {
+      errs() << argv[0] << ": error: unknown configuration '" << name << "'\n";
+      return 1;
+    }
+    configs.push_back(*it);
+  }
+  if (configs.empty())
+    configs.assign(std::begin(AllConfigs), std::end(AllConfigs));
+
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  exprBuilder = builder.get();
+
+  Corpus corpus;
+  if (!parseCorpus(corpus))
+    return 1;
+  outs() << "Corpus: " << corpus.queries.size() << " queries in "
+         << corpus.buffers.size() << " files\n";
+
+  std::vector<std::pair<std::string, Result>> results;
+  for (const Config &config : configs)
+    results.emplace_back(config.name, runConfig(config, corpus));
+
+  outs() << format("%-16s %10s %12s %10s %10s %8s %8s %9s %11s\n",
+                   ResultColumns[0], ResultColumns[1], ResultColumns[2],
+                   ResultColumns[3], ResultColumns[4], ResultColumns[5],
+                   ResultColumns[6], ResultColumns[7], ResultColumns[8]);
+  for (const auto &[name, result] : results)
+    printRow(outs(), name, result, false);
+
+  if (!WriteBaseline.empty()) {
+    std::error_code ec;
+    raw_fd_ostream os(WriteBaseline, ec, sys::fs::OF_Text);
+    if (ec) {
+      errs() << WriteBaseline << ": " << ec.message() << "\n";
+      return 1;
+    }
+    ListSeparator sep(",");
+    for (const char *column : ResultColumns)
+      os << sep << column;
+    os << '\n';
+    for (const auto &[name, result] : results)
+      printRow(os, name, result, true);
+  }
+
+  unsigned regressions = 0;
+  std::map<std::string, Result> baseline;
+  if (!Baseline.empty() && readBaseline(Baseline, baseline)) {
+    for (const auto &[name, result] : results) {
+      if (auto it = baseline.find(name); it != baseline.end())
+        regressions += compare(name, result, it->second);
+    }
+    outs() << (regressions ? "Performance regressions found"
+                           : "No regressions against the baseline")
+           << '\n';
+  }
+
+  llvm_shutdown();
+  return regressions ? 1 : 0;
+}
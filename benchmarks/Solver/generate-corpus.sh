@@ -0,0 +1,43 @@
+#!/usr/bin/env bash
+
+# ===-- generate-corpus.sh ------------------------------------------------===##
+# 
+#                      The KLEE Symbolic Virtual Machine
+# 
+#  This file is distributed under the University of Illinois Open Source
+#  License. See LICENSE.TXT for details.
+# 
+# ===----------------------------------------------------------------------===##
+#
+# Records the queries KLEE issues for the bundled example programs as .kquery
+# logs that SolverBenchmark can replay. The logged queries are the ones
+# entering the solver chain, so every chain configuration sees the same work.
+#
+# Usage: generate-corpus.sh <klee build dir> <output dir> [klee options...]
+
+if [ $# -lt 2 ] ; then
+	echo "Usage: $0 <klee build dir> <output dir> [klee options...]"
+	exit 1
+fi
+
+BUILD_DIR="$1"
+OUTPUT_DIR="$2"
+shift 2
+SOURCE_DIR="$(cd "$(dirname "$0")/../.." && pwd)"
+CLANG="${CLANG:-clang}"
+TMP_DIR="$(mktemp -d)"
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+mkdir -p "$OUTPUT_DIR"
+for src in "$SOURCE_DIR"/examples/*/*.c; do
+	name="$(basename "$src" .c)"
+	"$CLANG" -emit-llvm -c -g -O0 -Xclang -disable-O0-optnone \
+		-I "$SOURCE_DIR/include" "$src" -o "$TMP_DIR/$name.bc" || exit 1
+	"$BUILD_DIR/bin/klee" --output-dir="$TMP_DIR/$name" \
+		--use-query-log=all:kquery --max-time=60s "$@" \
+		"$TMP_DIR/$name.bc" > /dev/null 2>&1
+	if [ -s "$TMP_DIR/$name/all-queries.kquery" ] ; then
+		cp "$TMP_DIR/$name/all-queries.kquery" "$OUTPUT_DIR/$name.kquery"
+		echo "$name: $(grep -c '^(query' "$OUTPUT_DIR/$name.kquery") queries"
+	fi
+done
@@ -0,0 +1,658 @@
+//===-- ImmutableBTreeMap.h -------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_IMMUTABLEBTREEMAP_H
+#define KLEE_IMMUTABLEBTREEMAP_H
+
+#include "llvm/Support/Compiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+namespace klee {
+
+/// Persistent ordered map implemented as a reference-counted B+-tree.
+///
+/// Copying a map is O(1): both copies share all nodes. Updates copy only the
+/// nodes on the path from the root to the modified leaf that are shared with
+/// another map (path copying), while nodes owned exclusively by the updated
+/// map are modified in place. Every node stores up to `Capacity` entries, so
+/// trees are shallow and iteration walks over contiguous arrays.
+///
+/// The interface mirrors ImmutableMap. In addition, `replaceInPlace` and
+/// `removeInPlace` update a map without creating a temporary copy, which
+/// avoids any allocation if the affected nodes are not shared.
+///
+/// Keys and data must be default constructible and copy assignable.
+template <class K, class D, class CMP = std::less<K>, unsigned Capacity = 16>
+class ImmutableBTreeMap {
+  static_assert(Capacity >= 4, "B-tree nodes need at least four entries");
+
+public:
+  typedef K key_type;
+  typedef std::pair<K, D> value_type;
+
+  class iterator;
+
+private:
+  /// Minimum number of entries in every node but the root.
+  static constexpr unsigned MinFill = Capacity / 2;
+  /// Maximum number of levels supported by iterators.
+  static constexpr unsigned MaxHeight = 32;
+
+  struct Node {
+    unsigned references = 1;
+    unsigned count = 0;
+    const bool isLeaf;
+
+    explicit Node(bool isLeaf) : isLeaf(isLeaf) {}
+  };
+
+  struct Leaf : Node {
+    /// Sorted entries; slots at or past `count` hold default values.
+    value_type values[Capacity];
+
+    Leaf() : Node(true) {}
+  };
+
+  struct Inner : Node {
+    /// keys[i] is a lower bound of all keys in children[i] and greater than
+    /// all keys in children[i - 1]. keys[0] is not used.
+    K keys[Capacity];
+    Node *children[Capacity];
+
+    Inner() : Node(false) {}
+  };
+
+  Node *root = nullptr;
+  std::size_t numElements = 0;
+  /// Number of levels in the tree, 0 iff the map is empty.
+  unsigned height = 0;
+
+  static bool less(const K &a, const K &b) { return CMP()(a, b); }
+
+  static Leaf *asLeaf(Node *n) { return static_cast<Leaf *>(n); }
+  static Inner *asInner(Node *n) { return static_cast<Inner *>(n); }
+
+  static Node *incref(Node *n) {
+    ++n->references;
+    return n;
+  }
+
+  static void decref(Node *n) {
+    if (--n->references == 0)
+      destroy(n);
+  }
+
+  /// Frees `n`, then releases its children. Kept out of line so GCC does not
+  /// flag the second decref of a root shared by two iterators as a use after
+  /// free.
+  LLVM_ATTRIBUTE_NOINLINE static void destroy(Node *n) {
+    if (n->isLeaf) {
+      delete asLeaf(n);
+      return;
+    }
+    Inner *inner = asInner(n);
+    Node *children[Capacity];
+    const unsigned count = inner->count;
+    std::copy(inner->children, inner->children + count, children);
+    delete inner;
+    for (unsigned i = 0; i < count; ++i)
+      decref(children[i]);
+  }
+
+  static Node *clone(Node *n) {
+    if (n->isLeaf) {
+      Leaf *src = asLeaf(n);
+      Leaf *copy = new Leaf();
+      std::copy(src->values, src->values + src->count, copy->values);
+      copy->count = src->count;
+      return copy;
+    }
+    Inner *src = asInner(n);
+    Inner *copy = new Inner();
+    std::copy(src->keys, src->keys + src->count, copy->keys);
+    for (unsigned i = 0; i < src->count; ++i)
+      copy->children[i] = incref(src->children[i]);
+    copy->count = src->count;
+    return copy;
+  }
+
+  /// Returns a node with the contents of `n` that may be modified in place:
+  /// `n` itself if no one else refers to it, a private copy otherwise.
+  static Node *makeUnique(Node *n) {
+    if (n->references == 1)
+      return n;
+    Node *copy = clone(n);
+    decref(n);
+    return copy;
+  }
+
+  /// Index of the first entry of `leaf` whose key is not less than `k`.
+  static unsigned lowerIndex(Leaf *leaf, const K &k) {
+    return std::lower_bound(leaf->values, leaf->values + leaf->count, k,
+                            [](const value_type &v, const K &k) {
+                              return less(v.first, k);
+                            }) -
+           leaf->values;
+  }
+
+  /// Index of the first entry of `leaf` whose key is greater than `k`.
+  static unsigned upperIndex(Leaf *leaf, const K &k) {
+    return std::upper_bound(leaf->values, leaf->values + leaf->count, k,
+                            [](const K &k, const value_type &v) {
+                              return less(k, v.first);
+                            }) -
+           leaf->values;
+  }
+
+  /// Index of the child of `inner` whose key range contains `k`.
+  static unsigned findChild(Inner *inner, const K &k) {
+    return std::upper_bound(inner->keys + 1, inner->keys + inner->count, k,
+                            CMP()) -
+           inner->keys - 1;
+  }
+
+  static void insertAt(Leaf *leaf, unsigned pos, const value_type &value) {
+    std::move_backward(leaf->values + pos, leaf->values + leaf->count,
+                       leaf->values + leaf->count + 1);
+    leaf->values[pos] = value;
+    ++leaf->count;
+  }
+
+  static void eraseAt(Leaf *leaf, unsigned pos) {
+    std::move(leaf->values + pos + 1, leaf->values + leaf->count,
+              leaf->values + pos);
+    leaf->values[--leaf->count] = value_type();
+  }
+
+  /// Inserts `child` at `pos`; ownership of the reference is transferred.
+  static void insertAt(Inner *inner, unsigned pos, const K &key, Node *child) {
+    std::move_backward(inner->keys + pos, inner->keys + inner->count,
+                       inner->keys + inner->count + 1);
+    std::move_backward(inner->children + pos, inner->children + inner->count,
+                       inner->children + inner->count + 1);
+    inner->keys[pos] = key;
+    inner->children[pos] = child;
+    ++inner->count;
+  }
+
+  /// Removes the child at `pos` without releasing it.
+  static void eraseAt(Inner *inner, unsigned pos) {
+    std::move(inner->keys + pos + 1, inner->keys + inner->count,
+              inner->keys + pos);
+    std::move(inner->children + pos + 1, inner->children + inner->count,
+              inner->children + pos);
+    --inner->count;
+  }
+
+  /// Inserts `value` into the subtree rooted at the exclusively owned node
+  /// `n`. If `n` overflows, it is split in two and the new right half is
+  /// returned, with its smallest key stored in `splitKey`.
+  Node *insertInto(Node *n, const value_type &value, bool overwrite,
+                   K &splitKey) {
+    if (n->isLeaf) {
+      Leaf *leaf = asLeaf(n);
+      unsigned pos = lowerIndex(leaf, value.first);
+      if (pos < leaf->count && !less(value.first, leaf->values[pos].first)) {
+        if (overwrite)
+          leaf->values[pos] = value;
+        return nullptr;
+      }
+      ++numElements;
+      if (leaf->count < Capacity) {
+        insertAt(leaf, pos, value);
+        return nullptr;
+      }
+      Leaf *right = new Leaf();
+      std::move(leaf->values + MinFill, leaf->values + Capacity, right->values);
+      std::fill(leaf->values + MinFill, leaf->values + Capacity, value_type());
+      right->count = Capacity - MinFill;
+      leaf->count = MinFill;
+      if (pos <= MinFill)
+        insertAt(leaf, pos, value);
+      else
+        insertAt(right, pos - MinFill, value);
+      splitKey = right->values[0].first;
+      return right;
+    }
+
+    Inner *inner = asInner(n);
+    unsigned i = findChild(inner, value.first);
+    inner->children[i] = makeUnique(inner->children[i]);
+    K childKey;
+    Node *sibling = insertInto(inner->children[i], value, overwrite, childKey);
+    if (!sibling)
+      return nullptr;
+    if (inner->count < Capacity) {
+      insertAt(inner, i + 1, childKey, sibling);
+      return nullptr;
+    }
+    Inner *right = new Inner();
+    std::move(inner->keys + MinFill, inner->keys + Capacity, right->keys);
+    std::copy(inner->children + MinFill, inner->children + Capacity,
+              right->children);
+    right->count = Capacity - MinFill;
+    inner->count = MinFill;
+    if (i + 1 <= MinFill)
+      insertAt(inner, i + 1, childKey, sibling);
+    else
+      insertAt(right, i + 1 - MinFill, childKey, sibling);
+    splitKey = right->keys[0];
+    return right;
+  }
+
+  /// Removes `key`, which must be present, from the subtree rooted at the
+  /// exclusively owned node `n`. Afterwards, `n` may be underfull.
+  void removeFrom(Node *n, const K &key) {
+    if (n->isLeaf) {
+      Leaf *leaf = asLeaf(n);
+      unsigned pos = lowerIndex(leaf, key);
+      assert(pos < leaf->count && !less(key, leaf->values[pos].first) &&
+             "key not found");
+      eraseAt(leaf, pos);
+      --numElements;
+      return;
+    }
+
+    Inner *inner = asInner(n);
+    unsigned i = findChild(inner, key);
+    Node *child = inner->children[i] = makeUnique(inner->children[i]);
+    removeFrom(child, key);
+    if (child->count < MinFill)
+      rebalance(inner, i);
+  }
+
+  /// Refills the underfull child `i` of the exclusively owned node `parent`
+  /// by borrowing an entry from a sibling or merging it with one.
+  static void rebalance(Inner *parent, unsigned i) {
+    Node *child = parent->children[i];
+
+    if (i > 0 && parent->children[i - 1]->count > MinFill) {
+      Node *left = parent->children[i - 1] =
+          makeUnique(parent->children[i - 1]);
+      if (child->isLeaf) {
+        Leaf *l = asLeaf(left), *c = asLeaf(child);
+        insertAt(c, 0, l->values[l->count - 1]);
+        eraseAt(l, l->count - 1);
+        parent->keys[i] = c->values[0].first;
+      } else {
+        Inner *l = asInner(left), *c = asInner(child);
+        c->keys[0] = parent->keys[i];
+        insertAt(c, 0, l->keys[l->count - 1], l->children[l->count - 1]);
+        --l->count;
+        parent->keys[i] = c->keys[0];
+      }
+      return;
+    }
+
+    if (i + 1 < parent->count && parent->children[i + 1]->count > MinFill) {
+      Node *right = parent->children[i + 1] =
+          makeUnique(parent->children[i + 1]);
+      if (child->isLeaf) {
+        Leaf *r = asLeaf(right), *c = asLeaf(child);
+        insertAt(c, c->count, r->values[0]);
+        eraseAt(r, 0);
+        parent->keys[i + 1] = r->values[0].first;
+      } else {
+        Inner *r = asInner(right), *c = asInner(child);
+        insertAt(c, c->count, parent->keys[i + 1], r->children[0]);
+        parent->keys[i + 1] = r->keys[1];
+        eraseAt(r, 0);
+      }
+      return;
+    }
+
+    merge(parent, i > 0 ? i - 1 : i);
+  }
+
+  /// Moves all entries of child `j + 1` of `parent` into child `j`.
+  static void merge(Inner *parent, unsigned j) {
+    Node *left = parent->children[j] = makeUnique(parent->children[j]);
+    Node *right = parent->children[j + 1];
+    assert(left->count + right->count <= Capacity);
+    if (left->isLeaf) {
+      Leaf *l = asLeaf(left), *r = asLeaf(right);
+      std::copy(r->values, r->values + r->count, l->values + l->count);
+      l->count += r->count;
+    } else {
+      Inner *l = asInner(left), *r = asInner(right);
+      for (unsigned k = 0; k < r->count; ++k) {
+        l->keys[l->count] = k == 0 ? parent->keys[j + 1] : r->keys[k];
+        l->children[l->count++] = incref(r->children[k]);
+      }
+    }
+    decref(right);
+    eraseAt(parent, j + 1);
+  }
+
+  void insertValue(const value_type &value, bool overwrite) {
+    if (!root) {
+      Leaf *leaf = new Leaf();
+      leaf->values[0] = value;
+      leaf->count = 1;
+      root = leaf;
+      height = 1;
+      numElements = 1;
+      return;
+    }
+    root = makeUnique(root);
+    K splitKey;
+    if (Node *sibling = insertInto(root, value, overwrite, splitKey)) {
+      assert(height < MaxHeight && "tree too high");
+      Inner *newRoot = new Inner();
+      newRoot->children[0] = root;
+      newRoot->keys[1] = splitKey;
+      newRoot->children[1] = sibling;
+      newRoot->count = 2;
+      root = newRoot;
+      ++height;
+    }
+  }
+
+  void removeKey(const K &key) {
+    root = makeUnique(root);
+    removeFrom(root, key);
+    if (root->count == 0) {
+      decref(root);
+      root = nullptr;
+      height = 0;
+    } else if (!root->isLeaf && root->count == 1) {
+      Node *child = incref(asInner(root)->children[0]);
+      decref(root);
+      root = child;
+      --height;
+    }
+  }
+
+  iterator seek(const K &k, bool upper) const {
+    iterator it(root, height);
+    for (unsigned level = 0; level < height; ++level) {
+      Node *n = level == 0 ? root
+                           : asInner(it.path[level - 1])
+                                 ->children[it.index[level - 1]];
+      it.path[level] = n;
+      if (n->isLeaf) {
+        it.index[level] =
+            upper ? upperIndex(asLeaf(n), k) : lowerIndex(asLeaf(n), k);
+        if (it.index[level] == n->count)
+          it.nextLeaf();
+      } else {
+        it.index[level] = findChild(asInner(n), k);
+      }
+    }
+    return it;
+  }
+
+public:
+  ImmutableBTreeMap() = default;
+  ImmutableBTreeMap(const ImmutableBTreeMap &b)
+      : root(b.root ? incref(b.root) : nullptr), numElements(b.numElements),
+        height(b.height) {}
+  ImmutableBTreeMap(ImmutableBTreeMap &&b) noexcept
+      : root(b.root), numElements(b.numElements), height(b.height) {
+    b.root = nullptr;
+    b.numElements = 0;
+    b.height = 0;
+  }
+  ~ImmutableBTreeMap() {
+    if (root)
+      decref(root);
+  }
+
+  ImmutableBTreeMap &operator=(const ImmutableBTreeMap &b) {
+    ImmutableBTreeMap copy(b);
+    std::swap(root, copy.root);
+    std::swap(numElements, copy.numElements);
+    std::swap(height, copy.height);
+    return *this;
+  }
+  ImmutableBTreeMap &operator=(ImmutableBTreeMap &&b) noexcept {
+    std::swap(root, b.root);
+    std::swap(numElements, b.numElements);
+    std::swap(height, b.height);
+    return *this;
+  }
+
+  bool empty() const { return numElements == 0; }
+  std::size_t size() const { return numElements; }
+
+  std::size_t count(const key_type &key) const { return lookup(key) ? 1 : 0; }
+
+  const value_type *lookup(const key_type &key) const {
+    if (!root)
+      return nullptr;
+    Node *n = root;
+    while (!n->isLeaf)
+      n = asInner(n)->children[findChild(asInner(n), key)];
+    Leaf *leaf = asLeaf(n);
+    unsigned pos = lowerIndex(leaf, key);
+    if (pos < leaf->count && !less(key, leaf->values[pos].first))
+      return &leaf->values[pos];
+    return nullptr;
+  }
+
+  /// Returns the last value whose key is less than or equal to `key`, or
+  /// null if no such value exists.
+  const value_type *lookup_previous(const key_type &key) const {
+    if (!root)
+      return nullptr;
+    // deepest subtree left of the search path, holding the fallback result
+    Node *previous = nullptr;
+    Node *n = root;
+    while (!n->isLeaf) {
+      Inner *inner = asInner(n);
+      unsigned i = findChild(inner, key);
+      if (i > 0)
+        previous = inner->children[i - 1];
+      n = inner->children[i];
+    }
+    Leaf *leaf = asLeaf(n);
+    unsigned pos = upperIndex(leaf, key);
+    if (pos > 0)
+      return &leaf->values[pos - 1];
+    if (!previous)
+      return nullptr;
+    while (!previous->isLeaf)
+      previous = asInner(previous)->children[previous->count - 1];
+    return &asLeaf(previous)->values[previous->count - 1];
+  }
+
+  const value_type &min() const {
+    assert(root && "min() of empty map");
+    Node *n = root;
+    while (!n->isLeaf)
+      n = asInner(n)->children[0];
+    return asLeaf(n)->values[0];
+  }
+
+  const value_type &max() const {
+    assert(root && "max() of empty map");
+    Node *n = root;
+    while (!n->isLeaf)
+      n = asInner(n)->children[n->count - 1];
+    return asLeaf(n)->values[n->count - 1];
+  }
+
+  /// Returns a map that additionally contains `value`, unless its key is
+  /// already present.
+  ImmutableBTreeMap insert(const value_type &value) const {
+    ImmutableBTreeMap result(*this);
+    if (!count(value.first))
+      result.insertValue(value, false);
+    return result;
+  }
+
+  /// Returns a map in which the key of `value` is bound to `value`.
+  ImmutableBTreeMap replace(const value_type &value) const {
+    ImmutableBTreeMap result(*this);
+    result.insertValue(value, true);
+    return result;
+  }
+
+  /// Returns a map without `key`.
+  ImmutableBTreeMap remove(const key_type &key) const {
+    ImmutableBTreeMap result(*this);
+    result.removeInPlace(key);
+    return result;
+  }
+
+  /// Binds the key of `value` to `value` in this map.
+  void replaceInPlace(const value_type &value) { insertValue(value, true); }
+
+  /// Removes `key` from this map.
+  void removeInPlace(const key_type &key) {
+    if (count(key))
+      removeKey(key);
+  }
+
+  iterator begin() const {
+    iterator it(root, height);
+    it.descend(0, false);
+    return it;
+  }
+
+  iterator end() const {
+    iterator it(root, height);
+    it.descend(0, true);
+    if (height > 0)
+      ++it.index[height - 1];
+    return it;
+  }
+
+  iterator find(const key_type &key) const {
+    iterator it = lower_bound(key);
+    if (it == end() || less(key, it->first))
+      return end();
+    return it;
+  }
+
+  /// Returns an iterator to the first value whose key is not less than
+  /// `key`.
+  iterator lower_bound(const key_type &key) const { return seek(key, false); }
+
+  /// Returns an iterator to the first value whose key is greater than `key`.
+  iterator upper_bound(const key_type &key) const { return seek(key, true); }
+};
+
+/// Bidirectional iterator over an ImmutableBTreeMap. It keeps the iterated
+/// version of the map alive, so updates of the map do not invalidate it.
+template <class K, class D, class CMP, unsigned Capacity>
+class ImmutableBTreeMap<K, D, CMP, Capacity>::iterator {
+  friend class ImmutableBTreeMap<K, D, CMP, Capacity>;
+
+  Node *root;
+  unsigned height;
+  /// Nodes on the path from the root (level 0) to the current leaf and the
+  /// index taken in each of them.
+  Node *path[MaxHeight];
+  unsigned index[MaxHeight];
+
+  iterator(Node *root, unsigned height)
+      : root(root ? incref(root) : nullptr), height(height) {}
+
+  /// Follows the left- or rightmost path starting at `level`, whose node
+  /// must be set already unless `level` is 0.
+  void descend(unsigned level, bool rightmost) {
+    for (; level < height; ++level) {
+      Node *n = level == 0 ? root
+                           : asInner(path[level - 1])->children[index[level - 1]];
+      path[level] = n;
+      index[level] = rightmost ? n->count - 1 : 0;
+    }
+  }
+
+  /// Moves from the past-the-end index of a leaf to the first entry of the
+  /// next leaf. Stays put if there is no next leaf, which makes this end().
+  void nextLeaf() {
+    for (unsigned level = height - 1; level-- > 0;) {
+      if (index[level] + 1 < path[level]->count) {
+        ++index[level];
+        descend(level + 1, false);
+        return;
+      }
+    }
+  }
+
+public:
+  typedef std::bidirectional_iterator_tag iterator_category;
+  typedef typename ImmutableBTreeMap::value_type value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const value_type *pointer;
+  typedef const value_type &reference;
+
+  iterator(const iterator &i) : root(i.root ? incref(i.root) : nullptr),
+                                height(i.height) {
+    std::copy(i.path, i.path + height, path);
+    std::copy(i.index, i.index + height, index);
+  }
+  ~iterator() {
+    if (root)
+      decref(root);
+  }
+
+  iterator &operator=(const iterator &i) {
+    if (i.root)
+      incref(i.root);
+    if (root)
+      decref(root);
+    root = i.root;
+    height = i.height;
+    std::copy(i.path, i.path + height, path);
+    std::copy(i.index, i.index + height, index);
+    return *this;
+  }
+
+  reference operator*() const {
+    return asLeaf(path[height - 1])->values[index[height - 1]];
+  }
+  pointer operator->() const { return &**this; }
+
+  bool operator==(const iterator &b) const {
+    if (height != b.height)
+      return false;
+    return height == 0 || (path[height - 1] == b.path[height - 1] &&
+                           index[height - 1] == b.index[height - 1]);
+  }
+  bool operator!=(const iterator &b) const { return !(*this == b); }
+
+  iterator &operator++() {
+    assert(height > 0 && index[height - 1] < path[height - 1]->count &&
+           "incrementing end()");
+    if (++index[height - 1] == path[height - 1]->count)
+      nextLeaf();
+    return *this;
+  }
+
+  iterator &operator--() {
+    assert(height > 0 && "decrementing begin()");
+    unsigned leafLevel = height - 1;
+    if (index[leafLevel] > 0) {
+      --index[leafLevel];
+      return *this;
+    }
+    for (unsigned level = leafLevel; level-- > 0;) {
+      if (index[level] > 0) {
+        --index[level];
+        descend(level + 1, true);
+        return *this;
+      }
+    }
+    assert(0 && "decrementing begin()");
+    return *this;
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_IMMUTABLEBTREEMAP_H */
@@ -54,6 +54,47 @@ extern "C" {
 
   void  kTest_free(KTest *);
 
+
+  /* A test archive stores many tests in one append-only file, each one as
+     an (optionally compressed) .ktest image followed by an offset index
+     that is written when the archive is closed. Archives are opened either
+     for appending or for (memory-mapped) reading. */
+  typedef struct KTestArchive KTestArchive;
+
+  /* return true iff file at path matches the archive header */
+  int   kTestArchive_isArchive(const char *path);
+
+  /* opens the archive at path for appending, creating it if it does not
+     exist. Tests are compressed if compress is non-zero and KLEE was built
+     with zlib. Returns NULL on (unspecified) error */
+  KTestArchive* kTestArchive_openForAppend(const char *path, int compress);
+
+  /* returns 1 on success, 0 on (unspecified) error */
+  int   kTestArchive_append(KTestArchive *, KTest *, unsigned id);
+
+  /* opens the archive at path for reading. Returns NULL on (unspecified)
+     error */
+  KTestArchive* kTestArchive_open(const char *path);
+
+  /* returns the number of tests in an archive */
+  unsigned kTestArchive_numTests(KTestArchive *);
+
+  /* returns the id the test at index was appended with */
+  unsigned kTestArchive_getID(KTestArchive *, unsigned index);
+
+  /* returns the test at index without copying object data; the result is
+     owned by the archive and valid until it is closed. Must not be passed to
+     kTest_free. Returns NULL on (unspecified) error */
+  KTest* kTestArchive_view(KTestArchive *, unsigned index);
+
+  /* returns a copy of the test at index that has to be released with
+     kTest_free. Returns NULL on (unspecified) error */
+  KTest* kTestArchive_read(KTestArchive *, unsigned index);
+
+  /* writes the index of an archive opened for appending and releases the
+     archive. Returns 1 on success, 0 on (unspecified) error */
+  int   kTestArchive_close(KTestArchive *);
+
 #ifdef __cplusplus
 }
 #endif
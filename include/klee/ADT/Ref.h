@@ -31,6 +31,7 @@
 
 #include "klee/Support/Casting.h"
 
+#include <atomic>
 #include <cassert>
 
 namespace llvm {
@@ -78,6 +79,42 @@ public:
   ReferenceCounter &operator=(ReferenceCounter &&other) noexcept = delete;
 };
 
+/// Thread-safe variant of ReferenceCounter for ref-managed objects that are
+/// shared between threads.
+class AtomicReferenceCounter {
+  template<class T>
+  friend class ref;
+
+  /// Count how often the object has been referenced.
+  std::atomic<unsigned> refCount{0};
+
+public:
+  AtomicReferenceCounter() = default;
+  ~AtomicReferenceCounter() = default;
+
+  // Explicitly initialise reference counter with 0 again
+  AtomicReferenceCounter(const AtomicReferenceCounter &) {}
+
+  /// Returns the number of parallel references of this objects
+  /// \return number of references on this object
+  unsigned getCount() { return refCount.load(); }
+
+  // Copy assignment operator
+  AtomicReferenceCounter &operator=(const AtomicReferenceCounter &a) {
+    if (this == &a)
+      return *this;
+    // The new copy won't be referenced
+    refCount = 0;
+    return *this;
+  }
+
+  // Do not allow move operations for the reference counter
+  // as otherwise, references become incorrect.
+  AtomicReferenceCounter(AtomicReferenceCounter &&r) noexcept = delete;
+  AtomicReferenceCounter &
+  operator=(AtomicReferenceCounter &&other) noexcept = delete;
+};
+
 template<class T>
 class ref {
   T *ptr;
@@ -10,6 +10,7 @@
 #ifndef KLEE_TREESTREAM_H
 #define KLEE_TREESTREAM_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -24,14 +25,33 @@ namespace klee {
     friend class TreeOStream;
 
   private:
+    /// A contiguous run of stream data in the output file.
+    struct Segment {
+      std::uint64_t offset;
+      unsigned size;
+    };
+
+    /// Index entry for one stream: the stream it was forked from, how many
+    /// of the parent's segments precede the fork, and the stream's own
+    /// segments in file order. This lets readStream() seek straight to the
+    /// data of a stream instead of rescanning the whole file.
+    struct StreamInfo {
+      TreeStreamID parent;
+      unsigned parentSegments;
+      std::vector<Segment> segments;
+    };
+
     char buffer[bufferSize];
     unsigned lastID, bufferCount;
 
     std::string path;
     std::ofstream *output;
     unsigned ids;
+    std::uint64_t offset;
+    std::vector<StreamInfo> streams;
 
     void write(TreeOStream &os, const char *s, unsigned size);
+    void writeSegment(unsigned id, const char *s, unsigned size);
     void flushBuffer();
 
   public:
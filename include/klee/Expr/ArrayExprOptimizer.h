@@ -10,6 +10,7 @@
 #ifndef KLEE_ARRAYEXPROPTIMIZER_H
 #define KLEE_ARRAYEXPROPTIMIZER_H
 
+#include <cstddef>
 #include <cstdint>
 #include <map>
 #include <unordered_map>
@@ -28,11 +29,52 @@ enum ArrayOptimizationType { NONE, ALL, INDEX, VALUE };
 using array2idx_ty = std::map<const Array *, std::vector<ref<Expr>>>;
 using mapIndexOptimizedExpr_ty = std::map<ref<Expr>, std::vector<ref<Expr>>>;
 
+/// Encodings of reads from constant arrays as expressions over the index
+enum class TableEncoding {
+  /// Reads are not lowered
+  None,
+  /// A chain of selects, one per distinct value, testing the index against
+  /// all ranges holding that value
+  ValueChain,
+  /// A balanced tree of selects that splits the ranges of equal values at
+  /// their boundaries
+  IntervalTree,
+  /// A tree of selects on the bits of the index, sharing equal subtrees
+  MuxTree
+};
+
+/// The lowered form of a constant array, from which reads with any index
+/// are built
+struct LoweredTable {
+  /// A select of a MuxTree: index bit `bit` chooses between the nodes
+  /// `ifSet` and `ifUnset`
+  struct MuxNode {
+    unsigned bit;
+    unsigned ifSet;
+    unsigned ifUnset;
+  };
+
+  TableEncoding encoding = TableEncoding::None;
+
+  /// Ranges [first, second) of equal elements and their values
+  std::vector<std::pair<uint64_t, uint64_t>> ranges;
+  std::vector<uint64_t> rangeValues;
+
+  /// MuxTree: nodes 0 to leafValues.size() - 1 are the distinct element
+  /// values, the others are muxNodes in bottom-up order
+  std::vector<uint64_t> leafValues;
+  std::vector<MuxNode> muxNodes;
+  unsigned muxRoot = 0;
+  unsigned muxBits = 0;
+};
+
 class ExprOptimizer {
 private:
   ExprHashMap<ref<Expr>> cacheExprOptimized;
   ExprHashSet cacheExprUnapplicable;
   ExprHashMap<ref<Expr>> cacheReadExprOptimized;
+  /// Lowered forms of constant arrays without updates, by element width
+  std::map<std::pair<const Array *, Expr::Width>, LoweredTable> loweredTables;
 
 public:
   /// Returns the optimised version of e.
@@ -41,6 +83,10 @@ public:
   /// @return optimised expression
   ref<Expr> optimizeExpr(const ref<Expr> &e, bool valueOnly);
 
+  /// Chooses the cheapest applicable encoding for an array with the given
+  /// element values
+  LoweredTable lowerTable(const std::vector<uint64_t> &arrayValues) const;
+
 private:
   bool computeIndexes(array2idx_ty &arrays, const ref<Expr> &e,
                       mapIndexOptimizedExpr_ty &idx_valIdx) const;
@@ -51,9 +97,16 @@ private:
       bool isSymbolic);
 
   ref<Expr> buildConstantSelectExpr(const ref<Expr> &index,
-                                    std::vector<uint64_t> &arrayValues,
-                                    Expr::Width width,
-                                    unsigned elementsInArray) const;
+                                    const LoweredTable &table,
+                                    Expr::Width width) const;
+  ref<Expr> buildValueChainExpr(const ref<Expr> &index,
+                                const LoweredTable &table,
+                                Expr::Width width) const;
+  ref<Expr> buildIntervalTreeExpr(const ref<Expr> &index,
+                                  const LoweredTable &table, Expr::Width width,
+                                  std::size_t begin, std::size_t end) const;
+  ref<Expr> buildMuxTreeExpr(const ref<Expr> &index, const LoweredTable &table,
+                             Expr::Width width) const;
 
   ref<Expr>
   buildMixedSelectExpr(const ReadExpr *re,
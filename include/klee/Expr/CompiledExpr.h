@@ -0,0 +1,161 @@
+//===-- CompiledExpr.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_COMPILEDEXPR_H
+#define KLEE_COMPILEDEXPR_H
+
+#include "klee/Expr/Expr.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace klee {
+class Array;
+class Assignment;
+
+/// Expressions lowered to a flat, register-based bytecode that can be
+/// evaluated under many assignments without allocating any expressions.
+///
+/// Every instruction writes its own register, sub-expressions shared in the
+/// DAG are compiled once, and all values are kept in 64-bit registers. A
+/// batch of assignments is evaluated at once with one lane per assignment:
+/// each register holds the values of all lanes next to each other, so that
+/// every instruction is a simple loop the compiler can vectorise.
+/// Expressions with wider values are not compiled; they and evaluations the
+/// bytecode cannot decide (e.g. a division by zero or a read of an unbound
+/// byte with free values allowed) fall back to the AssignmentEvaluator, so
+/// the results always match Assignment::evaluate.
+class CompiledExpr {
+public:
+  CompiledExpr() = default;
+  explicit CompiledExpr(const ref<Expr> &e) { add(e); }
+  template <typename InputIterator>
+  CompiledExpr(InputIterator begin, InputIterator end) {
+    for (; begin != end; ++begin)
+      add(*begin);
+  }
+
+  /// Appends `e` to the compiled expressions
+  void add(const ref<Expr> &e);
+
+  /// Returns the value of the `i`-th expression under `a`, which is a
+  /// constant unless the assignment allows free values
+  ref<Expr> evaluate(const Assignment &a, unsigned i = 0) const;
+
+  /// Evaluates the `i`-th expression under each of `assignments`
+  void evaluate(const std::vector<const Assignment *> &assignments, unsigned i,
+                std::vector<ref<Expr>> &result) const;
+
+  /// Returns true iff all expressions evaluate to true under `a`
+  bool satisfies(const Assignment &a) const;
+
+  /// Returns the index of the first of `assignments` under which all
+  /// expressions evaluate to true, or the number of assignments if there is
+  /// none
+  std::size_t
+  findSatisfying(const std::vector<const Assignment *> &assignments) const;
+
+private:
+  enum class Opcode : std::uint8_t {
+    Constant,
+    Read,
+    Select,
+    Concat,
+    Extract,
+    ZExt,
+    SExt,
+    Add,
+    Sub,
+    Mul,
+    UDiv,
+    SDiv,
+    URem,
+    SRem,
+    Not,
+    And,
+    Or,
+    Xor,
+    Shl,
+    LShr,
+    AShr,
+    Eq,
+    Ne,
+    Ult,
+    Ule,
+    Slt,
+    Sle
+  };
+
+  /// Writes the register with the same index as the instruction
+  struct Instruction {
+    Opcode opcode;
+    /// Width of the result
+    Expr::Width width;
+    /// Operand registers or immediates, depending on the opcode
+    unsigned a, b, c;
+  };
+
+  /// An update list read by Read instructions: the base array and the index
+  /// and value registers of all updates, newest first
+  struct Updates {
+    unsigned array;
+    std::vector<std::pair<unsigned, unsigned>> updates;
+  };
+
+  static constexpr unsigned NotCompiled = ~0u;
+  /// Lanes evaluated at once, one bit each in a mask
+  static constexpr unsigned MaxLanes = 64;
+
+  std::vector<Instruction> program;
+  std::vector<std::uint64_t> constants;
+  std::vector<const Array *> arrays;
+  std::vector<Updates> updates;
+
+  struct Root {
+    ref<Expr> expr;
+    /// Register holding the value, or NotCompiled
+    unsigned reg;
+    /// End of the instructions needed for this and all previous roots
+    unsigned end;
+  };
+  std::vector<Root> roots;
+
+  std::unordered_map<const Expr *, unsigned> compiled;
+  std::unordered_map<const Array *, unsigned> arrayIds;
+  std::map<std::pair<const Array *, const UpdateNode *>, unsigned> updateIds;
+
+  /// Lanes of the current batch
+  mutable unsigned lanes = 0;
+  /// The value of register `r` in lane `l` is at `r * lanes + l`
+  mutable std::vector<std::uint64_t> registers;
+  /// The binding of array `i` in lane `l` is at `i * lanes + l`
+  mutable std::vector<const std::vector<unsigned char> *> bindings;
+
+  unsigned compile(const ref<Expr> &e);
+  unsigned compileUpdates(const UpdateList &ul);
+  unsigned emit(Opcode opcode, Expr::Width width, unsigned a = 0,
+                unsigned b = 0, unsigned c = 0);
+
+  /// Starts a batch and looks up the bindings of all arrays read
+  void bind(const Assignment *const *assignments, unsigned lanes) const;
+  /// Executes the instructions [begin, end) in all lanes, returns the mask
+  /// of lanes in which a value is undetermined
+  std::uint64_t execute(const Assignment *const *assignments, unsigned begin,
+                        unsigned end) const;
+  bool read(const Assignment &a, unsigned array, unsigned lane,
+            std::uint64_t index, std::uint64_t &value) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_COMPILEDEXPR_H */
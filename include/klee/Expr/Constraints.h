@@ -10,10 +10,16 @@
 #ifndef KLEE_CONSTRAINTS_H
 #define KLEE_CONSTRAINTS_H
 
+#include "klee/ADT/ImmutableBTreeMap.h"
 #include "klee/Expr/Expr.h"
 
+#include <memory>
+#include <vector>
+
 namespace klee {
 
+class ConstraintSimplifier;
+
 /// Resembles a set of constraints that can be passed around
 ///
 class ConstraintSet {
@@ -40,8 +46,53 @@ public:
     return constraints == b.constraints;
   }
 
+  /// Replacements used to simplify expressions under these constraints:
+  /// every constraint is mapped to true and, for every `c == e` with a
+  /// constant `c`, `e` is mapped to `c`
+  using equalities_ty = ImmutableBTreeMap<ref<Expr>, ref<Expr>>;
+
+  using reads_ty = std::vector<ref<ReadExpr>>;
+
+  /// Returns the reads of `constraint`, which has to be part of this set,
+  /// including those in update lists. They are computed once per constraint
+  /// and shared by all copies of the set.
+  const reads_ty &getReads(const ref<Expr> &constraint) const;
+
 private:
   constraints_ty constraints;
+
+  /// Built on first use and then updated with every added constraint. The
+  /// map is persistent, so copies of the set (e.g. forked states) share it.
+  mutable equalities_ty equalities;
+  mutable bool equalitiesValid = false;
+  /// Memo of simplified (sub-)expressions; shared by copies until one of
+  /// them is modified
+  mutable std::shared_ptr<ConstraintSimplifier> simplifier;
+
+  struct ConstraintReads {
+    std::shared_ptr<const reads_ty> reads;
+    /// Number of times the constraint occurs in the set
+    unsigned count = 0;
+  };
+  using constraint_reads_ty = ImmutableBTreeMap<ref<Expr>, ConstraintReads>;
+  /// The constraints a read occurs in
+  using occurrences_ty = ImmutableBTreeMap<ref<Expr>, bool>;
+
+  /// Reads of every constraint and the reverse occurrence index, built on
+  /// first use like the equalities
+  mutable constraint_reads_ty constraintReads;
+  mutable ImmutableBTreeMap<ref<Expr>, occurrences_ty> occurrences;
+  mutable bool readsValid = false;
+
+  void addEquality(const ref<Expr> &e) const;
+  const equalities_ty &getEqualities() const;
+
+  void addReads(const ref<Expr> &constraint) const;
+  void removeReads(const ref<Expr> &constraint) const;
+  void buildReads() const;
+  /// Returns the constraints that may contain `e`, or null if that might be
+  /// any constraint because `e` does not read from an array
+  const occurrences_ty *findCandidates(const ref<Expr> &e) const;
 };
 
 class ExprVisitor;
@@ -65,10 +116,11 @@ public:
   void addConstraint(const ref<Expr> &constraint);
 
 private:
-  /// Rewrite set of constraints using the visitor
-  /// \param visitor constraint rewriter
+  /// Rewrite every constraint that contains `src` using the visitor
+  /// \param visitor constraint rewriter replacing `src`
+  /// \param src the replaced expression
   /// \return true iff any constraint has been changed
-  bool rewriteConstraints(ExprVisitor &visitor);
+  bool rewriteConstraints(ExprVisitor &visitor, const ref<Expr> &src);
 
   /// Add constraint to the set of constraints
   void addConstraintInternal(const ref<Expr> &constraint);
@@ -12,6 +12,7 @@
 
 #include "klee/ADT/Bits.h"
 #include "klee/ADT/Ref.h"
+#include "klee/Expr/ExprAllocator.h"
 
 #include "klee/Support/CompilerWarning.h"
 DISABLE_WARNING_PUSH
@@ -96,6 +97,8 @@ Todo: Shouldn't bool \c Xor just be written as not equal?
 class Expr {
 public:
   static unsigned count;
+  /// Allocator backing all expression nodes.
+  static ExprAllocator allocator;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
   /// The type of an expression is simply its width, in bits. 
@@ -218,6 +221,13 @@ public:
   Expr() { Expr::count++; }
   virtual ~Expr() { Expr::count--; } 
 
+  static void *operator new(std::size_t size) {
+    return allocator.allocate(size);
+  }
+  static void operator delete(void *ptr, std::size_t size) {
+    allocator.deallocate(ptr, size);
+  }
+
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
   
@@ -488,6 +498,16 @@ public:
   UpdateNode() = delete;
   ~UpdateNode() = default;
 
+  /// Allocator backing all update nodes.
+  static ExprAllocator allocator;
+
+  static void *operator new(std::size_t size) {
+    return allocator.allocate(size);
+  }
+  static void operator delete(void *ptr, std::size_t size) {
+    allocator.deallocate(ptr, size);
+  }
+
   unsigned computeHash();
 };
 
@@ -0,0 +1,128 @@
+//===-- ExprAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRALLOCATOR_H
+#define KLEE_EXPRALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace klee {
+
+/// Size-segregated slab allocator for small, frequently created nodes such as
+/// Expr and UpdateNode.
+///
+/// Nodes are carved out of large slabs and recycled through one free list per
+/// size class, so creating and destroying a node costs a couple of pointer
+/// updates instead of a malloc/free pair. Slabs are never returned to the
+/// system, and a freed node is only reused by later nodes of its own size
+/// class. The bytes reserved in slabs but not taken up by live nodes are
+/// reported by getIdleBytes(), so that memory limits can discount them.
+/// Requests larger than the biggest size class fall through to the global
+/// allocator.
+///
+/// The allocator keeps exact counts of the bytes handed out (per size class
+/// and in total), which lets the statistics tracker report the memory taken
+/// up by expression nodes independent of the general malloc usage.
+///
+/// Instances have a constexpr constructor and are therefore constant
+/// initialised, which makes them safe to use during static initialisation.
+/// They are not thread-safe.
+class ExprAllocator {
+public:
+  /// Granularity (and alignment) of the size classes in bytes.
+  static constexpr std::size_t Granularity = 8;
+  /// Number of size classes; larger nodes bypass the free lists.
+  static constexpr std::size_t NumSizeClasses = 32;
+  /// Largest node size served from the free lists.
+  static constexpr std::size_t MaxSize = Granularity * NumSizeClasses;
+  /// Size of a single slab in bytes.
+  static constexpr std::size_t SlabSize = 64 * 1024;
+
+private:
+  struct FreeNode {
+    FreeNode *next;
+  };
+
+  FreeNode *freeLists[NumSizeClasses] = {};
+  std::uint64_t liveBytes[NumSizeClasses + 1] = {};
+  std::uint64_t totalLiveBytes = 0;
+  std::uint64_t reservedBytes = 0;
+  /// Bytes of the slabs taken up by live nodes, rounded up to their chunks
+  std::uint64_t usedSlabBytes = 0;
+  char *slabCursor = nullptr;
+  char *slabEnd = nullptr;
+
+  static std::size_t getSizeClass(std::size_t size) {
+    return (size + Granularity - 1) / Granularity - 1;
+  }
+
+  void *refill(std::size_t sizeClass);
+
+public:
+  constexpr ExprAllocator() = default;
+  ExprAllocator(const ExprAllocator &) = delete;
+  ExprAllocator &operator=(const ExprAllocator &) = delete;
+
+  void *allocate(std::size_t size) {
+    totalLiveBytes += size;
+    std::size_t sizeClass = getSizeClass(size);
+    if (sizeClass >= NumSizeClasses) {
+      liveBytes[NumSizeClasses] += size;
+      return ::operator new(size);
+    }
+    liveBytes[sizeClass] += size;
+    usedSlabBytes += (sizeClass + 1) * Granularity;
+    if (FreeNode *node = freeLists[sizeClass]) {
+      freeLists[sizeClass] = node->next;
+      return node;
+    }
+    return refill(sizeClass);
+  }
+
+  void deallocate(void *ptr, std::size_t size) {
+    if (!ptr)
+      return;
+    totalLiveBytes -= size;
+    std::size_t sizeClass = getSizeClass(size);
+    if (sizeClass >= NumSizeClasses) {
+      liveBytes[NumSizeClasses] -= size;
+      ::operator delete(ptr);
+      return;
+    }
+    liveBytes[sizeClass] -= size;
+    usedSlabBytes -= (sizeClass + 1) * Granularity;
+    FreeNode *node = static_cast<FreeNode *>(ptr);
+    node->next = freeLists[sizeClass];
+    freeLists[sizeClass] = node;
+  }
+
+  /// Returns the number of bytes currently held by live nodes.
+  std::uint64_t getLiveBytes() const { return totalLiveBytes; }
+
+  /// Returns the number of bytes held by live nodes whose size falls into
+  /// the same size class as `size`. All nodes larger than MaxSize share one
+  /// bucket.
+  std::uint64_t getLiveBytesForSize(std::size_t size) const {
+    std::size_t sizeClass = getSizeClass(size);
+    return liveBytes[sizeClass < NumSizeClasses ? sizeClass : NumSizeClasses];
+  }
+
+  /// Returns the number of bytes reserved in slabs, whether in use or not.
+  std::uint64_t getReservedBytes() const { return reservedBytes; }
+
+  /// Returns the number of bytes reserved in slabs but not in use by any
+  /// node. The system still counts them as allocated.
+  std::uint64_t getIdleBytes() const { return reservedBytes - usedSlabBytes; }
+};
+
+} // namespace klee
+
+#endif /* KLEE_EXPRALLOCATOR_H */
@@ -101,6 +101,14 @@ namespace klee {
   /// Base - The base builder to use when constructing expressions.
   ExprBuilder *createSimplifyingExprBuilder(ExprBuilder *Base);
 
+  /// createWordLevelExprBuilder - Create an expression builder which
+  /// simplifies the byte-wise expressions of multi-byte accesses at the level
+  /// of words (extract/concat/zext chains, word equalities) and folds
+  /// comparisons decided by the known bits and value ranges of the operands.
+  ///
+  /// Base - The base builder to use when constructing expressions.
+  ExprBuilder *createWordLevelExprBuilder(ExprBuilder *Base);
+
   extern ExprBuilder *exprBuilder;
 }
 
@@ -75,19 +75,15 @@ namespace expr {
   };
 
   /// Lexer - Interface for lexing tokens from a .kquery language file.
+  ///
+  /// Characters are classified with a lookup table and comments are
+  /// skipped with memchr, so that large query logs are lexed with few
+  /// branches per character.
   class Lexer {
     const char *BufferPos;      /// The current lexer position.
     const char *BufferEnd;      /// The buffer end position.
+    const char *LineStart;      /// The start of the current line.
     unsigned    LineNumber;     /// The current line.
-    unsigned    ColumnNumber;   /// The current column.
-
-    /// GetNextChar - Eat a character or -1 from the stream.
-    int GetNextChar();
-
-    /// PeekNextChar - Return the next character without consuming it
-    /// from the stream. This does not perform newline
-    /// canonicalization.
-    int PeekNextChar();
 
     /// SetTokenKind - Set the token kind and length (using the
     /// token's start pointer, which must have been initialized).
@@ -97,7 +93,12 @@ namespace expr {
     /// same requirements as SetTokenKind and additionally takes care
     /// of keyword recognition.
     Token &SetIdentifierTokenKind(Token &Result);
-  
+
+    /// ConsumeNewline - Eat the newline character \arg Char, which has
+    /// already been read, and a complementary '\r' or '\n' after it.
+    void ConsumeNewline(char Char);
+
+    void SkipWhitespace();
     void SkipToEndOfLine();
 
     /// LexNumber - Lex a number which does not have a base specifier.
@@ -114,6 +115,12 @@ namespace expr {
     /// when the end of the file is reached. The input argument is
     /// used as the result, for convenience.
     Token &Lex(Token &Result);
+
+    /// SkipParens - Skip the input up to and including the ')' that
+    /// closes \arg Depth already lexed '(' tokens, ignoring comments.
+    ///
+    /// \return False if the end of the file is reached first.
+    bool SkipParens(unsigned Depth);
   };
 }
 }
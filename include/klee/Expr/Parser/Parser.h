@@ -17,6 +17,7 @@
 
 namespace llvm {
   class MemoryBuffer;
+  class raw_ostream;
 }
 
 namespace klee {
@@ -215,12 +216,24 @@ namespace expr {
     /// GetNumErrors - Return the number of encountered errors.
     virtual unsigned GetNumErrors() const = 0;
 
+    /// SetDiagnosticStream - Print diagnostics to \arg OS instead of
+    /// stderr.
+    virtual void SetDiagnosticStream(llvm::raw_ostream &OS) = 0;
+
     /// ParseTopLevelDecl - Parse and return a top level declaration,
     /// which the caller assumes ownership of.
     ///
     /// \return NULL indicates the end of the file has been reached.
     virtual Decl *ParseTopLevelDecl() = 0;
 
+    /// SkipQueryCommand - Skip the next top level declaration without
+    /// parsing it, if it is a query command. This is much faster than
+    /// parsing and freeing the query.
+    ///
+    /// \return false if the next declaration is not a query command, in
+    /// which case nothing is consumed.
+    virtual bool SkipQueryCommand() = 0;
+
     /// CreateParser - Create a parser implementation for the given
     /// MemoryBuffer.
     ///
@@ -75,7 +75,9 @@ public:
     }
 
   public:
-    mutable class klee::ReferenceCounter _refCount;
+    /// Allocators created from the same factory may be used on different
+    /// threads, hence the atomic reference count.
+    mutable class klee::AtomicReferenceCounter _refCount;
 
   private:
     Mapping mapping;
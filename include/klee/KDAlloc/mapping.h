@@ -20,7 +20,9 @@
 #include <unistd.h>
 
 #if defined(__linux__)
+#include <linux/mempolicy.h>
 #include <linux/version.h>
+#include <sys/syscall.h>
 #endif
 
 #if defined(__APPLE__)
@@ -140,6 +142,40 @@ public:
 #endif
   }
 
+  /// Back the mapping with transparent huge pages. This reduces TLB pressure
+  /// for mappings that see a lot of traffic, at the cost of coarser-grained
+  /// memory usage. Returns false if the platform does not support it.
+  bool adviseHugePages() noexcept {
+    assert(*this && "Invalid mapping");
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    return ::madvise(baseAddress, size, MADV_HUGEPAGE) == 0;
+#else
+    return false;
+#endif
+  }
+
+  /// Restrict the physical pages backing the mapping to the given NUMA node.
+  /// Returns false if the platform does not support it or the node is
+  /// invalid.
+  bool bindToNumaNode(unsigned node) noexcept {
+    assert(*this && "Invalid mapping");
+
+#if defined(__linux__) && defined(SYS_mbind)
+    constexpr unsigned bitsPerWord = sizeof(unsigned long) * 8;
+    constexpr unsigned maxNode = 1024;
+    if (node >= maxNode)
+      return false;
+    unsigned long nodeMask[maxNode / bitsPerWord] = {};
+    nodeMask[node / bitsPerWord] = 1UL << (node % bitsPerWord);
+    return ::syscall(SYS_mbind, baseAddress, size, MPOL_BIND, nodeMask,
+                     maxNode + 1, 0) == 0;
+#else
+    (void)node;
+    return false;
+#endif
+  }
+
   explicit operator bool() const noexcept { return baseAddress != MAP_FAILED; }
 
   ~Mapping() {
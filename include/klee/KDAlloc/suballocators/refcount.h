@@ -0,0 +1,39 @@
+//===-- refcount.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KDALLOC_UTIL_REFCOUNT_H
+#define KDALLOC_UTIL_REFCOUNT_H
+
+#include <cstddef>
+
+namespace klee::kdalloc::suballocators {
+/// Atomic operations on the reference counts of copy-on-write structures.
+///
+/// The counts are plain `std::size_t`s so that the structures containing them
+/// remain trivially copyable, but they are always accessed atomically. This
+/// allows allocators that share (parts of) their state to be used from
+/// different threads, as long as each individual allocator is only used by a
+/// single thread at a time.
+namespace refcount {
+inline void increment(std::size_t &count) noexcept {
+  __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+}
+
+/// Returns `true` iff the last reference was dropped.
+[[nodiscard]] inline bool decrement(std::size_t &count) noexcept {
+  return __atomic_sub_fetch(&count, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+[[nodiscard]] inline std::size_t load(std::size_t const &count) noexcept {
+  return __atomic_load_n(&count, __ATOMIC_ACQUIRE);
+}
+} // namespace refcount
+} // namespace klee::kdalloc::suballocators
+
+#endif
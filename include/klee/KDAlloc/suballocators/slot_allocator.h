@@ -13,6 +13,7 @@
 #include "../define.h"
 #include "../location_info.h"
 #include "../tagged_logger.h"
+#include "refcount.h"
 
 #include "klee/ADT/Bits.h"
 
@@ -172,8 +173,7 @@ class SlotAllocator<false> final : public TaggedLogger<SlotAllocator<false>> {
 
   inline void releaseData() noexcept {
     if (data) {
-      --data->referenceCount;
-      if (data->referenceCount == 0) {
+      if (refcount::decrement(data->referenceCount)) {
         std::free(data);
       }
       data = nullptr;
@@ -182,7 +182,7 @@ class SlotAllocator<false> final : public TaggedLogger<SlotAllocator<false>> {
 
   inline void acquireData(Control const &Control) noexcept {
     assert(!!data);
-    if (data->referenceCount > 1) {
+    if (refcount::load(data->referenceCount) > 1) {
       auto newCapacity = computeNextCapacity(
           getLastUsed(Control) +
           1); // one more, since `getLastUsed` is an index, not a size
@@ -205,11 +205,13 @@ class SlotAllocator<false> final : public TaggedLogger<SlotAllocator<false>> {
           &newData->quarantineAndBitmap[Control.quarantineSize + newCapacity],
           ~static_cast<std::size_t>(0));
 
-      --data->referenceCount;
-      assert(data->referenceCount > 0);
+      // the other owners may have released the data in the meantime
+      if (refcount::decrement(data->referenceCount)) {
+        std::free(data);
+      }
       data = newData;
     }
-    assert(data->referenceCount == 1);
+    assert(refcount::load(data->referenceCount) == 1);
   }
 
   std::size_t quarantine(Control const &control, std::size_t const index) {
@@ -220,7 +222,7 @@ class SlotAllocator<false> final : public TaggedLogger<SlotAllocator<false>> {
       return index;
     }
 
-    assert(data->referenceCount == 1 &&
+    assert(refcount::load(data->referenceCount) == 1 &&
            "Must hold CoW ownership to quarantine a new index");
 
     auto const pos = data->quarantineAndBitmap[0];
@@ -358,7 +360,8 @@ class SlotAllocator<false> final : public TaggedLogger<SlotAllocator<false>> {
             ~static_cast<std::size_t>(0));
       }
     } else {
-      if (loc == data->capacity && data->referenceCount == 1) {
+      if (loc == data->capacity &&
+          refcount::load(data->referenceCount) == 1) {
         auto newCapacity = computeNextCapacity(data->capacity);
         auto objectSize =
             control.prefixSize + newCapacity * sizeof(std::size_t);
@@ -378,7 +381,7 @@ class SlotAllocator<false> final : public TaggedLogger<SlotAllocator<false>> {
     }
 
     assert(!!data);
-    assert(data->referenceCount == 1);
+    assert(refcount::load(data->referenceCount) == 1);
     assert(loc < data->capacity);
 
     auto word = data->quarantineAndBitmap[control.quarantineSize + loc];
@@ -405,8 +408,8 @@ public:
 
   SlotAllocator(SlotAllocator const &rhs) noexcept : data(rhs.data) {
     if (data) {
-      ++data->referenceCount;
-      assert(data->referenceCount > 1);
+      refcount::increment(data->referenceCount);
+      assert(refcount::load(data->referenceCount) > 1);
     }
   }
 
@@ -415,8 +418,8 @@ public:
       releaseData();
       data = rhs.data;
       if (data) {
-        ++data->referenceCount;
-        assert(data->referenceCount > 1);
+        refcount::increment(data->referenceCount);
+        assert(refcount::load(data->referenceCount) > 1);
       }
     }
     return *this;
@@ -424,7 +427,7 @@ public:
 
   SlotAllocator(SlotAllocator &&rhs) noexcept
       : data(std::exchange(rhs.data, nullptr)) {
-    assert(data == nullptr || data->referenceCount > 0);
+    assert(data == nullptr || refcount::load(data->referenceCount) > 0);
   }
 
   SlotAllocator &operator=(SlotAllocator &&rhs) noexcept {
@@ -0,0 +1,185 @@
+//===-- BinaryQueryLog.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BINARYQUERYLOG_H
+#define KLEE_BINARYQUERYLOG_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/System/Time.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace klee {
+class ArrayCache;
+
+/// Query logs in a compact binary form (--use-query-log=all:binary or
+/// solver:binary), which klee-query-log converts back to .kquery or .smt2.
+///
+/// A log starts with a magic number and continues with a sequence of
+/// records. Arrays, update nodes and expressions are defined by a record the
+/// first time they occur and referred to by their index afterwards, so that
+/// sub-expressions shared by many queries are written once. All integers are
+/// LEB128-encoded.
+namespace querylog {
+
+const char Magic[] = "KQLOG001";
+
+enum class Record : std::uint8_t {
+  Array = 1,
+  UpdateNode,
+  Expr,
+  /// A query followed by its result, which is missing at the end of a log
+  /// if KLEE stopped while solving a query logged early
+  Query,
+  /// Forgets all update nodes and expressions defined so far
+  Reset
+};
+
+enum class QueryType : std::uint8_t { Truth, Validity, Value, InitialValues };
+
+const char *getQueryTypeName(QueryType type);
+
+/// A query with its result as read from a log
+struct LoggedQuery {
+  QueryType type = QueryType::Truth;
+  std::uint64_t instructions = 0;
+  std::vector<ref<Expr>> constraints;
+  ref<Expr> expr;
+  /// Arrays to compute values for (InitialValues queries)
+  std::vector<const Array *> objects;
+
+  /// False if the log ends before the result, i.e., the query was logged
+  /// early and KLEE hung or crashed while solving it
+  bool finished = true;
+  bool success = false;
+  /// Status of the solver below when the query failed
+  SolverImpl::SolverRunStatus status = SolverImpl::SOLVER_RUN_STATUS_FAILURE;
+  time::Span elapsed;
+  /// Truth: is valid, Validity: the validity, InitialValues: has a solution
+  std::int64_t result = 0;
+  /// Value queries: the computed value
+  ref<Expr> value;
+  /// InitialValues queries: the values of `objects`
+  std::vector<std::vector<unsigned char>> values;
+};
+
+/// Serialises queries and keeps track of the definitions written so far.
+class Writer {
+  ExprHashMap<std::uint64_t> exprIds;
+  std::unordered_map<const UpdateNode *,
+                     std::pair<ref<const UpdateNode>, std::uint64_t>>
+      updateIds;
+  std::unordered_map<const Array *, std::uint64_t> arrayIds;
+
+  /// Definitions added since the last commit, undone by discard()
+  std::vector<ref<Expr>> newExprs;
+  std::vector<const UpdateNode *> newUpdates;
+  std::vector<const Array *> newArrays;
+
+  /// Number of definitions after which the expressions and update nodes
+  /// are forgotten, bounding the memory they hold on to
+  std::size_t maxDefinitions;
+
+  std::string *out = nullptr;
+
+  std::uint64_t writeArray(const Array *array);
+  std::uint64_t writeUpdates(const UpdateList &updates);
+  std::uint64_t writeExpr(const ref<Expr> &e);
+
+public:
+  explicit Writer(std::size_t maxDefinitions = 1 << 20)
+      : maxDefinitions(maxDefinitions) {}
+
+  /// Appends the query and the definitions it needs to `buffer`
+  void writeQuery(std::string &buffer, QueryType type,
+                  std::uint64_t instructions, const Query &query,
+                  const std::vector<const Array *> *objects);
+  /// Appends the result of the last query to `buffer`. `value` is used for
+  /// Value queries, `values` for InitialValues queries with a solution and
+  /// `result` otherwise.
+  void writeResult(std::string &buffer, bool success,
+                   SolverImpl::SolverRunStatus status, time::Span elapsed,
+                   std::int64_t result, const ref<Expr> &value,
+                   const std::vector<std::vector<unsigned char>> *values);
+
+  /// Keeps the definitions written since the last commit. Appends a Reset
+  /// record to `buffer` and forgets all definitions but the arrays once
+  /// there are too many of them.
+  void commit(std::string &buffer);
+  /// Forgets the definitions written since the last commit, whose records
+  /// were dropped
+  void discard();
+};
+
+/// Reads the queries of a log, which can be passed in consecutive blocks so
+/// that logs larger than the memory can be read
+class Reader {
+  ArrayCache &arrayCache;
+  const unsigned char *pos = nullptr;
+  const unsigned char *end = nullptr;
+  /// Whether the current block ends the log
+  bool last = true;
+  /// Whether the magic number has been checked
+  bool started = false;
+  /// Whether the current record continues in the next block
+  bool incomplete = false;
+
+  std::vector<const Array *> arrays;
+  std::vector<ref<UpdateNode>> updates;
+  std::vector<ref<Expr>> exprs;
+
+  std::string error;
+
+  bool readInt(std::uint64_t &value);
+  bool readBytes(std::vector<unsigned char> &bytes);
+  bool readAPInt(Expr::Width width, llvm::APInt &value);
+  bool readArray();
+  bool readUpdateNode();
+  bool readExpr();
+  bool readExprRef(ref<Expr> &e);
+  bool readArrayRef(const Array *&array);
+  bool readQuery(LoggedQuery &query);
+  bool fail(const std::string &message);
+  /// Fails at the end of the log, or stops reading until the next block
+  bool truncated();
+
+public:
+  explicit Reader(ArrayCache &arrayCache) : arrayCache(arrayCache) {}
+  /// Reads the whole log in `data`, which has to stay valid while reading
+  Reader(ArrayCache &arrayCache, const char *data, std::size_t size);
+
+  /// Continues reading with the next block of the log, which has to stay
+  /// valid until the next call. The block has to start with the bytes
+  /// getUnreadSize() reported for the previous one. `last` tells whether
+  /// the log ends with this block.
+  void feed(const char *data, std::size_t size, bool last);
+
+  /// Reads the next query. Returns false at the end of the block or the log,
+  /// or on an error, which getError() then describes.
+  bool next(LoggedQuery &query);
+
+  /// Returns the number of bytes at the end of the current block that
+  /// belong to a record continuing in the next block
+  std::size_t getUnreadSize() const { return end - pos; }
+
+  const std::string &getError() const { return error; }
+};
+
+} // namespace querylog
+} // namespace klee
+
+#endif /* KLEE_BINARYQUERYLOG_H */
@@ -15,6 +15,7 @@
 #include "klee/System/Time.h"
 #include "klee/Solver/SolverCmdLine.h"
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -23,6 +24,7 @@ namespace klee {
   class ConstraintSet;
   class Expr;
   class SolverImpl;
+  enum class SolverLayer : std::uint8_t;
 
   /// Collection of meta data that a solver can have access to. This is
   /// independent of the actual constraints but can be used as a two-way
@@ -256,6 +258,25 @@ namespace klee {
   /// \param s - The underlying solver to use.
   std::unique_ptr<Solver> createIndependentSolver(std::unique_ptr<Solver> s);
 
+  /// createSimplifyingSolver - Create a solver which rebuilds the constraints
+  /// and the expression of every query with the word-level expression builder
+  /// before propagating it to the underlying solver.
+  ///
+  /// \param s - The underlying solver to use.
+  std::unique_ptr<Solver> createSimplifyingSolver(std::unique_ptr<Solver> s);
+
+  /// createMonitoringSolver - Create a solver which records the number of
+  /// queries, hits and the latency distribution of the solver chain layer
+  /// `s` in the statistics of `layer` (see SolverStats.h).
+  ///
+  /// \param s - The layer to monitor.
+  /// \param below - The monitoring solver of the next layer below `s`, or
+  /// null if `s` is the bottom layer. A query counts as a hit if it does not
+  /// reach `below`.
+  std::unique_ptr<Solver> createMonitoringSolver(SolverLayer layer,
+                                                 std::unique_ptr<Solver> s,
+                                                 Solver *below);
+
   /// createKQueryLoggingSolver - Create a solver which will forward all queries
   /// after writing them to the given path in .kquery format.
   std::unique_ptr<Solver>
@@ -268,6 +289,14 @@ namespace klee {
   createSMTLIBLoggingSolver(std::unique_ptr<Solver> s, std::string path,
                             time::Span minQueryTimeToLog, bool logTimedOut);
 
+  /// createBinaryQueryLoggingSolver - Create a solver which will forward all
+  /// queries after writing them to the given path in the binary query log
+  /// format (see BinaryQueryLog.h).
+  std::unique_ptr<Solver>
+  createBinaryQueryLoggingSolver(std::unique_ptr<Solver> s, std::string path,
+                                 time::Span minQueryTimeToLog,
+                                 bool logTimedOut);
+
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
   std::unique_ptr<Solver> createDummySolver();
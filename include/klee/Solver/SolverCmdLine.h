@@ -36,6 +36,14 @@ extern llvm::cl::opt<bool> UseBranchCache;
 
 extern llvm::cl::opt<bool> UseIndependentSolver;
 
+extern llvm::cl::opt<bool> SimplifySolverQueries;
+
+extern llvm::cl::opt<bool> SolverLayerStats;
+
+extern llvm::cl::opt<bool> DropUnprofitableSolverLayers;
+
+extern llvm::cl::opt<unsigned> SolverLayerWindow;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
 
 extern llvm::cl::opt<std::string> MinQueryTimeToLog;
@@ -55,11 +63,19 @@ enum QueryLoggingSolverType {
   ALL_KQUERY,    ///< Log all queries in .kquery (KQuery) format
   ALL_SMTLIB,    ///< Log all queries .smt2 (SMT-LIBv2) format
   SOLVER_KQUERY, ///< Log queries passed to solver in .kquery (KQuery) format
-  SOLVER_SMTLIB  ///< Log queries passed to solver in .smt2 (SMT-LIBv2) format
+  SOLVER_SMTLIB, ///< Log queries passed to solver in .smt2 (SMT-LIBv2) format
+  ALL_BINARY,    ///< Log all queries in the binary query log format
+  SOLVER_BINARY  ///< Log queries passed to solver in the binary format
 };
 
 extern llvm::cl::bits<QueryLoggingSolverType> QueryLoggingOptions;
 
+extern llvm::cl::opt<bool> LogPartialQueriesEarly;
+
+#ifdef HAVE_ZLIB_H
+extern llvm::cl::opt<bool> CreateCompressedQueryLog;
+#endif
+
 enum CoreSolverType {
   STP_SOLVER,
   METASMT_SOLVER,
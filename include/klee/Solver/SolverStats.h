@@ -10,9 +10,33 @@
 #ifndef KLEE_SOLVERSTATS_H
 #define KLEE_SOLVERSTATS_H
 
+#include "klee/Statistics/LatencyHistogram.h"
 #include "klee/Statistics/Statistic.h"
 
+#include <cstdint>
+
+/// \cond DO_NOT_DOCUMENT
+#define SOLVER_LAYERS                                                          \
+  SLAYER(Independent)                                                          \
+  SLAYER(Caching)                                                              \
+  SLAYER(CexCaching)                                                           \
+  SLAYER(FastCex)                                                              \
+  SLAYER(Core)
+/// \endcond
+
 namespace klee {
+
+/// Layers of the solver chain that can be monitored (--solver-layer-stats)
+enum class SolverLayer : std::uint8_t {
+  /// \cond DO_NOT_DOCUMENT
+  #undef SLAYER
+  #define SLAYER(Name) Name,
+  SOLVER_LAYERS
+  /// \endcond
+};
+
+const char *getSolverLayerName(SolverLayer layer);
+
 namespace stats {
 
   extern Statistic cexCacheTime;
@@ -27,7 +51,23 @@ namespace stats {
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
   extern Statistic queryTime;
-  
+  extern Statistic z3ConstructCacheHits;
+  extern Statistic z3ConstructCacheMisses;
+
+  /// Per-layer statistics of the solver chain: queries entering the layer,
+  /// queries it answered without consulting the next monitored layer (not
+  /// recorded for the core solver), and time spent in it including all
+  /// layers below (in microseconds).
+  #undef SLAYER
+  #define SLAYER(Name)                                                         \
+    extern Statistic solver##Name##Queries;                                    \
+    extern Statistic solver##Name##Hits;                                       \
+    extern Statistic solver##Name##Time;
+  SOLVER_LAYERS
+
+  /// Latency distribution of a solver chain layer (in nanoseconds)
+  LatencyHistogram &getSolverLayerLatency(SolverLayer layer);
+
 #ifdef KLEE_ARRAY_DEBUG
   extern Statistic arrayHashTime;
 #endif
@@ -0,0 +1,144 @@
+//===-- BinaryIStats.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BINARYISTATS_H
+#define KLEE_BINARYISTATS_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+
+/// Binary, columnar alternative to the callgrind-format run.istats file.
+///
+/// The file starts with a layout record describing the events (statistics),
+/// source files, functions, and instructions ("rows") once. Every snapshot
+/// that follows only contains the counters that changed since the previous
+/// snapshot, stored per event column as (row delta, value) pairs in LEB128
+/// encoding, followed by the changed call-site summaries. All records are
+/// length-prefixed, so a snapshot that was cut short by a crash is simply
+/// ignored by readers.
+///
+/// The klee-istats tool converts a snapshot back to callgrind text.
+
+struct IStatsFunction {
+  std::string name;
+  unsigned file;
+  std::uint64_t assemblyLine;
+  unsigned line;
+  bool defined;
+};
+
+struct IStatsInstruction {
+  unsigned function;
+  unsigned file;
+  unsigned assemblyLine;
+  unsigned line;
+};
+
+struct IStatsLayout {
+  std::string cmd;
+  std::string object;
+  std::uint64_t pid = 0;
+  /// (short name, name) of every event
+  std::vector<std::pair<std::string, std::string>> events;
+  std::vector<std::string> files;
+  std::vector<IStatsFunction> functions;
+  /// One row per instruction, grouped by function in output order
+  std::vector<IStatsInstruction> instructions;
+};
+
+struct IStatsCallSite {
+  unsigned row;
+  unsigned callee;
+  std::uint64_t count;
+  /// One value per event
+  std::vector<std::uint64_t> values;
+};
+
+class BinaryIStatsWriter {
+  llvm::raw_ostream &os;
+  const unsigned numEvents;
+  const unsigned numRows;
+
+  /// Last written value per event (event-major)
+  std::vector<std::uint64_t> previous;
+  /// Last written (count, values...) per (row, callee)
+  std::map<std::pair<unsigned, unsigned>, std::vector<std::uint64_t>>
+      previousCallSites;
+
+  std::string snapshot;
+  unsigned nextEvent = 0;
+
+public:
+  /// Writes the file header and layout record to `os`
+  BinaryIStatsWriter(llvm::raw_ostream &os, const IStatsLayout &layout);
+
+  BinaryIStatsWriter(const BinaryIStatsWriter &) = delete;
+  BinaryIStatsWriter &operator=(const BinaryIStatsWriter &) = delete;
+
+  /// Starts a snapshot taken `time` microseconds after the start of the run
+  void beginSnapshot(std::uint64_t time);
+
+  /// Adds the current values of the next event, one per row
+  void addColumn(const std::uint64_t *values);
+
+  /// Adds the current call-site summaries
+  void addCallSites(const std::vector<IStatsCallSite> &callSites);
+
+  /// Appends the snapshot record to the stream
+  void endSnapshot();
+};
+
+class BinaryIStatsReader {
+  std::string data;
+  std::size_t position = 0;
+
+  IStatsLayout layout;
+  std::vector<std::uint64_t> values;
+  std::map<std::pair<unsigned, unsigned>, IStatsCallSite> callSites;
+  std::uint64_t time = 0;
+  unsigned snapshots = 0;
+
+public:
+  /// Reads the file at `path`, returns false and sets `error` if it is not a
+  /// binary istats file
+  bool open(const std::string &path, std::string &error);
+
+  const IStatsLayout &getLayout() const { return layout; }
+
+  /// Applies the next snapshot; returns false if there is none
+  bool next();
+
+  /// Returns the number of snapshots applied so far
+  unsigned getSnapshotCount() const { return snapshots; }
+
+  /// Returns the time stamp (in microseconds) of the current snapshot
+  std::uint64_t getTime() const { return time; }
+
+  std::uint64_t getValue(unsigned row, unsigned event) const {
+    return values[event * layout.instructions.size() + row];
+  }
+
+  /// Prints the current snapshot in callgrind format, as written to
+  /// run.istats
+  void printCallgrind(std::ostream &os) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_BINARYISTATS_H */
@@ -0,0 +1,82 @@
+//===-- LatencyHistogram.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_LATENCYHISTOGRAM_H
+#define KLEE_LATENCYHISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace klee {
+
+/// HDR-style histogram with log-linear buckets: every power of two is split
+/// into 2^SubBucketBits equally sized buckets, so recorded values keep three
+/// significant bits (a relative error of at most 12.5%) over the whole
+/// 64-bit range in a fixed amount of memory.
+class LatencyHistogram {
+  static constexpr unsigned SubBucketBits = 3;
+  static constexpr unsigned SubBuckets = 1u << SubBucketBits;
+  static constexpr unsigned NumBuckets = (64 - SubBucketBits + 1) * SubBuckets;
+
+  std::array<std::uint64_t, NumBuckets> buckets{};
+  std::uint64_t count = 0;
+  std::uint64_t max = 0;
+
+  static unsigned log2(std::uint64_t value) {
+    return 63 - __builtin_clzll(value);
+  }
+
+public:
+  static unsigned getBucket(std::uint64_t value) {
+    if (value < SubBuckets)
+      return value;
+    const unsigned shift = log2(value) - SubBucketBits;
+    return (shift + 1) * SubBuckets + (value >> shift) - SubBuckets;
+  }
+
+  /// Returns the largest value that falls into `bucket`
+  static std::uint64_t getBucketLimit(unsigned bucket) {
+    if (bucket < SubBuckets)
+      return bucket;
+    const unsigned shift = bucket / SubBuckets - 1;
+    const std::uint64_t base = SubBuckets + bucket % SubBuckets;
+    return (base << shift) + ((std::uint64_t(1) << shift) - 1);
+  }
+
+  void record(std::uint64_t value) {
+    ++buckets[getBucket(value)];
+    ++count;
+    max = std::max(max, value);
+  }
+
+  std::uint64_t getCount() const { return count; }
+  std::uint64_t getMax() const { return max; }
+
+  /// Returns an upper bound of the value below which `percentile` percent of
+  /// the recorded values fall, or 0 if nothing was recorded
+  std::uint64_t getPercentile(double percentile) const {
+    if (!count)
+      return 0;
+    const double rank = std::clamp(percentile, 0.0, 100.0) / 100.0 * count;
+    const std::uint64_t target = std::max<std::uint64_t>(std::ceil(rank), 1);
+    std::uint64_t seen = 0;
+    for (unsigned bucket = 0; bucket < NumBuckets; ++bucket) {
+      seen += buckets[bucket];
+      if (seen >= target)
+        return std::min(getBucketLimit(bucket), max);
+    }
+    return max;
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_LATENCYHISTOGRAM_H */
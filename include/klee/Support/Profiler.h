@@ -0,0 +1,90 @@
+//===-- Profiler.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PROFILER_H
+#define KLEE_PROFILER_H
+
+#include <string>
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace klee {
+
+/// Built-in profiler for KLEE itself (not the program under test).
+///
+/// Code is annotated with named zones (KLEE_PROFILE_ZONE), which form a call
+/// tree at run time. Depending on `--profile`, the profiler either measures
+/// the time spent in every node of that tree with the time-stamp counter
+/// ("zones") or periodically samples the currently active node from a
+/// SIGPROF handler ("sampling"), which has lower overhead for very hot zones.
+/// When profiling is disabled, a zone costs a single, well-predicted branch.
+///
+/// Zones must only be entered from the interpreter thread.
+namespace profiler {
+
+/// True between start() and stop() if profiling was requested
+extern bool active;
+
+/// Returns the id of the zone called `name`, registering it on first use
+unsigned registerZone(const std::string &name);
+
+/// Starts profiling if requested on the command line
+void start();
+
+/// Stops profiling; the collected data stays available for writing
+void stop();
+
+/// Returns true if profiling was requested on the command line
+bool isEnabled();
+
+void enter(unsigned zone);
+void leave();
+
+/// Writes one line per call path ("a;b;c <self weight>") as consumed by
+/// flamegraph.pl and similar tools
+void writeFoldedStacks(llvm::raw_ostream &os);
+
+/// Writes a per-zone table with calls, inclusive and exclusive weights
+void writeSummary(llvm::raw_ostream &os);
+
+} // namespace profiler
+
+/// RAII helper that attributes the lifetime of the object to `zone`
+class ProfileZone {
+  const bool entered;
+
+public:
+  explicit ProfileZone(unsigned zone) : entered(profiler::active) {
+    if (entered)
+      profiler::enter(zone);
+  }
+  ~ProfileZone() {
+    if (entered)
+      profiler::leave();
+  }
+
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+};
+
+} // namespace klee
+
+#define KLEE_PROFILE_CONCAT_(a, b) a##b
+#define KLEE_PROFILE_CONCAT(a, b) KLEE_PROFILE_CONCAT_(a, b)
+
+/// Attributes the rest of the enclosing scope to the zone called `name`
+#define KLEE_PROFILE_ZONE(name)                                                \
+  static const unsigned KLEE_PROFILE_CONCAT(profileZoneId, __LINE__) =         \
+      ::klee::profiler::registerZone(name);                                    \
+  ::klee::ProfileZone KLEE_PROFILE_CONCAT(profileZone, __LINE__)(              \
+      KLEE_PROFILE_CONCAT(profileZoneId, __LINE__))
+
+#endif /* KLEE_PROFILER_H */
@@ -16,6 +16,12 @@ namespace klee {
   namespace util {
     /// Get total malloc usage in bytes
     size_t GetTotalMallocUsage();
+
+    /// Get the number of page faults serviced without I/O so far
+    size_t GetMinorPageFaults();
+
+    /// Get the number of page faults that required I/O so far
+    size_t GetMajorPageFaults();
   }
 }
 
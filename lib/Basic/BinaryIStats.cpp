@@ -0,0 +1,401 @@
+//===-- BinaryIStats.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Statistics/BinaryIStats.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace klee;
+
+static const char IStatsMagic[8] = {'K', 'L', 'E', 'E', 'I', 'S', 'T', 'S'};
+static const unsigned IStatsVersion = 1;
+
+enum RecordKind : char { LayoutRecord = 'L', SnapshotRecord = 'S' };
+
+static void writeVarint(std::string &out, std::uint64_t value) {
+  do {
+    char byte = value & 0x7f;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    out.push_back(byte);
+  } while (value);
+}
+
+static void writeString(std::string &out, const std::string &s) {
+  writeVarint(out, s.size());
+  out += s;
+}
+
+static void writeRecord(llvm::raw_ostream &os, RecordKind kind,
+                        const std::string &payload) {
+  std::string header(1, kind);
+  writeVarint(header, payload.size());
+  os << header << payload;
+}
+
+namespace {
+/// Bounds-checked cursor over a record payload
+class Decoder {
+  const char *pos, *end;
+
+public:
+  bool ok = true;
+
+  Decoder(const char *begin, const char *end) : pos(begin), end(end) {}
+
+  const char *current() const { return pos; }
+  std::size_t remaining() const { return end - pos; }
+
+  std::uint64_t varint() {
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; ok; shift += 7) {
+      if (pos == end || shift > 63) {
+        ok = false;
+        break;
+      }
+      const unsigned char byte = *pos++;
+      value |= std::uint64_t(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        break;
+    }
+    return value;
+  }
+
+  /// Reads an element count; every element takes at least one byte
+  std::size_t count() {
+    const std::uint64_t n = varint();
+    if (n > remaining())
+      ok = false;
+    return ok ? n : 0;
+  }
+
+  std::string string() {
+    const std::uint64_t size = varint();
+    if (!ok || size > std::uint64_t(end - pos)) {
+      ok = false;
+      return {};
+    }
+    std::string s(pos, size);
+    pos += size;
+    return s;
+  }
+};
+} // namespace
+
+/// Locates the record at `position` and advances past it; returns false if
+/// there is no complete record left
+static bool readRecord(const std::string &data, std::size_t &position,
+                       char &kind, const char *&begin, const char *&end) {
+  if (position >= data.size())
+    return false;
+  kind = data[position];
+  Decoder d(data.data() + position + 1, data.data() + data.size());
+  const std::uint64_t size = d.varint();
+  if (!d.ok || size > d.remaining())
+    return false;
+  begin = d.current();
+  end = begin + size;
+  position = end - data.data();
+  return true;
+}
+
+/***/
+
+BinaryIStatsWriter::BinaryIStatsWriter(llvm::raw_ostream &os,
+                                       const IStatsLayout &layout)
+    : os(os), numEvents(layout.events.size()),
+      numRows(layout.instructions.size()),
+      previous(std::size_t(numEvents) * numRows, 0) {
+  std::string header(IStatsMagic, sizeof(IStatsMagic));
+  writeVarint(header, IStatsVersion);
+  os << header;
+
+  std::string payload;
+  writeString(payload, layout.cmd);
+  writeString(payload, layout.object);
+  writeVarint(payload, layout.pid);
+  writeVarint(payload, layout.events.size());
+  for (const auto &[shortName, name] : layout.events) {
+    writeString(payload, shortName);
+    writeString(payload, name);
+  }
+  writeVarint(payload, layout.files.size());
+  for (const auto &file : layout.files)
+    writeString(payload, file);
+  writeVarint(payload, layout.functions.size());
+  for (const auto &f : layout.functions) {
+    writeString(payload, f.name);
+    writeVarint(payload, f.file);
+    writeVarint(payload, f.assemblyLine);
+    writeVarint(payload, f.line);
+    writeVarint(payload, f.defined);
+  }
+  writeVarint(payload, layout.instructions.size());
+  for (const auto &i : layout.instructions) {
+    writeVarint(payload, i.function);
+    writeVarint(payload, i.file);
+    writeVarint(payload, i.assemblyLine);
+    writeVarint(payload, i.line);
+  }
+  writeRecord(os, LayoutRecord, payload);
+}
+
+void BinaryIStatsWriter::beginSnapshot(std::uint64_t time) {
+  snapshot.clear();
+  nextEvent = 0;
+  writeVarint(snapshot, time);
+}
+
+void BinaryIStatsWriter::addColumn(const std::uint64_t *values) {
+  assert(nextEvent < numEvents && "too many columns");
+  std::uint64_t *last = &previous[std::size_t(nextEvent++) * numRows];
+
+  unsigned changed = 0;
+  for (unsigned row = 0; row < numRows; ++row)
+    changed += values[row] != last[row];
+
+  writeVarint(snapshot, changed);
+  unsigned lastRow = 0;
+  for (unsigned row = 0; row < numRows; ++row) {
+    if (values[row] == last[row])
+      continue;
+    writeVarint(snapshot, row - lastRow);
+    writeVarint(snapshot, values[row]);
+    last[row] = values[row];
+    lastRow = row;
+  }
+}
+
+void BinaryIStatsWriter::addCallSites(
+    const std::vector<IStatsCallSite> &callSites) {
+  assert(nextEvent == numEvents && "columns missing");
+
+  std::string changed;
+  unsigned numChanged = 0;
+  std::vector<std::uint64_t> current;
+  for (const auto &cs : callSites) {
+    assert(cs.values.size() == numEvents);
+    current.clear();
+    current.push_back(cs.count);
+    current.insert(current.end(), cs.values.begin(), cs.values.end());
+
+    auto &last = previousCallSites[{cs.row, cs.callee}];
+    if (last == current)
+      continue;
+    last = current;
+
+    ++numChanged;
+    writeVarint(changed, cs.row);
+    writeVarint(changed, cs.callee);
+    for (const auto value : current)
+      writeVarint(changed, value);
+  }
+
+  writeVarint(snapshot, numChanged);
+  snapshot += changed;
+  nextEvent = numEvents + 1;
+}
+
+void BinaryIStatsWriter::endSnapshot() {
+  if (nextEvent == numEvents)
+    addCallSites({});
+  assert(nextEvent == numEvents + 1 && "incomplete snapshot");
+  writeRecord(os, SnapshotRecord, snapshot);
+}
+
+/***/
+
+bool BinaryIStatsReader::open(const std::string &path, std::string &error) {
+  std::ifstream is(path, std::ios::in | std::ios::binary);
+  if (!is) {
+    error = "cannot open file";
+    return false;
+  }
+  data.assign(std::istreambuf_iterator<char>(is),
+              std::istreambuf_iterator<char>());
+
+  if (data.size() < sizeof(IStatsMagic) ||
+      memcmp(data.data(), IStatsMagic, sizeof(IStatsMagic))) {
+    error = "not a binary istats file";
+    return false;
+  }
+  Decoder header(data.data() + sizeof(IStatsMagic), data.data() + data.size());
+  if (header.varint() != IStatsVersion || !header.ok) {
+    error = "unsupported binary istats version";
+    return false;
+  }
+  position = header.current() - data.data();
+
+  char kind;
+  const char *begin, *end;
+  if (!readRecord(data, position, kind, begin, end) || kind != LayoutRecord) {
+    error = "missing or truncated layout record";
+    return false;
+  }
+
+  Decoder d(begin, end);
+  layout.cmd = d.string();
+  layout.object = d.string();
+  layout.pid = d.varint();
+  layout.events.resize(d.count());
+  for (auto &event : layout.events) {
+    event.first = d.string();
+    event.second = d.string();
+  }
+  layout.files.resize(d.count());
+  for (auto &file : layout.files)
+    file = d.string();
+  layout.functions.resize(d.count());
+  for (auto &f : layout.functions) {
+    f.name = d.string();
+    f.file = d.varint();
+    f.assemblyLine = d.varint();
+    f.line = d.varint();
+    f.defined = d.varint();
+  }
+  layout.instructions.resize(d.count());
+  for (auto &i : layout.instructions) {
+    i.function = d.varint();
+    i.file = d.varint();
+    i.assemblyLine = d.varint();
+    i.line = d.varint();
+    if (i.function >= layout.functions.size() ||
+        i.file >= layout.files.size())
+      d.ok = false;
+  }
+  for (const auto &f : layout.functions) {
+    if (f.file >= layout.files.size())
+      d.ok = false;
+  }
+  if (!d.ok) {
+    error = "corrupt layout record";
+    return false;
+  }
+
+  values.assign(layout.events.size() * layout.instructions.size(), 0);
+  return true;
+}
+
+bool BinaryIStatsReader::next() {
+  char kind;
+  const char *begin, *end;
+  while (readRecord(data, position, kind, begin, end)) {
+    if (kind != SnapshotRecord)
+      continue; // unknown record kinds are skipped
+
+    // decode into copies so that a corrupt snapshot leaves the state intact
+    Decoder d(begin, end);
+    auto newValues = values;
+    auto newCallSites = callSites;
+    const std::uint64_t newTime = d.varint();
+    const std::size_t numRows = layout.instructions.size();
+    for (std::size_t event = 0; d.ok && event < layout.events.size();
+         ++event) {
+      std::uint64_t row = 0;
+      for (std::uint64_t n = d.varint(); d.ok && n; --n) {
+        row += d.varint();
+        const std::uint64_t value = d.varint();
+        if (row >= numRows) {
+          d.ok = false;
+          break;
+        }
+        newValues[event * numRows + row] = value;
+      }
+    }
+    for (std::uint64_t n = d.ok ? d.varint() : 0; d.ok && n; --n) {
+      IStatsCallSite cs;
+      cs.row = d.varint();
+      cs.callee = d.varint();
+      cs.count = d.varint();
+      for (std::size_t i = 0; i < layout.events.size(); ++i)
+        cs.values.push_back(d.varint());
+      if (cs.row >= numRows || cs.callee >= layout.functions.size()) {
+        d.ok = false;
+        break;
+      }
+      newCallSites[{cs.row, cs.callee}] = std::move(cs);
+    }
+    if (!d.ok)
+      return false;
+
+    values = std::move(newValues);
+    callSites = std::move(newCallSites);
+    time = newTime;
+    ++snapshots;
+    return true;
+  }
+  return false;
+}
+
+void BinaryIStatsReader::printCallgrind(std::ostream &os) const {
+  os << "version: 1\n";
+  os << "creator: klee\n";
+  os << "pid: " << layout.pid << "\n";
+  os << "cmd: " << layout.cmd << "\n\n";
+  os << "\n";
+
+  os << "positions: instr line\n";
+  for (const auto &[shortName, name] : layout.events)
+    os << "event: " << shortName << " : " << name << "\n";
+  os << "events: ";
+  for (const auto &event : layout.events)
+    os << event.first << " ";
+  os << "\n";
+
+  os << "ob=" << layout.object << "\n";
+
+  const std::size_t numRows = layout.instructions.size();
+  std::string sourceFile = "";
+  auto callSite = callSites.begin();
+  unsigned currentFunction = ~0u;
+  for (std::size_t row = 0; row < numRows; ++row) {
+    const IStatsInstruction &ii = layout.instructions[row];
+    if (ii.function != currentFunction) {
+      // Always try to write the filename before the function name, as
+      // otherwise KCachegrind can create two entries for the function.
+      currentFunction = ii.function;
+      const IStatsFunction &f = layout.functions[currentFunction];
+      if (layout.files[f.file] != sourceFile) {
+        sourceFile = layout.files[f.file];
+        os << "fl=" << sourceFile << "\n";
+      }
+      os << "fn=" << f.name << "\n";
+    }
+    if (layout.files[ii.file] != sourceFile) {
+      sourceFile = layout.files[ii.file];
+      os << "fl=" << sourceFile << "\n";
+    }
+    os << ii.assemblyLine << " " << ii.line << " ";
+    for (std::size_t event = 0; event < layout.events.size(); ++event)
+      os << values[event * numRows + row] << " ";
+    os << "\n";
+
+    for (; callSite != callSites.end() && callSite->first.first == row;
+         ++callSite) {
+      const IStatsCallSite &cs = callSite->second;
+      const IStatsFunction &f = layout.functions[cs.callee];
+      const std::string &calleeFile = layout.files[f.file];
+      if (calleeFile != "" && calleeFile != sourceFile)
+        os << "cfl=" << calleeFile << "\n";
+      os << "cfn=" << f.name << "\n";
+      os << "calls=" << cs.count << " " << f.assemblyLine << " " << f.line
+         << "\n";
+      os << ii.assemblyLine << " " << ii.line << " ";
+      for (const auto value : cs.values)
+        os << value << " ";
+      os << "\n";
+    }
+  }
+}
@@ -8,10 +8,20 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/ADT/KTest.h"
+#include "klee/Config/config.h"
 
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
 
 #define KTEST_VERSION 3
 #define KTEST_MAGIC_SIZE 5
@@ -91,16 +101,11 @@ int kTest_isKTestFile(const char *path) {
   return res;
 }
 
-KTest *kTest_fromFile(const char *path) {
-  FILE *f = fopen(path, "rb");
+/* reads a test following the header from f */
+static KTest *kTest_fromStream(FILE *f) {
   KTest *res = 0;
   unsigned i, version;
 
-  if (!f) 
-    goto error;
-  if (!kTest_checkHeader(f)) 
-    goto error;
-
   res = (KTest*) calloc(1, sizeof(*res));
   if (!res) 
     goto error;
@@ -146,8 +151,6 @@ KTest *kTest_fromFile(const char *path) {
       goto error;
   }
 
-  fclose(f);
-
   return res;
  error:
   if (res) {
@@ -170,17 +173,26 @@ KTest *kTest_fromFile(const char *path) {
     free(res);
   }
 
-  if (f) fclose(f);
-
   return 0;
 }
 
-int kTest_toFile(KTest *bo, const char *path) {
-  FILE *f = fopen(path, "wb");
+KTest *kTest_fromFile(const char *path) {
+  FILE *f = fopen(path, "rb");
+  KTest *res = 0;
+
+  if (!f)
+    return 0;
+  if (kTest_checkHeader(f))
+    res = kTest_fromStream(f);
+  fclose(f);
+
+  return res;
+}
+
+/* writes a complete test, including the header, to f */
+static int kTest_toStream(KTest *bo, FILE *f) {
   unsigned i;
 
-  if (!f) 
-    goto error;
   if (fwrite(KTEST_MAGIC, strlen(KTEST_MAGIC), 1, f)!=1)
     goto error;
   if (!write_uint32(f, KTEST_VERSION))
@@ -210,15 +222,24 @@ int kTest_toFile(KTest *bo, const char *path) {
       goto error;
   }
 
-  fclose(f);
-
   return 1;
  error:
-  if (f) fclose(f);
-  
   return 0;
 }
 
+int kTest_toFile(KTest *bo, const char *path) {
+  FILE *f = fopen(path, "wb");
+  int res;
+
+  if (!f)
+    return 0;
+  res = kTest_toStream(bo, f);
+  if (fclose(f))
+    res = 0;
+
+  return res;
+}
+
 unsigned kTest_numBytes(KTest *bo) {
   unsigned i, res = 0;
   for (i=0; i<bo->numObjects; i++)
@@ -238,3 +259,497 @@ void kTest_free(KTest *bo) {
   free(bo->objects);
   free(bo);
 }
+
+/***/
+
+#define KTEST_ARCHIVE_VERSION 1
+#define KTEST_ARCHIVE_MAGIC "KTARCHIV"
+#define KTEST_ARCHIVE_MAGIC_SIZE 8
+#define KTEST_ARCHIVE_INDEX_MAGIC "KTAINDEX"
+/* magic and version */
+#define KTEST_ARCHIVE_HEADER_SIZE (KTEST_ARCHIVE_MAGIC_SIZE + 4)
+#define KTEST_ARCHIVE_RECORD_MAGIC "KTRC"
+#define KTEST_ARCHIVE_RECORD_MAGIC_SIZE 4
+/* magic, id, flags, stored size, uncompressed size */
+#define KTEST_ARCHIVE_RECORD_HEADER_SIZE (KTEST_ARCHIVE_RECORD_MAGIC_SIZE + 16)
+/* number of tests, index offset and magic */
+#define KTEST_ARCHIVE_TRAILER_SIZE (16 + KTEST_ARCHIVE_MAGIC_SIZE)
+#define KTEST_ARCHIVE_COMPRESSED 1
+
+struct KTestArchive {
+  /* archives opened for appending */
+  FILE *file;
+  int compress;
+
+  /* archives opened for reading */
+  unsigned char *data;
+  size_t size;
+  /* end of the last complete record */
+  uint64_t end;
+  /* per test, lazily created views and decompressed images */
+  KTest **views;
+  unsigned char **images;
+
+  uint64_t *offsets;
+  unsigned numTests;
+  unsigned capacity;
+};
+
+static unsigned get_uint32(const unsigned char *data) {
+  return (((((data[0]<<8) + data[1])<<8) + data[2])<<8) + data[3];
+}
+
+static uint64_t get_uint64(const unsigned char *data) {
+  return ((uint64_t) get_uint32(data) << 32) | get_uint32(data + 4);
+}
+
+static int write_uint64(FILE *f, uint64_t value) {
+  return write_uint32(f, value >> 32) && write_uint32(f, value);
+}
+
+static int kTestArchive_addOffset(KTestArchive *a, uint64_t offset) {
+  if (a->numTests == a->capacity) {
+    unsigned capacity = a->capacity ? 2 * a->capacity : 64;
+    uint64_t *offsets =
+        (uint64_t*) realloc(a->offsets, capacity * sizeof(*offsets));
+    if (!offsets)
+      return 0;
+    a->offsets = offsets;
+    a->capacity = capacity;
+  }
+  a->offsets[a->numTests++] = offset;
+  return 1;
+}
+
+/* Reads the index of a mapped archive. Falls back to scanning the records
+   if the archive was not closed properly. */
+static int kTestArchive_readIndex(KTestArchive *a) {
+  const unsigned char *trailer, *record;
+  uint64_t numTests, indexOffset, offset, i;
+
+  if (a->size >= KTEST_ARCHIVE_HEADER_SIZE + KTEST_ARCHIVE_TRAILER_SIZE) {
+    trailer = a->data + a->size - KTEST_ARCHIVE_TRAILER_SIZE;
+    numTests = get_uint64(trailer);
+    indexOffset = get_uint64(trailer + 8);
+    /* the bound on numTests keeps 8 * numTests from wrapping around */
+    if (!memcmp(trailer + 16, KTEST_ARCHIVE_INDEX_MAGIC,
+                KTEST_ARCHIVE_MAGIC_SIZE) &&
+        indexOffset >= KTEST_ARCHIVE_HEADER_SIZE &&
+        indexOffset <= a->size - KTEST_ARCHIVE_TRAILER_SIZE &&
+        numTests <= (a->size - KTEST_ARCHIVE_TRAILER_SIZE - indexOffset) / 8 &&
+        indexOffset + 8 * numTests + KTEST_ARCHIVE_TRAILER_SIZE == a->size) {
+      for (i = 0; i < numTests; i++) {
+        offset = get_uint64(a->data + indexOffset + 8 * i);
+        if (offset < KTEST_ARCHIVE_HEADER_SIZE || offset > indexOffset ||
+            indexOffset - offset < KTEST_ARCHIVE_RECORD_HEADER_SIZE)
+          return 0;
+        record = a->data + offset;
+        if (memcmp(record, KTEST_ARCHIVE_RECORD_MAGIC,
+                   KTEST_ARCHIVE_RECORD_MAGIC_SIZE) ||
+            get_uint32(record + KTEST_ARCHIVE_RECORD_MAGIC_SIZE + 8) >
+                indexOffset - offset - KTEST_ARCHIVE_RECORD_HEADER_SIZE)
+          return 0;
+        if (!kTestArchive_addOffset(a, offset))
+          return 0;
+      }
+      a->end = indexOffset;
+      return 1;
+    }
+  }
+
+  offset = KTEST_ARCHIVE_HEADER_SIZE;
+  while (offset + KTEST_ARCHIVE_RECORD_HEADER_SIZE <= a->size) {
+    const unsigned char *record = a->data + offset;
+    uint64_t next = offset + KTEST_ARCHIVE_RECORD_HEADER_SIZE +
+                    get_uint32(record + KTEST_ARCHIVE_RECORD_MAGIC_SIZE + 8);
+    if (memcmp(record, KTEST_ARCHIVE_RECORD_MAGIC,
+               KTEST_ARCHIVE_RECORD_MAGIC_SIZE) ||
+        next > a->size)
+      break;
+    if (!kTestArchive_addOffset(a, offset))
+      return 0;
+    offset = next;
+  }
+  a->end = offset;
+  return 1;
+}
+
+/* Returns the .ktest image of the test at index, decompressing it if
+   necessary. */
+static const unsigned char *kTestArchive_getImage(KTestArchive *a,
+                                                  unsigned index,
+                                                  unsigned *size) {
+  const unsigned char *record;
+  unsigned flags, storedSize;
+
+  if (!a->data || index >= a->numTests)
+    return 0;
+  record = a->data + a->offsets[index] + KTEST_ARCHIVE_RECORD_MAGIC_SIZE;
+  flags = get_uint32(record + 4);
+  storedSize = get_uint32(record + 8);
+  *size = get_uint32(record + 12);
+  record += 16;
+
+  if (!(flags & KTEST_ARCHIVE_COMPRESSED)) {
+    if (*size != storedSize)
+      return 0;
+    return record;
+  }
+
+#ifdef HAVE_ZLIB_H
+  if (!a->images[index]) {
+    uLongf length = *size;
+    unsigned char *image = (unsigned char*) malloc(*size ? *size : 1);
+    if (!image)
+      return 0;
+    if (uncompress(image, &length, record, storedSize) != Z_OK ||
+        length != *size) {
+      free(image);
+      return 0;
+    }
+    a->images[index] = image;
+  }
+  return a->images[index];
+#else
+  return 0;
+#endif
+}
+
+int kTestArchive_isArchive(const char *path) {
+  FILE *f = fopen(path, "rb");
+  char header[KTEST_ARCHIVE_MAGIC_SIZE];
+  int res;
+
+  if (!f)
+    return 0;
+  res = fread(header, KTEST_ARCHIVE_MAGIC_SIZE, 1, f) == 1 &&
+        !memcmp(header, KTEST_ARCHIVE_MAGIC, KTEST_ARCHIVE_MAGIC_SIZE);
+  fclose(f);
+
+  return res;
+}
+
+KTestArchive *kTestArchive_open(const char *path) {
+  KTestArchive *a = 0;
+  struct stat st;
+  void *data;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0)
+    return 0;
+  if (fstat(fd, &st) || (size_t) st.st_size < KTEST_ARCHIVE_HEADER_SIZE)
+    goto error;
+  data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    goto error;
+  close(fd);
+  fd = -1;
+
+  a = (KTestArchive*) calloc(1, sizeof(*a));
+  if (!a) {
+    munmap(data, st.st_size);
+    goto error;
+  }
+  a->data = (unsigned char*) data;
+  a->size = st.st_size;
+
+  if (memcmp(a->data, KTEST_ARCHIVE_MAGIC, KTEST_ARCHIVE_MAGIC_SIZE) ||
+      get_uint32(a->data + KTEST_ARCHIVE_MAGIC_SIZE) > KTEST_ARCHIVE_VERSION)
+    goto error;
+  if (!kTestArchive_readIndex(a))
+    goto error;
+
+  a->views = (KTest**) calloc(a->numTests + 1, sizeof(*a->views));
+  a->images = (unsigned char**) calloc(a->numTests + 1, sizeof(*a->images));
+  if (!a->views || !a->images)
+    goto error;
+
+  return a;
+ error:
+  if (a)
+    kTestArchive_close(a);
+  if (fd >= 0)
+    close(fd);
+
+  return 0;
+}
+
+KTestArchive *kTestArchive_openForAppend(const char *path, int compress) {
+  KTestArchive *a = 0, *existing = 0;
+  FILE *f = fopen(path, "r+b");
+
+  if (f && (fseek(f, 0, SEEK_END) || ftell(f) != 0)) {
+    /* recover the offsets and drop the index, it is rewritten on close */
+    existing = kTestArchive_open(path);
+    if (!existing)
+      goto error;
+    if (ftruncate(fileno(f), existing->end) ||
+        fseek(f, existing->end, SEEK_SET))
+      goto error;
+  } else {
+    if (!f)
+      f = fopen(path, "wb");
+    if (!f)
+      goto error;
+    if (fwrite(KTEST_ARCHIVE_MAGIC, KTEST_ARCHIVE_MAGIC_SIZE, 1, f) != 1 ||
+        !write_uint32(f, KTEST_ARCHIVE_VERSION))
+      goto error;
+  }
+
+  a = (KTestArchive*) calloc(1, sizeof(*a));
+  if (!a)
+    goto error;
+  a->file = f;
+#ifdef HAVE_ZLIB_H
+  a->compress = compress;
+#else
+  (void) compress;
+#endif
+  if (existing) {
+    a->offsets = existing->offsets;
+    a->numTests = existing->numTests;
+    a->capacity = existing->capacity;
+    existing->offsets = 0;
+    existing->numTests = 0;
+    kTestArchive_close(existing);
+  }
+
+  return a;
+ error:
+  if (existing)
+    kTestArchive_close(existing);
+  if (f)
+    fclose(f);
+
+  return 0;
+}
+
+int kTestArchive_append(KTestArchive *a, KTest *bo, unsigned id) {
+  char *image = 0;
+  size_t size = 0;
+  const unsigned char *stored;
+  size_t storedSize;
+  unsigned flags = 0;
+  long offset;
+  int res = 0;
+  FILE *f;
+#ifdef HAVE_ZLIB_H
+  unsigned char *compressed = 0;
+#endif
+
+  if (!a->file)
+    return 0;
+
+  /* serialise into memory first, the record header holds the size */
+  f = open_memstream(&image, &size);
+  if (!f)
+    return 0;
+  if (!kTest_toStream(bo, f)) {
+    fclose(f);
+    goto error;
+  }
+  if (fclose(f))
+    goto error;
+  stored = (const unsigned char*) image;
+  storedSize = size;
+
+#ifdef HAVE_ZLIB_H
+  if (a->compress) {
+    uLongf length = compressBound(size);
+    compressed = (unsigned char*) malloc(length);
+    if (!compressed)
+      goto error;
+    if (compress2(compressed, &length, (const Bytef*) image, size,
+                  Z_BEST_SPEED) != Z_OK)
+      goto error;
+    if (length < size) {
+      stored = compressed;
+      storedSize = length;
+      flags |= KTEST_ARCHIVE_COMPRESSED;
+    }
+  }
+#endif
+
+  offset = ftell(a->file);
+  if (offset < 0)
+    goto error;
+  if (fwrite(KTEST_ARCHIVE_RECORD_MAGIC, KTEST_ARCHIVE_RECORD_MAGIC_SIZE, 1,
+             a->file) != 1 ||
+      !write_uint32(a->file, id) || !write_uint32(a->file, flags) ||
+      !write_uint32(a->file, storedSize) || !write_uint32(a->file, size) ||
+      fwrite(stored, storedSize, 1, a->file) != 1)
+    goto error;
+  res = kTestArchive_addOffset(a, offset);
+
+ error:
+#ifdef HAVE_ZLIB_H
+  free(compressed);
+#endif
+  free(image);
+
+  return res;
+}
+
+unsigned kTestArchive_numTests(KTestArchive *a) {
+  return a->numTests;
+}
+
+unsigned kTestArchive_getID(KTestArchive *a, unsigned index) {
+  if (!a->data || index >= a->numTests)
+    return 0;
+  return get_uint32(a->data + a->offsets[index] +
+                    KTEST_ARCHIVE_RECORD_MAGIC_SIZE);
+}
+
+KTest *kTestArchive_view(KTestArchive *a, unsigned index) {
+  const unsigned char *pos, *end;
+  KTest *res;
+  unsigned i, size, length;
+
+  if (a->views && index < a->numTests && a->views[index])
+    return a->views[index];
+  pos = kTestArchive_getImage(a, index, &size);
+  if (!pos)
+    return 0;
+  end = pos + size;
+
+#define VIEW_UINT32(value)                                                     \
+  do {                                                                         \
+    if (end - pos < 4)                                                         \
+      goto error;                                                              \
+    (value) = get_uint32(pos);                                                 \
+    pos += 4;                                                                  \
+  } while (0)
+#define VIEW_STRING(value)                                                     \
+  do {                                                                         \
+    VIEW_UINT32(length);                                                       \
+    if ((unsigned) (end - pos) < length)                                       \
+      goto error;                                                              \
+    (value) = (char*) malloc(length + 1);                                      \
+    if (!(value))                                                              \
+      goto error;                                                              \
+    memcpy((value), pos, length);                                              \
+    (value)[length] = 0;                                                       \
+    pos += length;                                                             \
+  } while (0)
+
+  res = (KTest*) calloc(1, sizeof(*res));
+  if (!res)
+    return 0;
+  if (end - pos < KTEST_MAGIC_SIZE ||
+      (memcmp(pos, KTEST_MAGIC, KTEST_MAGIC_SIZE) &&
+       memcmp(pos, BOUT_MAGIC, KTEST_MAGIC_SIZE)))
+    goto error;
+  pos += KTEST_MAGIC_SIZE;
+
+  VIEW_UINT32(res->version);
+  if (res->version > kTest_getCurrentVersion())
+    goto error;
+
+  VIEW_UINT32(res->numArgs);
+  res->args = (char**) calloc(res->numArgs, sizeof(*res->args));
+  if (!res->args)
+    goto error;
+  for (i=0; i<res->numArgs; i++)
+    VIEW_STRING(res->args[i]);
+
+  if (res->version >= 2) {
+    VIEW_UINT32(res->symArgvs);
+    VIEW_UINT32(res->symArgvLen);
+  }
+
+  VIEW_UINT32(res->numObjects);
+  res->objects = (KTestObject*) calloc(res->numObjects, sizeof(*res->objects));
+  if (!res->objects)
+    goto error;
+  for (i=0; i<res->numObjects; i++) {
+    KTestObject *o = &res->objects[i];
+    VIEW_STRING(o->name);
+    VIEW_UINT32(o->numBytes);
+    if ((unsigned) (end - pos) < o->numBytes)
+      goto error;
+    /* object data is not copied but refers to the mapped archive */
+    o->bytes = (unsigned char*) pos;
+    pos += o->numBytes;
+  }
+
+#undef VIEW_STRING
+#undef VIEW_UINT32
+
+  a->views[index] = res;
+  return res;
+ error:
+  for (i=0; res->args && i<res->numArgs; i++)
+    free(res->args[i]);
+  free(res->args);
+  for (i=0; res->objects && i<res->numObjects; i++)
+    free(res->objects[i].name);
+  free(res->objects);
+  free(res);
+
+  return 0;
+}
+
+KTest *kTestArchive_read(KTestArchive *a, unsigned index) {
+  const unsigned char *image;
+  unsigned size;
+  KTest *res = 0;
+  FILE *f;
+
+  image = kTestArchive_getImage(a, index, &size);
+  if (!image)
+    return 0;
+  f = fmemopen((void*) image, size, "rb");
+  if (!f)
+    return 0;
+  if (kTest_checkHeader(f))
+    res = kTest_fromStream(f);
+  fclose(f);
+
+  return res;
+}
+
+int kTestArchive_close(KTestArchive *a) {
+  unsigned i;
+  int res = 1;
+  long indexOffset;
+
+  if (a->file) {
+    indexOffset = ftell(a->file);
+    if (indexOffset < 0)
+      res = 0;
+    for (i=0; res && i<a->numTests; i++)
+      res = write_uint64(a->file, a->offsets[i]);
+    res = res && write_uint64(a->file, a->numTests) &&
+          write_uint64(a->file, indexOffset) &&
+          fwrite(KTEST_ARCHIVE_INDEX_MAGIC, KTEST_ARCHIVE_MAGIC_SIZE, 1,
+                 a->file) == 1;
+    if (fclose(a->file))
+      res = 0;
+  }
+
+  if (a->data) {
+    for (i=0; a->views && i<a->numTests; i++) {
+      KTest *view = a->views[i];
+      unsigned j;
+      if (!view)
+        continue;
+      for (j=0; j<view->numArgs; j++)
+        free(view->args[j]);
+      free(view->args);
+      for (j=0; j<view->numObjects; j++)
+        free(view->objects[j].name);
+      free(view->objects);
+      free(view);
+    }
+    for (i=0; a->images && i<a->numTests; i++)
+      free(a->images[i]);
+    munmap(a->data, a->size);
+  }
+  free(a->views);
+  free(a->images);
+  free(a->offsets);
+  free(a);
+
+  return res;
+}
@@ -16,6 +16,7 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprBuilder.h"
 #include "klee/Statistics/TimerStatIncrementer.h"
+#include "klee/Support/Profiler.h"
 
 #include "CoreStats.h"
 
@@ -26,11 +27,18 @@ using namespace klee;
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
-  objects = objects.replace(std::make_pair(mo, os));
+  if (const auto res = objects.lookup(mo))
+    if (res->second->copyOnWriteOwner == cowKey)
+      exclusiveSize -= res->second->size;
+  exclusiveSize += os->size;
+  objects.replaceInPlace(std::make_pair(mo, os));
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
-  objects = objects.remove(mo);
+  if (const auto res = objects.lookup(mo))
+    if (res->second->copyOnWriteOwner == cowKey)
+      exclusiveSize -= res->second->size;
+  objects.removeInPlace(mo);
 }
 
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
@@ -49,7 +57,8 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
   // Add a copy of this object state that can be updated
   ref<ObjectState> newObjectState(new ObjectState(*os));
   newObjectState->copyOnWriteOwner = cowKey;
-  objects = objects.replace(std::make_pair(mo, newObjectState));
+  exclusiveSize += newObjectState->size;
+  objects.replaceInPlace(std::make_pair(mo, newObjectState));
   return newObjectState.get();
 }
 
@@ -84,6 +93,7 @@ bool AddressSpace::resolveOne(ExecutionState &state,
     success = resolveOne(CE, result);
     return true;
   } else {
+    KLEE_PROFILE_ZONE("AddressSpace::resolveOne");
     TimerStatIncrementer timer(stats::resolveTime);
 
     // try cheap search, will succeed for any inbounds pointer
@@ -214,6 +224,7 @@ bool AddressSpace::resolve(ExecutionState &state, TimingSolver *solver,
       rl.push_back(res);
     return false;
   } else {
+    KLEE_PROFILE_ZONE("AddressSpace::resolve");
     TimerStatIncrementer timer(stats::resolveTime);
 
     // XXX in general this isn't exactly what we want... for
@@ -299,6 +310,7 @@ bool AddressSpace::resolve(ExecutionState &state, TimingSolver *solver,
 // then its concrete cache byte isn't being used) but is just a hack.
 
 std::size_t AddressSpace::copyOutConcretes() {
+  KLEE_PROFILE_ZONE("AddressSpace::copyOutConcretes");
   std::size_t numPages{};
   for (const auto &object : objects) {
     auto &mo = object.first;
@@ -320,6 +332,7 @@ void AddressSpace::copyOutConcrete(const MemoryObject *mo,
 }
 
 bool AddressSpace::copyInConcretes(bool concretize) {
+  KLEE_PROFILE_ZONE("AddressSpace::copyInConcretes");
   for (auto &obj : objects) {
     const MemoryObject *mo = obj.first;
 
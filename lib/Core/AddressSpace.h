@@ -13,7 +13,7 @@
 #include "Memory.h"
 
 #include "klee/Expr/Expr.h"
-#include "klee/ADT/ImmutableMap.h"
+#include "klee/ADT/ImmutableBTreeMap.h"
 #include "klee/System/Time.h"
 
 namespace klee {
@@ -32,7 +32,8 @@ namespace klee {
     bool operator()(const MemoryObject *a, const MemoryObject *b) const;
   };
 
-  typedef ImmutableMap<const MemoryObject *, ref<ObjectState>, MemoryObjectLT>
+  typedef ImmutableBTreeMap<const MemoryObject *, ref<ObjectState>,
+                            MemoryObjectLT>
       MemoryMap;
 
   class AddressSpace {
@@ -40,6 +41,10 @@ namespace klee {
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
+    /// Number of bytes held by the objects this address space owns, i.e.
+    /// the memory that would be released together with it.
+    mutable std::size_t exclusiveSize = 0;
+
     /// Unsupported, use copy constructor
     AddressSpace &operator=(const AddressSpace &);
 
@@ -65,7 +70,11 @@ namespace klee {
     MemoryMap objects;
 
     AddressSpace() : cowKey(1) {}
-    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) { }
+    AddressSpace(const AddressSpace &b) : cowKey(++b.cowKey), objects(b.objects) {
+      // Bumping the key of `b` hands over ownership of all its objects to
+      // the shared map: neither copy owns anything until it writes.
+      b.exclusiveSize = 0;
+    }
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
@@ -112,6 +121,10 @@ namespace klee {
     /// Lookup a binding from a MemoryObject.
     const ObjectState *findObject(const MemoryObject *mo) const;
 
+    /// Returns the number of bytes of object state owned exclusively by this
+    /// address space, i.e. not shared with any other state.
+    std::size_t getExclusiveSize() const { return exclusiveSize; }
+
     /// \brief Obtain an ObjectState suitable for writing.
     ///
     /// This returns a writeable object state, creating a new copy of
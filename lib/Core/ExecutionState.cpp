@@ -397,3 +397,12 @@ void ExecutionState::addConstraint(ref<Expr> e) {
 void ExecutionState::addCexPreference(const ref<Expr> &cond) {
   cexPreferences = cexPreferences.insert(cond);
 }
+
+std::size_t ExecutionState::getMemoryFootprint() const {
+  std::size_t footprint = sizeof(ExecutionState);
+  footprint += addressSpace.getExclusiveSize();
+  for (const auto &sf : stack)
+    footprint += sizeof(StackFrame) + sf.kf->numRegisters * sizeof(Cell);
+  footprint += constraints.size() * sizeof(ref<Expr>);
+  return footprint;
+}
@@ -286,6 +286,12 @@ public:
   bool merge(const ExecutionState &b);
   void dumpStack(llvm::raw_ostream &out) const;
 
+  /// @brief Estimate of the memory (in bytes) that would be released by
+  /// terminating this state: exclusively owned object states, the stack
+  /// frames and the constraint list. Expressions are shared between states
+  /// and therefore not attributed.
+  std::size_t getMemoryFootprint() const;
+
   std::uint32_t getID() const { return id; };
   void setID() { id = nextID++; };
   static std::uint32_t getLastID() { return nextID - 1; };
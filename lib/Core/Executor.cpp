@@ -34,6 +34,7 @@
 #include "klee/Core/Interpreter.h"
 #include "klee/Expr/ArrayExprOptimizer.h"
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/CompiledExpr.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprBuilder.h"
 #include "klee/Expr/ExprPPrinter.h"
@@ -54,6 +55,7 @@
 #include "klee/Support/FileHandling.h"
 #include "klee/Support/ModuleUtil.h"
 #include "klee/Support/OptionCategories.h"
+#include "klee/Support/Profiler.h"
 #include "klee/System/MemoryUsage.h"
 #include "klee/System/Time.h"
 
@@ -527,7 +529,9 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
       interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
       interpreterHandler->getOutputFilename(ALL_QUERIES_KQUERY_FILE_NAME),
-      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME));
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_KQUERY_FILE_NAME),
+      interpreterHandler->getOutputFilename(ALL_QUERIES_BINARY_FILE_NAME),
+      interpreterHandler->getOutputFilename(SOLVER_QUERIES_BINARY_FILE_NAME));
 
   this->solver = std::make_unique<TimingSolver>(std::move(solver), EqualitySubstitution);
   memory = std::make_unique<MemoryManager>(&arrayCache);
@@ -915,6 +919,19 @@ bool Executor::branchingPermitted(const ExecutionState &state) const {
   return true;
 }
 
+/// Evaluates the `i`-th expression of `compiled` under all `seeds` at once
+static std::vector<ref<Expr>> evaluateSeeds(const CompiledExpr &compiled,
+                                            const std::vector<SeedInfo> &seeds,
+                                            unsigned i = 0) {
+  std::vector<const Assignment *> assignments;
+  assignments.reserve(seeds.size());
+  for (const auto &seed : seeds)
+    assignments.push_back(&seed.assignment);
+  std::vector<ref<Expr>> result;
+  compiled.evaluate(assignments, i, result);
+  return result;
+}
+
 void Executor::branch(ExecutionState &state,
                       const std::vector<ref<Expr>> &conditions,
                       std::vector<ExecutionState *> &result,
@@ -961,13 +978,17 @@ void Executor::branch(ExecutionState &state,
     // Assume each seed only satisfies one condition (necessarily true
     // when conditions are mutually exclusive and their conjunction is
     // a tautology).
+    CompiledExpr compiled(conditions.begin(), conditions.end());
+    std::vector<std::vector<ref<Expr>>> evaluated(N);
+    for (unsigned i = 0; i < N; ++i)
+      evaluated[i] = evaluateSeeds(compiled, seeds, i);
     for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
            siie = seeds.end(); siit != siie; ++siit) {
       unsigned i;
       for (i=0; i<N; ++i) {
         ref<ConstantExpr> res;
         bool success = solver->getValue(
-            state.constraints, siit->assignment.evaluate(conditions[i]), res,
+            state.constraints, evaluated[i][siit - seeds.begin()], res,
             state.queryMetaData);
         assert(success && "FIXME: Unhandled solver failure");
         (void) success;
@@ -1058,6 +1079,7 @@ ref<Expr> Executor::maxStaticPctChecks(ExecutionState &current,
 
 Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
                                    bool isInternal, BranchType reason) {
+  KLEE_PROFILE_ZONE("Executor::fork");
   Solver::Validity res;
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&current);
@@ -1123,11 +1145,10 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       res == Solver::Unknown) {
     bool trueSeed=false, falseSeed=false;
     // Is seed extension still ok here?
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
+    const auto evaluated = evaluateSeeds(CompiledExpr(condition), it->second);
+    for (const auto &value : evaluated) {
       ref<ConstantExpr> res;
-      bool success = solver->getValue(current.constraints,
-                                      siit->assignment.evaluate(condition), res,
+      bool success = solver->getValue(current.constraints, value, res,
                                       current.queryMetaData);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
@@ -1185,11 +1206,12 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       it->second.clear();
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
+      const auto evaluated = evaluateSeeds(CompiledExpr(condition), seeds);
       for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
              siie = seeds.end(); siit != siie; ++siit) {
         ref<ConstantExpr> res;
         bool success = solver->getValue(current.constraints,
-                                        siit->assignment.evaluate(condition),
+                                        evaluated[siit - seeds.begin()],
                                         res, current.queryMetaData);
         assert(success && "FIXME: Unhandled solver failure");
         (void) success;
@@ -1250,6 +1272,7 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
 }
 
 void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
+  KLEE_PROFILE_ZONE("Executor::addConstraint");
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(condition)) {
     if (!CE->isTrue())
       llvm::report_fatal_error("attempt to add invalid constraint");
@@ -1261,11 +1284,12 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
     seedMap.find(&state);
   if (it != seedMap.end()) {
     bool warn = false;
+    const auto evaluated = evaluateSeeds(CompiledExpr(condition), it->second);
     for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
            siie = it->second.end(); siit != siie; ++siit) {
       bool res;
       bool success = solver->mustBeFalse(state.constraints,
-                                         siit->assignment.evaluate(condition),
+                                         evaluated[siit - it->second.begin()],
                                          res, state.queryMetaData);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
@@ -1374,11 +1398,9 @@ ref<klee::ConstantExpr> Executor::getValueFromSeeds(ExecutionState &state,
   if (found == seedMap.end())
     return nullptr;
 
-  auto seeds = found->second;
-  for (auto const &seed : seeds) {
-    auto value = seed.assignment.evaluate(e);
-    if (isa<ConstantExpr>(value))
-      return value;
+  for (const auto &value : evaluateSeeds(CompiledExpr(e), found->second)) {
+    if (auto ce = dyn_cast<ConstantExpr>(value))
+      return ce;
   }
   return nullptr;
 }
@@ -1399,9 +1421,7 @@ void Executor::executeGetValue(ExecutionState &state,
     bindLocal(target, state, value);
   } else {
     std::set< ref<Expr> > values;
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
-      ref<Expr> cond = siit->assignment.evaluate(e);
+    for (ref<Expr> cond : evaluateSeeds(CompiledExpr(e), it->second)) {
       cond = optimizer.optimizeExpr(cond, true);
       ref<ConstantExpr> value;
       bool success =
@@ -2136,8 +2156,22 @@ Function *Executor::getTargetFunction(Value *calledVal) {
   }
 }
 
+/// Returns the profiler zone of the handler for `opcode`
+static unsigned getOpcodeZone(unsigned opcode) {
+  static std::vector<unsigned> zones;
+  if (opcode >= zones.size())
+    zones.resize(opcode + 1, 0);
+  if (!zones[opcode])
+    zones[opcode] = profiler::registerZone(
+        std::string("Executor::executeInstruction/") +
+        Instruction::getOpcodeName(opcode));
+  return zones[opcode];
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   Instruction *i = ki->inst;
+  ProfileZone profileZone(profiler::active ? getOpcodeZone(i->getOpcode())
+                                           : 0);
   switch (i->getOpcode()) {
     // Control flow
   case Instruction::Ret: {
@@ -3419,6 +3453,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
 void Executor::updateStates(ExecutionState *current) {
   if (searcher) {
+    KLEE_PROFILE_ZONE("Searcher::update");
     searcher->update(current, addedStates, removedStates);
   }
   
@@ -3577,8 +3612,13 @@ bool Executor::checkMemoryUsage() {
   if ((stats::instructions & 0xFFFFU) != 0) // every 65536 instructions
     return true;
 
-  // check memory limit
-  const auto mallocUsage = util::GetTotalMallocUsage() >> 20U;
+  // check memory limit, not counting the idle slab memory of the expression
+  // allocators, which the system sees as allocated but no state holds on to
+  const auto idleExprBytes =
+      Expr::allocator.getIdleBytes() + UpdateNode::allocator.getIdleBytes();
+  const std::size_t mallocBytes = util::GetTotalMallocUsage();
+  const auto mallocUsage =
+      (mallocBytes - std::min<std::size_t>(mallocBytes, idleExprBytes)) >> 20U;
   const auto mmapUsage = memory->getUsedDeterministicSize() >> 20U;
   const auto totalUsage = mallocUsage + mmapUsage;
   atMemoryLimit = totalUsage > MaxMemory; // inhibit forking
@@ -3589,23 +3629,40 @@ bool Executor::checkMemoryUsage() {
   if (totalUsage <= MaxMemory + 100)
     return true;
 
-  // just guess at how many to kill
+  // upper bound on the number of states to kill (proportional to the excess)
   const auto numStates = states.size();
-  auto toKill = std::max(1UL, numStates - numStates * MaxMemory / totalUsage);
-  klee_warning("killing %lu states (over memory cap: %luMB)", toKill, totalUsage);
-
-  // randomly select states for early termination
-  std::vector<ExecutionState *> arr(states.begin(), states.end()); // FIXME: expensive
-  for (unsigned i = 0, N = arr.size(); N && i < toKill; ++i, --N) {
-    unsigned idx = theRNG.getInt32() % N;
-    // Make two pulls to try and not hit a state that
-    // covered new code.
-    if (arr[idx]->coveredNew)
-      idx = theRNG.getInt32() % N;
-
-    std::swap(arr[idx], arr[N - 1]);
-    terminateStateEarly(*arr[N - 1], "Memory limit exceeded.", StateTerminationType::OutOfMemory);
-  }
+  const auto maxKill =
+      std::max(1UL, numStates - numStates * MaxMemory / totalUsage);
+
+  // Rank states by the memory they would release per unit of coverage
+  // potential. States that covered new code count double, as do states that
+  // covered new instructions recently (few instructions since new coverage).
+  std::vector<std::pair<double, ExecutionState *>> ranked;
+  ranked.reserve(numStates);
+  for (auto *es : states) {
+    double potential = (es->coveredNew ? 2.0 : 1.0) *
+                       (1.0 + 65536.0 / (65536.0 + es->instsSinceCovNew));
+    ranked.emplace_back(es->getMemoryFootprint() / potential, es);
+  }
+  std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+    if (a.first != b.first)
+      return a.first > b.first;
+    return a.second->getID() < b.second->getID();
+  });
+
+  // kill states until the estimated release covers the excess
+  const std::uint64_t excess = (totalUsage - MaxMemory) << 20U;
+  std::uint64_t released = 0;
+  std::size_t toKill = 0;
+  while (toKill < maxKill && toKill < ranked.size() && released < excess)
+    released += ranked[toKill++].second->getMemoryFootprint();
+  klee_warning("killing %zu states (over memory cap: %luMB, releasing ~%" PRIu64
+               "MB)",
+               toKill, totalUsage, released >> 20U);
+
+  for (std::size_t i = 0; i < toKill; ++i)
+    terminateStateEarly(*ranked[i].second, "Memory limit exceeded.",
+                        StateTerminationType::OutOfMemory);
 
   return false;
 }
@@ -3623,6 +3680,7 @@ void Executor::doDumpStates() {
 }
 
 void Executor::run(ExecutionState &initialState) {
+  KLEE_PROFILE_ZONE("Executor::run");
   bindModuleConstants();
 
   // Delay init till now so that ticks don't accrue during optimization and such.
@@ -3701,7 +3759,10 @@ void Executor::run(ExecutionState &initialState) {
 
   // main interpreter loop
   while (!states.empty() && !haltExecution) {
-    ExecutionState &state = searcher->selectState();
+    ExecutionState &state = [this]() -> ExecutionState & {
+      KLEE_PROFILE_ZONE("Searcher::selectState");
+      return searcher->selectState();
+    }();
     KInstruction *ki = state.pc;
     stepInstruction(state);
 
@@ -4434,6 +4495,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                       ref<Expr> address,
                                       ref<Expr> value /* undef if read */,
                                       KInstruction *target /* undef if write */) {
+  KLEE_PROFILE_ZONE("Executor::executeMemoryOperation");
   Expr::Width type = (isWrite ? value->getWidth() : 
                      getWidthForLLVMType(target->inst->getType()));
   unsigned bytes = Expr::getMinBytesForWidth(type);
@@ -21,6 +21,7 @@
 #include "klee/Support/OptionCategories.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Support/ErrorHandling.h"
+#include "klee/Support/Profiler.h"
 
 #include "klee/Support/CompilerWarning.h"
 DISABLE_WARNING_PUSH
@@ -442,6 +443,7 @@ void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
 /***/
 
 ref<Expr> ObjectState::read(ref<Expr> offset, Expr::Width width) const {
+  KLEE_PROFILE_ZONE("ObjectState::read");
   // Truncate offset to 32-bits.
   offset = exprBuilder->ZExt(offset, Expr::Int32);
 
@@ -487,6 +489,7 @@ ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
 }
 
 void ObjectState::write(ref<Expr> offset, ref<Expr> value) {
+  KLEE_PROFILE_ZONE("ObjectState::write");
   // Truncate offset to 32-bits.
   offset = exprBuilder->ZExt(offset, Expr::Int32);
 
@@ -15,6 +15,7 @@
 
 #include "klee/Expr/Expr.h"
 #include "klee/Support/ErrorHandling.h"
+#include "klee/Support/Profiler.h"
 
 #include "klee/Support/CompilerWarning.h"
 DISABLE_WARNING_PUSH
@@ -97,6 +98,18 @@ llvm::cl::opt<std::uintptr_t> DeterministicAllocationStackStartAddress(
     llvm::cl::desc("Start address for stack segment (has to be page aligned)"),
     llvm::cl::cat(MemoryCat));
 
+llvm::cl::opt<bool> DeterministicAllocationHugePages(
+    "kdalloc-huge-pages",
+    llvm::cl::desc("Back deterministic allocator segments with transparent "
+                   "huge pages (default=false)"),
+    llvm::cl::init(false), llvm::cl::cat(MemoryCat));
+
+llvm::cl::opt<int> DeterministicAllocationNumaNode(
+    "kdalloc-numa-node",
+    llvm::cl::desc("Bind deterministic allocator segments to the given NUMA "
+                   "node, -1 to disable (default=-1)"),
+    llvm::cl::init(-1), llvm::cl::cat(MemoryCat));
+
 struct QuarantineSizeParser : public llvm::cl::parser<std::uint32_t> {
   explicit QuarantineSizeParser(llvm::cl::Option &O)
       : llvm::cl::parser<std::uint32_t>(O) {}
@@ -250,6 +263,21 @@ MemoryManager::MemoryManager(ArrayCache *_arrayCache)
                    reinterpret_cast<std::uintptr_t>(
                        factory.get().getMapping().getBaseAddress()),
                    size / (1024 * 1024 * 1024));
+
+      if (DeterministicAllocationHugePages &&
+          !factory.get().getMapping().adviseHugePages()) {
+        klee_warning("Deterministic allocator: Could not enable huge pages "
+                     "for %s: %s",
+                     segment.c_str(), strerror(errno));
+      }
+      if (DeterministicAllocationNumaNode >= 0 &&
+          !factory.get().getMapping().bindToNumaNode(
+              DeterministicAllocationNumaNode)) {
+        klee_error("Deterministic allocator: Could not bind %s to NUMA node "
+                   "%d: %s",
+                   segment.c_str(), DeterministicAllocationNumaNode.getValue(),
+                   strerror(errno));
+      }
       if (allocator) {
         *allocator = factory.get().makeAllocator();
       }
@@ -271,6 +299,7 @@ MemoryObject *MemoryManager::allocate(uint64_t size, bool isLocal,
                                       bool isGlobal, ExecutionState *state,
                                       const llvm::Value *allocSite,
                                       size_t alignment) {
+  KLEE_PROFILE_ZONE("MemoryManager::allocate");
   if (size > 10 * 1024 * 1024)
     klee_warning_once(0, "Large alloc: %" PRIu64
                          " bytes.  KLEE may run out of memory.",
@@ -18,9 +18,11 @@
 #include "klee/Module/KInstruction.h"
 #include "klee/Module/KModule.h"
 #include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/BinaryIStats.h"
 #include "klee/Statistics/Statistics.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Support/ModuleUtil.h"
+#include "klee/Support/Profiler.h"
 #include "klee/System/MemoryUsage.h"
 
 #include "CallPathManager.h"
@@ -37,6 +39,7 @@ DISABLE_WARNING_DEPRECATED_DECLARATIONS
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
@@ -47,6 +50,7 @@ DISABLE_WARNING_DEPRECATED_DECLARATIONS
 #include "llvm/Support/Process.h"
 DISABLE_WARNING_POP
 
+#include <algorithm>
 #include <fstream>
 #include <unistd.h>
 
@@ -76,6 +80,25 @@ cl::opt<bool> OutputIStats("output-istats", cl::init(true),
                                     "callgrind format (default=true)"),
                            cl::cat(StatsCat));
 
+enum class IStatsFormat {
+  Text,   // callgrind text, rewritten on every write
+  Binary, // columnar deltas, appended on every write
+};
+
+cl::opt<IStatsFormat> IStatsFileFormat(
+    "istats-format",
+    cl::desc("Format of the instruction level statistics"),
+    cl::values(
+        clEnumValN(IStatsFormat::Text, "text",
+                   "Callgrind format, the whole file is rewritten on every "
+                   "write (run.istats) (default)"),
+        clEnumValN(IStatsFormat::Binary, "binary",
+                   "Binary format, every write only appends the counters that "
+                   "changed (run.istats.bin). Use klee-istats to convert it to "
+                   "callgrind format.")),
+    cl::init(IStatsFormat::Text),
+    cl::cat(StatsCat));
+
 cl::opt<std::string> StatsWriteInterval(
     "stats-write-interval", cl::init("1s"),
     cl::desc("Approximate time between stats writes (default=1s)"),
@@ -284,14 +307,17 @@ StatsTracker::StatsTracker(Executor &_executor, std::string _objectFilename,
   }
 
   if (OutputIStats) {
-    istatsFile = executor.interpreterHandler->openOutputFile("run.istats");
+    const bool binary = IStatsFileFormat == IStatsFormat::Binary;
+    istatsFile = executor.interpreterHandler->openOutputFile(
+        binary ? "run.istats.bin" : "run.istats");
     if (istatsFile) {
       if (iStatsWriteInterval)
         executor.timers.add(std::make_unique<Timer>(iStatsWriteInterval, [&]{
           writeIStats();
         }));
     } else {
-      klee_error("Unable to open instruction level stats file (run.istats).");
+      klee_error("Unable to open instruction level stats file (%s).",
+                 binary ? "run.istats.bin" : "run.istats");
     }
   }
 }
@@ -323,6 +349,7 @@ void StatsTracker::done() {
 }
 
 void StatsTracker::stepInstruction(ExecutionState &es) {
+  KLEE_PROFILE_ZONE("StatsTracker::stepInstruction");
   if (OutputIStats) {
     if (TrackInstructionTime) {
       static time::Point lastNowTime(time::getWallTime());
@@ -440,6 +467,12 @@ void StatsTracker::writeStatsHeader() {
   #define BTYPE(Name,I) << "Branches" #Name " INTEGER,"
   #undef TCLASS
   #define TCLASS(Name,I) << "Termination" #Name " INTEGER,"
+  #undef SLAYER
+  #define SLAYER(Name) << "Solver" #Name "Queries INTEGER,"                   \
+                       << "Solver" #Name "Hits INTEGER,"                      \
+                       << "Solver" #Name "Time INTEGER,"                      \
+                       << "Solver" #Name "P50 REAL,"                          \
+                       << "Solver" #Name "P99 REAL,"
   std::ostringstream create, insert;
   create << "CREATE TABLE stats ("
          << "Instructions INTEGER,"
@@ -464,6 +497,8 @@ void StatsTracker::writeStatsHeader() {
          << "QueryCacheHits INTEGER,"
          << "QueryCexCacheMisses INTEGER,"
          << "QueryCexCacheHits INTEGER,"
+         << "Z3ConstructCacheMisses INTEGER,"
+         << "Z3ConstructCacheHits INTEGER,"
          << "InhibitedForks INTEGER,"
          << "ExternalCalls INTEGER,"
          << "Allocations INTEGER,"
@@ -475,8 +510,13 @@ void StatsTracker::writeStatsHeader() {
          << "ExprOpts4 INTEGER,"
          << "ExprOpts5 INTEGER,"
          << "ConstOpts INTEGER,"
+         << "ExprMemory INTEGER,"
+         << "UpdateNodeMemory INTEGER,"
+         << "MinorPageFaults INTEGER,"
+         << "MajorPageFaults INTEGER,"
          BRANCH_TYPES
          TERMINATION_CLASSES
+         SOLVER_LAYERS
          << "ArrayHashTime INTEGER"
          << ')';
   char *zErrMsg = nullptr;
@@ -494,6 +534,12 @@ void StatsTracker::writeStatsHeader() {
   #define BTYPE(Name, I) << "Branches" #Name ","
   #undef TCLASS
   #define TCLASS(Name, I) << "Termination" #Name ","
+  #undef SLAYER
+  #define SLAYER(Name) << "Solver" #Name "Queries,"                           \
+                       << "Solver" #Name "Hits,"                              \
+                       << "Solver" #Name "Time,"                              \
+                       << "Solver" #Name "P50,"                               \
+                       << "Solver" #Name "P99,"
   insert << "INSERT OR FAIL INTO stats ("
          << "Instructions,"
          << "FullBranches,"
@@ -517,6 +563,8 @@ void StatsTracker::writeStatsHeader() {
          << "QueryCacheHits,"
          << "QueryCexCacheMisses,"
          << "QueryCexCacheHits,"
+         << "Z3ConstructCacheMisses,"
+         << "Z3ConstructCacheHits,"
          << "InhibitedForks,"
          << "ExternalCalls,"
          << "Allocations,"
@@ -528,14 +576,21 @@ void StatsTracker::writeStatsHeader() {
          << "ExprOpts4,"
          << "ExprOpts5,"
          << "ConstOpts,"
+         << "ExprMemory,"
+         << "UpdateNodeMemory,"
+         << "MinorPageFaults,"
+         << "MajorPageFaults,"
          BRANCH_TYPES
          TERMINATION_CLASSES
+         SOLVER_LAYERS
          << "ArrayHashTime"
          << ')';
   #undef BTYPE
   #define BTYPE(Name, I) << "?,"
   #undef TCLASS
   #define TCLASS(Name, I) << "?,"
+  #undef SLAYER
+  #define SLAYER(Name) << "?,?,?,?,?,"
   insert << " VALUES ("
          << "?,"
          << "?,"
@@ -570,8 +625,15 @@ void StatsTracker::writeStatsHeader() {
          << "?,"
          << "?,"
          << "?,"
+         << "?,"
+         << "?,"
+         << "?,"
+         << "?,"
+         << "?,"
+         << "?,"
          BRANCH_TYPES
          TERMINATION_CLASSES
+         SOLVER_LAYERS
          << "? "
          << ')';
 
@@ -589,7 +651,20 @@ void StatsTracker::writeStatsLine() {
   #define BTYPE(Name,I) sqlite3_bind_int64(insertStmt, arg++, stats::branches ## Name);
   #undef TCLASS
   #define TCLASS(Name,I) sqlite3_bind_int64(insertStmt, arg++, stats::termination ## Name);
+  #undef SLAYER
+  #define SLAYER(Name)                                                         \
+    sqlite3_bind_int64(insertStmt, arg++, stats::solver##Name##Queries);       \
+    sqlite3_bind_int64(insertStmt, arg++, stats::solver##Name##Hits);          \
+    sqlite3_bind_int64(insertStmt, arg++, stats::solver##Name##Time);          \
+    bindLatency(SolverLayer::Name, 50);                                        \
+    bindLatency(SolverLayer::Name, 99);
   int arg = 1;
+  // latency percentiles in microseconds
+  auto bindLatency = [&](SolverLayer layer, double percentile) {
+    const auto &latency = stats::getSolverLayerLatency(layer);
+    sqlite3_bind_double(insertStmt, arg++,
+                        latency.getPercentile(percentile) / 1000.0);
+  };
   sqlite3_bind_int64(insertStmt, arg++, stats::instructions);
   sqlite3_bind_int64(insertStmt, arg++, fullBranches);
   sqlite3_bind_int64(insertStmt, arg++, partialBranches);
@@ -612,6 +687,8 @@ void StatsTracker::writeStatsLine() {
   sqlite3_bind_int64(insertStmt, arg++, stats::queryCacheHits);
   sqlite3_bind_int64(insertStmt, arg++, stats::queryCexCacheMisses);
   sqlite3_bind_int64(insertStmt, arg++, stats::queryCexCacheHits);
+  sqlite3_bind_int64(insertStmt, arg++, stats::z3ConstructCacheMisses);
+  sqlite3_bind_int64(insertStmt, arg++, stats::z3ConstructCacheHits);
   sqlite3_bind_int64(insertStmt, arg++, stats::inhibitedForks);
   sqlite3_bind_int64(insertStmt, arg++, stats::externalCalls);
   sqlite3_bind_int64(insertStmt, arg++, stats::allocations);
@@ -623,8 +700,13 @@ void StatsTracker::writeStatsLine() {
   sqlite3_bind_int64(insertStmt, arg++, stats::exprOpts4);
   sqlite3_bind_int64(insertStmt, arg++, stats::exprOpts5);
   sqlite3_bind_int64(insertStmt, arg++, stats::constOpts);
+  sqlite3_bind_int64(insertStmt, arg++, Expr::allocator.getLiveBytes());
+  sqlite3_bind_int64(insertStmt, arg++, UpdateNode::allocator.getLiveBytes());
+  sqlite3_bind_int64(insertStmt, arg++, util::GetMinorPageFaults());
+  sqlite3_bind_int64(insertStmt, arg++, util::GetMajorPageFaults());
   BRANCH_TYPES
   TERMINATION_CLASSES
+  SOLVER_LAYERS
 #ifdef KLEE_ARRAY_DEBUG
   sqlite3_bind_int64(insertStmt, arg++, stats::arrayHashTime);
 #else
@@ -658,7 +740,25 @@ void StatsTracker::updateStateStatistics(uint64_t addend) {
   }
 }
 
+std::vector<unsigned> StatsTracker::getIStatsEvents() {
+  StatisticManager &sm = *theStatisticManager;
+  std::vector<unsigned> events;
+  for (const char *name :
+       {"Queries", "QueriesValid", "QueriesInvalid", "QueryTime",
+        "ResolveTime", "Instructions", "InstructionTimes",
+        "InstructionRealTimes", "Forks", "CoveredInstructions",
+        "UncoveredInstructions", "States", "MinDistToUncovered"})
+    events.push_back(sm.getStatisticID(name));
+  std::sort(events.begin(), events.end());
+  return events;
+}
+
 void StatsTracker::writeIStats() {
+  if (binaryIStats || IStatsFileFormat == IStatsFormat::Binary) {
+    writeBinaryIStats();
+    return;
+  }
+
   const auto m = executor.kmodule->module.get();
   llvm::raw_fd_ostream &of = *istatsFile;
   
@@ -677,19 +777,8 @@ void StatsTracker::writeIStats() {
   unsigned nStats = sm.getNumStatistics();
   llvm::SmallBitVector istatsMask(nStats);
 
-  istatsMask.set(sm.getStatisticID("Queries"));
-  istatsMask.set(sm.getStatisticID("QueriesValid"));
-  istatsMask.set(sm.getStatisticID("QueriesInvalid"));
-  istatsMask.set(sm.getStatisticID("QueryTime"));
-  istatsMask.set(sm.getStatisticID("ResolveTime"));
-  istatsMask.set(sm.getStatisticID("Instructions"));
-  istatsMask.set(sm.getStatisticID("InstructionTimes"));
-  istatsMask.set(sm.getStatisticID("InstructionRealTimes"));
-  istatsMask.set(sm.getStatisticID("Forks"));
-  istatsMask.set(sm.getStatisticID("CoveredInstructions"));
-  istatsMask.set(sm.getStatisticID("UncoveredInstructions"));
-  istatsMask.set(sm.getStatisticID("States"));
-  istatsMask.set(sm.getStatisticID("MinDistToUncovered"));
+  for (unsigned id : getIStatsEvents())
+    istatsMask.set(id);
 
   of << "positions: instr line\n";
 
@@ -809,6 +898,109 @@ void StatsTracker::writeIStats() {
   of.flush();
 }
 
+void StatsTracker::writeBinaryIStats() {
+  StatisticManager &sm = *theStatisticManager;
+  const auto &infos = *executor.kmodule->infos;
+
+  // The module does not change during execution, so the layout only needs to
+  // be written once. Rows are the instructions of all defined functions, in
+  // the same order as in run.istats.
+  if (!binaryIStats) {
+    const auto m = executor.kmodule->module.get();
+    IStatsLayout layout;
+    layout.cmd = m->getModuleIdentifier();
+    layout.object = llvm::sys::path::filename(objectFilename).str();
+    layout.pid = getpid();
+
+    istatsEvents = getIStatsEvents();
+    for (unsigned id : istatsEvents) {
+      Statistic &s = sm.getStatistic(id);
+      layout.events.emplace_back(s.getShortName(), s.getName());
+    }
+
+    std::map<std::string, unsigned> files;
+    auto getFileIndex = [&](const std::string &file) {
+      auto [it, inserted] = files.emplace(file, layout.files.size());
+      if (inserted)
+        layout.files.push_back(file);
+      return it->second;
+    };
+
+    for (Function &fn : *m) {
+      const FunctionInfo &fi = infos.getFunctionInfo(fn);
+      istatsFunctions[&fn] = layout.functions.size();
+      layout.functions.push_back({fn.getName().str(), getFileIndex(fi.file),
+                                  fi.assemblyLine, fi.line,
+                                  !fn.isDeclaration()});
+    }
+
+    for (Function &fn : *m) {
+      if (fn.isDeclaration())
+        continue;
+      for (Instruction &instr : llvm::instructions(fn)) {
+        const InstructionInfo &ii = infos.getInfo(instr);
+        if (isa<CallInst>(instr) || isa<InvokeInst>(instr))
+          istatsCallSiteRows[&instr] = istatsRows.size();
+        istatsRows.push_back(ii.id);
+        layout.instructions.push_back({istatsFunctions[&fn],
+                                       getFileIndex(ii.file), ii.assemblyLine,
+                                       ii.line});
+      }
+    }
+
+    binaryIStats = std::make_unique<BinaryIStatsWriter>(*istatsFile, layout);
+  }
+
+  // set state counts, decremented after we process
+  const bool trackStates = std::find(istatsEvents.begin(), istatsEvents.end(),
+                                     stats::states.getID()) !=
+                           istatsEvents.end();
+  if (trackStates)
+    updateStateStatistics(1);
+
+  binaryIStats->beginSnapshot(elapsed().toMicroseconds());
+
+  std::vector<std::uint64_t> column(istatsRows.size());
+  for (unsigned id : istatsEvents) {
+    const Statistic &s = sm.getStatistic(id);
+    for (std::size_t row = 0; row < istatsRows.size(); ++row)
+      column[row] = sm.getIndexedValue(s, istatsRows[row]);
+    binaryIStats->addColumn(column.data());
+  }
+
+  std::vector<IStatsCallSite> callSites;
+  if (UseCallPaths) {
+    CallSiteSummaryTable callSiteStats;
+    callPathManager.getSummaryStatistics(callSiteStats);
+    for (const auto &[instr, targets] : callSiteStats) {
+      const auto row = istatsCallSiteRows.find(instr);
+      if (row == istatsCallSiteRows.end())
+        continue;
+      for (const auto &[f, csi] : targets) {
+        const auto callee = istatsFunctions.find(f);
+        if (callee == istatsFunctions.end())
+          continue;
+        IStatsCallSite cs{row->second, callee->second, csi.count, {}};
+        for (unsigned id : istatsEvents) {
+          Statistic &s = sm.getStatistic(id);
+          // Hack, ignore things that don't make sense on call paths.
+          cs.values.push_back(&s == &stats::uncoveredInstructions
+                                  ? 0
+                                  : csi.statistics.getValue(s));
+        }
+        callSites.push_back(std::move(cs));
+      }
+    }
+  }
+  binaryIStats->addCallSites(callSites);
+  binaryIStats->endSnapshot();
+
+  if (trackStates)
+    updateStateStatistics((uint64_t)-1);
+
+  istatsFile->flush();
+}
+
 ///
 
 typedef std::map<Instruction*, std::vector<Function*> > calltargets_ty;
@@ -16,6 +16,8 @@
 #include <memory>
 #include <set>
 #include <sqlite3.h>
+#include <unordered_map>
+#include <vector>
 
 namespace llvm {
   class BranchInst;
@@ -25,6 +27,7 @@ namespace llvm {
 }
 
 namespace klee {
+  class BinaryIStatsWriter;
   class ExecutionState;
   class Executor;
   class InstructionInfoTable;
@@ -40,6 +43,13 @@ namespace klee {
     std::string objectFilename;
 
     std::unique_ptr<llvm::raw_fd_ostream> istatsFile;
+    // binary istats: writer, statistic IDs of the columns, instruction ID of
+    // every row, and rows/indices of call sites and functions
+    std::unique_ptr<BinaryIStatsWriter> binaryIStats;
+    std::vector<unsigned> istatsEvents;
+    std::vector<unsigned> istatsRows;
+    std::unordered_map<const llvm::Instruction *, unsigned> istatsCallSiteRows;
+    std::unordered_map<const llvm::Function *, unsigned> istatsFunctions;
     ::sqlite3 *statsFile = nullptr;
     ::sqlite3_stmt *transactionBeginStmt = nullptr;
     ::sqlite3_stmt *transactionEndStmt = nullptr;
@@ -64,6 +74,8 @@ namespace klee {
     void writeStatsHeader();
     void writeStatsLine();
     void writeIStats();
+    void writeBinaryIStats();
+    static std::vector<unsigned> getIStatsEvents();
 
   public:
     StatsTracker(Executor &_executor, std::string _objectFilename,
@@ -26,7 +26,9 @@
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <limits>
 #include <set>
+#include <tuple>
 
 using namespace klee;
 
@@ -57,6 +59,13 @@ llvm::cl::opt<double> ArrayValueSymbRatio(
                    "the mixed value-based transformations are applied."),
     llvm::cl::init(1.0), llvm::cl::value_desc("Symbolic Values / Array Size"),
     llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<unsigned> ArrayMuxTreeSize(
+    "array-mux-tree-size",
+    llvm::cl::desc("Maximum number of elements of a concrete array for which "
+                   "reads may be transformed into selects on the bits of the "
+                   "index (default=256)"),
+    llvm::cl::init(256), llvm::cl::cat(klee::SolvingCat));
 }; // namespace klee
 
 ref<Expr> extendRead(const UpdateList &ul, const ref<Expr> index,
@@ -100,6 +109,47 @@ ref<Expr> extendRead(const UpdateList &ul, const ref<Expr> index,
   }
 }
 
+/// Returns the elements of the concrete array read through `updates`, after
+/// applying the (concrete) updates
+static std::vector<uint64_t> getConstantArrayValues(const UpdateList &updates,
+                                                    unsigned bytesPerElement) {
+  // We need to read updates from lest recent to most recent, therefore
+  // reverse the list
+  std::vector<const UpdateNode *> us;
+  us.reserve(updates.getSize());
+  for (const UpdateNode *un = updates.head.get(); un; un = un->next.get())
+    us.push_back(un);
+
+  auto arrayConstValues = updates.root->constantValues;
+  for (auto it = us.rbegin(); it != us.rend(); it++) {
+    const UpdateNode *un = *it;
+    auto ce = dyn_cast<ConstantExpr>(un->index);
+    assert(ce && "Not a constant expression");
+    uint64_t index = ce->getAPValue().getZExtValue();
+    assert(index < arrayConstValues.size());
+    auto arrayValue = dyn_cast<ConstantExpr>(un->value);
+    assert(arrayValue && "Not a constant expression");
+    arrayConstValues[index] = arrayValue;
+  }
+
+  unsigned elementsInArray = updates.root->getSize() / bytesPerElement;
+  std::vector<uint64_t> arrayValues;
+  arrayValues.reserve(elementsInArray);
+  // Get the concrete values from the array
+  for (unsigned i = 0; i < elementsInArray; i++) {
+    uint64_t val = 0;
+    for (unsigned j = 0; j < bytesPerElement; j++) {
+      val |= (*(arrayConstValues[(i * bytesPerElement) + j]
+                    .get()
+                    ->getAPValue()
+                    .getRawData())
+              << (j * 8));
+    }
+    arrayValues.push_back(val);
+  }
+  return arrayValues;
+}
+
 ref<Expr> ExprOptimizer::optimizeExpr(const ref<Expr> &e, bool valueOnly) {
   // Nothing to optimise for constant expressions
   if (isa<ConstantExpr>(e))
@@ -269,55 +319,35 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
       if (info.second > width) {
         width = info.second;
       }
-      unsigned size = read->updates.root->getSize();
       unsigned bytesPerElement = width / 8;
-      unsigned elementsInArray = size / bytesPerElement;
 
       // Note: we already filtered the ReadExpr, so here we can safely
       // assume that the UpdateNodes contain ConstantExpr indexes and values
       assert(read->updates.root->isConstantArray() &&
              "Expected concrete array, found symbolic array");
 
-      // We need to read updates from lest recent to most recent, therefore
-      // reverse the list
-      std::vector<const UpdateNode *> us;
-      us.reserve(read->updates.getSize());
-      for (const UpdateNode *un = read->updates.head.get(); un;
-           un = un->next.get())
-        us.push_back(un);
-
-      auto arrayConstValues = read->updates.root->constantValues;
-      for (auto it = us.rbegin(); it != us.rend(); it++) {
-        const UpdateNode *un = *it;
-        auto ce = dyn_cast<ConstantExpr>(un->index);
-        assert(ce && "Not a constant expression");
-        uint64_t index = ce->getAPValue().getZExtValue();
-        assert(index < arrayConstValues.size());
-        auto arrayValue = dyn_cast<ConstantExpr>(un->value);
-        assert(arrayValue && "Not a constant expression");
-        arrayConstValues[index] = arrayValue;
-      }
-      std::vector<uint64_t> arrayValues;
-      // Get the concrete values from the array
-      for (unsigned i = 0; i < elementsInArray; i++) {
-        uint64_t val = 0;
-        for (unsigned j = 0; j < bytesPerElement; j++) {
-          val |= (*(
-                       arrayConstValues[(i * bytesPerElement) + j]
-                           .get()
-                           ->getAPValue()
-                           .getRawData())
-                  << (j * 8));
-        }
-        arrayValues.push_back(val);
+      // Arrays without updates are lowered once for all reads
+      LoweredTable updatedTable;
+      const LoweredTable *table = &updatedTable;
+      if (!read->updates.head) {
+        auto key = std::make_pair(read->updates.root, width);
+        auto it = loweredTables.find(key);
+        if (it == loweredTables.end())
+          it = loweredTables
+                   .emplace(key, lowerTable(getConstantArrayValues(
+                                     read->updates, bytesPerElement)))
+                   .first;
+        table = &it->second;
+      } else {
+        updatedTable =
+            lowerTable(getConstantArrayValues(read->updates, bytesPerElement));
       }
 
       ref<Expr> index = exprBuilder->UDiv(
           read->index,
           exprBuilder->Constant(bytesPerElement, read->index->getWidth()));
 
-      ref<Expr> opt =
-          buildConstantSelectExpr(index, arrayValues, width, elementsInArray);
+      ref<Expr> opt = buildConstantSelectExpr(index, *table, width);
       if (opt) {
         cacheReadExprOptimized[const_cast<ReadExpr *>(read)] = opt;
         optimized.insert(std::make_pair(info.first, opt));
@@ -429,49 +459,149 @@ ref<Expr> ExprOptimizer::getSelectOptExpr(
   return toReturn ? toReturn : notFound;
 }
 
-ref<Expr> ExprOptimizer::buildConstantSelectExpr(
-    const ref<Expr> &index, std::vector<uint64_t> &arrayValues,
-    Expr::Width width, unsigned arraySize) const {
-  std::vector<std::pair<uint64_t, uint64_t>> ranges;
-  std::vector<uint64_t> values;
-  std::set<uint64_t> unique_array_values;
-  ExprBuilder *builder = createDefaultExprBuilder();
-  Expr::Width valWidth = width;
-  ref<Expr> result;
+LoweredTable
+ExprOptimizer::lowerTable(const std::vector<uint64_t> &arrayValues) const {
+  LoweredTable table;
+  const std::size_t arraySize = arrayValues.size();
+  if (arraySize == 0)
+    return table;
+
+  // Calculate the repeating values ranges in the constant array
+  std::set<uint64_t> uniqueValues;
+  for (std::size_t begin = 0, i = 1; i <= arraySize; i++) {
+    if (i == arraySize || arrayValues[i] != arrayValues[begin]) {
+      table.ranges.emplace_back(begin, i);
+      table.rangeValues.push_back(arrayValues[begin]);
+      uniqueValues.insert(arrayValues[begin]);
+      begin = i;
+    }
+  }
 
+  // Each applicable encoding is costed by (roughly) the number of
+  // expressions it builds, and the cheapest one is chosen
+  std::size_t bestCost = std::numeric_limits<std::size_t>::max();
+  auto consider = [&](TableEncoding encoding, std::size_t cost) {
+    if (cost < bestCost) {
+      bestCost = cost;
+      table.encoding = encoding;
+    }
+  };
+
+  if ((double)uniqueValues.size() / (double)arraySize < ArrayValueRatio) {
+    // The smallest value is the final "else", every other value needs a
+    // select and a test of its ranges
+    std::size_t cost = 1 + 2 * (uniqueValues.size() - 1);
+    std::size_t tests = 0;
+    for (std::size_t i = 0; i < table.ranges.size(); i++) {
+      if (table.rangeValues[i] == *uniqueValues.begin())
+        continue;
+      const auto &range = table.ranges[i];
+      cost += range.second - range.first == 1 ? 2 : 5;
+      tests++;
+    }
+    cost += tests - (uniqueValues.size() - 1);
+    consider(TableEncoding::ValueChain, cost);
+  }
+
+  if ((double)table.ranges.size() / (double)arraySize < ArrayValueRatio) {
+    // A constant per range, a comparison and a select per split
+    consider(TableEncoding::IntervalTree, 4 * table.ranges.size() - 3);
+  }
+
+  if (arraySize <= ArrayMuxTreeSize) {
+    unsigned bits = 0;
+    while ((std::size_t(1) << bits) < arraySize)
+      bits++;
+
+    // Indexes past the end read the last element, which keeps the tree
+    // small for sizes that are not a power of two
+    std::map<uint64_t, unsigned> leafIds;
+    std::vector<unsigned> level;
+    level.reserve(std::size_t(1) << bits);
+    for (std::size_t i = 0; i < (std::size_t(1) << bits); i++) {
+      uint64_t value = arrayValues[std::min(i, arraySize - 1)];
+      auto leaf = leafIds.emplace(value, leafIds.size()).first;
+      level.push_back(leaf->second);
+    }
+
+    LoweredTable mux;
+    mux.leafValues.resize(leafIds.size());
+    for (auto &leaf : leafIds)
+      mux.leafValues[leaf.second] = leaf.first;
+
+    // Merge the nodes level by level, dropping selects between equal nodes
+    // and sharing equal selects
+    std::map<std::tuple<unsigned, unsigned, unsigned>, unsigned> nodeIds;
+    for (unsigned bit = 0; bit < bits; bit++) {
+      for (std::size_t i = 0; i < level.size() / 2; i++) {
+        unsigned ifUnset = level[2 * i], ifSet = level[2 * i + 1];
+        if (ifSet == ifUnset) {
+          level[i] = ifSet;
+          continue;
+        }
+        auto key = std::make_tuple(bit, ifSet, ifUnset);
+        auto node = nodeIds.find(key);
+        if (node == nodeIds.end()) {
+          unsigned id = mux.leafValues.size() + mux.muxNodes.size();
+          mux.muxNodes.push_back({bit, ifSet, ifUnset});
+          node = nodeIds.emplace(key, id).first;
+        }
+        level[i] = node->second;
+      }
+      level.resize(level.size() / 2);
+    }
+    mux.muxRoot = level[0];
+    mux.muxBits = bits;
+
+    // A constant per leaf, a select per node and an extract per bit
+    std::size_t cost =
+        mux.leafValues.size() + mux.muxNodes.size() + mux.muxBits;
+    if (cost < bestCost) {
+      table.leafValues = std::move(mux.leafValues);
+      table.muxNodes = std::move(mux.muxNodes);
+      table.muxRoot = mux.muxRoot;
+      table.muxBits = mux.muxBits;
+      consider(TableEncoding::MuxTree, cost);
+    }
+  }
+
+  return table;
+}
+
+ref<Expr> ExprOptimizer::buildConstantSelectExpr(const ref<Expr> &index,
+                                                 const LoweredTable &table,
+                                                 Expr::Width width) const {
   ref<Expr> actualIndex;
   if (index->getWidth() > Expr::Int32) {
     actualIndex = ExtractExpr::alloc(index, 0, Expr::Int32);
   } else {
     actualIndex = index;
   }
-  Expr::Width idxWidth = actualIndex->getWidth();
 
-  // Calculate the repeating values ranges in the constant array
-  unsigned curr_idx = 0;
-  uint64_t curr_val = arrayValues[0];
-  for (unsigned i = 0; i < arraySize; i++) {
-    uint64_t temp = arrayValues[i];
-    unique_array_values.insert(curr_val);
-    if (temp != curr_val) {
-      ranges.emplace_back(curr_idx, i);
-      values.push_back(curr_val);
-      curr_val = temp;
-      curr_idx = i;
-      if (i == (arraySize - 1)) {
-        ranges.emplace_back(curr_idx, i + 1);
-        values.push_back(curr_val);
-      }
-    } else if (i == (arraySize - 1)) {
-      ranges.emplace_back(curr_idx, i + 1);
-      values.push_back(curr_val);
-    }
+  switch (table.encoding) {
+  case TableEncoding::None:
+    return ref<Expr>();
+  case TableEncoding::ValueChain:
+    return buildValueChainExpr(actualIndex, table, width);
+  case TableEncoding::IntervalTree:
+    return buildIntervalTreeExpr(actualIndex, table, width, 0,
+                                 table.ranges.size());
+  case TableEncoding::MuxTree:
+    return buildMuxTreeExpr(actualIndex, table, width);
   }
+  assert(0 && "invalid table encoding");
+  return ref<Expr>();
+}
 
-  if (((double)unique_array_values.size() / (double)(arraySize)) >=
-      ArrayValueRatio) {
-    return result;
-  }
+ref<Expr> ExprOptimizer::buildValueChainExpr(const ref<Expr> &actualIndex,
+                                             const LoweredTable &table,
+                                             Expr::Width width) const {
+  const std::vector<std::pair<uint64_t, uint64_t>> &ranges = table.ranges;
+  const std::vector<uint64_t> &values = table.rangeValues;
+  ExprBuilder *builder = createDefaultExprBuilder();
+  Expr::Width valWidth = width;
+  Expr::Width idxWidth = actualIndex->getWidth();
+  ref<Expr> result;
 
   std::map<uint64_t, std::vector<std::pair<uint64_t, uint64_t>>> exprMap;
   for (size_t i = 0; i < ranges.size(); i++) {
@@ -570,6 +700,40 @@ ref<Expr> ExprOptimizer::buildConstantSelectExpr(
   return result;
 }
 
+ref<Expr> ExprOptimizer::buildIntervalTreeExpr(const ref<Expr> &index,
+                                               const LoweredTable &table,
+                                               Expr::Width width,
+                                               std::size_t begin,
+                                               std::size_t end) const {
+  if (end - begin == 1)
+    return exprBuilder->Constant(table.rangeValues[begin], width);
+
+  std::size_t mid = begin + (end - begin) / 2;
+  return exprBuilder->Select(
+      exprBuilder->Ult(index, exprBuilder->Constant(table.ranges[mid].first,
+                                                    index->getWidth())),
+      buildIntervalTreeExpr(index, table, width, begin, mid),
+      buildIntervalTreeExpr(index, table, width, mid, end));
+}
+
+ref<Expr> ExprOptimizer::buildMuxTreeExpr(const ref<Expr> &index,
+                                          const LoweredTable &table,
+                                          Expr::Width width) const {
+  assert(table.muxBits <= index->getWidth() && "Index is too narrow");
+  std::vector<ref<Expr>> bits;
+  for (unsigned bit = 0; bit < table.muxBits; bit++)
+    bits.push_back(exprBuilder->Extract(index, bit, Expr::Bool));
+
+  std::vector<ref<Expr>> nodes;
+  nodes.reserve(table.leafValues.size() + table.muxNodes.size());
+  for (uint64_t value : table.leafValues)
+    nodes.push_back(exprBuilder->Constant(value, width));
+  for (const LoweredTable::MuxNode &node : table.muxNodes)
+    nodes.push_back(exprBuilder->Select(bits[node.bit], nodes[node.ifSet],
+                                        nodes[node.ifUnset]));
+  return nodes[table.muxRoot];
+}
+
 ref<Expr> ExprOptimizer::buildMixedSelectExpr(
     const ReadExpr *re, std::vector<std::pair<uint64_t, bool>> &arrayValues,
     Expr::Width width, unsigned elementsInArray) const {
@@ -0,0 +1,429 @@
+//===-- CompiledExpr.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/CompiledExpr.h"
+
+#include "klee/Expr/Assignment.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+static std::uint64_t getMask(Expr::Width width) {
+  return width >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << width) - 1;
+}
+
+static std::int64_t signExtend(std::uint64_t value, Expr::Width width) {
+  if (width >= 64)
+    return static_cast<std::int64_t>(value);
+  const unsigned shift = 64 - width;
+  return static_cast<std::int64_t>(value << shift) >> shift;
+}
+
+unsigned CompiledExpr::emit(Opcode opcode, Expr::Width width, unsigned a,
+                            unsigned b, unsigned c) {
+  program.push_back({opcode, width, a, b, c});
+  return program.size() - 1;
+}
+
+unsigned CompiledExpr::compileUpdates(const UpdateList &ul) {
+  const auto key = std::make_pair(ul.root, ul.head.get());
+  if (auto it = updateIds.find(key); it != updateIds.end())
+    return it->second;
+
+  Updates result;
+  auto [it, inserted] = arrayIds.try_emplace(ul.root, arrays.size());
+  if (inserted)
+    arrays.push_back(ul.root);
+  result.array = it->second;
+  for (auto un = ul.head; un; un = un->next) {
+    const unsigned index = compile(un->index);
+    const unsigned value = compile(un->value);
+    if (index == NotCompiled || value == NotCompiled)
+      return NotCompiled;
+    result.updates.emplace_back(index, value);
+  }
+
+  updates.push_back(std::move(result));
+  updateIds.emplace(key, updates.size() - 1);
+  return updates.size() - 1;
+}
+
+unsigned CompiledExpr::compile(const ref<Expr> &e) {
+  if (auto it = compiled.find(e.get()); it != compiled.end())
+    return it->second;
+
+  unsigned result = NotCompiled;
+  const Expr::Width width = e->getWidth();
+  auto binary = [&](Opcode opcode, const ref<Expr> &l, const ref<Expr> &r,
+                    unsigned c = 0) {
+    const unsigned a = compile(l);
+    const unsigned b = compile(r);
+    if (a != NotCompiled && b != NotCompiled)
+      result = emit(opcode, width, a, b, c);
+  };
+  auto compare = [&](Opcode opcode, const ref<Expr> &l, const ref<Expr> &r) {
+    binary(opcode, l, r, l->getWidth());
+  };
+
+  bool operandsFit = width <= 64;
+  for (unsigned i = 0; i < e->getNumKids() && operandsFit; ++i)
+    operandsFit = e->getKid(i)->getWidth() <= 64;
+
+  switch (operandsFit ? e->getKind() : Expr::InvalidKind) {
+  case Expr::Constant:
+    constants.push_back(cast<ConstantExpr>(e)->getZExtValue());
+    result = emit(Opcode::Constant, width, constants.size() - 1);
+    break;
+  case Expr::NotOptimized:
+    result = compile(cast<NotOptimizedExpr>(e)->src);
+    break;
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    const unsigned ul = compileUpdates(re->updates);
+    const unsigned index = compile(re->index);
+    if (ul != NotCompiled && index != NotCompiled)
+      result = emit(Opcode::Read, width, ul, index);
+    break;
+  }
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    const unsigned c = compile(se->cond);
+    const unsigned t = compile(se->trueExpr);
+    const unsigned f = compile(se->falseExpr);
+    if (c != NotCompiled && t != NotCompiled && f != NotCompiled)
+      result = emit(Opcode::Select, width, c, t, f);
+    break;
+  }
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    binary(Opcode::Concat, ce->getLeft(), ce->getRight(),
+           ce->getRight()->getWidth());
+    break;
+  }
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    const unsigned src = compile(ee->expr);
+    if (src != NotCompiled)
+      result = emit(Opcode::Extract, width, src, ee->offset);
+    break;
+  }
+  case Expr::ZExt:
+  case Expr::SExt: {
+    const CastExpr *ce = cast<CastExpr>(e);
+    const unsigned src = compile(ce->src);
+    if (src != NotCompiled)
+      result = emit(isa<SExtExpr>(ce) ? Opcode::SExt : Opcode::ZExt, width,
+                    src, ce->src->getWidth());
+    break;
+  }
+  case Expr::Not: {
+    const unsigned src = compile(cast<NotExpr>(e)->expr);
+    if (src != NotCompiled)
+      result = emit(Opcode::Not, width, src);
+    break;
+  }
+
+#define BINARY(Kind)                                                           \
+  case Expr::Kind: {                                                           \
+    const BinaryExpr *be = cast<BinaryExpr>(e);                                \
+    binary(Opcode::Kind, be->left, be->right);                                 \
+    break;                                                                     \
+  }
+    BINARY(Add)
+    BINARY(Sub)
+    BINARY(Mul)
+    BINARY(UDiv)
+    BINARY(SDiv)
+    BINARY(URem)
+    BINARY(SRem)
+    BINARY(And)
+    BINARY(Or)
+    BINARY(Xor)
+    BINARY(Shl)
+    BINARY(LShr)
+    BINARY(AShr)
+#undef BINARY
+
+#define COMPARE(Kind, Op, Swap)                                            \
+  case Expr::Kind: {                                                           \
+    const CmpExpr *ce = cast<CmpExpr>(e);                                      \
+    if (Swap)                                                                  \
+      compare(Opcode::Op, ce->right, ce->left);                                \
+    else                                                                       \
+      compare(Opcode::Op, ce->left, ce->right);                                \
+    break;                                                                     \
+  }
+    COMPARE(Eq, Eq, false)
+    COMPARE(Ne, Ne, false)
+    COMPARE(Ult, Ult, false)
+    COMPARE(Ule, Ule, false)
+    COMPARE(Ugt, Ult, true)
+    COMPARE(Uge, Ule, true)
+    COMPARE(Slt, Slt, false)
+    COMPARE(Sle, Sle, false)
+    COMPARE(Sgt, Slt, true)
+    COMPARE(Sge, Sle, true)
+#undef COMPARE
+
+  default:
+    break;
+  }
+
+  compiled.emplace(e.get(), result);
+  return result;
+}
+
+void CompiledExpr::add(const ref<Expr> &e) {
+  const unsigned reg = compile(e);
+  roots.push_back({e, reg, static_cast<unsigned>(program.size())});
+}
+
+void CompiledExpr::bind(const Assignment *const *assignments,
+                        unsigned lanes) const {
+  this->lanes = lanes;
+  bindings.resize(arrays.size() * lanes);
+  for (unsigned i = 0; i < arrays.size(); ++i) {
+    for (unsigned l = 0; l < lanes; ++l) {
+      const Assignment &a = *assignments[l];
+      auto it = a.bindings.find(arrays[i]);
+      bindings[i * lanes + l] = it != a.bindings.end() ? &it->second : nullptr;
+    }
+  }
+  registers.resize(program.size() * lanes);
+}
+
+bool CompiledExpr::read(const Assignment &a, unsigned array, unsigned lane,
+                        std::uint64_t index, std::uint64_t &value) const {
+  const Array *root = arrays[array];
+  // mirrors ExprEvaluator::evalRead and Assignment::evaluate
+  if (root->isConstantArray() && index < root->size) {
+    value = root->constantValues[index]->getZExtValue();
+    return true;
+  }
+  const auto *binding = bindings[array * lanes + lane];
+  if (binding && index < binding->size()) {
+    value = (*binding)[index];
+    return true;
+  }
+  value = 0;
+  return !a.allowFreeValues;
+}
+
+std::uint64_t CompiledExpr::execute(const Assignment *const *assignments,
+                                    unsigned begin, unsigned end) const {
+  std::uint64_t undetermined = 0;
+  const unsigned n = lanes;
+  for (unsigned i = begin; i < end; ++i) {
+    const Instruction &inst = program[i];
+    std::uint64_t *out = &registers[i * n];
+    // the operands, only valid for opcodes taking registers
+    const std::uint64_t *x = &registers[inst.a * n];
+    const std::uint64_t *y = &registers[inst.b * n];
+    const std::uint64_t *z = &registers[inst.c * n];
+    const Expr::Width w = inst.width;
+
+    // the loops over all lanes are simple enough to be vectorised
+#define FOR_LANES(value)                                                       \
+  for (unsigned l = 0; l < n; ++l)                                             \
+    out[l] = (value);                                                          \
+  break;
+
+    switch (inst.opcode) {
+    case Opcode::Constant:
+      FOR_LANES(constants[inst.a])
+    case Opcode::Read: {
+      const Updates &ul = updates[inst.a];
+      for (unsigned l = 0; l < n; ++l) {
+        const std::uint64_t index = static_cast<unsigned>(y[l]);
+        bool found = false;
+        for (const auto &[ui, uv] : ul.updates) {
+          if (registers[ui * n + l] == index) {
+            out[l] = registers[uv * n + l];
+            found = true;
+            break;
+          }
+        }
+        if (!found && !read(*assignments[l], ul.array, l, index, out[l]))
+          undetermined |= std::uint64_t(1) << l;
+      }
+      break;
+    }
+    case Opcode::Select:
+      FOR_LANES(x[l] ? y[l] : z[l])
+    case Opcode::Concat:
+      FOR_LANES((x[l] << inst.c) | y[l])
+    case Opcode::Extract:
+      FOR_LANES(x[l] >> inst.b)
+    case Opcode::ZExt:
+      FOR_LANES(x[l])
+    case Opcode::SExt:
+      FOR_LANES(signExtend(x[l], inst.b))
+    case Opcode::Add:
+      FOR_LANES(x[l] + y[l])
+    case Opcode::Sub:
+      FOR_LANES(x[l] - y[l])
+    case Opcode::Mul:
+      FOR_LANES(x[l] * y[l])
+    case Opcode::UDiv:
+    case Opcode::URem:
+    case Opcode::SDiv:
+    case Opcode::SRem:
+      for (unsigned l = 0; l < n; ++l) {
+        // the evaluator leaves divisions by zero unevaluated
+        if (!y[l]) {
+          undetermined |= std::uint64_t(1) << l;
+          out[l] = 0;
+          continue;
+        }
+        const std::int64_t sx = signExtend(x[l], w);
+        const std::int64_t sy = signExtend(y[l], w);
+        switch (inst.opcode) {
+        case Opcode::UDiv:
+          out[l] = x[l] / y[l];
+          break;
+        case Opcode::URem:
+          out[l] = x[l] % y[l];
+          break;
+        // avoid the overflow of INT64_MIN / -1, which wraps around like APInt
+        case Opcode::SDiv:
+          out[l] = sy == -1 ? -x[l] : sx / sy;
+          break;
+        default:
+          out[l] = sy == -1 ? 0 : sx % sy;
+          break;
+        }
+      }
+      break;
+    case Opcode::Not:
+      FOR_LANES(~x[l])
+    case Opcode::And:
+      FOR_LANES(x[l] & y[l])
+    case Opcode::Or:
+      FOR_LANES(x[l] | y[l])
+    case Opcode::Xor:
+      FOR_LANES(x[l] ^ y[l])
+    case Opcode::Shl:
+      FOR_LANES(y[l] >= w ? 0 : x[l] << y[l])
+    case Opcode::LShr:
+      FOR_LANES(y[l] >= w ? 0 : x[l] >> y[l])
+    case Opcode::AShr:
+      FOR_LANES(signExtend(x[l], w) >> std::min<std::uint64_t>(y[l], 63))
+    case Opcode::Eq:
+      FOR_LANES(x[l] == y[l])
+    case Opcode::Ne:
+      FOR_LANES(x[l] != y[l])
+    case Opcode::Ult:
+      FOR_LANES(x[l] < y[l])
+    case Opcode::Ule:
+      FOR_LANES(x[l] <= y[l])
+    case Opcode::Slt:
+      FOR_LANES(signExtend(x[l], inst.c) < signExtend(y[l], inst.c))
+    case Opcode::Sle:
+      FOR_LANES(signExtend(x[l], inst.c) <= signExtend(y[l], inst.c))
+    }
+#undef FOR_LANES
+
+    const std::uint64_t mask = getMask(w);
+    for (unsigned l = 0; l < n; ++l)
+      out[l] &= mask;
+  }
+  return undetermined;
+}
+
+ref<Expr> CompiledExpr::evaluate(const Assignment &a, unsigned i) const {
+  const Root &root = roots[i];
+  if (root.reg != NotCompiled) {
+    const Assignment *assignments[] = {&a};
+    bind(assignments, 1);
+    if (!execute(assignments, 0, root.end))
+      return ConstantExpr::alloc(registers[root.reg], root.expr->getWidth());
+  }
+  return a.evaluate(root.expr);
+}
+
+void CompiledExpr::evaluate(const std::vector<const Assignment *> &assignments,
+                            unsigned i, std::vector<ref<Expr>> &result) const {
+  const Root &root = roots[i];
+  result.clear();
+  result.reserve(assignments.size());
+  for (std::size_t first = 0; first < assignments.size(); first += MaxLanes) {
+    const unsigned n = std::min<std::size_t>(assignments.size() - first,
+                                             MaxLanes);
+    const Assignment *const *batch = &assignments[first];
+    std::uint64_t undetermined = ~std::uint64_t(0);
+    if (root.reg != NotCompiled) {
+      bind(batch, n);
+      undetermined = execute(batch, 0, root.end);
+    }
+    for (unsigned l = 0; l < n; ++l) {
+      if (undetermined & (std::uint64_t(1) << l))
+        result.push_back(batch[l]->evaluate(root.expr));
+      else
+        result.push_back(ConstantExpr::alloc(registers[root.reg * n + l],
+                                             root.expr->getWidth()));
+    }
+  }
+}
+
+bool CompiledExpr::satisfies(const Assignment &a) const {
+  const std::vector<const Assignment *> assignments = {&a};
+  return findSatisfying(assignments) == 0;
+}
+
+std::size_t CompiledExpr::findSatisfying(
+    const std::vector<const Assignment *> &assignments) const {
+  for (std::size_t first = 0; first < assignments.size(); first += MaxLanes) {
+    const unsigned n = std::min<std::size_t>(assignments.size() - first,
+                                             MaxLanes);
+    const Assignment *const *batch = &assignments[first];
+    bind(batch, n);
+
+    // lanes still satisfying all expressions, and lanes with an undetermined
+    // value that have to be checked directly
+    std::uint64_t active = n == 64 ? ~std::uint64_t(0)
+                                   : (std::uint64_t(1) << n) - 1;
+    std::uint64_t undetermined = 0;
+    unsigned executed = 0;
+    for (unsigned i = 0; i < roots.size() && active; ++i) {
+      const Root &root = roots[i];
+      if (root.reg == NotCompiled) {
+        for (unsigned l = 0; l < n; ++l) {
+          if ((active & (std::uint64_t(1) << l)) &&
+              !batch[l]->evaluate(root.expr)->isTrue())
+            active &= ~(std::uint64_t(1) << l);
+        }
+        continue;
+      }
+
+      const std::uint64_t failed = execute(batch, executed, root.end) & active;
+      executed = root.end;
+      undetermined |= failed;
+      active &= ~failed;
+      for (unsigned l = 0; l < n; ++l) {
+        if (root.expr->getWidth() != Expr::Bool ||
+            registers[root.reg * n + l] != 1)
+          active &= ~(std::uint64_t(1) << l);
+      }
+    }
+
+    for (unsigned l = 0; l < n; ++l) {
+      if (active & (std::uint64_t(1) << l))
+        return first + l;
+      if (undetermined & (std::uint64_t(1) << l)) {
+        AssignmentEvaluator v(*batch[l]);
+        if (std::all_of(roots.begin(), roots.end(), [&](const Root &root) {
+              return v.visit(root.expr)->isTrue();
+            }))
+          return first + l;
+      }
+    }
+  }
+  return assignments.size();
+}
@@ -9,6 +9,7 @@
 
 #include "klee/Expr/Constraints.h"
 
+#include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Module/KModule.h"
 #include "klee/Support/OptionCategories.h"
@@ -16,6 +17,7 @@
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
 #include <map>
 
 using namespace klee;
@@ -54,39 +56,92 @@ public:
 
 class ExprReplaceVisitor2 : public ExprVisitor {
 private:
-  const std::map< ref<Expr>, ref<Expr> > &replacements;
+  const ConstraintSet::equalities_ty &replacements;
 
 public:
   explicit ExprReplaceVisitor2(
-      const std::map<ref<Expr>, ref<Expr>> &_replacements)
+      const ConstraintSet::equalities_ty &_replacements)
       : ExprVisitor(true), replacements(_replacements) {}
 
   Action visitExprPost(const Expr &e) override {
-    auto it = replacements.find(ref<Expr>(const_cast<Expr *>(&e)));
-    if (it!=replacements.end()) {
+    auto it = replacements.lookup(ref<Expr>(const_cast<Expr *>(&e)));
+    if (it) {
       return Action::changeTo(it->second);
     }
     return Action::doChildren();
   }
 };
 
-bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
-  ConstraintSet old;
-  bool changed = false;
+namespace klee {
+/// Simplifies expressions with a fixed set of equalities. The visitor caches
+/// the result for every sub-expression it has seen, so repeated queries
+/// under unchanged constraints only traverse new parts of an expression.
+class ConstraintSimplifier {
+  /// Bound on the expressions simplified before the memo is dropped
+  static constexpr unsigned MaxCalls = 1024;
 
-  std::swap(constraints, old);
-  for (auto &ce : old) {
-    ref<Expr> e = visitor.visit(ce);
+  const ConstraintSet::equalities_ty equalities;
+  std::unique_ptr<ExprReplaceVisitor2> visitor;
+  unsigned calls = 0;
 
-    if (e!=ce) {
-      addConstraintInternal(e); // enable further reductions
-      changed = true;
-    } else {
-      constraints.push_back(ce);
+public:
+  explicit ConstraintSimplifier(const ConstraintSet::equalities_ty &equalities)
+      : equalities(equalities),
+        visitor(std::make_unique<ExprReplaceVisitor2>(this->equalities)) {}
+
+  ref<Expr> simplify(const ref<Expr> &e) {
+    if (++calls > MaxCalls) {
+      visitor = std::make_unique<ExprReplaceVisitor2>(equalities);
+      calls = 1;
     }
+    return visitor->visit(e);
   }
-
-  return changed;
+};
+} // namespace klee
+
+bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor,
+                                           const ref<Expr> &src) {
+  // only the constraints that read everything `src` reads can contain it
+  std::map<ref<Expr>, ref<Expr>> rewritten;
+  auto rewrite = [&](const ref<Expr> &ce) {
+    if (rewritten.count(ce))
+      return;
+    ref<Expr> e = visitor.visit(ce);
+    if (e != ce)
+      rewritten.emplace(ce, e);
+  };
+  if (const auto *candidates = constraints.findCandidates(src)) {
+    for (const auto &candidate : *candidates)
+      rewrite(candidate.first);
+  } else {
+    for (const auto &ce : constraints)
+      rewrite(ce);
+  }
+  if (rewritten.empty())
+    return false;
+
+  // remove the changed constraints and add their rewritten forms afterwards,
+  // so that they can in turn rewrite all remaining constraints
+  std::vector<ref<Expr>> added;
+  auto &cs = constraints.constraints;
+  cs.erase(std::remove_if(cs.begin(), cs.end(),
+                          [&](const ref<Expr> &ce) {
+                            auto it = rewritten.find(ce);
+                            if (it == rewritten.end())
+                              return false;
+                            if (constraints.readsValid)
+                              constraints.removeReads(ce);
+                            added.push_back(it->second);
+                            return true;
+                          }),
+           cs.end());
+  constraints.equalities = ConstraintSet::equalities_ty();
+  constraints.equalitiesValid = false;
+  constraints.simplifier.reset();
+
+  for (const auto &e : added)
+    addConstraintInternal(e); // enable further reductions
+  return true;
 }
 
 ref<Expr> ConstraintManager::simplifyExpr(const ConstraintSet &constraints,
@@ -95,24 +150,10 @@ ref<Expr> ConstraintManager::simplifyExpr(const ConstraintSet &constraints,
   if (isa<ConstantExpr>(e))
     return e;
 
-  std::map< ref<Expr>, ref<Expr> > equalities;
-
-  for (auto &constraint : constraints) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(constraint)) {
-      if (isa<ConstantExpr>(ee->left)) {
-        equalities.insert(std::make_pair(ee->right,
-                                         ee->left));
-      } else {
-        equalities.insert(
-            std::make_pair(constraint, ConstantExpr::alloc(1, Expr::Bool)));
-      }
-    } else {
-      equalities.insert(
-          std::make_pair(constraint, ConstantExpr::alloc(1, Expr::Bool)));
-    }
-  }
-
-  return ExprReplaceVisitor2(equalities).visit(e);
+  if (!constraints.simplifier)
+    constraints.simplifier =
+        std::make_shared<ConstraintSimplifier>(constraints.getEqualities());
+  return constraints.simplifier->simplify(e);
 }
 
 void ConstraintManager::addConstraintInternal(const ref<Expr> &e) {
@@ -134,15 +175,10 @@ void ConstraintManager::addConstraintInternal(const ref<Expr> &e) {
 
   case Expr::Eq: {
     if (RewriteEqualities) {
-      // XXX: should profile the effects of this and the overhead.
-      // traversing the constraints looking for equalities is hardly the
-      // slowest thing we do, but it is probably nicer to have a
-      // ConstraintSet ADT which efficiently remembers obvious patterns
-      // (byte-constant comparison).
       BinaryExpr *be = cast<BinaryExpr>(e);
       if (isa<ConstantExpr>(be->left)) {
-	ExprReplaceVisitor visitor(be->right, be->left);
-	rewriteConstraints(visitor);
+        ExprReplaceVisitor visitor(be->right, be->left);
+        rewriteConstraints(visitor, be->right);
       }
     }
     constraints.push_back(e);
@@ -175,4 +211,115 @@ klee::ConstraintSet::constraint_iterator ConstraintSet::end() const {
 
 size_t ConstraintSet::size() const noexcept { return constraints.size(); }
 
-void ConstraintSet::push_back(const ref<Expr> &e) { constraints.push_back(e); }
+void ConstraintSet::push_back(const ref<Expr> &e) {
+  constraints.push_back(e);
+  if (equalitiesValid)
+    addEquality(e);
+  if (readsValid)
+    addReads(e);
+  simplifier.reset();
+}
+
+void ConstraintSet::addEquality(const ref<Expr> &constraint) const {
+  // the first replacement for an expression wins
+  ref<Expr> key = constraint, value = ConstantExpr::alloc(1, Expr::Bool);
+  if (const EqExpr *ee = dyn_cast<EqExpr>(constraint)) {
+    if (isa<ConstantExpr>(ee->left)) {
+      key = ee->right;
+      value = ee->left;
+    }
+  }
+  if (!equalities.count(key))
+    equalities.replaceInPlace(std::make_pair(key, value));
+}
+
+const ConstraintSet::equalities_ty &ConstraintSet::getEqualities() const {
+  if (!equalitiesValid) {
+    for (const auto &constraint : constraints)
+      addEquality(constraint);
+    equalitiesValid = true;
+  }
+  return equalities;
+}
+
+void ConstraintSet::addReads(const ref<Expr> &constraint) const {
+  if (const auto *entry = constraintReads.lookup(constraint)) {
+    ConstraintReads info = entry->second;
+    ++info.count;
+    constraintReads.replaceInPlace(std::make_pair(constraint, info));
+    return;
+  }
+
+  auto reads = std::make_shared<reads_ty>();
+  findReads(constraint, /* visitUpdates= */ true, *reads);
+  for (const auto &read : *reads) {
+    occurrences_ty constraints;
+    if (const auto *entry = occurrences.lookup(read))
+      constraints = entry->second;
+    constraints.replaceInPlace(std::make_pair(constraint, true));
+    occurrences.replaceInPlace(std::make_pair(read, constraints));
+  }
+  constraintReads.replaceInPlace(
+      std::make_pair(constraint, ConstraintReads{std::move(reads), 1}));
+}
+
+void ConstraintSet::removeReads(const ref<Expr> &constraint) const {
+  const auto *entry = constraintReads.lookup(constraint);
+  assert(entry && "constraint is not part of the set");
+  ConstraintReads info = entry->second;
+  if (--info.count) {
+    constraintReads.replaceInPlace(std::make_pair(constraint, info));
+    return;
+  }
+
+  for (const auto &read : *info.reads) {
+    const auto *occ = occurrences.lookup(read);
+    if (!occ)
+      continue; // the same read occurs more than once
+    occurrences_ty constraints = occ->second;
+    constraints.removeInPlace(constraint);
+    if (constraints.empty())
+      occurrences.removeInPlace(read);
+    else
+      occurrences.replaceInPlace(std::make_pair(read, constraints));
+  }
+  constraintReads.removeInPlace(constraint);
+}
+
+void ConstraintSet::buildReads() const {
+  if (readsValid)
+    return;
+  for (const auto &constraint : constraints)
+    addReads(constraint);
+  readsValid = true;
+}
+
+const ConstraintSet::reads_ty &
+ConstraintSet::getReads(const ref<Expr> &constraint) const {
+  buildReads();
+  const auto *entry = constraintReads.lookup(constraint);
+  assert(entry && "constraint is not part of the set");
+  return *entry->second.reads;
+}
+
+const ConstraintSet::occurrences_ty *
+ConstraintSet::findCandidates(const ref<Expr> &e) const {
+  std::vector<ref<ReadExpr>> reads;
+  findReads(e, /* visitUpdates= */ true, reads);
+  if (reads.empty())
+    return nullptr;
+
+  buildReads();
+  // a constraint containing `e` contains every read of it, so it suffices to
+  // look at the constraints of the rarest one
+  static const occurrences_ty none;
+  const occurrences_ty *candidates = nullptr;
+  for (const auto &read : reads) {
+    const auto *entry = occurrences.lookup(read);
+    if (!entry)
+      return &none;
+    if (!candidates || entry->second.size() < candidates->size())
+      candidates = &entry->second;
+  }
+  return candidates;
+}
@@ -44,6 +44,7 @@ cl::opt<bool> ConstArrayOpt(
 /***/
 
 unsigned Expr::count = 0;
+ExprAllocator Expr::allocator;
 
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
@@ -0,0 +1,41 @@
+//===-- ExprAllocator.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprAllocator.h"
+
+#include <cassert>
+
+using namespace klee;
+
+void *ExprAllocator::refill(std::size_t sizeClass) {
+  const std::size_t chunkSize = (sizeClass + 1) * Granularity;
+
+  if (static_cast<std::size_t>(slabEnd - slabCursor) < chunkSize) {
+    // Hand the tail of the current slab to the free lists before starting a
+    // new one, so that no memory is wasted.
+    while (slabCursor && slabCursor != slabEnd) {
+      std::size_t remaining = static_cast<std::size_t>(slabEnd - slabCursor);
+      std::size_t tailClass =
+          (remaining < MaxSize ? remaining : MaxSize) / Granularity - 1;
+      FreeNode *node = reinterpret_cast<FreeNode *>(slabCursor);
+      node->next = freeLists[tailClass];
+      freeLists[tailClass] = node;
+      slabCursor += (tailClass + 1) * Granularity;
+    }
+
+    slabCursor = static_cast<char *>(::operator new(SlabSize));
+    slabEnd = slabCursor + SlabSize;
+    reservedBytes += SlabSize;
+  }
+
+  assert(static_cast<std::size_t>(slabEnd - slabCursor) >= chunkSize);
+  void *result = slabCursor;
+  slabCursor += chunkSize;
+  return result;
+}
@@ -11,6 +11,9 @@
 #include "klee/Expr/ExprStats.h"
 #include "klee/Expr/Expr.h"
 
+#include <algorithm>
+#include <cstdint>
+
 using namespace klee;
 
 ExprBuilder::ExprBuilder() {
@@ -2301,6 +2304,501 @@ namespace {
 
   typedef ConstantSpecializedExprBuilder<SimplifyingBuilder>
     SimplifyingExprBuilder;
+
+  /// Bits of a value of at most 64 bits that are known to be zero or one.
+  struct KnownBits {
+    uint64_t zero = 0;
+    uint64_t one = 0;
+  };
+
+  uint64_t getWidthMask(Expr::Width W) {
+    return W >= 64 ? ~UINT64_C(0) : (UINT64_C(1) << W) - 1;
+  }
+
+  /// Operand depth up to which known bits and ranges are computed, which
+  /// bounds the work done per constructed expression.
+  const unsigned MaxAnalysisDepth = 6;
+
+  KnownBits computeKnownBits(const ref<Expr> &E, unsigned Depth) {
+    KnownBits Known;
+    const Expr::Width Width = E->getWidth();
+    if (Width > 64)
+      return Known;
+    const uint64_t Mask = getWidthMask(Width);
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(E)) {
+      Known.one = CE->getZExtValue();
+      Known.zero = ~Known.one & Mask;
+      return Known;
+    }
+    if (Depth-- == 0)
+      return Known;
+
+    switch (E->getKind()) {
+    default:
+      break;
+
+    case Expr::ZExt: {
+      const ref<Expr> &Src = cast<CastExpr>(E)->src;
+      Known = computeKnownBits(Src, Depth);
+      Known.zero |= Mask & ~getWidthMask(Src->getWidth());
+      break;
+    }
+
+    case Expr::SExt: {
+      const ref<Expr> &Src = cast<CastExpr>(E)->src;
+      Known = computeKnownBits(Src, Depth);
+      const uint64_t Sign = UINT64_C(1) << (Src->getWidth() - 1);
+      const uint64_t High = Mask & ~getWidthMask(Src->getWidth());
+      if (Known.zero & Sign)
+        Known.zero |= High;
+      else if (Known.one & Sign)
+        Known.one |= High;
+      break;
+    }
+
+    case Expr::Concat: {
+      const ConcatExpr *CE = cast<ConcatExpr>(E);
+      const KnownBits L = computeKnownBits(CE->getLeft(), Depth);
+      const KnownBits R = computeKnownBits(CE->getRight(), Depth);
+      const unsigned Shift = CE->getRight()->getWidth();
+      Known.zero = (L.zero << Shift) | R.zero;
+      Known.one = (L.one << Shift) | R.one;
+      break;
+    }
+
+    case Expr::Extract: {
+      const ExtractExpr *EE = cast<ExtractExpr>(E);
+      if (EE->expr->getWidth() > 64)
+        break;
+      const KnownBits K = computeKnownBits(EE->expr, Depth);
+      Known.zero = (K.zero >> EE->offset) & Mask;
+      Known.one = (K.one >> EE->offset) & Mask;
+      break;
+    }
+
+    case Expr::Select: {
+      const SelectExpr *SE = cast<SelectExpr>(E);
+      const KnownBits T = computeKnownBits(SE->trueExpr, Depth);
+      const KnownBits F = computeKnownBits(SE->falseExpr, Depth);
+      Known.zero = T.zero & F.zero;
+      Known.one = T.one & F.one;
+      break;
+    }
+
+    case Expr::And:
+    case Expr::Or:
+    case Expr::Xor: {
+      const BinaryExpr *BE = cast<BinaryExpr>(E);
+      const KnownBits L = computeKnownBits(BE->left, Depth);
+      const KnownBits R = computeKnownBits(BE->right, Depth);
+      if (E->getKind() == Expr::And) {
+        Known.zero = L.zero | R.zero;
+        Known.one = L.one & R.one;
+      } else if (E->getKind() == Expr::Or) {
+        Known.zero = L.zero & R.zero;
+        Known.one = L.one | R.one;
+      } else {
+        Known.zero = (L.zero & R.zero) | (L.one & R.one);
+        Known.one = (L.zero & R.one) | (L.one & R.zero);
+      }
+      break;
+    }
+
+    case Expr::Shl:
+    case Expr::LShr: {
+      const BinaryExpr *BE = cast<BinaryExpr>(E);
+      const ConstantExpr *CE = dyn_cast<ConstantExpr>(BE->right);
+      if (!CE || CE->getZExtValue() >= Width)
+        break;
+      const unsigned Shift = CE->getZExtValue();
+      const KnownBits K = computeKnownBits(BE->left, Depth);
+      if (E->getKind() == Expr::Shl) {
+        Known.zero = ((K.zero << Shift) | getWidthMask(Shift)) & Mask;
+        Known.one = (K.one << Shift) & Mask;
+      } else {
+        Known.zero = (K.zero >> Shift) | (Mask & ~(Mask >> Shift));
+        Known.one = K.one >> Shift;
+      }
+      break;
+    }
+    }
+
+    return Known;
+  }
+
+  /// Computes bounds of the unsigned value of \a E, which must be at most 64
+  /// bits wide, from its known bits and the ranges of its operands.
+  void computeRange(const ref<Expr> &E, unsigned Depth, uint64_t &Min,
+                    uint64_t &Max) {
+    const uint64_t Mask = getWidthMask(E->getWidth());
+    const KnownBits Known = computeKnownBits(E, Depth);
+    Min = Known.one;
+    Max = ~Known.zero & Mask;
+    if (isa<ConstantExpr>(E) || Depth-- == 0)
+      return;
+
+    uint64_t LMin, LMax, RMin, RMax;
+    switch (E->getKind()) {
+    default:
+      return;
+
+    case Expr::ZExt:
+      computeRange(cast<CastExpr>(E)->src, Depth, LMin, LMax);
+      break;
+
+    case Expr::Select: {
+      const SelectExpr *SE = cast<SelectExpr>(E);
+      computeRange(SE->trueExpr, Depth, LMin, LMax);
+      computeRange(SE->falseExpr, Depth, RMin, RMax);
+      LMin = std::min(LMin, RMin);
+      LMax = std::max(LMax, RMax);
+      break;
+    }
+
+    case Expr::Add: {
+      const BinaryExpr *BE = cast<BinaryExpr>(E);
+      computeRange(BE->left, Depth, LMin, LMax);
+      computeRange(BE->right, Depth, RMin, RMax);
+      // Only sums that cannot wrap around
+      if (LMax > Mask - RMax)
+        return;
+      LMin += RMin;
+      LMax += RMax;
+      break;
+    }
+
+    case Expr::UDiv:
+    case Expr::URem: {
+      const BinaryExpr *BE = cast<BinaryExpr>(E);
+      const ConstantExpr *CE = dyn_cast<ConstantExpr>(BE->right);
+      if (!CE || CE->isZero())
+        return;
+      const uint64_t Divisor = CE->getZExtValue();
+      computeRange(BE->left, Depth, LMin, LMax);
+      if (E->getKind() == Expr::UDiv) {
+        LMin /= Divisor;
+        LMax /= Divisor;
+      } else if (LMax >= Divisor) {
+        LMin = 0;
+        LMax = Divisor - 1;
+      }
+      break;
+    }
+    }
+
+    Min = std::max(Min, LMin);
+    Max = std::min(Max, LMax);
+  }
+
+  /// WordLevelBuilder - Simplifies the byte-wise expressions produced for
+  /// multi-byte memory accesses at the level of whole words, and folds
+  /// comparisons that are decided by the known bits or the value ranges of
+  /// their operands.
+  ///
+  /// A word is a right-nested chain of concatenated bytes: extracts from it
+  /// select the bytes directly, contiguous extracts of the same word are
+  /// merged back, and equalities of words drop the parts that are decided
+  /// on their own.
+  class WordLevelBuilder : public ChainedBuilder {
+    /// Returns true or false if the unsigned (or signed) comparison
+    /// `LHS < RHS` (`LHS <= RHS` if \a OrEqual) is decided by the ranges of
+    /// its operands, or null otherwise.
+    ref<Expr> decideLess(const ref<Expr> &LHS, const ref<Expr> &RHS,
+                         bool OrEqual, bool Signed) {
+      const Expr::Width Width = LHS->getWidth();
+      if (Width > 64 || Width == Expr::Bool)
+        return nullptr;
+      uint64_t LMin, LMax, RMin, RMax;
+      computeRange(LHS, MaxAnalysisDepth, LMin, LMax);
+      computeRange(RHS, MaxAnalysisDepth, RMin, RMax);
+      // Signed comparisons are only decided for non-negative operands, for
+      // which they match the unsigned ones
+      if (Signed) {
+        const uint64_t Sign = UINT64_C(1) << (Width - 1);
+        if (LMax >= Sign || RMax >= Sign)
+          return nullptr;
+      }
+      if (OrEqual ? LMax <= RMin : LMax < RMin)
+        return Builder->True();
+      if (OrEqual ? LMin > RMax : LMin >= RMax)
+        return Builder->False();
+      return nullptr;
+    }
+
+    /// Returns false if `LHS == RHS` is refuted by the known bits or ranges
+    /// of its operands, or null otherwise.
+    ref<Expr> refuteEq(const ref<Expr> &LHS, const ref<Expr> &RHS) {
+      const Expr::Width Width = LHS->getWidth();
+      if (Width > 64 || Width == Expr::Bool)
+        return nullptr;
+      const KnownBits L = computeKnownBits(LHS, MaxAnalysisDepth);
+      const KnownBits R = computeKnownBits(RHS, MaxAnalysisDepth);
+      if ((L.one & R.zero) || (L.zero & R.one))
+        return Builder->False();
+      uint64_t LMin, LMax, RMin, RMax;
+      computeRange(LHS, MaxAnalysisDepth, LMin, LMax);
+      computeRange(RHS, MaxAnalysisDepth, RMin, RMax);
+      if (LMax < RMin || RMax < LMin)
+        return Builder->False();
+      return nullptr;
+    }
+
+  public:
+    WordLevelBuilder(ExprBuilder *Builder, ExprBuilder *Base)
+      : ChainedBuilder(Builder, Base) {}
+
+    ref<Expr> Concat(const ref<ConstantExpr> &LHS,
+                     const ref<NonConstantExpr> &RHS) {
+      // Concat 0 X ==> ZExt X
+      if (LHS->isZero())
+        return Builder->ZExt(RHS, LHS->getWidth() + RHS->getWidth());
+      return Base->Concat(LHS, RHS);
+    }
+
+    ref<Expr> Concat(const ref<NonConstantExpr> &LHS,
+                     const ref<ConstantExpr> &RHS) {
+      return Base->Concat(LHS, RHS);
+    }
+
+    ref<Expr> Concat(const ref<NonConstantExpr> &LHS,
+                     const ref<NonConstantExpr> &RHS) {
+      const ExtractExpr *LE = dyn_cast<ExtractExpr>(LHS);
+      if (!LE)
+        return Base->Concat(LHS, RHS);
+
+      // Concat (Extract X o+w w') (Extract X o w) ==> Extract X o (w+w')
+      if (const ExtractExpr *RE = dyn_cast<ExtractExpr>(RHS))
+        if (LE->expr == RE->expr && RE->offset + RE->width == LE->offset)
+          return Builder->Extract(LE->expr, RE->offset,
+                                  LE->width + RE->width);
+
+      // The same for the leftmost parts of a right-nested chain
+      if (const ConcatExpr *RC = dyn_cast<ConcatExpr>(RHS))
+        if (const ExtractExpr *RE = dyn_cast<ExtractExpr>(RC->getLeft()))
+          if (LE->expr == RE->expr && RE->offset + RE->width == LE->offset)
+            return Builder->Concat(
+                Builder->Extract(LE->expr, RE->offset, LE->width + RE->width),
+                RC->getRight());
+
+      return Base->Concat(LHS, RHS);
+    }
+
+    ref<Expr> Extract(const ref<NonConstantExpr> &LHS, unsigned Offset,
+                      Expr::Width W) {
+      if (W == LHS->getWidth())
+        return LHS;
+
+      switch (LHS->getKind()) {
+      default:
+        break;
+
+      case Expr::Concat: {
+        // Select the parts of the word that are extracted
+        const ConcatExpr *CE = cast<ConcatExpr>(LHS);
+        const Expr::Width RW = CE->getRight()->getWidth();
+        if (Offset >= RW)
+          return Builder->Extract(CE->getLeft(), Offset - RW, W);
+        if (Offset + W <= RW)
+          return Builder->Extract(CE->getRight(), Offset, W);
+        return Builder->Concat(
+            Builder->Extract(CE->getLeft(), 0, Offset + W - RW),
+            Builder->Extract(CE->getRight(), Offset, RW - Offset));
+      }
+
+      case Expr::Extract: {
+        // Extract (Extract X o) o' w ==> Extract X (o+o') w
+        const ExtractExpr *EE = cast<ExtractExpr>(LHS);
+        return Builder->Extract(EE->expr, EE->offset + Offset, W);
+      }
+
+      case Expr::ZExt:
+      case Expr::SExt: {
+        const ref<Expr> &Src = cast<CastExpr>(LHS)->src;
+        const Expr::Width SW = Src->getWidth();
+        if (Offset + W <= SW)
+          return Builder->Extract(Src, Offset, W);
+        if (LHS->getKind() == Expr::SExt)
+          break;
+        // Only the zeros of the extension are extracted
+        if (Offset >= SW)
+          return Builder->Constant(0, W);
+        return Builder->ZExt(Builder->Extract(Src, Offset, SW - Offset), W);
+      }
+      }
+
+      return Base->Extract(LHS, Offset, W);
+    }
+
+    ref<Expr> ZExt(const ref<NonConstantExpr> &LHS, Expr::Width W) {
+      if (W > LHS->getWidth())
+        // ZExt (ZExt X) w ==> ZExt X w
+        if (const ZExtExpr *ZE = dyn_cast<ZExtExpr>(LHS))
+          return Builder->ZExt(ZE->src, W);
+      return Base->ZExt(LHS, W);
+    }
+
+    ref<Expr> SExt(const ref<NonConstantExpr> &LHS, Expr::Width W) {
+      const Expr::Width Width = LHS->getWidth();
+      // The extension of a value with a zero sign bit is a zero extension
+      if (W > Width && Width <= 64 &&
+          (computeKnownBits(LHS, MaxAnalysisDepth).zero >> (Width - 1)) & 1)
+        return Builder->ZExt(LHS, W);
+      return Base->SExt(LHS, W);
+    }
+
+    ref<Expr> And(const ref<ConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      const Expr::Width Width = RHS->getWidth();
+      if (Width <= 64) {
+        const uint64_t Mask = getWidthMask(Width);
+        const uint64_t C = LHS->getZExtValue();
+        const uint64_t Unknown = ~computeKnownBits(RHS, MaxAnalysisDepth).zero;
+        // C & X ==> 0 if C only keeps bits known to be zero
+        if (!(C & Unknown & Mask))
+          return Builder->Constant(0, Width);
+        // C & X ==> X if C only clears bits known to be zero
+        if (!(~C & Unknown & Mask))
+          return RHS;
+      }
+      return Base->And(LHS, RHS);
+    }
+
+    ref<Expr> And(const ref<NonConstantExpr> &LHS,
+                  const ref<ConstantExpr> &RHS) {
+      return And(RHS, LHS);
+    }
+
+    ref<Expr> And(const ref<NonConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      return Base->And(LHS, RHS);
+    }
+
+    ref<Expr> Eq(const ref<ConstantExpr> &LHS,
+                 const ref<NonConstantExpr> &RHS) {
+      // C == Concat X Y ==> C[hi] == X && C[lo] == Y, kept only where a part
+      // is constant so that the query shrinks
+      if (const ConcatExpr *CE = dyn_cast<ConcatExpr>(RHS)) {
+        const Expr::Width RW = CE->getRight()->getWidth();
+        ref<Expr> High = Builder->Eq(
+            LHS->Extract(RW, CE->getLeft()->getWidth()), CE->getLeft());
+        ref<Expr> Low = Builder->Eq(LHS->Extract(0, RW), CE->getRight());
+        if (isa<ConstantExpr>(High) || isa<ConstantExpr>(Low))
+          return Builder->And(High, Low);
+      }
+      if (ref<Expr> Refuted = refuteEq(LHS, RHS))
+        return Refuted;
+      return Base->Eq(LHS, RHS);
+    }
+
+    ref<Expr> Eq(const ref<NonConstantExpr> &LHS,
+                 const ref<ConstantExpr> &RHS) {
+      return Eq(RHS, LHS);
+    }
+
+    ref<Expr> Eq(const ref<NonConstantExpr> &LHS,
+                 const ref<NonConstantExpr> &RHS) {
+      // Concat X Y == Concat X Y' ==> Y == Y' (and the same for equal lower
+      // parts) for words split at the same position
+      if (const ConcatExpr *LC = dyn_cast<ConcatExpr>(LHS))
+        if (const ConcatExpr *RC = dyn_cast<ConcatExpr>(RHS))
+          if (LC->getRight()->getWidth() == RC->getRight()->getWidth()) {
+            if (LC->getLeft() == RC->getLeft())
+              return Builder->Eq(LC->getRight(), RC->getRight());
+            if (LC->getRight() == RC->getRight())
+              return Builder->Eq(LC->getLeft(), RC->getLeft());
+          }
+      if (ref<Expr> Refuted = refuteEq(LHS, RHS))
+        return Refuted;
+      return Base->Eq(LHS, RHS);
+    }
+
+    ref<Expr> Ult(const ref<ConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, false, false))
+        return Decided;
+      return Base->Ult(LHS, RHS);
+    }
+
+    ref<Expr> Ult(const ref<NonConstantExpr> &LHS,
+                  const ref<ConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, false, false))
+        return Decided;
+      return Base->Ult(LHS, RHS);
+    }
+
+    ref<Expr> Ult(const ref<NonConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, false, false))
+        return Decided;
+      return Base->Ult(LHS, RHS);
+    }
+
+    ref<Expr> Ule(const ref<ConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, true, false))
+        return Decided;
+      return Base->Ule(LHS, RHS);
+    }
+
+    ref<Expr> Ule(const ref<NonConstantExpr> &LHS,
+                  const ref<ConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, true, false))
+        return Decided;
+      return Base->Ule(LHS, RHS);
+    }
+
+    ref<Expr> Ule(const ref<NonConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, true, false))
+        return Decided;
+      return Base->Ule(LHS, RHS);
+    }
+
+    ref<Expr> Slt(const ref<ConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, false, true))
+        return Decided;
+      return Base->Slt(LHS, RHS);
+    }
+
+    ref<Expr> Slt(const ref<NonConstantExpr> &LHS,
+                  const ref<ConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, false, true))
+        return Decided;
+      return Base->Slt(LHS, RHS);
+    }
+
+    ref<Expr> Slt(const ref<NonConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, false, true))
+        return Decided;
+      return Base->Slt(LHS, RHS);
+    }
+
+    ref<Expr> Sle(const ref<ConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, true, true))
+        return Decided;
+      return Base->Sle(LHS, RHS);
+    }
+
+    ref<Expr> Sle(const ref<NonConstantExpr> &LHS,
+                  const ref<ConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, true, true))
+        return Decided;
+      return Base->Sle(LHS, RHS);
+    }
+
+    ref<Expr> Sle(const ref<NonConstantExpr> &LHS,
+                  const ref<NonConstantExpr> &RHS) {
+      if (ref<Expr> Decided = decideLess(LHS, RHS, true, true))
+        return Decided;
+      return Base->Sle(LHS, RHS);
+    }
+  };
+
+  typedef ConstantSpecializedExprBuilder<WordLevelBuilder>
+    WordLevelExprBuilder;
 }
 
 ExprBuilder *klee::createDefaultExprBuilder() {
@@ -2315,6 +2813,10 @@ ExprBuilder *klee::createSimplifyingExprBuilder(ExprBuilder *Base) {
   return new SimplifyingExprBuilder(Base);
 }
 
+ExprBuilder *klee::createWordLevelExprBuilder(ExprBuilder *Base) {
+  return new WordLevelExprBuilder(Base);
+}
+
 namespace klee {
 
   ExprBuilder* exprBuilder = nullptr;
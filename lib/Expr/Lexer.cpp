@@ -12,8 +12,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
-#include <iomanip>
-#include <string.h>
+#include <cstring>
 
 using namespace llvm;
 using namespace klee;
@@ -59,45 +58,58 @@ void Token::dump() {
 
 ///
 
-static inline bool isInternalIdentifierChar(int Char) {
-  return isalnum(Char) || Char == '_' || Char == '.' || Char == '-';
-}
+namespace {
+/// Character classes used by the lexer
+enum CharClass : unsigned char {
+  CC_Space = 1 << 0,      ///< [ \t\n\v\f\r]
+  CC_Digit = 1 << 1,      ///< [0-9]
+  CC_IdentStart = 1 << 2, ///< [a-zA-Z_]
+  CC_IdentChar = 1 << 3,  ///< [a-zA-Z0-9_.-]
+  CC_NumberChar = 1 << 4, ///< [a-zA-Z0-9_]
+  CC_ParenScan = 1 << 5   ///< [()#\n\r], stops SkipParens
+};
+
+struct CharClassTable {
+  unsigned char Classes[256] = {};
+
+  constexpr CharClassTable() {
+    for (unsigned C : {' ', '\t', '\n', '\v', '\f', '\r'})
+      Classes[C] |= CC_Space;
+    for (unsigned C = '0'; C <= '9'; ++C)
+      Classes[C] |= CC_Digit | CC_IdentChar | CC_NumberChar;
+    for (unsigned C = 'a'; C <= 'z'; ++C) {
+      Classes[C] |= CC_IdentStart | CC_IdentChar | CC_NumberChar;
+      Classes[C - 'a' + 'A'] |= CC_IdentStart | CC_IdentChar | CC_NumberChar;
+    }
+    Classes[unsigned('_')] |= CC_IdentStart | CC_IdentChar | CC_NumberChar;
+    Classes[unsigned('.')] |= CC_IdentChar;
+    Classes[unsigned('-')] |= CC_IdentChar;
+    for (unsigned C : {'(', ')', '#', '\n', '\r'})
+      Classes[C] |= CC_ParenScan;
+  }
+};
+} // namespace
 
-Lexer::Lexer(const llvm::MemoryBuffer *MB) 
-  : BufferPos(MB->getBufferStart()), BufferEnd(MB->getBufferEnd()), 
-    LineNumber(1), ColumnNumber(0) {
-}
+static constexpr CharClassTable CharClasses;
 
-Lexer::~Lexer() {
+static inline bool isClass(char Char, unsigned char Class) {
+  return CharClasses.Classes[static_cast<unsigned char>(Char)] & Class;
 }
 
-int Lexer::PeekNextChar() {
-  if (BufferPos == BufferEnd)
-    return -1;
-  return *BufferPos;
+Lexer::Lexer(const llvm::MemoryBuffer *MB)
+  : BufferPos(MB->getBufferStart()), BufferEnd(MB->getBufferEnd()),
+    LineStart(BufferPos), LineNumber(1) {
 }
 
-int Lexer::GetNextChar() {
-  if (BufferPos == BufferEnd)
-    return -1;
-
-  // Handle DOS/Mac newlines here, by stripping duplicates and by
-  // returning '\n' for both.
-  char Result = *BufferPos++;
-  if (Result == '\n' || Result == '\r') {
-    if (BufferPos != BufferEnd && *BufferPos == ('\n' + '\r' - Result))
-      ++BufferPos;
-    Result = '\n';
-  }
-
-  if (Result == '\n') {
-    ++LineNumber;
-    ColumnNumber = 0;
-  } else {
-    ++ColumnNumber;
-  }
+Lexer::~Lexer() {
+}
 
-  return Result;
+void Lexer::ConsumeNewline(char Char) {
+  // Handle DOS/Mac newlines here, by treating '\r\n' and '\n\r' as one.
+  if (BufferPos != BufferEnd && *BufferPos == ('\n' + '\r' - Char))
+    ++BufferPos;
+  ++LineNumber;
+  LineStart = BufferPos;
 }
 
 Token &Lexer::SetTokenKind(Token &Result, Token::Kind k) {
@@ -185,23 +197,41 @@ Token &Lexer::SetIdentifierTokenKind(Token &Result) {
   return SetTokenKind(Result, Token::Identifier);
 }
 
+void Lexer::SkipWhitespace() {
+  while (BufferPos != BufferEnd && isClass(*BufferPos, CC_Space)) {
+    const char Char = *BufferPos++;
+    if (Char == '\n' || Char == '\r')
+      ConsumeNewline(Char);
+  }
+}
+
 void Lexer::SkipToEndOfLine() {
-  for (;;) {
-    int Char = GetNextChar();
-    if (Char == -1 || Char =='\n')
-      break;
+  const std::size_t Size = BufferEnd - BufferPos;
+  const char *End =
+      static_cast<const char *>(std::memchr(BufferPos, '\n', Size));
+  if (!End)
+    End = BufferEnd;
+  if (const char *CR = static_cast<const char *>(
+          std::memchr(BufferPos, '\r', End - BufferPos)))
+    End = CR;
+
+  if (End == BufferEnd) {
+    BufferPos = BufferEnd;
+    return;
   }
+  BufferPos = End + 1;
+  ConsumeNewline(*End);
 }
 
 Token &Lexer::LexNumber(Token &Result) {
-  while (isalnum(PeekNextChar()) || PeekNextChar()=='_')
-    GetNextChar();
+  while (BufferPos != BufferEnd && isClass(*BufferPos, CC_NumberChar))
+    ++BufferPos;
   return SetTokenKind(Result, Token::Number);
 }
 
 Token &Lexer::LexIdentifier(Token &Result) {
-  while (isInternalIdentifierChar(PeekNextChar()))
-    GetNextChar();
+  while (BufferPos != BufferEnd && isClass(*BufferPos, CC_IdentChar))
+    ++BufferPos;
 
   // Recognize keywords specially.
   return SetIdentifierTokenKind(Result);
@@ -210,19 +240,19 @@ Token &Lexer::LexIdentifier(Token &Result) {
 Token &Lexer::Lex(Token &Result) {
   Result.kind = Token::Unknown;
   Result.length = 0;
-  Result.start = BufferPos;
-  
-  // Skip whitespace.
-  while (isspace(PeekNextChar()))
-    GetNextChar();
+
+  SkipWhitespace();
 
   Result.start = BufferPos;
   Result.line = LineNumber;
-  Result.column = ColumnNumber;
-  int Char = GetNextChar();
+  Result.column = BufferPos - LineStart;
+  if (BufferPos == BufferEnd)
+    return SetTokenKind(Result, Token::EndOfFile);
+
+  const char Char = *BufferPos++;
+  const bool NextIsDigit =
+      BufferPos != BufferEnd && isClass(*BufferPos, CC_Digit);
   switch (Char) {
-  case -1:  return SetTokenKind(Result, Token::EndOfFile);
-    
   case '(': return SetTokenKind(Result, Token::LParen);
   case ')': return SetTokenKind(Result, Token::RParen);
   case ',': return SetTokenKind(Result, Token::Comma);
@@ -240,28 +270,52 @@ Token &Lexer::Lex(Token &Result) {
     return SetTokenKind(Result, Token::Comment);
 
   case '+': {
-    if (isdigit(PeekNextChar()))
+    if (NextIsDigit)
       return LexNumber(Result);
     else
       return SetTokenKind(Result, Token::Unknown);
   }
 
   case '-': {
-    int Next = PeekNextChar();
-    if (Next == '>')
-      return GetNextChar(), SetTokenKind(Result, Token::Arrow);
-    else if (isdigit(Next))
+    if (BufferPos != BufferEnd && *BufferPos == '>')
+      return ++BufferPos, SetTokenKind(Result, Token::Arrow);
+    else if (NextIsDigit)
       return LexNumber(Result);
     else
       return SetTokenKind(Result, Token::Unknown);
-    break;
   }
 
   default:
-    if (isdigit(Char))
+    if (isClass(Char, CC_Digit))
       return LexNumber(Result);
-    else if (isalpha(Char) || Char == '_')
+    else if (isClass(Char, CC_IdentStart))
       return LexIdentifier(Result);
     return SetTokenKind(Result, Token::Unknown);
   }
 }
+
+bool Lexer::SkipParens(unsigned Depth) {
+  while (Depth) {
+    while (BufferPos != BufferEnd && !isClass(*BufferPos, CC_ParenScan))
+      ++BufferPos;
+    if (BufferPos == BufferEnd)
+      return false;
+
+    const char Char = *BufferPos++;
+    switch (Char) {
+    case '(':
+      ++Depth;
+      break;
+    case ')':
+      --Depth;
+      break;
+    case '#':
+      SkipToEndOfLine();
+      break;
+    default:
+      ConsumeNewline(Char);
+      break;
+    }
+  }
+  return true;
+}
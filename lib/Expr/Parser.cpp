@@ -17,12 +17,14 @@
 #include "klee/Solver/Solver.h"
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <cassert>
 #include <cstdlib>
-#include <map>
 #include <cstring>
 
 using namespace llvm;
@@ -102,9 +104,9 @@ namespace {
 
   /// ParserImpl - Parser implementation.
   class ParserImpl : public Parser {
-    typedef std::map<const std::string, const Identifier*> IdentifierTabTy;
-    typedef std::map<const Identifier*, ExprHandle> ExprSymTabTy;
-    typedef std::map<const Identifier*, VersionHandle> VersionSymTabTy;
+    typedef llvm::StringMap<const Identifier*> IdentifierTabTy;
+    typedef llvm::DenseMap<const Identifier*, ExprHandle> ExprSymTabTy;
+    typedef llvm::DenseMap<const Identifier*, VersionHandle> VersionSymTabTy;
 
     const std::string Filename;
     const MemoryBuffer *TheMemoryBuffer;
@@ -115,11 +117,14 @@ namespace {
     Lexer TheLexer;
     unsigned MaxErrors;
     unsigned NumErrors;
+    llvm::raw_ostream *Diagnostics;
 
-    // FIXME: Use LLVM symbol tables?
+    /// Identifiers live as long as the parser, so they are allocated from
+    /// an arena and freed all at once.
+    llvm::SpecificBumpPtrAllocator<Identifier> IdentifierAllocator;
     IdentifierTabTy IdentifierTab;
 
-    std::map<const Identifier*, const ArrayDecl*> ArraySymTab;
+    llvm::DenseMap<const Identifier*, const ArrayDecl*> ArraySymTab;
     ExprSymTabTy ExprSymTab;
     VersionSymTabTy VersionSymTab;
 
@@ -141,6 +146,19 @@ namespace {
       } while (Tok.kind == Token::Comment);
     }
 
+    /// PeekTopLevelQuery - Check whether the current '(' token starts a
+    /// query command, without consuming anything.
+    bool PeekTopLevelQuery() {
+      if (Tok.kind != Token::LParen)
+        return false;
+      Lexer Peek = TheLexer;
+      Token Next;
+      do {
+        Peek.Lex(Next);
+      } while (Next.kind == Token::Comment);
+      return Next.kind == Token::KWQuery;
+    }
+
     /// ConsumeToken - Consume the current 'peek token' and lex the next one.
     void ConsumeToken() {
       assert(Tok.kind != Token::LParen && Tok.kind != Token::RParen &&
@@ -326,7 +344,7 @@ namespace {
                ExprBuilder *_Builder, bool _ClearArrayAfterQuery)
         : Filename(_Filename), TheMemoryBuffer(MB), Builder(_Builder),
           ClearArrayAfterQuery(_ClearArrayAfterQuery), TheLexer(MB),
-          MaxErrors(~0u), NumErrors(0) {}
+          MaxErrors(~0u), NumErrors(0), Diagnostics(&llvm::errs()) {}
 
     virtual ~ParserImpl();
 
@@ -341,6 +359,7 @@ namespace {
     /* Parser interface implementation */
 
     virtual Decl *ParseTopLevelDecl();
+    virtual bool SkipQueryCommand();
 
     virtual void SetMaxErrors(unsigned N) {
       MaxErrors = N;
@@ -349,19 +368,20 @@ namespace {
     virtual unsigned GetNumErrors() const {
       return NumErrors; 
     }
+
+    virtual void SetDiagnosticStream(llvm::raw_ostream &OS) {
+      Diagnostics = &OS;
+    }
   };
 }
 
 const Identifier *ParserImpl::GetOrCreateIdentifier(const Token &Tok) {
-  // FIXME: Make not horribly inefficient please.
   assert(Tok.kind == Token::Identifier && "Expected only identifier tokens.");
-  std::string Name(Tok.start, Tok.length);
-  IdentifierTabTy::iterator it = IdentifierTab.find(Name);
-  if (it != IdentifierTab.end())
-    return it->second;
-
-  Identifier *I = new Identifier(Name);
-  IdentifierTab.insert(std::make_pair(Name, I));
+  const Identifier *&I =
+      IdentifierTab[llvm::StringRef(Tok.start, Tok.length)];
+  if (!I)
+    I = new (IdentifierAllocator.Allocate())
+        Identifier(std::string(Tok.start, Tok.length));
 
   return I;
 }
@@ -393,6 +413,24 @@ Decl *ParserImpl::ParseTopLevelDecl() {
   return 0;
 }
 
+bool ParserImpl::SkipQueryCommand() {
+  if (!PeekTopLevelQuery())
+    return false;
+
+  // The lexer is positioned just after the '(' of the query, so skipping
+  // to its matching ')' does not need to look at the tokens in between.
+  if (!TheLexer.SkipParens(1)) {
+    GetNextNonCommentToken();
+    Error("unexpected end of file.");
+    return true;
+  }
+
+  if (ClearArrayAfterQuery)
+    ArraySymTab.clear();
+  GetNextNonCommentToken();
+  return true;
+}
+
 /// ParseArrayDecl - Parse an array declaration. The lexer should be positioned
 /// at the opening 'array'.
 ///
@@ -578,7 +616,7 @@ DeclResult ParserImpl::ParseQueryCommand() {
 
   // Reinsert initial array versions.
   // FIXME: Remove this!
-  for (std::map<const Identifier*, const ArrayDecl*>::iterator
+  for (llvm::DenseMap<const Identifier*, const ArrayDecl*>::iterator
          it = ArraySymTab.begin(), ie = ArraySymTab.end(); it != ie; ++it) {
     VersionSymTab.insert(std::make_pair(it->second->Name,
                                         UpdateList(it->second->Root, NULL)));
@@ -665,7 +703,7 @@ DeclResult ParserImpl::ParseQueryCommand() {
     ConsumeToken();
 
     // Lookup array.
-    std::map<const Identifier*, const ArrayDecl*>::iterator
+    llvm::DenseMap<const Identifier*, const ArrayDecl*>::iterator
       it = ArraySymTab.find(Label);
 
     if (it == ArraySymTab.end()) {
@@ -1450,7 +1488,7 @@ ExprResult ParserImpl::ParseNumberToken(Expr::Width Type, const Token &Tok) {
   }
 
   // Detect 0[box].
-  if ((Tok.length >= 2 && S[0] == '0') &&
+  if ((N >= 2 && S[0] == '0') &&
       (S[1] == 'b' || S[1] == 'o' || S[1] == 'x')) {
     if (S[1] == 'b') {
       Radix = 2; 
@@ -1472,7 +1510,11 @@ ExprResult ParserImpl::ParseNumberToken(Expr::Width Type, const Token &Tok) {
     }
   }
 
-  // This is a simple but slow way to handle overflow.
+  // Numbers that fit into 64 bits, which are almost all of them, are
+  // accumulated directly. Otherwise, this is a simple but slow way to
+  // handle overflow.
+  const bool Fits = RadixBits * N <= 64;
+  uint64_t Value = 0;
   APInt Val(RadixBits * N, 0);
   APInt RadixVal(Val.getBitWidth(), Radix);
   APInt DigitVal(Val.getBitWidth(), 0);
@@ -1498,9 +1540,15 @@ ExprResult ParserImpl::ParseNumberToken(Expr::Width Type, const Token &Tok) {
       return Builder->Constant(0, Type);
     }
 
-    DigitVal = Digit;
-    Val = Val * RadixVal + DigitVal;
+    if (Fits) {
+      Value = Value * Radix + Digit;
+    } else {
+      DigitVal = Digit;
+      Val = Val * RadixVal + DigitVal;
+    }
   }
+  if (Fits)
+    Val = APInt(Val.getBitWidth(), Value);
 
   // FIXME: Actually do the check for overflow.
   if (HasMinus)
@@ -1521,7 +1569,10 @@ TypeResult ParserImpl::ParseTypeSpecifier() {
   assert(Tok.kind == Token::KWWidth && "Unexpected token.");
 
   // FIXME: Need APInt technically.
-  int width = atoi(std::string(Tok.start+1,Tok.length-1).c_str());
+  int width = 0;
+  for (const char *S = Tok.start + 1, *E = Tok.start + Tok.length;
+       S != E && '0' <= *S && *S <= '9'; ++S)
+    width = width * 10 + (*S - '0');
   ConsumeToken();
 
   // FIXME: We should impose some sort of maximum just for sanity?
@@ -1533,7 +1584,7 @@ void ParserImpl::Error(const char *Message, const Token &At) {
   if (MaxErrors && NumErrors >= MaxErrors)
     return;
 
-  llvm::errs() << Filename
+  *Diagnostics << Filename
             << ":" << At.line << ":" << At.column 
             << ": error: " << Message << "\n";
 
@@ -1555,48 +1606,22 @@ void ParserImpl::Error(const char *Message, const Token &At) {
     ++LineEnd;
 
   // Show the line.
-  llvm::errs() << std::string(LineBegin, LineEnd) << "\n";
+  *Diagnostics << std::string(LineBegin, LineEnd) << "\n";
 
   // Show the caret or squiggly, making sure to print back spaces the
   // same.
   for (const char *S=LineBegin; S != At.start; ++S)
-    llvm::errs() << (isspace(*S) ? *S : ' ');
+    *Diagnostics << (isspace(*S) ? *S : ' ');
   if (At.length > 1) {
     for (unsigned i=0; i<At.length; ++i)
-      llvm::errs() << '~';
+      *Diagnostics << '~';
   } else
-    llvm::errs() << '^';
-  llvm::errs() << '\n';
+    *Diagnostics << '^';
+  *Diagnostics << '\n';
 }
 
 ParserImpl::~ParserImpl() {
-  // Free identifiers
-  //
-  // Note the Identifiers are not disjoint across the symbol
-  // tables so we need to keep track of what has freed to
-  // avoid doing a double free.
-  std::set<const Identifier*> freedNodes;
-  for (IdentifierTabTy::iterator pi = IdentifierTab.begin(),
-                                 pe = IdentifierTab.end();
-       pi != pe; ++pi) {
-    const Identifier* id = pi->second;
-    if (freedNodes.insert(id).second)
-      delete id;
-  }
-  for (ExprSymTabTy::iterator pi = ExprSymTab.begin(),
-                              pe = ExprSymTab.end();
-       pi != pe; ++pi) {
-    const Identifier* id = pi->first;
-    if (freedNodes.insert(id).second)
-      delete id;
-  }
-  for (VersionSymTabTy::iterator pi = VersionSymTab.begin(),
-                                 pe = VersionSymTab.end();
-       pi != pe; ++pi) {
-    const Identifier* id = pi->first;
-    if (freedNodes.insert(id).second)
-      delete id;
-  }
+  // Identifiers are freed with IdentifierAllocator.
 }
 
 // AST API
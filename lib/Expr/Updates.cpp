@@ -15,6 +15,8 @@ using namespace klee;
 
 ///
 
+ExprAllocator UpdateNode::allocator;
+
 UpdateNode::UpdateNode(const ref<UpdateNode> &_next, const ref<Expr> &_index,
                        const ref<Expr> &_value)
     : next(_next), index(_index), value(_value) {
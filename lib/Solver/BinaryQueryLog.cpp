@@ -0,0 +1,597 @@
+//===-- BinaryQueryLog.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/BinaryQueryLog.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+using namespace klee;
+using namespace klee::querylog;
+
+namespace {
+void writeInt(std::string &out, std::uint64_t value) {
+  do {
+    unsigned char byte = value & 0x7f;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    out.push_back(static_cast<char>(byte));
+  } while (value);
+}
+
+void writeAPInt(std::string &out, const llvm::APInt &value) {
+  for (unsigned i = 0, e = value.getNumWords(); i != e; ++i)
+    writeInt(out, value.getRawData()[i]);
+}
+
+void writeRecord(std::string &out, Record record) {
+  out.push_back(static_cast<char>(record));
+}
+
+std::uint64_t zigzag(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+} // namespace
+
+const char *klee::querylog::getQueryTypeName(QueryType type) {
+  switch (type) {
+  case QueryType::Truth:
+    return "Truth";
+  case QueryType::Validity:
+    return "Validity";
+  case QueryType::Value:
+    return "Value";
+  case QueryType::InitialValues:
+    return "InitialValues";
+  }
+  return "Unknown";
+}
+
+/***/
+
+std::uint64_t Writer::writeArray(const Array *array) {
+  auto it = arrayIds.find(array);
+  if (it != arrayIds.end())
+    return it->second;
+
+  writeRecord(*out, Record::Array);
+  writeInt(*out, array->name.size());
+  out->append(array->name);
+  writeInt(*out, array->size);
+  writeInt(*out, array->domain);
+  writeInt(*out, array->range);
+  writeInt(*out, array->constantValues.size());
+  for (const ref<ConstantExpr> &value : array->constantValues)
+    writeAPInt(*out, value->getAPValue());
+
+  const std::uint64_t id = arrayIds.size();
+  arrayIds.emplace(array, id);
+  newArrays.push_back(array);
+  return id;
+}
+
+std::uint64_t Writer::writeUpdates(const UpdateList &updates) {
+  // update lists can be long, so the nodes not written yet are collected
+  // first and then defined oldest first
+  std::vector<const UpdateNode *> pending;
+  std::uint64_t next = 0;
+  for (const UpdateNode *un = updates.head.get(); un; un = un->next.get()) {
+    auto it = updateIds.find(un);
+    if (it != updateIds.end()) {
+      next = it->second.second + 1;
+      break;
+    }
+    pending.push_back(un);
+  }
+
+  for (auto it = pending.rbegin(), ie = pending.rend(); it != ie; ++it) {
+    const UpdateNode *un = *it;
+    const std::uint64_t index = writeExpr(un->index);
+    const std::uint64_t value = writeExpr(un->value);
+    writeRecord(*out, Record::UpdateNode);
+    writeInt(*out, next);
+    writeInt(*out, index);
+    writeInt(*out, value);
+
+    const std::uint64_t id = updateIds.size();
+    updateIds.emplace(un, std::make_pair(ref<const UpdateNode>(un), id));
+    newUpdates.push_back(un);
+    next = id + 1;
+  }
+  return next;
+}
+
+std::uint64_t Writer::writeExpr(const ref<Expr> &e) {
+  auto it = exprIds.find(e);
+  if (it != exprIds.end())
+    return it->second;
+
+  std::string record;
+  writeRecord(record, Record::Expr);
+  writeInt(record, e->getKind());
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    const ConstantExpr *ce = cast<ConstantExpr>(e);
+    writeInt(record, ce->getWidth());
+    writeAPInt(record, ce->getAPValue());
+    break;
+  }
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    writeInt(record, writeArray(re->updates.root));
+    writeInt(record, writeUpdates(re->updates));
+    writeInt(record, writeExpr(re->index));
+    break;
+  }
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    writeInt(record, writeExpr(ee->expr));
+    writeInt(record, ee->offset);
+    writeInt(record, ee->width);
+    break;
+  }
+  case Expr::ZExt:
+  case Expr::SExt:
+    writeInt(record, writeExpr(e->getKid(0)));
+    writeInt(record, e->getWidth());
+    break;
+  default:
+    for (unsigned i = 0, n = e->getNumKids(); i != n; ++i)
+      writeInt(record, writeExpr(e->getKid(i)));
+    break;
+  }
+  // the kids were defined while the record was assembled
+  out->append(record);
+
+  const std::uint64_t id = exprIds.size();
+  exprIds.emplace(e, id);
+  newExprs.push_back(e);
+  return id;
+}
+
+void Writer::writeQuery(std::string &buffer, QueryType type,
+                        std::uint64_t instructions, const Query &query,
+                        const std::vector<const Array *> *objects) {
+  out = &buffer;
+  std::vector<std::uint64_t> constraints;
+  constraints.reserve(query.constraints.size());
+  for (const ref<Expr> &constraint : query.constraints)
+    constraints.push_back(writeExpr(constraint));
+  const std::uint64_t expr = writeExpr(query.expr);
+  std::vector<std::uint64_t> arrays;
+  if (objects)
+    for (const Array *array : *objects)
+      arrays.push_back(writeArray(array));
+
+  writeRecord(buffer, Record::Query);
+  buffer.push_back(static_cast<char>(type));
+  writeInt(buffer, instructions);
+  writeInt(buffer, constraints.size());
+  for (std::uint64_t id : constraints)
+    writeInt(buffer, id);
+  writeInt(buffer, expr);
+  if (type == QueryType::InitialValues) {
+    writeInt(buffer, arrays.size());
+    for (std::uint64_t id : arrays)
+      writeInt(buffer, id);
+  }
+  out = nullptr;
+}
+
+void Writer::writeResult(
+    std::string &buffer, bool success, SolverImpl::SolverRunStatus status,
+    time::Span elapsed, std::int64_t result, const ref<Expr> &value,
+    const std::vector<std::vector<unsigned char>> *values) {
+  buffer.push_back(success ? 1 : 0);
+  writeInt(buffer, status);
+  writeInt(buffer, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::duration(elapsed))
+                       .count());
+  if (!success)
+    return;
+
+  writeInt(buffer, zigzag(result));
+  if (value) {
+    const ConstantExpr *ce = cast<ConstantExpr>(value);
+    writeInt(buffer, ce->getWidth());
+    writeAPInt(buffer, ce->getAPValue());
+  }
+  if (values) {
+    writeInt(buffer, values->size());
+    for (const std::vector<unsigned char> &bytes : *values) {
+      writeInt(buffer, bytes.size());
+      buffer.append(bytes.begin(), bytes.end());
+    }
+  }
+}
+
+void Writer::commit(std::string &buffer) {
+  newExprs.clear();
+  newUpdates.clear();
+  newArrays.clear();
+
+  if (exprIds.size() + updateIds.size() > maxDefinitions) {
+    writeRecord(buffer, Record::Reset);
+    exprIds.clear();
+    updateIds.clear();
+  }
+}
+
+void Writer::discard() {
+  for (const ref<Expr> &e : newExprs)
+    exprIds.erase(e);
+  for (const UpdateNode *un : newUpdates)
+    updateIds.erase(un);
+  for (const Array *array : newArrays)
+    arrayIds.erase(array);
+  newExprs.clear();
+  newUpdates.clear();
+  newArrays.clear();
+}
+
+/***/
+
+Reader::Reader(ArrayCache &arrayCache, const char *data, std::size_t size)
+    : arrayCache(arrayCache) {
+  feed(data, size, true);
+}
+
+void Reader::feed(const char *data, std::size_t size, bool last) {
+  pos = reinterpret_cast<const unsigned char *>(data);
+  end = pos + size;
+  this->last = last;
+  if (started || !error.empty())
+    return;
+
+  const std::size_t magicSize = sizeof(Magic) - 1;
+  if (size < magicSize && !last)
+    return;
+  if (size < magicSize || std::memcmp(data, Magic, magicSize)) {
+    fail("not a binary query log");
+    return;
+  }
+  pos += magicSize;
+  started = true;
+}
+
+bool Reader::fail(const std::string &message) {
+  error = message;
+  pos = end;
+  return false;
+}
+
+bool Reader::truncated() {
+  if (last)
+    return fail("unexpected end of log");
+  incomplete = true;
+  return false;
+}
+
+bool Reader::readInt(std::uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (pos == end)
+      return truncated();
+    const unsigned char byte = *pos++;
+    value |= std::uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return fail("integer too large");
+}
+
+bool Reader::readBytes(std::vector<unsigned char> &bytes) {
+  std::uint64_t size;
+  if (!readInt(size))
+    return false;
+  if (size > std::uint64_t(end - pos))
+    return truncated();
+  bytes.assign(pos, pos + size);
+  pos += size;
+  return true;
+}
+
+bool Reader::readAPInt(Expr::Width width, llvm::APInt &value) {
+  if (width == 0 || width == Expr::InvalidWidth)
+    return fail("invalid width");
+  std::vector<std::uint64_t> words((width + 63) / 64);
+  for (std::uint64_t &word : words)
+    if (!readInt(word))
+      return false;
+  value = llvm::APInt(width, words);
+  return true;
+}
+
+bool Reader::readExprRef(ref<Expr> &e) {
+  std::uint64_t id;
+  if (!readInt(id))
+    return false;
+  if (id >= exprs.size())
+    return fail("reference to an undefined expression");
+  e = exprs[id];
+  return true;
+}
+
+bool Reader::readArrayRef(const Array *&array) {
+  std::uint64_t id;
+  if (!readInt(id))
+    return false;
+  if (id >= arrays.size())
+    return fail("reference to an undefined array");
+  array = arrays[id];
+  return true;
+}
+
+bool Reader::readArray() {
+  std::vector<unsigned char> name;
+  std::uint64_t size, domain, range, numValues;
+  if (!readBytes(name) || !readInt(size) || !readInt(domain) ||
+      !readInt(range) || !readInt(numValues))
+    return false;
+  if (numValues && numValues != size)
+    return fail("invalid constant array");
+
+  std::vector<ref<ConstantExpr>> values;
+  for (std::uint64_t i = 0; i != numValues; ++i) {
+    llvm::APInt value;
+    if (!readAPInt(range, value))
+      return false;
+    values.push_back(ConstantExpr::alloc(value));
+  }
+  arrays.push_back(arrayCache.CreateArray(
+      std::string(name.begin(), name.end()), size, values.data(),
+      values.data() + values.size(), domain, range));
+  return true;
+}
+
+bool Reader::readUpdateNode() {
+  std::uint64_t next;
+  ref<Expr> index, value;
+  if (!readInt(next) || !readExprRef(index) || !readExprRef(value))
+    return false;
+  if (next > updates.size())
+    return fail("reference to an undefined update");
+  updates.push_back(
+      new UpdateNode(next ? updates[next - 1] : ref<UpdateNode>(), index, value));
+  return true;
+}
+
+bool Reader::readExpr() {
+  std::uint64_t kind;
+  if (!readInt(kind))
+    return false;
+
+  ref<Expr> e, kids[3];
+  switch (kind) {
+  case Expr::Constant: {
+    std::uint64_t width;
+    llvm::APInt value;
+    if (!readInt(width) || !readAPInt(width, value))
+      return false;
+    e = ConstantExpr::alloc(value);
+    break;
+  }
+  case Expr::Read: {
+    const Array *array;
+    std::uint64_t head;
+    if (!readArrayRef(array) || !readInt(head) || !readExprRef(kids[0]))
+      return false;
+    if (head > updates.size())
+      return fail("reference to an undefined update");
+    e = ReadExpr::alloc(
+        UpdateList(array, head ? updates[head - 1] : ref<UpdateNode>()),
+        kids[0]);
+    break;
+  }
+  case Expr::Extract: {
+    std::uint64_t offset, width;
+    if (!readExprRef(kids[0]) || !readInt(offset) || !readInt(width))
+      return false;
+    e = ExtractExpr::alloc(kids[0], offset, width);
+    break;
+  }
+  case Expr::ZExt:
+  case Expr::SExt: {
+    std::uint64_t width;
+    if (!readExprRef(kids[0]) || !readInt(width))
+      return false;
+    e = kind == Expr::ZExt ? ZExtExpr::alloc(kids[0], width)
+                           : SExtExpr::alloc(kids[0], width);
+    break;
+  }
+  case Expr::NotOptimized:
+    if (!readExprRef(kids[0]))
+      return false;
+    e = NotOptimizedExpr::alloc(kids[0]);
+    break;
+  case Expr::Not:
+    if (!readExprRef(kids[0]))
+      return false;
+    e = NotExpr::alloc(kids[0]);
+    break;
+  case Expr::Select:
+    if (!readExprRef(kids[0]) || !readExprRef(kids[1]) ||
+        !readExprRef(kids[2]))
+      return false;
+    e = SelectExpr::alloc(kids[0], kids[1], kids[2]);
+    break;
+  case Expr::Concat:
+    if (!readExprRef(kids[0]) || !readExprRef(kids[1]))
+      return false;
+    e = ConcatExpr::alloc(kids[0], kids[1]);
+    break;
+  default:
+    if (kind < Expr::BinaryKindFirst || kind > Expr::BinaryKindLast)
+      return fail("invalid expression kind");
+    if (!readExprRef(kids[0]) || !readExprRef(kids[1]))
+      return false;
+    switch (kind) {
+#define BINARY_EXPR_CASE(T)                                                    \
+  case Expr::T:                                                                \
+    e = T##Expr::alloc(kids[0], kids[1]);                                      \
+    break;
+      BINARY_EXPR_CASE(Add)
+      BINARY_EXPR_CASE(Sub)
+      BINARY_EXPR_CASE(Mul)
+      BINARY_EXPR_CASE(UDiv)
+      BINARY_EXPR_CASE(SDiv)
+      BINARY_EXPR_CASE(URem)
+      BINARY_EXPR_CASE(SRem)
+      BINARY_EXPR_CASE(And)
+      BINARY_EXPR_CASE(Or)
+      BINARY_EXPR_CASE(Xor)
+      BINARY_EXPR_CASE(Shl)
+      BINARY_EXPR_CASE(LShr)
+      BINARY_EXPR_CASE(AShr)
+      BINARY_EXPR_CASE(Eq)
+      BINARY_EXPR_CASE(Ne)
+      BINARY_EXPR_CASE(Ult)
+      BINARY_EXPR_CASE(Ule)
+      BINARY_EXPR_CASE(Ugt)
+      BINARY_EXPR_CASE(Uge)
+      BINARY_EXPR_CASE(Slt)
+      BINARY_EXPR_CASE(Sle)
+      BINARY_EXPR_CASE(Sgt)
+      BINARY_EXPR_CASE(Sge)
+#undef BINARY_EXPR_CASE
+    default:
+      return fail("invalid expression kind");
+    }
+    break;
+  }
+  exprs.push_back(e);
+  return true;
+}
+
+bool Reader::readQuery(LoggedQuery &query) {
+  query = LoggedQuery();
+  if (pos == end)
+    return truncated();
+  const unsigned char type = *pos++;
+  if (type > static_cast<unsigned char>(QueryType::InitialValues))
+    return fail("invalid query type");
+  query.type = static_cast<QueryType>(type);
+
+  std::uint64_t numConstraints;
+  if (!readInt(query.instructions) || !readInt(numConstraints))
+    return false;
+  for (std::uint64_t i = 0; i != numConstraints; ++i) {
+    ref<Expr> constraint;
+    if (!readExprRef(constraint))
+      return false;
+    query.constraints.push_back(constraint);
+  }
+  if (!readExprRef(query.expr))
+    return false;
+  if (query.type == QueryType::InitialValues) {
+    std::uint64_t numObjects;
+    if (!readInt(numObjects))
+      return false;
+    for (std::uint64_t i = 0; i != numObjects; ++i) {
+      const Array *array;
+      if (!readArrayRef(array))
+        return false;
+      query.objects.push_back(array);
+    }
+  }
+
+  std::uint64_t status, elapsed;
+  if (pos == end) {
+    if (!last)
+      return truncated();
+    query.finished = false;
+    return true;
+  }
+  query.success = *pos++;
+  if (!readInt(status) || !readInt(elapsed))
+    return false;
+  query.status = static_cast<SolverImpl::SolverRunStatus>(status);
+  query.elapsed = time::nanoseconds(elapsed);
+  if (!query.success)
+    return true;
+
+  std::uint64_t result;
+  if (!readInt(result))
+    return false;
+  query.result = unzigzag(result);
+  if (query.type == QueryType::Value) {
+    std::uint64_t width;
+    llvm::APInt value;
+    if (!readInt(width) || !readAPInt(width, value))
+      return false;
+    query.value = ConstantExpr::alloc(value);
+  } else if (query.type == QueryType::InitialValues && query.result) {
+    std::uint64_t numValues;
+    if (!readInt(numValues))
+      return false;
+    if (numValues != query.objects.size())
+      return fail("invalid number of values");
+    query.values.resize(numValues);
+    for (std::vector<unsigned char> &bytes : query.values)
+      if (!readBytes(bytes))
+        return false;
+  }
+  return true;
+}
+
+bool Reader::next(LoggedQuery &query) {
+  if (!started)
+    return false;
+  while (pos != end) {
+    const unsigned char *start = pos;
+    const Record record = static_cast<Record>(*pos++);
+    bool success;
+    switch (record) {
+    case Record::Array:
+      success = readArray();
+      break;
+    case Record::UpdateNode:
+      success = readUpdateNode();
+      break;
+    case Record::Expr:
+      success = readExpr();
+      break;
+    case Record::Query:
+      success = readQuery(query);
+      if (success)
+        return true;
+      break;
+    case Record::Reset:
+      updates.clear();
+      exprs.clear();
+      success = true;
+      break;
+    default:
+      return fail("invalid record");
+    }
+    if (!success) {
+      // records only define anything once they are complete, so the record
+      // can be read again from the start with the next block
+      if (incomplete) {
+        incomplete = false;
+        pos = start;
+      }
+      return false;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,299 @@
+//===-- BinaryQueryLoggingSolver.cpp --------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Config/config.h"
+#include "klee/Solver/BinaryQueryLog.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Statistics/Statistics.h"
+#include "klee/Support/ErrorHandling.h"
+#include "klee/Support/FileHandling.h"
+#include "klee/System/Time.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace klee;
+using namespace klee::querylog;
+
+namespace {
+
+/// Writes chunks of the log on a thread of its own, so that neither the
+/// (optional) compression nor the file system slow down the solver chain.
+/// Writing blocks once too many chunks are pending.
+class AsyncLogWriter {
+  std::unique_ptr<llvm::raw_ostream> os;
+
+  std::mutex mutex;
+  std::condition_variable chunkAdded;
+  std::condition_variable chunkWritten;
+  std::deque<std::string> chunks;
+  bool done = false;
+  /// Numbers of chunks added and written so far
+  std::uint64_t numAdded = 0;
+  std::uint64_t numWritten = 0;
+  /// Chunks up to this number are flushed to the file once written
+  std::uint64_t flushUntil = 0;
+
+  std::thread thread;
+
+  static constexpr std::size_t MaxPendingChunks = 16;
+
+  void run();
+
+public:
+  explicit AsyncLogWriter(std::unique_ptr<llvm::raw_ostream> os);
+  /// Writes all pending chunks
+  ~AsyncLogWriter();
+
+  /// Queues `chunk`. With `sync`, waits until it and all chunks before it
+  /// have been written and flushed to the file.
+  void write(std::string chunk, bool sync = false);
+};
+
+AsyncLogWriter::AsyncLogWriter(std::unique_ptr<llvm::raw_ostream> os)
+    : os(std::move(os)), thread([this] { run(); }) {}
+
+AsyncLogWriter::~AsyncLogWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  chunkAdded.notify_one();
+  thread.join();
+}
+
+void AsyncLogWriter::write(std::string chunk, bool sync) {
+  std::unique_lock<std::mutex> lock(mutex);
+  chunkWritten.wait(lock, [this] { return chunks.size() < MaxPendingChunks; });
+  chunks.push_back(std::move(chunk));
+  const std::uint64_t id = ++numAdded;
+  if (sync)
+    flushUntil = id;
+  chunkAdded.notify_one();
+  if (sync)
+    chunkWritten.wait(lock, [this, id] { return numWritten >= id; });
+}
+
+void AsyncLogWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    chunkAdded.wait(lock, [this] { return done || !chunks.empty(); });
+    if (chunks.empty()) {
+      os->flush();
+      return;
+    }
+    std::string chunk = std::move(chunks.front());
+    chunks.pop_front();
+    const bool flush = numWritten < flushUntil;
+    lock.unlock();
+    chunkWritten.notify_all();
+    *os << chunk;
+    if (flush)
+      os->flush();
+    lock.lock();
+    ++numWritten;
+    chunkWritten.notify_all();
+  }
+}
+
+/// Logs all queries and their results in the binary query log format, see
+/// BinaryQueryLog.h. Queries are serialised into chunks that are handed to
+/// an AsyncLogWriter once they are large enough. With
+/// --log-partial-queries-early, the pending chunk is instead written before
+/// every call into the solver below, so that a hang or a crash does not lose
+/// the query being solved. Such a query is then logged regardless of how
+/// long it took, as it has already been written.
+class BinaryQueryLoggingSolver : public SolverImpl {
+  std::unique_ptr<Solver> solver;
+  Writer writer;
+  std::string chunk;
+  std::unique_ptr<AsyncLogWriter> logWriter;
+
+  time::Span minQueryTimeToLog;
+  bool logTimedOutQueries;
+
+  static constexpr std::size_t ChunkSize = 1 << 20;
+
+  void handOffChunk(bool sync);
+
+  template <typename Call, typename WriteResult>
+  bool log(QueryType type, const Query &query,
+           const std::vector<const Array *> *objects, Call &&call,
+           WriteResult &&writeResult);
+
+public:
+  BinaryQueryLoggingSolver(std::unique_ptr<Solver> solver, std::string path,
+                           time::Span queryTimeToLog, bool logTimedOut);
+  ~BinaryQueryLoggingSolver() override;
+
+  bool computeTruth(const Query &query, bool &isValid) override;
+  bool computeValidity(const Query &query, Solver::Validity &result) override;
+  bool computeValue(const Query &query, ref<Expr> &result) override;
+  bool computeInitialValues(const Query &query,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) override;
+  SolverRunStatus getOperationStatusCode() override;
+  std::string getConstraintLog(const Query &) override;
+  void setCoreSolverTimeout(time::Span timeout) override;
+};
+
+BinaryQueryLoggingSolver::BinaryQueryLoggingSolver(
+    std::unique_ptr<Solver> solver, std::string path,
+    time::Span queryTimeToLog, bool logTimedOut)
+    : solver(std::move(solver)), minQueryTimeToLog(queryTimeToLog),
+      logTimedOutQueries(logTimedOut) {
+  std::string error;
+  std::unique_ptr<llvm::raw_ostream> os;
+#ifdef HAVE_ZLIB_H
+  if (!CreateCompressedQueryLog) {
+#endif
+    os = klee_open_output_file(path, error);
+#ifdef HAVE_ZLIB_H
+  } else {
+    path.append(".gz");
+    os = klee_open_compressed_output_file(path, error);
+  }
+#endif
+  if (!os) {
+    klee_error("Could not open file %s : %s", path.c_str(), error.c_str());
+  }
+  logWriter = std::make_unique<AsyncLogWriter>(std::move(os));
+  chunk.reserve(ChunkSize + ChunkSize / 4);
+  chunk.append(Magic, sizeof(Magic) - 1);
+  assert(this->solver);
+}
+
+void BinaryQueryLoggingSolver::handOffChunk(bool sync) {
+  logWriter->write(std::move(chunk), sync);
+  chunk = std::string();
+  if (!sync)
+    chunk.reserve(ChunkSize + ChunkSize / 4);
+}
+
+BinaryQueryLoggingSolver::~BinaryQueryLoggingSolver() {
+  if (!chunk.empty())
+    logWriter->write(std::move(chunk));
+}
+
+template <typename Call, typename WriteResult>
+bool BinaryQueryLoggingSolver::log(QueryType type, const Query &query,
+                                   const std::vector<const Array *> *objects,
+                                   Call &&call, WriteResult &&writeResult) {
+  Statistic *S = theStatisticManager->getStatisticByName("Instructions");
+  const std::uint64_t instructions = S ? S->getValue() : 0;
+
+  const std::size_t start = chunk.size();
+  writer.writeQuery(chunk, type, instructions, query, objects);
+  if (LogPartialQueriesEarly)
+    handOffChunk(true);
+
+  const time::Point startTime = time::getWallTime();
+  const bool success = call();
+  const time::Span elapsed = time::getWallTime() - startTime;
+  const SolverRunStatus status = solver->impl->getOperationStatusCode();
+
+  // the same filter as for the textual query logs
+  const bool keep = LogPartialQueriesEarly || !minQueryTimeToLog ||
+                    elapsed > minQueryTimeToLog ||
+                    (logTimedOutQueries && status == SOLVER_RUN_STATUS_TIMEOUT);
+  if (!keep) {
+    chunk.resize(start);
+    writer.discard();
+    return success;
+  }
+
+  writeResult(success, status, elapsed);
+  writer.commit(chunk);
+  if (chunk.size() >= ChunkSize)
+    handOffChunk(false);
+  return success;
+}
+
+bool BinaryQueryLoggingSolver::computeTruth(const Query &query,
+                                            bool &isValid) {
+  return log(
+      QueryType::Truth, query, nullptr,
+      [&] { return solver->impl->computeTruth(query, isValid); },
+      [&](bool success, SolverRunStatus status, time::Span elapsed) {
+        writer.writeResult(chunk, success, status, elapsed, isValid,
+                           ref<Expr>(), nullptr);
+      });
+}
+
+bool BinaryQueryLoggingSolver::computeValidity(const Query &query,
+                                               Solver::Validity &result) {
+  return log(
+      QueryType::Validity, query, nullptr,
+      [&] { return solver->impl->computeValidity(query, result); },
+      [&](bool success, SolverRunStatus status, time::Span elapsed) {
+        writer.writeResult(chunk, success, status, elapsed, result,
+                           ref<Expr>(), nullptr);
+      });
+}
+
+bool BinaryQueryLoggingSolver::computeValue(const Query &query,
+                                            ref<Expr> &result) {
+  return log(
+      QueryType::Value, query, nullptr,
+      [&] { return solver->impl->computeValue(query, result); },
+      [&](bool success, SolverRunStatus status, time::Span elapsed) {
+        writer.writeResult(chunk, success, status, elapsed, 0, result,
+                           nullptr);
+      });
+}
+
+bool BinaryQueryLoggingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  return log(
+      QueryType::InitialValues, query, &objects,
+      [&] {
+        return solver->impl->computeInitialValues(query, objects, values,
+                                                  hasSolution);
+      },
+      [&](bool success, SolverRunStatus status, time::Span elapsed) {
+        writer.writeResult(chunk, success, status, elapsed, hasSolution,
+                           ref<Expr>(), hasSolution ? &values : nullptr);
+      });
+}
+
+SolverImpl::SolverRunStatus BinaryQueryLoggingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+std::string BinaryQueryLoggingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void BinaryQueryLoggingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+} // namespace
+
+std::unique_ptr<Solver>
+klee::createBinaryQueryLoggingSolver(std::unique_ptr<Solver> solver,
+                                     std::string path,
+                                     time::Span minQueryTimeToLog,
+                                     bool logTimedOut) {
+  return std::make_unique<Solver>(std::make_unique<BinaryQueryLoggingSolver>(
+      std::move(solver), std::move(path), minQueryTimeToLog, logTimedOut));
+}
@@ -16,6 +16,7 @@
 #include "klee/Solver/IncompleteSolver.h"
 #include "klee/Solver/SolverImpl.h"
 #include "klee/Solver/SolverStats.h"
+#include "klee/Support/Profiler.h"
 
 #include <memory>
 #include <unordered_map>
@@ -142,6 +143,7 @@ void CachingSolver::cacheInsert(const Query& query,
 
 bool CachingSolver::computeValidity(const Query& query,
                                     Solver::Validity &result) {
+  KLEE_PROFILE_ZONE("CachingSolver");
   IncompleteSolver::PartialValidity cachedResult;
   bool tmp, cacheHit = cacheLookup(query, cachedResult);
   
@@ -211,6 +213,7 @@ bool CachingSolver::computeValidity(const Query& query,
 
 bool CachingSolver::computeTruth(const Query& query,
                                  bool &isValid) {
+  KLEE_PROFILE_ZONE("CachingSolver");
   IncompleteSolver::PartialValidity cachedResult;
   bool cacheHit = cacheLookup(query, cachedResult);
 
@@ -11,9 +11,11 @@
 
 #include "klee/ADT/MapOfSets.h"
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/CompiledExpr.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprHashMap.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Support/OptionCategories.h"
@@ -21,11 +23,16 @@
 #include "klee/Solver/SolverImpl.h"
 #include "klee/Solver/SolverStats.h"
 #include "klee/Support/ErrorHandling.h"
+#include "klee/Support/Profiler.h"
 
 #include "llvm/Support/CommandLine.h"
 
 #include <memory>
+#include <numeric>
+#include <set>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 using namespace klee;
 using namespace llvm;
@@ -49,6 +56,13 @@ cl::opt<bool>
                               "before asking the SMT solver (default=false)"),
                      cl::cat(SolvingCat));
 
+cl::opt<bool> CexCacheFactors(
+    "cex-cache-factors", cl::init(false),
+    cl::desc("Cache the counterexamples of the parts of a query that share "
+             "no arrays separately, and only solve the parts without a cached "
+             "result (default=false)"),
+    cl::cat(SolvingCat));
+
 } // namespace
 
 ///
@@ -70,6 +84,9 @@ class CexCachingSolver : public SolverImpl {
   MapOfSets<ref<Expr>, Assignment*> cache;
   // memo table
   assignmentsTable_ty assignmentsTable;
+  /// The symbolic arrays of the constraints split by --cex-cache-factors
+  ExprHashMap<std::vector<const Array *>> constraintArrays;
+  static constexpr std::size_t MaxConstraintArrays = 1 << 16;
 
   bool searchForAssignment(KeyType &key, 
                            Assignment *&result);
@@ -82,7 +99,17 @@ class CexCachingSolver : public SolverImpl {
   }
 
   bool getAssignment(const Query& query, Assignment *&result);
-  
+
+  bool solveAndCache(const Query &query, const KeyType &key,
+                     Assignment *&result);
+
+  Assignment *memoize(Assignment *binding);
+
+  void splitIntoFactors(const KeyType &key, std::vector<KeyType> &factors);
+
+  bool getFactoredAssignment(const KeyType &key, std::vector<KeyType> &factors,
+                             Assignment *&result);
+
 public:
   CexCachingSolver(std::unique_ptr<Solver> solver)
       : solver(std::move(solver)) {}
@@ -110,16 +137,60 @@ struct NonNullAssignment {
   bool operator()(Assignment *a) const { return a!=0; }
 };
 
+/// Matches an unsatisfiable subset, or a satisfiable one whose assignment
+/// also satisfies `key`. The distinct assignments of satisfiable subsets are
+/// checked in small batches, so that the search stops soon after the first
+/// satisfying one has been seen; call finish() to check the last batch.
 struct NullOrSatisfyingAssignment {
-  KeyType &key;
-  
-  NullOrSatisfyingAssignment(KeyType &_key) : key(_key) {}
+  /// Candidates checked together
+  static constexpr std::size_t BatchSize = 8;
+
+  const KeyType &key;
+  /// The key, compiled when the first batch is checked
+  mutable std::unique_ptr<CompiledExpr> compiled;
+  mutable std::vector<const Assignment *> batch;
+  mutable std::set<const Assignment *> seen;
+  /// The satisfying assignment found, if any
+  mutable Assignment *satisfying = nullptr;
+
+  NullOrSatisfyingAssignment(const KeyType &_key) : key(_key) {}
+
+  bool operator()(Assignment *a) const {
+    if (!a)
+      return true;
+    if (!seen.insert(a).second)
+      return false;
+    batch.push_back(a);
+    return batch.size() == BatchSize && checkBatch();
+  }
 
-  bool operator()(Assignment *a) const { 
-    return !a || a->satisfies(key.begin(), key.end()); 
+  /// Checks the candidates collected since the last batch
+  bool finish() const { return !batch.empty() && checkBatch(); }
+
+private:
+  bool checkBatch() const {
+    if (!compiled)
+      compiled = std::make_unique<CompiledExpr>(key.begin(), key.end());
+    const std::size_t i = compiled->findSatisfying(batch);
+    if (i < batch.size())
+      satisfying = const_cast<Assignment *>(batch[i]);
+    batch.clear();
+    return satisfying;
   }
 };
 
+/// Returns the first of `assignments` that satisfies `key`, or null
+static Assignment *findSatisfying(const KeyType &key,
+                                  const std::vector<Assignment *> &assignments) {
+  if (assignments.empty())
+    return nullptr;
+  const std::vector<const Assignment *> batch(assignments.begin(),
+                                              assignments.end());
+  const std::size_t i =
+      CompiledExpr(key.begin(), key.end()).findSatisfying(batch);
+  return i < assignments.size() ? assignments[i] : nullptr;
+}
+
 /// searchForAssignment - Look for a cached solution for a query.
 ///
 /// \param key - The query to look up.
@@ -151,15 +222,13 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
       return true;
     }
 
-    // Otherwise, iterate through the set of current assignments to see if one
-    // of them satisfies the query.
-    for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
-           ie = assignmentsTable.end(); it != ie; ++it) {
-      Assignment *a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
-        result = a;
-        return true;
-      }
+    // Otherwise, check the set of current assignments to see if one of them
+    // satisfies the query.
+    if (Assignment *a = findSatisfying(
+            key, std::vector<Assignment *>(assignmentsTable.begin(),
+                                           assignmentsTable.end()))) {
+      result = a;
+      return true;
     }
   } else {
     // FIXME: Which order? one is sure to be better.
@@ -172,15 +241,20 @@ bool CexCachingSolver::searchForAssignment(KeyType &key, Assignment *&result) {
 
     // Otherwise, look for a subset which is unsatisfiable -- if the subset is
     // unsatisfiable then no additional constraints can produce a valid
-    // assignment. While searching subsets, we also explicitly the solutions for
-    // satisfiable subsets to see if they solve the current query and return
-    // them if so. This is cheap and frequently succeeds.
-    if (!lookup) 
-      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(key));
+    // assignment. While searching subsets, we also check the solutions for
+    // satisfiable subsets (in small batches) to see if they solve the current
+    // query and return them if so. This is cheap and frequently succeeds.
+    const NullOrSatisfyingAssignment predicate(key);
+    if (!lookup)
+      lookup = cache.findSubset(key, predicate);
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
-      result = *lookup;
+      result = predicate.satisfying ? predicate.satisfying : *lookup;
+      return true;
+    }
+    if (predicate.finish()) {
+      result = predicate.satisfying;
       return true;
     }
   }
@@ -224,6 +298,26 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   if (lookupAssignment(query, key, result))
     return true;
 
+  if (CexCacheFactors) {
+    std::vector<KeyType> factors;
+    splitIntoFactors(key, factors);
+    if (factors.size() > 1)
+      return getFactoredAssignment(key, factors, result);
+  }
+
+  return solveAndCache(query, key, result);
+}
+
+/// solveAndCache - Compute a result for a query with the solver below and
+/// cache it.
+///
+/// \param query - The query to solve.
+/// \param key - The key constructed for the query.
+/// \param result [out] - A satisfying assignment or 0 (for an unsatisfiable
+/// query).
+/// \return False if the solver below failed.
+bool CexCachingSolver::solveAndCache(const Query &query, const KeyType &key,
+                                     Assignment *&result) {
   std::vector<const Array*> objects;
   findSymbolicObjects(key.begin(), key.end(), objects);
 
@@ -235,16 +329,8 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
     
   Assignment *binding;
   if (hasSolution) {
-    binding = new Assignment(objects, values);
-
-    // Memoize the result.
-    std::pair<assignmentsTable_ty::iterator, bool>
-      res = assignmentsTable.insert(binding);
-    if (!res.second) {
-      delete binding;
-      binding = *res.first;
-    }
-    
+    binding = memoize(new Assignment(objects, values));
+
     if (DebugCexCacheCheckBinding)
       if (!binding->satisfies(key.begin(), key.end())) {
         query.dump();
@@ -261,6 +347,115 @@ bool CexCachingSolver::getAssignment(const Query& query, Assignment *&result) {
   return true;
 }
 
+/// Returns the assignment equal to `binding` from the memo table, which
+/// takes ownership of `binding`
+Assignment *CexCachingSolver::memoize(Assignment *binding) {
+  std::pair<assignmentsTable_ty::iterator, bool>
+    res = assignmentsTable.insert(binding);
+  if (!res.second) {
+    delete binding;
+    binding = *res.first;
+  }
+  return binding;
+}
+
+/// Splits `key` into factors that share no symbolic arrays, so that an
+/// assignment for `key` can be combined from assignments for its factors.
+void CexCachingSolver::splitIntoFactors(const KeyType &key,
+                                        std::vector<KeyType> &factors) {
+  // the entries for `key` have to survive until its factors are solved
+  if (constraintArrays.size() > MaxConstraintArrays)
+    constraintArrays.clear();
+
+  const std::vector<ref<Expr>> exprs(key.begin(), key.end());
+
+  // union-find over the constraints, joining those that read an array
+  std::vector<unsigned> parent(exprs.size());
+  std::iota(parent.begin(), parent.end(), 0);
+  auto find = [&parent](unsigned i) {
+    while (parent[i] != i)
+      i = parent[i] = parent[parent[i]];
+    return i;
+  };
+
+  std::unordered_map<const Array *, unsigned> reader;
+  for (unsigned i = 0; i < exprs.size(); ++i) {
+    auto cached = constraintArrays.find(exprs[i]);
+    if (cached == constraintArrays.end()) {
+      std::vector<const Array *> arrays;
+      findSymbolicObjects(exprs[i], arrays);
+      cached = constraintArrays.emplace(exprs[i], std::move(arrays)).first;
+    }
+    for (const Array *array : cached->second) {
+      auto it = reader.emplace(array, i);
+      if (!it.second)
+        parent[find(i)] = find(it.first->second);
+    }
+  }
+
+  std::unordered_map<unsigned, unsigned> factorOf;
+  for (unsigned i = 0; i < exprs.size(); ++i) {
+    auto it = factorOf.emplace(find(i), factors.size());
+    if (it.second)
+      factors.emplace_back();
+    factors[it.first->second].insert(exprs[i]);
+  }
+}
+
+/// getFactoredAssignment - Combine an assignment for a query from cached or
+/// newly computed assignments for each of its factors.
+///
+/// \param key - The key constructed for the query.
+/// \param factors - The factors of \arg key, see splitIntoFactors().
+/// \param result [out] - A satisfying assignment or 0 (for an unsatisfiable
+/// query).
+/// \return False if the solver below failed.
+bool CexCachingSolver::getFactoredAssignment(const KeyType &key,
+                                             std::vector<KeyType> &factors,
+                                             Assignment *&result) {
+  Assignment::bindings_ty bindings;
+  for (KeyType &factor : factors) {
+    Assignment *binding;
+    if (!searchForAssignment(factor, binding)) {
+      const ConstraintSet constraints(
+          std::vector<ref<Expr>>(factor.begin(), factor.end()));
+      if (!solveAndCache(Query(constraints, ConstantExpr::alloc(0, Expr::Bool)),
+                         factor, binding))
+        return false;
+    }
+
+    // an unsatisfiable factor makes the whole query unsatisfiable
+    if (!binding) {
+      result = (Assignment*) 0;
+      cache.insert(key, result);
+      return true;
+    }
+
+    // a cached assignment may bind arrays of other factors as well
+    for (const ref<Expr> &constraint : factor) {
+      for (const Array *array : constraintArrays.find(constraint)->second) {
+        auto it = binding->bindings.find(array);
+        if (it != binding->bindings.end())
+          bindings.insert(*it);
+      }
+    }
+  }
+
+  Assignment *binding = new Assignment();
+  binding->bindings = std::move(bindings);
+  binding = memoize(binding);
+
+  if (DebugCexCacheCheckBinding)
+    if (!binding->satisfies(key.begin(), key.end())) {
+      binding->dump();
+      klee_error("Combined assignment doesn't match query");
+    }
+
+  result = binding;
+  cache.insert(key, binding);
+  return true;
+}
+
 ///
 
 CexCachingSolver::~CexCachingSolver() {
@@ -272,6 +467,7 @@ CexCachingSolver::~CexCachingSolver() {
 
 bool CexCachingSolver::computeValidity(const Query& query,
                                        Solver::Validity &result) {
+  KLEE_PROFILE_ZONE("CexCachingSolver");
   TimerStatIncrementer t(stats::cexCacheTime);
   Assignment *a;
   if (!getAssignment(query.withFalse(), a))
@@ -296,6 +492,7 @@ bool CexCachingSolver::computeValidity(const Query& query,
 
 bool CexCachingSolver::computeTruth(const Query& query,
                                     bool &isValid) {
+  KLEE_PROFILE_ZONE("CexCachingSolver");
   TimerStatIncrementer t(stats::cexCacheTime);
 
   Assignment *a;
@@ -309,6 +506,7 @@ bool CexCachingSolver::computeTruth(const Query& query,
 
 bool CexCachingSolver::computeValue(const Query& query,
                                     ref<Expr> &result) {
+  KLEE_PROFILE_ZONE("CexCachingSolver");
   TimerStatIncrementer t(stats::cexCacheTime);
 
   Assignment *a;
@@ -328,6 +526,7 @@ CexCachingSolver::computeInitialValues(const Query& query,
                                        std::vector< std::vector<unsigned char> >
                                          &values,
                                        bool &hasSolution) {
+  KLEE_PROFILE_ZONE("CexCachingSolver");
   TimerStatIncrementer t(stats::cexCacheTime);
   Assignment *a;
   if (!getAssignment(query, a))
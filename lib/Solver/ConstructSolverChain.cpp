@@ -13,6 +13,7 @@
 
 #include "klee/Solver/Common.h"
 #include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverStats.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/System/Time.h"
 
@@ -25,11 +26,24 @@ namespace klee {
 std::unique_ptr<Solver> constructSolverChain(
     std::unique_ptr<Solver> coreSolver, std::string querySMT2LogPath,
     std::string baseSolverQuerySMT2LogPath, std::string queryKQueryLogPath,
-    std::string baseSolverQueryKQueryLogPath) {
+    std::string baseSolverQueryKQueryLogPath, std::string queryBinaryLogPath,
+    std::string baseSolverQueryBinaryLogPath) {
   Solver *rawCoreSolver = coreSolver.get();
   std::unique_ptr<Solver> solver = std::move(coreSolver);
   const time::Span minQueryTimeToLog(MinQueryTimeToLog);
 
+  // Every layer of the chain is optionally wrapped in a monitoring solver
+  // that knows the monitor of the layer below.
+  const bool monitorLayers = SolverLayerStats || DropUnprofitableSolverLayers;
+  Solver *monitorBelow = nullptr;
+  auto monitor = [&](SolverLayer layer, std::unique_ptr<Solver> s) {
+    if (!monitorLayers)
+      return s;
+    s = createMonitoringSolver(layer, std::move(s), monitorBelow);
+    monitorBelow = s.get();
+    return s;
+  };
+
   if (QueryLoggingOptions.isSet(SOLVER_KQUERY)) {
     solver = createKQueryLoggingSolver(std::move(solver),
                                        baseSolverQueryKQueryLogPath,
@@ -46,20 +60,38 @@ std::unique_ptr<Solver> constructSolverChain(
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (QueryLoggingOptions.isSet(SOLVER_BINARY)) {
+    solver = createBinaryQueryLoggingSolver(std::move(solver),
+                                            baseSolverQueryBinaryLogPath,
+                                            minQueryTimeToLog,
+                                            LogTimedOutQueries);
+    klee_message("Logging queries that reach solver in binary format to %s\n",
+                 baseSolverQueryBinaryLogPath.c_str());
+  }
+
   if (UseAssignmentValidatingSolver)
     solver = createAssignmentValidatingSolver(std::move(solver));
 
+  if (SimplifySolverQueries)
+    solver = createSimplifyingSolver(std::move(solver));
+
+  solver = monitor(SolverLayer::Core, std::move(solver));
+
   if (UseFastCexSolver)
-    solver = createFastCexSolver(std::move(solver));
+    solver = monitor(SolverLayer::FastCex,
+                     createFastCexSolver(std::move(solver)));
 
   if (UseCexCache)
-    solver = createCexCachingSolver(std::move(solver));
+    solver = monitor(SolverLayer::CexCaching,
+                     createCexCachingSolver(std::move(solver)));
 
   if (UseBranchCache)
-    solver = createCachingSolver(std::move(solver));
+    solver =
+        monitor(SolverLayer::Caching, createCachingSolver(std::move(solver)));
 
   if (UseIndependentSolver)
-    solver = createIndependentSolver(std::move(solver));
+    solver = monitor(SolverLayer::Independent,
+                     createIndependentSolver(std::move(solver)));
 
   if (DebugValidateSolver)
     solver = createValidatingSolver(std::move(solver), rawCoreSolver, false);
@@ -77,6 +109,16 @@ std::unique_ptr<Solver> constructSolverChain(
     klee_message("Logging all queries in .smt2 format to %s\n",
                  querySMT2LogPath.c_str());
   }
+
+  if (QueryLoggingOptions.isSet(ALL_BINARY)) {
+    solver = createBinaryQueryLoggingSolver(std::move(solver),
+                                            queryBinaryLogPath,
+                                            minQueryTimeToLog,
+                                            LogTimedOutQueries);
+    klee_message("Logging all queries in binary format to %s\n",
+                 queryBinaryLogPath.c_str());
+  }
+
   if (DebugCrossCheckCoreSolverWith != NO_SOLVER) {
     std::unique_ptr<Solver> oracleSolver =
         createCoreSolver(DebugCrossCheckCoreSolverWith);
@@ -18,6 +18,7 @@
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Solver/IncompleteSolver.h"
 #include "klee/Support/Debug.h"
+#include "klee/Support/Profiler.h"
 
 #include "llvm/ADT/APInt.h"
 #include "llvm/Support/raw_ostream.h"
@@ -1059,6 +1060,7 @@ static bool propagateValues(const Query &query, CexData &cd, bool checkExpr,
 
 IncompleteSolver::PartialValidity 
 FastCexSolver::computeTruth(const Query& query) {
+  KLEE_PROFILE_ZONE("FastCexSolver");
   CexData cd;
 
   bool isValid;
@@ -1071,6 +1073,7 @@ FastCexSolver::computeTruth(const Query& query) {
 }
 
 bool FastCexSolver::computeValue(const Query& query, ref<Expr> &result) {
+  KLEE_PROFILE_ZONE("FastCexSolver");
   CexData cd;
 
   bool isValid;
@@ -1103,6 +1106,7 @@ FastCexSolver::computeInitialValues(const Query& query,
                                     std::vector< std::vector<unsigned char> >
                                       &values,
                                     bool &hasSolution) {
+  KLEE_PROFILE_ZONE("FastCexSolver");
   CexData cd;
 
   bool isValid;
@@ -16,6 +16,7 @@
 #include "klee/Expr/ExprBuilder.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Support/Debug.h"
+#include "klee/Support/Profiler.h"
 #include "klee/Solver/SolverImpl.h"
 
 #include "llvm/Support/raw_ostream.h"
@@ -110,14 +111,34 @@ public:
 
   IndependentElementSet() {}
   IndependentElementSet(ref<Expr> e) {
+    std::vector< ref<ReadExpr> > reads;
+    findReads(e, /* visitUpdates= */ true, reads);
+    addReads(e, reads);
+  }
+  /// Creates the set of a constraint of `constraints`, reusing the reads
+  /// remembered by the constraint set
+  IndependentElementSet(ref<Expr> e, const ConstraintSet &constraints) {
+    addReads(e, constraints.getReads(e));
+  }
+  IndependentElementSet(const IndependentElementSet &ies) : 
+    elements(ies.elements),
+    wholeObjects(ies.wholeObjects),
+    exprs(ies.exprs) {}
+
+  IndependentElementSet &operator=(const IndependentElementSet &ies) {
+    elements = ies.elements;
+    wholeObjects = ies.wholeObjects;
+    exprs = ies.exprs;
+    return *this;
+  }
+
+  void addReads(ref<Expr> e, const std::vector< ref<ReadExpr> > &reads) {
     exprs.push_back(e);
     // Track all reads in the program.  Determines whether reads are
     // concrete or symbolic.  If they are symbolic, "collapses" array
     // by adding it to wholeObjects.  Otherwise, creates a mapping of
     // the form Map<array, set<index>> which tracks which parts of the
     // array are being accessed.
-    std::vector< ref<ReadExpr> > reads;
-    findReads(e, /* visitUpdates= */ true, reads);
     for (unsigned i = 0; i != reads.size(); ++i) {
       ReadExpr *re = reads[i].get();
       const Array *array = re->updates.root;
@@ -141,17 +162,6 @@ public:
       }
     }
   }
-  IndependentElementSet(const IndependentElementSet &ies) : 
-    elements(ies.elements),
-    wholeObjects(ies.wholeObjects),
-    exprs(ies.exprs) {}
-
-  IndependentElementSet &operator=(const IndependentElementSet &ies) {
-    elements = ies.elements;
-    wholeObjects = ies.wholeObjects;
-    exprs = ies.exprs;
-    return *this;
-  }
 
   void print(llvm::raw_ostream &os) const {
     os << "{";
@@ -280,7 +290,7 @@ getAllIndependentConstraintsSets(const Query &query) {
     // evaluated.  If the queue property isn't maintained, then the exprs
     // could be returned in an order different from how they came it, negatively
     // affecting later stages.
-    factors->push_back(IndependentElementSet(constraint));
+    factors->push_back(IndependentElementSet(constraint, query.constraints));
   }
 
   bool doneLoop = false;
@@ -328,7 +338,8 @@ IndependentElementSet getIndependentConstraints(const Query& query,
 
   for (const auto &constraint : query.constraints)
     worklist.push_back(
-        std::make_pair(constraint, IndependentElementSet(constraint)));
+        std::make_pair(constraint,
+                       IndependentElementSet(constraint, query.constraints)));
 
   // XXX This should be more efficient (in terms of low level copy stuff).
   bool done = false;
@@ -411,6 +422,7 @@ public:
   
 bool IndependentSolver::computeValidity(const Query& query,
                                         Solver::Validity &result) {
+  KLEE_PROFILE_ZONE("IndependentSolver");
   std::vector< ref<Expr> > required;
   IndependentElementSet eltsClosure =
     getIndependentConstraints(query, required);
@@ -420,6 +432,7 @@ bool IndependentSolver::computeValidity(const Query& query,
 }
 
 bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
+  KLEE_PROFILE_ZONE("IndependentSolver");
   std::vector< ref<Expr> > required;
   IndependentElementSet eltsClosure = 
     getIndependentConstraints(query, required);
@@ -429,6 +442,7 @@ bool IndependentSolver::computeTruth(const Query& query, bool &isValid) {
 }
 
 bool IndependentSolver::computeValue(const Query& query, ref<Expr> &result) {
+  KLEE_PROFILE_ZONE("IndependentSolver");
   std::vector< ref<Expr> > required;
   IndependentElementSet eltsClosure = 
     getIndependentConstraints(query, required);
@@ -476,6 +490,7 @@ bool IndependentSolver::computeInitialValues(const Query& query,
                                              const std::vector<const Array*> &objects,
                                              std::vector< std::vector<unsigned char> > &values,
                                              bool &hasSolution){
+  KLEE_PROFILE_ZONE("IndependentSolver");
   // We assume the query has a solution except proven differently
   // This is important in case we don't have any constraints but
   // we need initial values for requested array objects.
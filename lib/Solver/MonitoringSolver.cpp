@@ -0,0 +1,228 @@
+//===-- MonitoringSolver.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// Decorator placed above every layer of the solver chain. It records how
+/// many queries enter the layer, how long they take (including all layers
+/// below), and how many the layer answers itself, i.e. without the next
+/// monitored layer below being consulted. Hits are not recorded for the
+/// bottom layer, which answers every query itself.
+///
+/// With --drop-unprofitable-solver-layers, the time a caching layer saves
+/// (hits times the average latency below) is periodically compared with the
+/// time it costs itself; a layer that does not pay off is bypassed from then
+/// on.
+class MonitoringSolver : public SolverImpl {
+  const SolverLayer layer;
+  std::unique_ptr<Solver> solver;
+  /// The next monitored layer below, or null for the bottom layer
+  Solver *below;
+
+  Statistic &queriesStat;
+  Statistic &hitsStat;
+  Statistic &timeStat;
+  LatencyHistogram &latency;
+
+  bool bypassed = false;
+  std::uint64_t calls = 0;
+  /// Time spent in this layer and all layers below
+  std::uint64_t nanoseconds = 0;
+  std::uint64_t reportedMicroseconds = 0;
+
+  /// Evaluation window for dropping the layer
+  std::uint64_t windowCalls = 0;
+  std::uint64_t windowHits = 0;
+  std::uint64_t windowTime = 0;
+  std::uint64_t windowBelowCalls = 0;
+  std::uint64_t windowBelowTime = 0;
+
+  const MonitoringSolver &getBelow() const {
+    return *static_cast<const MonitoringSolver *>(below->impl.get());
+  }
+
+  SolverImpl &getTarget() { return bypassed ? *below->impl : *solver->impl; }
+
+  template <typename Call> bool monitor(Call &&call);
+  void evaluateWindow();
+
+public:
+  MonitoringSolver(SolverLayer layer, std::unique_ptr<Solver> solver,
+                   Solver *below);
+
+  bool computeValidity(const Query &, Solver::Validity &result) override;
+  bool computeTruth(const Query &, bool &isValid) override;
+  bool computeValue(const Query &, ref<Expr> &result) override;
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) override;
+  SolverRunStatus getOperationStatusCode() override;
+  std::string getConstraintLog(const Query &) override;
+  void setCoreSolverTimeout(time::Span timeout) override;
+};
+
+static Statistic &getQueries(SolverLayer layer) {
+  switch (layer) {
+#undef SLAYER
+#define SLAYER(Name)                                                           \
+  case SolverLayer::Name:                                                      \
+    return stats::solver##Name##Queries;
+    SOLVER_LAYERS
+  }
+  __builtin_unreachable();
+}
+
+static Statistic &getHits(SolverLayer layer) {
+  switch (layer) {
+#undef SLAYER
+#define SLAYER(Name)                                                           \
+  case SolverLayer::Name:                                                      \
+    return stats::solver##Name##Hits;
+    SOLVER_LAYERS
+  }
+  __builtin_unreachable();
+}
+
+static Statistic &getTime(SolverLayer layer) {
+  switch (layer) {
+#undef SLAYER
+#define SLAYER(Name)                                                           \
+  case SolverLayer::Name:                                                      \
+    return stats::solver##Name##Time;
+    SOLVER_LAYERS
+  }
+  __builtin_unreachable();
+}
+
+MonitoringSolver::MonitoringSolver(SolverLayer layer,
+                                   std::unique_ptr<Solver> solver,
+                                   Solver *below)
+    : layer(layer), solver(std::move(solver)), below(below),
+      queriesStat(getQueries(layer)), hitsStat(getHits(layer)),
+      timeStat(getTime(layer)),
+      latency(stats::getSolverLayerLatency(layer)) {}
+
+template <typename Call> bool MonitoringSolver::monitor(Call &&call) {
+  const bool wasBypassed = bypassed;
+  const std::uint64_t belowCalls = below ? getBelow().calls : 0;
+  const std::uint64_t belowTime = below ? getBelow().nanoseconds : 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  const bool success = call(getTarget());
+  const std::uint64_t elapsed =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+
+  ++calls;
+  nanoseconds += elapsed;
+  ++queriesStat;
+  latency.record(elapsed);
+  if (const std::uint64_t us = nanoseconds / 1000; us > reportedMicroseconds) {
+    timeStat += us - reportedMicroseconds;
+    reportedMicroseconds = us;
+  }
+  if (wasBypassed)
+    return success;
+
+  if (!below)
+    return success;
+
+  const bool hit = getBelow().calls == belowCalls;
+  if (hit)
+    ++hitsStat;
+
+  if (DropUnprofitableSolverLayers && layer != SolverLayer::Independent) {
+    ++windowCalls;
+    windowHits += hit;
+    windowTime += elapsed;
+    windowBelowCalls += getBelow().calls - belowCalls;
+    windowBelowTime += getBelow().nanoseconds - belowTime;
+    if (windowCalls >= SolverLayerWindow)
+      evaluateWindow();
+  }
+  return success;
+}
+
+void MonitoringSolver::evaluateWindow() {
+  // a layer that answered everything itself is clearly worth keeping
+  if (windowBelowCalls) {
+    const double missLatency = double(windowBelowTime) / windowBelowCalls;
+    const double saved = windowHits * missLatency;
+    const double cost = double(windowTime - windowBelowTime);
+    if (saved < cost) {
+      bypassed = true;
+      klee_message("Bypassing the %s solver layer: %llu hits in %llu queries "
+                   "saved %.0fus but cost %.0fus",
+                   getSolverLayerName(layer),
+                   static_cast<unsigned long long>(windowHits),
+                   static_cast<unsigned long long>(windowCalls), saved / 1000,
+                   cost / 1000);
+    }
+  }
+  windowCalls = windowHits = windowTime = 0;
+  windowBelowCalls = windowBelowTime = 0;
+}
+
+bool MonitoringSolver::computeValidity(const Query &query,
+                                       Solver::Validity &result) {
+  return monitor(
+      [&](SolverImpl &s) { return s.computeValidity(query, result); });
+}
+
+bool MonitoringSolver::computeTruth(const Query &query, bool &isValid) {
+  return monitor(
+      [&](SolverImpl &s) { return s.computeTruth(query, isValid); });
+}
+
+bool MonitoringSolver::computeValue(const Query &query, ref<Expr> &result) {
+  return monitor(
+      [&](SolverImpl &s) { return s.computeValue(query, result); });
+}
+
+bool MonitoringSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  return monitor([&](SolverImpl &s) {
+    return s.computeInitialValues(query, objects, values, hasSolution);
+  });
+}
+
+SolverImpl::SolverRunStatus MonitoringSolver::getOperationStatusCode() {
+  return getTarget().getOperationStatusCode();
+}
+
+std::string MonitoringSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void MonitoringSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+std::unique_ptr<Solver> createMonitoringSolver(SolverLayer layer,
+                                               std::unique_ptr<Solver> s,
+                                               Solver *below) {
+  return std::make_unique<Solver>(
+      std::make_unique<MonitoringSolver>(layer, std::move(s), below));
+}
+} // namespace klee
@@ -9,7 +9,7 @@
 #include "QueryLoggingSolver.h"
 
 #include "klee/Config/config.h"
-#include "klee/Support/OptionCategories.h"
+#include "klee/Solver/SolverCmdLine.h"
 #include "klee/Statistics/Statistics.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Support/FileHandling.h"
@@ -17,20 +17,6 @@
 
 #include <utility>
 
-namespace {
-llvm::cl::opt<bool> DumpPartialQueryiesEarly(
-    "log-partial-queries-early", llvm::cl::init(false),
-    llvm::cl::desc("Log queries before calling the solver (default=false)"),
-    llvm::cl::cat(klee::SolvingCat));
-
-#ifdef HAVE_ZLIB_H
-llvm::cl::opt<bool> CreateCompressedQueryLog(
-    "compress-query-log", llvm::cl::init(false),
-    llvm::cl::desc("Compress query log files (default=false)"),
-    llvm::cl::cat(klee::SolvingCat));
-#endif
-} // namespace
-
 QueryLoggingSolver::QueryLoggingSolver(std::unique_ptr<Solver> solver,
                                        std::string path,
                                        const std::string &commentSign,
@@ -78,7 +64,7 @@ void QueryLoggingSolver::startQuery(const Query &query, const char *typeName,
 
   printQuery(query, falseQuery, objects);
 
-  if (DumpPartialQueryiesEarly) {
+  if (LogPartialQueriesEarly) {
     flushBufferConditionally(true);
   }
   startTime = time::getWallTime();
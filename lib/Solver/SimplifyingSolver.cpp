@@ -0,0 +1,236 @@
+//===-- SimplifyingSolver.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// Rebuilds the constraints and the expression of every query through the
+/// word-level expression builder before passing it on. The expressions KLEE
+/// constructs while executing are only simplified locally; rebuilding them
+/// bottom-up merges the byte-wise accesses of words and folds comparisons
+/// that the known bits or value ranges of their operands decide, so smaller
+/// queries reach the core solver. Only the top MaxDepth levels of every
+/// expression are rebuilt, which bounds the recursion.
+class SimplifyingSolver : public SolverImpl {
+  std::unique_ptr<Solver> solver;
+  std::unique_ptr<ExprBuilder> builder;
+
+  /// Simplified (sub-)expressions, shared by all queries
+  ExprHashMap<ref<Expr>> cache;
+  static constexpr std::size_t MaxCachedExprs = 1 << 16;
+  /// Depth below which expressions are passed on as they are
+  static constexpr unsigned MaxDepth = 256;
+
+  ref<Expr> simplify(const ref<Expr> &e, unsigned depth = 0);
+  template <typename Call> bool forward(const Query &query, Call &&call);
+
+public:
+  explicit SimplifyingSolver(std::unique_ptr<Solver> solver)
+      : solver(std::move(solver)),
+        builder(createWordLevelExprBuilder(
+            createConstantFoldingExprBuilder(createDefaultExprBuilder()))) {}
+
+  bool computeValidity(const Query &, Solver::Validity &result) override;
+  bool computeTruth(const Query &, bool &isValid) override;
+  bool computeValue(const Query &, ref<Expr> &result) override;
+  bool computeInitialValues(const Query &,
+                            const std::vector<const Array *> &objects,
+                            std::vector<std::vector<unsigned char>> &values,
+                            bool &hasSolution) override;
+  SolverRunStatus getOperationStatusCode() override;
+  std::string getConstraintLog(const Query &) override;
+  void setCoreSolverTimeout(time::Span timeout) override;
+};
+
+ref<Expr> SimplifyingSolver::simplify(const ref<Expr> &e, unsigned depth) {
+  // expressions below NotOptimized are kept as they are
+  if (isa<ConstantExpr>(e) || isa<NotOptimizedExpr>(e) || depth == MaxDepth)
+    return e;
+  auto it = cache.find(e);
+  if (it != cache.end())
+    return it->second;
+
+  ref<Expr> kids[3];
+  bool changed = false;
+  for (unsigned i = 0, n = e->getNumKids(); i < n; ++i) {
+    kids[i] = simplify(e->getKid(i), depth + 1);
+    changed |= kids[i].get() != e->getKid(i).get();
+  }
+
+  ExprBuilder &b = *builder;
+  ref<Expr> result;
+  switch (e->getKind()) {
+  case Expr::Read:
+    // also rolls back through updates the index cannot match
+    result = b.Read(cast<ReadExpr>(e)->updates, kids[0]);
+    break;
+  case Expr::Select:
+    result = b.Select(kids[0], kids[1], kids[2]);
+    break;
+  case Expr::Concat:
+    result = b.Concat(kids[0], kids[1]);
+    break;
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    result = b.Extract(kids[0], ee->offset, ee->width);
+    break;
+  }
+  case Expr::ZExt:
+    result = b.ZExt(kids[0], e->getWidth());
+    break;
+  case Expr::SExt:
+    result = b.SExt(kids[0], e->getWidth());
+    break;
+  case Expr::Not:
+    result = b.Not(kids[0]);
+    break;
+  case Expr::Add:
+    result = b.Add(kids[0], kids[1]);
+    break;
+  case Expr::Sub:
+    result = b.Sub(kids[0], kids[1]);
+    break;
+  case Expr::Mul:
+    result = b.Mul(kids[0], kids[1]);
+    break;
+  case Expr::UDiv:
+    result = b.UDiv(kids[0], kids[1]);
+    break;
+  case Expr::SDiv:
+    result = b.SDiv(kids[0], kids[1]);
+    break;
+  case Expr::URem:
+    result = b.URem(kids[0], kids[1]);
+    break;
+  case Expr::SRem:
+    result = b.SRem(kids[0], kids[1]);
+    break;
+  case Expr::And:
+    result = b.And(kids[0], kids[1]);
+    break;
+  case Expr::Or:
+    result = b.Or(kids[0], kids[1]);
+    break;
+  case Expr::Xor:
+    result = b.Xor(kids[0], kids[1]);
+    break;
+  case Expr::Shl:
+    result = b.Shl(kids[0], kids[1]);
+    break;
+  case Expr::LShr:
+    result = b.LShr(kids[0], kids[1]);
+    break;
+  case Expr::AShr:
+    result = b.AShr(kids[0], kids[1]);
+    break;
+  case Expr::Eq:
+    result = b.Eq(kids[0], kids[1]);
+    break;
+  case Expr::Ult:
+    result = b.Ult(kids[0], kids[1]);
+    break;
+  case Expr::Ule:
+    result = b.Ule(kids[0], kids[1]);
+    break;
+  case Expr::Slt:
+    result = b.Slt(kids[0], kids[1]);
+    break;
+  case Expr::Sle:
+    result = b.Sle(kids[0], kids[1]);
+    break;
+  default:
+    result = changed ? e->rebuild(kids) : e;
+    break;
+  }
+
+  // keep the original object if nothing was simplified
+  if (result == e)
+    result = e;
+  cache.insert(std::make_pair(e, result));
+  return result;
+}
+
+template <typename Call>
+bool SimplifyingSolver::forward(const Query &query, Call &&call) {
+  if (cache.size() > MaxCachedExprs)
+    cache.clear();
+
+  bool changed = false;
+  std::vector<ref<Expr>> constraints;
+  constraints.reserve(query.constraints.size());
+  for (const auto &constraint : query.constraints) {
+    ref<Expr> simplified = simplify(constraint);
+    changed |= simplified.get() != constraint.get();
+    if (!simplified->isTrue())
+      constraints.push_back(simplified);
+  }
+  const ref<Expr> expr = simplify(query.expr);
+  changed |= expr.get() != query.expr.get();
+
+  if (!changed)
+    return call(query);
+  const ConstraintSet simplifiedConstraints(std::move(constraints));
+  return call(Query(simplifiedConstraints, expr));
+}
+
+bool SimplifyingSolver::computeValidity(const Query &query,
+                                        Solver::Validity &result) {
+  return forward(query, [&](const Query &q) {
+    return solver->impl->computeValidity(q, result);
+  });
+}
+
+bool SimplifyingSolver::computeTruth(const Query &query, bool &isValid) {
+  return forward(query, [&](const Query &q) {
+    return solver->impl->computeTruth(q, isValid);
+  });
+}
+
+bool SimplifyingSolver::computeValue(const Query &query, ref<Expr> &result) {
+  return forward(query, [&](const Query &q) {
+    return solver->impl->computeValue(q, result);
+  });
+}
+
+bool SimplifyingSolver::computeInitialValues(
+    const Query &query, const std::vector<const Array *> &objects,
+    std::vector<std::vector<unsigned char>> &values, bool &hasSolution) {
+  // arrays that no longer occur are still assigned by the solver below
+  return forward(query, [&](const Query &q) {
+    return solver->impl->computeInitialValues(q, objects, values, hasSolution);
+  });
+}
+
+SolverImpl::SolverRunStatus SimplifyingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+std::string SimplifyingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void SimplifyingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+std::unique_ptr<Solver> createSimplifyingSolver(std::unique_ptr<Solver> s) {
+  return std::make_unique<Solver>(
+      std::make_unique<SimplifyingSolver>(std::move(s)));
+}
+} // namespace klee
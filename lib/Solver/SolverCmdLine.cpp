@@ -56,6 +56,32 @@ cl::opt<bool>
                          cl::desc("Use constraint independence (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<bool> SimplifySolverQueries(
+    "simplify-solver-queries", cl::init(false),
+    cl::desc("Simplify queries at the word level before they reach the core "
+             "solver (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> SolverLayerStats(
+    "solver-layer-stats", cl::init(false),
+    cl::desc("Record queries, hits and latency percentiles of every layer of "
+             "the solver chain in run.stats (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<bool> DropUnprofitableSolverLayers(
+    "drop-unprofitable-solver-layers", cl::init(false),
+    cl::desc("Bypass caching and fast counterexample layers of the solver "
+             "chain whose hits save less time than they cost. Implies "
+             "--solver-layer-stats (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> SolverLayerWindow(
+    "solver-layer-window", cl::init(1000),
+    cl::desc("Number of queries after which the benefit of a solver layer is "
+             "re-evaluated for --drop-unprofitable-solver-layers "
+             "(default=1000)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> DebugValidateSolver(
     "debug-validate-solver", cl::init(false),
     cl::desc("Crosscheck the results of the solver chain above the core solver "
@@ -104,9 +130,27 @@ cl::bits<QueryLoggingSolverType> QueryLoggingOptions(
             "All queries reaching the solver in .kquery (KQuery) format"),
         clEnumValN(
             SOLVER_SMTLIB, "solver:smt2",
-            "All queries reaching the solver in .smt2 (SMT-LIBv2) format")),
+            "All queries reaching the solver in .smt2 (SMT-LIBv2) format"),
+        clEnumValN(ALL_BINARY, "all:binary",
+                   "All queries in the compact binary format, which "
+                   "klee-query-log converts to .kquery or .smt2"),
+        clEnumValN(SOLVER_BINARY, "solver:binary",
+                   "All queries reaching the solver in the compact binary "
+                   "format")),
     cl::CommaSeparated, cl::cat(SolvingCat));
 
+cl::opt<bool> LogPartialQueriesEarly(
+    "log-partial-queries-early", cl::init(false),
+    cl::desc("Log queries before calling the solver (default=false)"),
+    cl::cat(SolvingCat));
+
+#ifdef HAVE_ZLIB_H
+cl::opt<bool> CreateCompressedQueryLog(
+    "compress-query-log", cl::init(false),
+    cl::desc("Compress query log files (default=false)"),
+    cl::cat(SolvingCat));
+#endif
+
 cl::opt<bool> UseAssignmentValidatingSolver(
     "debug-assignment-validating-solver", cl::init(false),
     cl::desc("Debug the correctness of generated assignments (default=false)"),
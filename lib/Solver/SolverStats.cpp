@@ -9,6 +9,8 @@
 
 #include "klee/Solver/SolverStats.h"
 
+#include <array>
+
 using namespace klee;
 
 Statistic stats::cexCacheTime("CexCacheTime", "CCtime");
@@ -23,6 +25,35 @@ Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
 Statistic stats::queryConstructs("QueryConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
 Statistic stats::queryTime("QueryTime", "Qtime");
+Statistic stats::z3ConstructCacheHits("Z3ConstructCacheHits", "Z3CChits");
+Statistic stats::z3ConstructCacheMisses("Z3ConstructCacheMisses",
+                                        "Z3CCmisses");
+
+#undef SLAYER
+#define SLAYER(Name)                                                           \
+  Statistic stats::solver##Name##Queries("Solver" #Name "Queries",             \
+                                         "S" #Name "Q");                       \
+  Statistic stats::solver##Name##Hits("Solver" #Name "Hits", "S" #Name "H");   \
+  Statistic stats::solver##Name##Time("Solver" #Name "Time", "S" #Name "T");
+SOLVER_LAYERS
+
+const char *klee::getSolverLayerName(SolverLayer layer) {
+  switch (layer) {
+#undef SLAYER
+#define SLAYER(Name)                                                           \
+  case SolverLayer::Name:                                                      \
+    return #Name;
+    SOLVER_LAYERS
+  }
+  return "";
+}
+
+LatencyHistogram &stats::getSolverLayerLatency(SolverLayer layer) {
+#undef SLAYER
+#define SLAYER(Name) +1
+  static std::array<LatencyHistogram, 0 SOLVER_LAYERS> histograms;
+  return histograms[static_cast<unsigned>(layer)];
+}
 
 #ifdef KLEE_ARRAY_DEBUG
 Statistic stats::arrayHashTime("ArrayHashTime", "AHtime");
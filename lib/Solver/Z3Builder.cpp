@@ -29,6 +29,14 @@ llvm::cl::opt<bool> UseConstructHashZ3(
     llvm::cl::init(true),
     llvm::cl::cat(klee::ExprCat));
 
+llvm::cl::opt<unsigned> Z3ConstructCacheSize(
+    "z3-construct-cache-size",
+    llvm::cl::desc("Number of expressions (and of array updates) whose Z3 "
+                   "encoding is kept across queries per generation; the "
+                   "least recently used generation is evicted. 0 drops the "
+                   "encodings after every query (default=65536)"),
+    llvm::cl::init(65536), llvm::cl::cat(klee::ExprCat));
+
 // FIXME: This should be std::atomic<bool>. Need C++11 for that.
 bool Z3InterationLogOpen = false;
 }
@@ -76,7 +84,9 @@ void Z3ArrayExprHash::clear() {
 }
 
 Z3Builder::Z3Builder(bool autoClearConstructCache, const char* z3LogInteractionFileArg)
-    : autoClearConstructCache(autoClearConstructCache), z3LogInteractionFile("") {
+    : constructed(Z3ConstructCacheSize), updatedArrays(Z3ConstructCacheSize),
+      autoClearConstructCache(autoClearConstructCache),
+      z3LogInteractionFile("") {
   if (z3LogInteractionFileArg)
     this->z3LogInteractionFile = std::string(z3LogInteractionFileArg);
   if (z3LogInteractionFile.length() > 0) {
@@ -111,6 +121,11 @@ Z3Builder::~Z3Builder() {
   }
 }
 
+void Z3Builder::endQuery() {
+  if (!Z3ConstructCacheSize)
+    clearConstructCache();
+}
+
 Z3SortHandle Z3Builder::getBvSort(unsigned width) {
   // FIXME: cache these
   return Z3SortHandle(Z3_mk_bv_sort(ctx, width), ctx);
@@ -434,8 +449,13 @@ Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
   // or no more update nodes remain
   Z3ASTHandle un_expr;
   std::vector<const UpdateNode *> update_nodes;
-  for (; un && !_arr_hash.lookupUpdateNodeExpr(un, un_expr);
-       un = un->next.get()) {
+  for (; un; un = un->next.get()) {
+    if (const UpdatedArray *cached = updatedArrays.lookup(un)) {
+      ++stats::z3ConstructCacheHits;
+      un_expr = cached->array;
+      break;
+    }
+    ++stats::z3ConstructCacheMisses;
     update_nodes.push_back(un);
   }
   if (!un) {
@@ -451,7 +471,7 @@ Z3ASTHandle Z3Builder::getArrayForUpdate(const Array *root,
     un_expr =
         writeExpr(un_expr, construct(un->index, 0), construct(un->value, 0));
 
-    _arr_hash.hashUpdateNodeExpr(un, un_expr);
+    updatedArrays.insert(un, UpdatedArray{un, un_expr});
   }
 
   return un_expr;
@@ -465,18 +485,18 @@ Z3ASTHandle Z3Builder::construct(ref<Expr> e, int *width_out) {
   if (!UseConstructHashZ3 || isa<ConstantExpr>(e)) {
     return constructActual(e, width_out);
   } else {
-    ExprHashMap<std::pair<Z3ASTHandle, unsigned> >::iterator it =
-        constructed.find(e);
-    if (it != constructed.end()) {
+    if (const auto *cached = constructed.lookup(e)) {
+      ++stats::z3ConstructCacheHits;
       if (width_out)
-        *width_out = it->second.second;
-      return it->second.first;
+        *width_out = cached->second;
+      return cached->first;
     } else {
+      ++stats::z3ConstructCacheMisses;
       int width;
       if (!width_out)
         width_out = &width;
       Z3ASTHandle res = constructActual(e, width_out);
-      constructed.insert(std::make_pair(e, std::make_pair(res, *width_out)));
+      constructed.insert(e, std::make_pair(res, *width_out));
       return res;
     }
   }
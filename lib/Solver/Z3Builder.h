@@ -14,7 +14,10 @@
 #include "klee/Expr/ArrayExprHash.h"
 #include "klee/Expr/ExprHashMap.h"
 
+#include <cstddef>
+#include <functional>
 #include <unordered_map>
+#include <utility>
 #include <z3.h>
 
 namespace klee {
@@ -101,8 +104,65 @@ public:
   void clear();
 };
 
+/// Cache of constructed Z3 ASTs that is kept across queries. Entries live in
+/// two generations: new entries and entries found in the old generation go
+/// into the current one, and once the current generation holds `capacity`
+/// entries, the old generation is dropped and the current one becomes old.
+/// Entries used in consecutive generations thus survive, while at most twice
+/// the capacity is kept. A capacity of zero does not bound the cache.
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>>
+class Z3GenerationalCache {
+  using map_ty = std::unordered_map<Key, Value, Hash, Equal>;
+  map_ty current;
+  map_ty old;
+  std::size_t capacity;
+
+public:
+  explicit Z3GenerationalCache(std::size_t capacity) : capacity(capacity) {}
+
+  /// Returns the cached value of `key`, or null. The value is valid until
+  /// the next insertion.
+  const Value *lookup(const Key &key) {
+    auto it = current.find(key);
+    if (it != current.end())
+      return &it->second;
+    auto oldIt = old.find(key);
+    if (oldIt == old.end())
+      return nullptr;
+    Value value = std::move(oldIt->second);
+    old.erase(oldIt);
+    return &insert(key, std::move(value));
+  }
+
+  const Value &insert(const Key &key, Value value) {
+    if (capacity && current.size() >= capacity) {
+      old = std::move(current);
+      current.clear();
+    }
+    return current.insert_or_assign(key, std::move(value)).first->second;
+  }
+
+  std::size_t size() const { return current.size() + old.size(); }
+
+  void clear() {
+    current.clear();
+    old.clear();
+  }
+};
+
 class Z3Builder {
-  ExprHashMap<std::pair<Z3ASTHandle, unsigned> > constructed;
+  /// Constructed expressions and their widths
+  Z3GenerationalCache<ref<Expr>, std::pair<Z3ASTHandle, unsigned>,
+                      util::ExprHash, util::ExprCmp>
+      constructed;
+  /// Arrays after an update. The node is kept alive with its AST, so that
+  /// its address is not reused while it is cached.
+  struct UpdatedArray {
+    ref<const UpdateNode> node;
+    Z3ASTHandle array;
+  };
+  Z3GenerationalCache<const UpdateNode *, UpdatedArray> updatedArrays;
   Z3ArrayExprHash _arr_hash;
 
 private:
@@ -187,7 +247,14 @@ public:
     return res;
   }
 
-  void clearConstructCache() { constructed.clear(); }
+  /// Called after every query. Unless they are cached across queries
+  /// (--z3-construct-cache-size), the ASTs constructed for it are dropped.
+  void endQuery();
+
+  void clearConstructCache() {
+    constructed.clear();
+    updatedArrays.clear();
+  }
 };
 }
 
@@ -11,6 +11,7 @@
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Support/FileHandling.h"
 #include "klee/Support/OptionCategories.h"
+#include "klee/Support/Profiler.h"
 
 #include <csignal>
 
@@ -242,6 +243,7 @@ bool Z3SolverImpl::internalRunSolver(
     const Query &query, const std::vector<const Array *> *objects,
     std::vector<std::vector<unsigned char> > *values, bool &hasSolution) {
 
+  KLEE_PROFILE_ZONE("Z3Solver");
   TimerStatIncrementer t(stats::queryTime);
   // NOTE: Z3 will switch to using a slower solver internally if push/pop are
   // used so for now it is likely that creating a new solver each time is the
@@ -300,12 +302,11 @@ bool Z3SolverImpl::internalRunSolver(
                                        hasSolution);
 
   Z3_solver_dec_ref(builder->ctx, theSolver);
-  // Clear the builder's cache to prevent memory usage exploding.
-  // By using ``autoClearConstructCache=false`` and clearning now
-  // we allow Z3_ast expressions to be shared from an entire
-  // ``Query`` rather than only sharing within a single call to
-  // ``builder->construct()``.
-  builder->clearConstructCache();
+  // By using ``autoClearConstructCache=false`` and only ending the query
+  // now we allow Z3_ast expressions to be shared from an entire ``Query``
+  // (and across queries, within the cache budget) rather than only sharing
+  // within a single call to ``builder->construct()``.
+  builder->endQuery();
 
   if (runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE ||
       runStatusCode == SolverImpl::SOLVER_RUN_STATUS_SUCCESS_UNSOLVABLE) {
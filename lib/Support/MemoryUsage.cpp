@@ -23,6 +23,8 @@
 #include <malloc/malloc.h>
 #endif
 
+#include <sys/resource.h>
+
 // ASan Support
 //
 // When building with ASan the `mallinfo()` function is intercepted and always
@@ -137,3 +139,17 @@ size_t util::GetTotalMallocUsage() {
 
 #endif
 }
+
+size_t util::GetMinorPageFaults() {
+  struct rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage))
+    return 0;
+  return usage.ru_minflt;
+}
+
+size_t util::GetMajorPageFaults() {
+  struct rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage))
+    return 0;
+  return usage.ru_majflt;
+}
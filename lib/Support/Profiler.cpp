@@ -0,0 +1,331 @@
+//===-- Profiler.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Support/Profiler.h"
+
+#include "klee/Support/ErrorHandling.h"
+#include "klee/Support/OptionCategories.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <signal.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+enum class ProfileMode { None, Zones, Sampling };
+
+llvm::cl::opt<ProfileMode> Profile(
+    "profile",
+    llvm::cl::desc("Profile KLEE itself and write profile.folded (flamegraph "
+                   "input) and profile.txt to the output directory "
+                   "(default=none)"),
+    llvm::cl::values(
+        clEnumValN(ProfileMode::None, "none", "No profiling"),
+        clEnumValN(ProfileMode::Zones, "zones",
+                   "Measure the time spent in every zone"),
+        clEnumValN(ProfileMode::Sampling, "sampling",
+                   "Periodically sample the active zone (lower overhead)")),
+    llvm::cl::init(ProfileMode::None), llvm::cl::cat(klee::MiscCat));
+
+llvm::cl::opt<unsigned> ProfileSamplingRate(
+    "profile-sampling-rate",
+    llvm::cl::desc("Samples per second of CPU time taken by "
+                   "--profile=sampling (default=1000)"),
+    llvm::cl::init(1000), llvm::cl::cat(klee::MiscCat));
+
+/// A node of the zone call tree; node 0 is the root (outside of all zones)
+struct Node {
+  unsigned zone = 0;
+  unsigned parent = 0;
+  unsigned firstChild = 0;
+  unsigned nextSibling = 0;
+  std::uint64_t calls = 0;
+  /// Inclusive time stamp counter ticks (zones mode)
+  std::uint64_t ticks = 0;
+  /// Samples taken while this node was active (sampling mode)
+  std::atomic<std::uint64_t> samples{0};
+};
+
+struct Frame {
+  unsigned parent;
+  bool counted;
+  std::uint64_t start;
+};
+
+// The node table never moves, so that the signal handler can safely update
+// it while the interpreter thread adds nodes.
+constexpr unsigned MaxNodes = 1u << 16;
+std::unique_ptr<Node[]> nodes;
+unsigned numNodes = 0;
+std::atomic<unsigned> current{0};
+std::vector<Frame> stack;
+unsigned overflows = 0;
+
+std::vector<std::string> zoneNames{"[unzoned]"};
+std::unordered_map<std::string, unsigned> zoneIds;
+
+std::uint64_t startTicks = 0, stopTicks = 0;
+std::chrono::steady_clock::time_point startTime, stopTime;
+struct sigaction previousAction;
+
+inline std::uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+void handleSample(int) {
+  nodes[current.load(std::memory_order_relaxed)].samples.fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+/// Returns the child of `parent` for `zone`, or 0 if the table is full
+unsigned getChild(unsigned parent, unsigned zone) {
+  Node &p = nodes[parent];
+  for (unsigned *link = &p.firstChild; *link; link = &nodes[*link].nextSibling) {
+    const unsigned child = *link;
+    if (nodes[child].zone != zone)
+      continue;
+    // move to front: a handful of children (e.g. opcodes) dominate
+    *link = nodes[child].nextSibling;
+    nodes[child].nextSibling = p.firstChild;
+    p.firstChild = child;
+    return child;
+  }
+
+  if (numNodes == MaxNodes)
+    return 0;
+  const unsigned child = numNodes++;
+  nodes[child].zone = zone;
+  nodes[child].parent = parent;
+  nodes[child].nextSibling = p.firstChild;
+  p.firstChild = child;
+  return child;
+}
+
+/// Inclusive and exclusive weight of every node, in ticks or samples
+void computeWeights(std::vector<std::uint64_t> &inclusive,
+                    std::vector<std::uint64_t> &exclusive) {
+  inclusive.assign(numNodes, 0);
+  exclusive.assign(numNodes, 0);
+  // children are always created after their parents
+  if (Profile == ProfileMode::Sampling) {
+    for (unsigned n = numNodes; n-- > 0;) {
+      exclusive[n] = nodes[n].samples;
+      inclusive[n] += exclusive[n];
+      if (n)
+        inclusive[nodes[n].parent] += inclusive[n];
+    }
+  } else {
+    inclusive[0] = stopTicks - startTicks;
+    for (unsigned n = 1; n < numNodes; ++n)
+      inclusive[n] = nodes[n].ticks;
+    exclusive = inclusive;
+    for (unsigned n = 1; n < numNodes; ++n) {
+      auto &parent = exclusive[nodes[n].parent];
+      parent -= std::min(parent, inclusive[n]);
+    }
+  }
+}
+
+std::string getPath(unsigned node) {
+  std::vector<unsigned> path;
+  for (; node; node = nodes[node].parent)
+    path.push_back(node);
+  if (path.empty())
+    return zoneNames[0];
+  std::string result;
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    if (!result.empty())
+      result += ';';
+    result += zoneNames[nodes[*it].zone];
+  }
+  return result;
+}
+} // namespace
+
+bool profiler::active = false;
+
+unsigned profiler::registerZone(const std::string &name) {
+  const auto [it, inserted] = zoneIds.try_emplace(name, zoneNames.size());
+  if (inserted)
+    zoneNames.push_back(name);
+  return it->second;
+}
+
+bool profiler::isEnabled() { return Profile != ProfileMode::None; }
+
+void profiler::start() {
+  if (!isEnabled() || active)
+    return;
+  if (!nodes) {
+    nodes.reset(new Node[MaxNodes]);
+    numNodes = 1;
+  }
+
+  if (Profile == ProfileMode::Sampling) {
+    if (!ProfileSamplingRate)
+      klee_error("--profile-sampling-rate must be positive");
+    struct sigaction action {};
+    action.sa_handler = handleSample;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &previousAction);
+
+    const long interval = std::max(1000000L / ProfileSamplingRate, 1L);
+    struct itimerval timer {};
+    timer.it_interval.tv_sec = interval / 1000000;
+    timer.it_interval.tv_usec = interval % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr))
+      klee_warning("unable to start the profiling timer");
+  }
+
+  startTime = std::chrono::steady_clock::now();
+  startTicks = readTicks();
+  active = true;
+}
+
+void profiler::stop() {
+  if (!active)
+    return;
+  active = false;
+  stopTicks = readTicks();
+  stopTime = std::chrono::steady_clock::now();
+
+  if (Profile == ProfileMode::Sampling) {
+    struct itimerval timer {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    sigaction(SIGPROF, &previousAction, nullptr);
+  }
+  if (overflows)
+    klee_warning("profiler: %u zone entries not recorded (call tree too "
+                 "large)",
+                 overflows);
+}
+
+void profiler::enter(unsigned zone) {
+  const unsigned parent = current.load(std::memory_order_relaxed);
+  const unsigned child = getChild(parent, zone);
+  if (!child) {
+    ++overflows;
+    stack.push_back({parent, false, 0});
+    return;
+  }
+
+  ++nodes[child].calls;
+  stack.push_back({parent, true,
+                   Profile == ProfileMode::Zones ? readTicks() : 0});
+  current.store(child, std::memory_order_relaxed);
+}
+
+void profiler::leave() {
+  const Frame frame = stack.back();
+  stack.pop_back();
+  if (!frame.counted)
+    return;
+  if (Profile == ProfileMode::Zones)
+    nodes[current.load(std::memory_order_relaxed)].ticks +=
+        readTicks() - frame.start;
+  current.store(frame.parent, std::memory_order_relaxed);
+}
+
+void profiler::writeFoldedStacks(llvm::raw_ostream &os) {
+  if (!nodes)
+    return;
+  std::vector<std::uint64_t> inclusive, exclusive;
+  computeWeights(inclusive, exclusive);
+  for (unsigned n = 0; n < numNodes; ++n) {
+    if (exclusive[n])
+      os << getPath(n) << ' ' << exclusive[n] << '\n';
+  }
+}
+
+void profiler::writeSummary(llvm::raw_ostream &os) {
+  if (!nodes)
+    return;
+  std::vector<std::uint64_t> inclusive, exclusive;
+  computeWeights(inclusive, exclusive);
+
+  struct ZoneSummary {
+    std::uint64_t calls = 0, inclusive = 0, exclusive = 0;
+  };
+  std::vector<ZoneSummary> zones(zoneNames.size());
+  for (unsigned n = 0; n < numNodes; ++n) {
+    ZoneSummary &z = zones[nodes[n].zone];
+    z.calls += nodes[n].calls;
+    z.exclusive += exclusive[n];
+    // do not count recursive entries twice
+    bool nested = false;
+    for (unsigned a = nodes[n].parent; n && a && !nested; a = nodes[a].parent)
+      nested = nodes[a].zone == nodes[n].zone;
+    if (!nested)
+      z.inclusive += inclusive[n];
+  }
+
+  const double total = std::max<std::uint64_t>(inclusive[0], 1);
+  const double seconds =
+      std::chrono::duration<double>(stopTime - startTime).count();
+  // milliseconds per tick or per sample
+  const double scale =
+      Profile == ProfileMode::Sampling
+          ? 1000.0 / ProfileSamplingRate
+          : 1000.0 * seconds / std::max<std::uint64_t>(stopTicks - startTicks, 1);
+
+  std::vector<unsigned> order;
+  for (unsigned z = 0; z < zones.size(); ++z) {
+    if (zones[z].inclusive || zones[z].calls)
+      order.push_back(z);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    if (zones[a].exclusive != zones[b].exclusive)
+      return zones[a].exclusive > zones[b].exclusive;
+    return zones[a].inclusive > zones[b].inclusive;
+  });
+
+  std::size_t width = 4;
+  for (const auto z : order)
+    width = std::max(width, zoneNames[z].size());
+
+  os << (Profile == ProfileMode::Sampling ? "Mode: sampling (" : "Mode: zones (")
+     << llvm::format("%.3f", seconds) << "s profiled";
+  if (Profile == ProfileMode::Sampling)
+    os << ", " << inclusive[0] << " samples";
+  os << ")\n";
+  os << llvm::left_justify("Zone", width)
+     << "        Calls   Self(%)   Self(ms)   Incl(%)   Incl(ms)\n";
+  for (const auto z : order) {
+    const ZoneSummary &s = zones[z];
+    os << llvm::left_justify(zoneNames[z], width)
+       << llvm::format(" %12llu %8.2f%% %10.1f %8.2f%% %10.1f\n",
+                       static_cast<unsigned long long>(s.calls),
+                       100.0 * s.exclusive / total, s.exclusive * scale,
+                       100.0 * s.inclusive / total, s.inclusive * scale);
+  }
+}
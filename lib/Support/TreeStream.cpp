@@ -16,7 +16,7 @@
 #include <iomanip>
 #include <fstream>
 #include <iterator>
-#include <map>
+#include <utility>
 
 #include "llvm/Support/raw_ostream.h"
 #include <string.h>
@@ -31,7 +31,9 @@ TreeStreamWriter::TreeStreamWriter(const std::string &_path)
     path(_path),
     output(new std::ofstream(path.c_str(), 
                              std::ios::out | std::ios::binary)),
-    ids(1) {
+    ids(1),
+    offset(0),
+    streams(1) {
   if (!output->good()) {
     delete output;
     output = 0;
@@ -58,6 +60,9 @@ TreeOStream TreeStreamWriter::open(const TreeOStream &os) {
   output->write(reinterpret_cast<const char*>(&os.id), 4);
   unsigned tag = id | (1<<31);
   output->write(reinterpret_cast<const char*>(&tag), 4);
+  offset += 8;
+  streams.push_back(StreamInfo{
+      os.id, static_cast<unsigned>(streams[os.id].segments.size()), {}});
   return TreeOStream(*this, id);
 }
 
@@ -73,17 +78,22 @@ void TreeStreamWriter::write(TreeOStream &os, const char *s, unsigned size) {
     memcpy(buffer, s, size);
     bufferCount = size;
   } else {
-    output->write(reinterpret_cast<const char*>(&os.id), 4);
-    output->write(reinterpret_cast<const char*>(&size), 4);
-    output->write(s, size);
+    writeSegment(os.id, s, size);
   }
 }
 
+void TreeStreamWriter::writeSegment(unsigned id, const char *s,
+                                    unsigned size) {
+  output->write(reinterpret_cast<const char*>(&id), 4);
+  output->write(reinterpret_cast<const char*>(&size), 4);
+  output->write(s, size);
+  streams[id].segments.push_back(Segment{offset + 8, size});
+  offset += 8 + size;
+}
+
 void TreeStreamWriter::flushBuffer() {
-  if (bufferCount) {    
-    output->write(reinterpret_cast<const char*>(&lastID), 4);
-    output->write(reinterpret_cast<const char*>(&bufferCount), 4);
-    output->write(buffer, bufferCount);
+  if (bufferCount) {
+    writeSegment(lastID, buffer, bufferCount);
     bufferCount = 0;
   }
 }
@@ -97,67 +107,39 @@ void TreeStreamWriter::readStream(TreeStreamID streamID,
                                   std::vector<unsigned char> &out) {
   assert(streamID>0 && streamID<ids);
   flush();
-  
-  std::ifstream is(path.c_str(),
-                   std::ios::in | std::ios::binary);
-  assert(is.good());
+
   KLEE_DEBUG(llvm::errs() << "finding chain for: " << streamID << "\n");
 
-  std::map<unsigned,unsigned> parents;
-  std::vector<unsigned> roots;
-  for (;;) {
-    assert(is.good());
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-
-      if (child==streamID) {
-        roots.push_back(child);
-        while (id) {
-          roots.push_back(id);
-          std::map<unsigned, unsigned>::iterator it = parents.find(id);
-          assert(it!=parents.end());
-          id = it->second;
-        } 
-        break;
-      } else {
-        parents.insert(std::make_pair(child,id));
-      }
-    } else {
-      unsigned size = tag;
-      while (size--) is.get();
-    }
+  // Walk up the fork chain, remembering for each ancestor how many of its
+  // segments were written before the fork that leads to streamID.
+  std::vector<std::pair<TreeStreamID, unsigned>> roots;
+  unsigned limit = streams[streamID].segments.size();
+  for (TreeStreamID id = streamID; id; id = streams[id].parent) {
+    roots.emplace_back(id, limit);
+    limit = streams[id].parentSegments;
   }
   KLEE_DEBUG({
       llvm::errs() << "roots: ";
       for (size_t i = 0, e = roots.size(); i < e; ++i) {
-        llvm::errs() << roots[i] << " ";
+        llvm::errs() << roots[i].first << " ";
       }
       llvm::errs() << "\n";
     });
-  is.seekg(0, std::ios::beg);
-  for (;;) {
-    unsigned id;
-    unsigned tag;
-    is.read(reinterpret_cast<char*>(&id), 4);
-    is.read(reinterpret_cast<char*>(&tag), 4);
-    if (!is.good()) break;
-    if (tag&(1<<31)) { // fork
-      unsigned child = tag ^ (1<<31);
-      if (id==roots.back() && roots.size()>1 && child==roots[roots.size()-2])
-        roots.pop_back();
-    } else {
-      unsigned size = tag;
-      if (id==roots.back()) {
-        while (size--) out.push_back(is.get());
-      } else {
-        while (size--) is.get();
-      }
+
+  std::ifstream is(path.c_str(),
+                   std::ios::in | std::ios::binary);
+  assert(is.good());
+  for (auto it = roots.rbegin(), ie = roots.rend(); it != ie; ++it) {
+    const std::vector<Segment> &segments = streams[it->first].segments;
+    for (unsigned i = 0; i < it->second; ++i) {
+      const Segment &segment = segments[i];
+      std::size_t pos = out.size();
+      out.resize(pos + segment.size);
+      is.seekg(segment.offset, std::ios::beg);
+      is.read(reinterpret_cast<char*>(out.data() + pos), segment.size);
+      assert(is.good());
     }
-  }  
+  }
 }
 
 ///
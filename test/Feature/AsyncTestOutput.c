@@ -0,0 +1,28 @@
+// RUN: %clang %s -emit-llvm -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --async-test-output --async-test-output-queue=1 --write-cov --write-kqueries %t.bc 2>&1 | FileCheck %s
+// RUN: ls %t.klee-out/ | grep .ktest | wc -l | grep 8
+// RUN: ls %t.klee-out/ | grep .cov | wc -l | grep 8
+// RUN: ls %t.klee-out/ | grep .kquery | wc -l | grep 8
+// RUN: ls %t.klee-out/ | grep .err | wc -l | grep 1
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main() {
+  unsigned char x = klee_range(0, 8, "x");
+  switch (x) {
+  case 0: return 0;
+  case 1: return 1;
+  case 2: return 2;
+  case 3: return 3;
+  case 4: return 4;
+  case 5: return 5;
+  case 6: return 6;
+  default: assert(0 && "reached");
+  }
+}
+
+// CHECK: ASSERTION FAIL
+// CHECK: KLEE: done: generated tests = 8
@@ -0,0 +1,51 @@
+// Check that binary instruction level statistics convert to the same
+// callgrind output as the text format.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error --istats-format=binary --istats-write-interval=0s --istats-write-after-instructions=5 %t1.bc
+// RUN: not test -f %t.klee-out/run.istats
+// RUN: %klee-istats --list %t.klee-out/run.istats.bin | FileCheck --check-prefix=CHECK-LIST %s
+// RUN: %klee-istats %t.klee-out/run.istats.bin | FileCheck %s
+// RUN: %klee-istats --snapshot=1 %t.klee-out/run.istats.bin | FileCheck --check-prefix=CHECK-FIRST %s
+//
+// The same run in text format, without the pid and the timing columns
+// (Ireal, Itime, Rtime and Qtime)
+// RUN: rm -rf %t.text-out
+// RUN: %klee --output-dir=%t.text-out --exit-on-error --istats-format=text --istats-write-interval=0s --istats-write-after-instructions=5 %t1.bc
+// RUN: grep -v '^pid:' %t.text-out/run.istats | cut -d' ' -f1-4,7-8,10-14 > %t.text
+// RUN: %klee-istats %t.klee-out/run.istats.bin | grep -v '^pid:' | cut -d' ' -f1-4,7-8,10-14 > %t.binary
+// RUN: diff %t.text %t.binary
+
+// Every few instructions a snapshot is appended
+// CHECK-LIST: 1: {{.*}}s
+// CHECK-LIST: 2: {{.*}}s
+
+// CHECK: positions: instr line
+// CHECK: ob=assembly.ll
+// CHECK: fl={{.*}}test/Feature/BinaryIStats.c
+// CHECK-NEXT: fn=f0
+// CHECK-NEXT: {{[1-9][0-9]*}} {{[1-9][0-9]*}}
+
+// Earlier snapshots can be converted as well
+// CHECK-FIRST: positions: instr line
+// CHECK-FIRST: fn=f0
+
+int f0(int a, int b) {
+  return a + b;
+}
+
+int f1(int a, int b) {
+  // CHECK: fn=f1
+  // CHECK: cfn=f0
+  // CHECK-NEXT: calls=1 {{[1-9][0-9]*}}
+  // CHECK-NEXT: {{[1-9][0-9]*}} [[@LINE+1]] {{.*}}
+  return f0(a, b);
+}
+
+// CHECK: fn=main
+int main() {
+  int x = f1(1, 2);
+
+  return x;
+}
@@ -0,0 +1,29 @@
+// RUN: %clang %s -emit-llvm %O0opt -g -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-seed %t.unpacked %t.ktests
+// RUN: %klee --output-dir=%t.klee-out --write-ktest-archive --compress-ktest-archive %t.bc
+// RUN: not ls %t.klee-out/*.ktest
+// RUN: %ktest-tool %t.klee-out/tests.ktests | FileCheck --check-prefix=CHECK-TOOL %s
+// RUN: %ktest-tool --unpack %t.unpacked %t.klee-out/tests.ktests
+// RUN: ls %t.unpacked | grep .ktest | wc -l | grep 3
+// RUN: %ktest-tool --pack %t.ktests %t.unpacked/test000001.ktest %t.unpacked/test000002.ktest
+// RUN: %ktest-gen --archive %t.ktests --sym-stdin %s
+// RUN: %ktest-tool %t.ktests | grep -c "ktest file" | grep 3
+// RUN: %klee --output-dir=%t.klee-out-seed --seed-file=%t.klee-out/tests.ktests --only-seed %t.bc 2>&1 | FileCheck --check-prefix=CHECK-SEED %s
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x < 0)
+    return 1;
+  if (x > 100)
+    return 2;
+  return 0;
+}
+
+// CHECK-TOOL: ktest file : '{{.*}}tests.ktests:test000001'
+// CHECK-TOOL: name: 'x'
+// CHECK-TOOL: ktest file : '{{.*}}tests.ktests:test000002'
+// CHECK-TOOL: ktest file : '{{.*}}tests.ktests:test000003'
+// CHECK-SEED: using 3 seeds
@@ -0,0 +1,76 @@
+; REQUIRES: not-msan
+; MSan adds additional memory that overflows the counter
+;
+; Check that states are killed by their memory footprint when the memory cap
+; is exceeded: only the state that allocated 200 MB is killed (x == 0), while
+; the state that allocated nothing runs to completion.
+;
+; RUN: %llvmas %s -f -o %t1.bc
+; RUN: rm -rf %t.klee-out
+; RUN: %klee --output-dir=%t.klee-out --max-memory=20 %t1.bc > %t.log
+; RUN: FileCheck -input-file=%t.log %s
+; RUN: FileCheck -check-prefix=CHECK-WRN -input-file=%t.klee-out/warnings.txt %s
+; RUN: FileCheck -check-prefix=CHECK-EARLY -input-file=%t.klee-out/test000001.early %s
+; RUN: %ktest-tool %t.klee-out/test000001.ktest | FileCheck -check-prefix=CHECK-KILLED %s
+
+; CHECK-WRN: WARNING: killing 1 states (over memory cap
+; CHECK-EARLY: Memory limit exceeded.
+; CHECK-KILLED: object 0: int : 0
+; CHECK-NOT: BIG DONE
+; CHECK: SMALL DONE
+; CHECK-NOT: BIG DONE
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@.name = private unnamed_addr constant [2 x i8] c"x\00", align 1
+@.big = private unnamed_addr constant [10 x i8] c"BIG DONE\0A\00", align 1
+@.small = private unnamed_addr constant [12 x i8] c"SMALL DONE\0A\00", align 1
+@sink = global i64 0
+
+declare void @klee_make_symbolic(i8*, i64, i8*)
+declare i8* @malloc(i64)
+declare i32 @printf(i8*, ...)
+
+; Burns `n` iterations so that the periodic memory check runs in between.
+define void @spin(i64 %n) {
+entry:
+  br label %loop
+loop:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %loop ]
+  store volatile i64 %j, i64* @sink
+  %j.next = add i64 %j, 1
+  %done = icmp eq i64 %j.next, %n
+  br i1 %done, label %exit, label %loop
+exit:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  %x = alloca i32, align 4
+  %xp = bitcast i32* %x to i8*
+  call void @klee_make_symbolic(i8* %xp, i64 4, i8* getelementptr ([2 x i8], [2 x i8]* @.name, i64 0, i64 0))
+  %xv = load i32, i32* %x, align 4
+  %isbig = icmp eq i32 %xv, 0
+  br i1 %isbig, label %big, label %small
+
+; allocates 200 MB in 1 MB chunks
+big:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %big ]
+  %p = call i8* @malloc(i64 1048576)
+  store i8 1, i8* %p, align 1
+  call void @spin(i64 1000)
+  %i.next = add i64 %i, 1
+  %big.done = icmp eq i64 %i.next, 200
+  br i1 %big.done, label %big.exit, label %big
+big.exit:
+  %0 = call i32 (i8*, ...) @printf(i8* getelementptr ([10 x i8], [10 x i8]* @.big, i64 0, i64 0))
+  ret i32 0
+
+; allocates nothing, but runs for as long as the big state
+small:
+  call void @spin(i64 1000000)
+  %1 = call i32 (i8*, ...) @printf(i8* getelementptr ([12 x i8], [12 x i8]* @.small, i64 0, i64 0))
+  ret i32 0
+}
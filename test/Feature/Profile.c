@@ -0,0 +1,28 @@
+// Check that --profile writes a folded-stack file and a summary table.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --profile=zones %t1.bc
+// RUN: FileCheck --check-prefix=CHECK-FOLDED --input-file=%t.klee-out/profile.folded %s
+// RUN: FileCheck --check-prefix=CHECK-SUMMARY --input-file=%t.klee-out/profile.txt %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc
+// RUN: not test -f %t.klee-out/profile.folded
+
+// CHECK-FOLDED-DAG: {{^}}Executor::run;Executor::executeInstruction/br;Executor::fork;{{.*}} {{[0-9]+$}}
+// CHECK-FOLDED-DAG: {{^}}Executor::run;Searcher::selectState {{[0-9]+$}}
+
+// CHECK-SUMMARY: Mode: zones
+// CHECK-SUMMARY: Zone Calls Self(%) Self(ms) Incl(%) Incl(ms)
+// CHECK-SUMMARY-DAG: {{^}}Executor::run 1 {{.*}}%
+// CHECK-SUMMARY-DAG: {{^}}Executor::fork {{[1-9][0-9]*}} {{.*}}%
+
+#include "klee/klee.h"
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  if (x > 10)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,32 @@
+// Check that --solver-layer-stats records per-layer statistics in run.stats,
+// and that klee-stats prints them. The core solver answers all queries itself,
+// so no hits are recorded for it.
+//
+// RUN: %clang %s -emit-llvm -g %O0opt -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --solver-layer-stats %t1.bc
+// RUN: %sqlite3 -separator ' ' %t.klee-out/run.stats "SELECT SolverIndependentQueries >= SolverCoreQueries, SolverCoreQueries > 0, SolverCoreHits = 0, SolverCoreP99 >= SolverCoreP50 FROM stats ORDER BY rowid DESC LIMIT 1" | FileCheck %s
+// RUN: %klee-stats --print-solver-layers --table-format=csv %t.klee-out | FileCheck --check-prefix=CHECK-LAYERS %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --drop-unprofitable-solver-layers --solver-layer-window=1 %t1.bc 2>&1 | FileCheck --check-prefix=CHECK-DROP %s
+
+// CHECK: 1 1 1 1
+// CHECK-LAYERS: Path,Time(s),TSolver(%),QIndep,HitIndep(%),P50Indep(us),P99Indep(us),QCache,HitCache(%),P50Cache(us),P99Cache(us),QCexCache,HitCexCache(%),P50CexCache(us),P99CexCache(us),QFastCex,HitFastCex(%),P50FastCex(us),P99FastCex(us),QCore,P50Core(us),P99Core(us)
+// CHECK-LAYERS-NEXT: klee-out,{{[0-9.]+}},{{[0-9.]+}},{{[1-9][0-9]*}},{{([0-9.]+,)+}}{{[1-9][0-9]*}},{{[0-9.]+}},{{[0-9.]+}}{{$}}
+// CHECK-DROP: KLEE: Bypassing the {{[A-Za-z]+}} solver layer: 0 hits in 1 queries
+// CHECK-DROP: KLEE: done: completed paths = 4
+
+#include "klee/klee.h"
+
+volatile int g;
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof(x), "x");
+  klee_make_symbolic(&y, sizeof(y), "y");
+  if (x > 10)
+    x = 1;
+  if (y < x)
+    g = 1;
+  return 0;
+}
@@ -26,23 +26,43 @@
 
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Signals.h"
 
+#include <poll.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 using namespace llvm;
 using namespace klee;
 using namespace klee::expr;
 
 namespace {
-llvm::cl::opt<std::string> InputFile(llvm::cl::desc("<input query log>"),
-                                     llvm::cl::Positional, llvm::cl::init("-"),
-                                     llvm::cl::cat(klee::ExprCat));
+llvm::cl::list<std::string> InputFiles(llvm::cl::desc("<input query logs>"),
+                                      llvm::cl::Positional,
+                                      llvm::cl::ZeroOrMore,
+                                      llvm::cl::cat(klee::ExprCat));
 
 enum ToolActions { PrintTokens, PrintAST, PrintSMTLIBv2, Evaluate };
 
@@ -61,7 +81,8 @@ static llvm::cl::opt<ToolActions> ToolAction(
 enum BuilderKinds {
   DefaultBuilder,
   ConstantFoldingBuilder,
-  SimplifyingBuilder
+  SimplifyingBuilder,
+  WordLevelBuilder
 };
 
 static llvm::cl::opt<BuilderKinds> BuilderKind(
@@ -72,7 +93,10 @@ static llvm::cl::opt<BuilderKinds> BuilderKind(
                      clEnumValN(ConstantFoldingBuilder, "constant-folding",
                                 "Fold constant expressions."),
                      clEnumValN(SimplifyingBuilder, "simplify",
-                                "Fold constants and simplify expressions.")),
+                                "Fold constants and simplify expressions."),
+                     clEnumValN(WordLevelBuilder, "word-level",
+                                "Fold constants and simplify expressions at "
+                                "the level of words and value ranges.")),
     llvm::cl::cat(klee::ExprCat));
 
 llvm::cl::opt<std::string> DirectoryToWriteQueryLogs(
@@ -86,9 +110,87 @@ llvm::cl::opt<bool> ClearArrayAfterQuery(
     llvm::cl::desc("Discard the previous array declarations after a query "
                    "is performed (default=false)"),
     llvm::cl::init(false), llvm::cl::cat(klee::ExprCat));
+
+llvm::cl::opt<unsigned> Jobs(
+    "jobs",
+    llvm::cl::desc("Number of worker processes that evaluate queries in "
+                   "parallel, each with its own solver chain; 0 uses one per "
+                   "CPU. Results are printed in input order, but "
+                   "counterexamples may differ from a sequential run, as "
+                   "each worker only caches those of the queries it "
+                   "evaluates (default=1)"),
+    llvm::cl::init(1), llvm::cl::cat(klee::SolvingCat));
+
+llvm::cl::opt<std::string> QueryTimesFile(
+    "query-times",
+    llvm::cl::desc("Write the result and solving time of every evaluated "
+                   "query as CSV to the given file (default=off)"),
+    llvm::cl::init(""), llvm::cl::cat(klee::SolvingCat));
+
+/// An input query log, kept in memory (or mapped) for the whole run
+struct Input {
+  std::string name;
+  std::unique_ptr<MemoryBuffer> buffer;
+};
+
+enum class QueryStatus : std::uint8_t { Valid, Invalid, Failed };
+
+const char *getQueryStatusName(QueryStatus status) {
+  switch (status) {
+  case QueryStatus::Valid:
+    return "VALID";
+  case QueryStatus::Invalid:
+    return "INVALID";
+  case QueryStatus::Failed:
+    return "FAIL";
+  }
+  return "";
+}
+
+enum class QueryKind : std::uint8_t { Truth, Value, InitialValues };
+
+const char *getQueryKindName(QueryKind kind) {
+  switch (kind) {
+  case QueryKind::Truth:
+    return "Truth";
+  case QueryKind::Value:
+    return "Value";
+  case QueryKind::InitialValues:
+    return "InitialValues";
+  }
+  return "";
+}
+
+/// Describes one evaluated query; sent from workers to the parent process
+/// followed by `length` bytes of output text
+struct QueryRecord {
+  /// Position of the query among all queries of all inputs
+  std::uint64_t index;
+  std::uint64_t nanoseconds;
+  std::uint32_t file;
+  /// Position of the query within its input
+  std::uint32_t query;
+  std::uint32_t length;
+  QueryKind kind;
+  QueryStatus status;
+};
+
+/// Solver statistics printed after evaluation, summed over all workers
+struct QuerySummary {
+  std::uint64_t queries = 0;
+  std::uint64_t queryConstructs = 0;
+  std::uint64_t valid = 0;
+  std::uint64_t invalid = 0;
+  std::uint64_t cex = 0;
+};
+
+/// Record index that marks the final QuerySummary of a worker
+constexpr std::uint64_t SummaryIndex = ~std::uint64_t(0);
+/// Record index that marks the diagnostics of parse errors in `file`
+constexpr std::uint64_t ParseErrorIndex = SummaryIndex - 1;
 } // namespace
 
-static std::string getQueryLogPath(const char filename[])
+static std::string getQueryLogPath(const char filename[], unsigned worker)
 {
 	//check directoryToWriteLogs exists
 	struct stat s;
@@ -115,6 +217,9 @@ static std::string getQueryLogPath(const char filename[])
 	std::string path = DirectoryToWriteQueryLogs;
 	path += "/";
 	path += filename;
+	// parallel workers must not share log files
+	if (Jobs != 1)
+	  path.insert(path.rfind('.'), "." + std::to_string(worker));
 	return path;
 }
 
@@ -180,133 +285,599 @@ static bool PrintInputAST(const char *Filename,
   return success;
 }
 
-static bool EvaluateInputAST(const char *Filename,
-                             const MemoryBuffer *MB,
+static std::unique_ptr<Solver> createSolver(unsigned worker) {
+  std::unique_ptr<Solver> coreSolver = klee::createCoreSolver(CoreSolverToUse);
+
+  if (CoreSolverToUse != DUMMY_SOLVER) {
+    const time::Span maxCoreSolverTime(MaxCoreSolverTime);
+    if (maxCoreSolverTime) {
+      coreSolver->setCoreSolverTimeout(maxCoreSolverTime);
+    }
+  }
+
+  return constructSolverChain(
+      std::move(coreSolver),
+      getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME, worker),
+      getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME, worker),
+      getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME, worker),
+      getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME, worker),
+      getQueryLogPath(ALL_QUERIES_BINARY_FILE_NAME, worker),
+      getQueryLogPath(SOLVER_QUERIES_BINARY_FILE_NAME, worker));
+}
+
+/// Parses the inputs one declaration at a time and calls `onQuery(index,
+/// file, query, command)` for every query command without parse errors,
+/// until it returns false. Query commands are freed as soon as they have
+/// been handled, and array declarations once the parser forgets them, so
+/// memory use does not grow with the number of queries in the inputs.
+/// Queries for which `skipQuery(index)` holds are skipped without being
+/// parsed, so neither they nor their parse errors are seen. Diagnostics are
+/// passed to `onErrors(file, diagnostics)` instead of being printed.
+/// Returns the number of parse errors.
+template <typename SkipQuery, typename OnQuery, typename OnErrors>
+static unsigned forEachQuery(const std::vector<Input> &inputs,
+                             ExprBuilder *Builder, SkipQuery &&skipQuery,
+                             OnQuery &&onQuery, OnErrors &&onErrors) {
+  std::uint64_t index = 0;
+  unsigned errors = 0;
+  std::string diagnostics;
+  llvm::raw_string_ostream os(diagnostics);
+  for (unsigned file = 0; file < inputs.size(); ++file) {
+    const Input &input = inputs[file];
+    std::unique_ptr<Parser> P(Parser::Create(
+        input.name, input.buffer.get(), Builder, ClearArrayAfterQuery));
+    P->SetMaxErrors(0);
+    P->SetDiagnosticStream(os);
+    auto reportErrors = [&]() {
+      os.flush();
+      if (diagnostics.empty())
+        return;
+      onErrors(file, llvm::StringRef(diagnostics));
+      diagnostics.clear();
+    };
+
+    // the parser refers to the array declarations until they are cleared
+    std::vector<std::unique_ptr<Decl>> arrays;
+    unsigned query = 0;
+    bool stop = false;
+    while (!stop) {
+      if (skipQuery(index) && P->SkipQueryCommand()) {
+        reportErrors();
+        ++index;
+        ++query;
+        if (ClearArrayAfterQuery)
+          arrays.clear();
+        continue;
+      }
+      const unsigned before = P->GetNumErrors();
+      Decl *D = P->ParseTopLevelDecl();
+      reportErrors();
+      if (!D)
+        break;
+      std::unique_ptr<Decl> decl(D);
+      QueryCommand *QC = dyn_cast<QueryCommand>(D);
+      if (!QC) {
+        arrays.push_back(std::move(decl));
+        continue;
+      }
+      if (P->GetNumErrors() == before && !onQuery(index, file, query, *QC))
+        stop = true;
+      ++index;
+      ++query;
+      if (ClearArrayAfterQuery)
+        arrays.clear();
+    }
+    errors += P->GetNumErrors();
+    if (stop)
+      break;
+  }
+  return errors;
+}
+
+namespace {
+/// Collects the diagnostics of parse errors and prints them ordered by their
+/// position. Workers may report a diagnostic more than once, as all of them
+/// parse the array declarations and a query with errors can throw the
+/// parser off the query boundaries.
+class ParseErrors {
+  const std::vector<Input> &inputs;
+  /// Diagnostics of every input by line and column
+  std::vector<std::set<std::tuple<unsigned, unsigned, std::string>>>
+      diagnostics;
+
+  /// Number of diagnostics printed per input
+  static constexpr unsigned MaxPrintedErrors = 19;
+
+public:
+  explicit ParseErrors(const std::vector<Input> &inputs)
+      : inputs(inputs), diagnostics(inputs.size()) {}
+
+  bool empty() const {
+    for (const auto &file : diagnostics)
+      if (!file.empty())
+        return false;
+    return true;
+  }
+
+  /// Adds the diagnostics printed by the parser of `file`, each of which
+  /// starts with a "<name>:<line>:<column>: error: " line
+  void add(unsigned file, llvm::StringRef text) {
+    const std::string &name = inputs[file].name;
+    std::tuple<unsigned, unsigned, std::string> current;
+    bool started = false;
+    while (!text.empty()) {
+      llvm::StringRef line;
+      std::tie(line, text) = text.split('\n');
+      unsigned lineNo, column;
+      llvm::StringRef rest = line;
+      if (rest.consume_front(name) && rest.consume_front(":") &&
+          !rest.consumeInteger(10, lineNo) && rest.consume_front(":") &&
+          !rest.consumeInteger(10, column) && rest.startswith(": error: ")) {
+        if (started)
+          diagnostics[file].insert(std::move(current));
+        current = std::make_tuple(lineNo, column, std::string());
+        started = true;
+      }
+      if (started)
+        (std::get<2>(current) += line) += '\n';
+    }
+    if (started)
+      diagnostics[file].insert(std::move(current));
+  }
+
+  void print() const {
+    for (unsigned file = 0; file < inputs.size(); ++file) {
+      if (diagnostics[file].empty())
+        continue;
+      unsigned printed = 0;
+      for (const auto &diagnostic : diagnostics[file])
+        if (printed++ < MaxPrintedErrors)
+          llvm::errs() << std::get<2>(diagnostic);
+      llvm::errs() << inputs[file].name
+                   << ": parse failure: " << diagnostics[file].size()
+                   << " errors.\n";
+    }
+  }
+};
+} // namespace
+
+static QueryKind getQueryKind(const QueryCommand &QC) {
+  if (QC.Values.empty() && QC.Objects.empty())
+    return QueryKind::Truth;
+  return QC.Values.empty() ? QueryKind::InitialValues : QueryKind::Value;
+}
+
+/// Evaluates `QC` with `S` and prints the result (without the leading
+/// "Query N:" and the trailing newline) to `os`
+static QueryStatus evaluateQuery(Solver &S, const QueryCommand &QC,
+                                 llvm::raw_ostream &os) {
+  assert("FIXME: Support counterexample query commands!");
+  switch (getQueryKind(QC)) {
+  case QueryKind::Truth: {
+    bool result;
+    if (S.mustBeTrue(Query(ConstraintSet(QC.Constraints), QC.Query), result)) {
+      os << (result ? "VALID" : "INVALID");
+      return result ? QueryStatus::Valid : QueryStatus::Invalid;
+    }
+    os << "FAIL (reason: "
+       << SolverImpl::getOperationStatusString(
+              S.impl->getOperationStatusCode())
+       << ")";
+    return QueryStatus::Failed;
+  }
+  case QueryKind::Value: {
+    assert(QC.Objects.empty() &&
+           "FIXME: Support counterexamples for values and objects!");
+    assert(QC.Values.size() == 1 &&
+           "FIXME: Support counterexamples for multiple values!");
+    assert(QC.Query->isFalse() &&
+           "FIXME: Support counterexamples with non-trivial query!");
+    ref<ConstantExpr> result;
+    if (S.getValue(Query(ConstraintSet(QC.Constraints), QC.Values[0]),
+                   result)) {
+      os << "INVALID\n";
+      os << "\tExpr 0:\t" << result;
+      return QueryStatus::Invalid;
+    }
+    os << "FAIL (reason: "
+       << SolverImpl::getOperationStatusString(
+              S.impl->getOperationStatusCode())
+       << ")";
+    return QueryStatus::Failed;
+  }
+  case QueryKind::InitialValues: {
+    std::vector<std::vector<unsigned char>> result;
+    if (S.getInitialValues(Query(ConstraintSet(QC.Constraints), QC.Query),
+                           QC.Objects, result)) {
+      os << "INVALID\n";
+
+      for (unsigned i = 0, e = result.size(); i != e; ++i) {
+        os << "\tArray " << i << ":\t" << QC.Objects[i]->name << "[";
+        for (unsigned j = 0; j != QC.Objects[i]->size; ++j) {
+          os << (unsigned)result[i][j];
+          if (j + 1 != QC.Objects[i]->size)
+            os << ", ";
+        }
+        os << "]";
+        if (i + 1 != e)
+          os << "\n";
+      }
+      return QueryStatus::Invalid;
+    }
+    SolverImpl::SolverRunStatus retCode = S.impl->getOperationStatusCode();
+    if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
+      os << " FAIL (reason: " << SolverImpl::getOperationStatusString(retCode)
+         << ")";
+      return QueryStatus::Failed;
+    }
+    os << "VALID (counterexample request ignored)";
+    return QueryStatus::Valid;
+  }
+  }
+  return QueryStatus::Failed;
+}
+
+/// Evaluates a query, measuring the time it takes
+static QueryRecord evaluateQuery(Solver &S, std::uint64_t index, unsigned file,
+                                 unsigned query, const QueryCommand &QC,
+                                 std::string &output) {
+  output.clear();
+  llvm::raw_string_ostream os(output);
+  const auto start = std::chrono::steady_clock::now();
+  const QueryStatus status = evaluateQuery(S, QC, os);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  os.flush();
+
+  QueryRecord record{};
+  record.index = index;
+  record.nanoseconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  record.file = file;
+  record.query = query;
+  record.length = output.size();
+  record.kind = getQueryKind(QC);
+  record.status = status;
+  return record;
+}
+
+static QuerySummary getQuerySummary() {
+  QuerySummary summary;
+  summary.queries = *theStatisticManager->getStatisticByName("SolverQueries");
+  summary.queryConstructs =
+      *theStatisticManager->getStatisticByName("QueryConstructs");
+  summary.valid = *theStatisticManager->getStatisticByName("QueriesValid");
+  summary.invalid = *theStatisticManager->getStatisticByName("QueriesInvalid");
+  summary.cex = *theStatisticManager->getStatisticByName("QueriesCEX");
+  return summary;
+}
+
+namespace {
+/// Prints evaluated queries in input order, and their timing as CSV
+class ResultPrinter {
+  const std::vector<Input> &inputs;
+  std::unique_ptr<llvm::raw_fd_ostream> csv;
+  unsigned lastFile = ~0u;
+
+public:
+  explicit ResultPrinter(const std::vector<Input> &inputs) : inputs(inputs) {}
+
+  bool open() {
+    if (QueryTimesFile.empty())
+      return true;
+    std::error_code ec;
+    csv = std::make_unique<llvm::raw_fd_ostream>(QueryTimesFile, ec,
+                                                 llvm::sys::fs::OF_Text);
+    if (ec) {
+      llvm::errs() << "Unable to open " << QueryTimesFile << ": "
+                   << ec.message() << "\n";
+      return false;
+    }
+    *csv << "File,Query,Kind,Result,Time(us)\n";
+    return true;
+  }
+
+  void print(const QueryRecord &record, llvm::StringRef output) {
+    if (inputs.size() > 1 && record.file != lastFile)
+      llvm::outs() << inputs[record.file].name << ":\n";
+    lastFile = record.file;
+    llvm::outs() << "Query " << record.query << ":\t" << output << "\n";
+
+    if (csv)
+      *csv << inputs[record.file].name << ',' << record.query << ','
+           << getQueryKindName(record.kind) << ','
+           << getQueryStatusName(record.status) << ','
+           << llvm::format("%.3f", record.nanoseconds / 1000.0) << '\n';
+  }
+
+  static void printSummary(const QuerySummary &summary) {
+    if (!summary.queries)
+      return;
+    llvm::outs() << "--\n"
+                 << "total queries = " << summary.queries << '\n'
+                 << "total query constructs = " << summary.queryConstructs
+                 << '\n'
+                 << "valid queries = " << summary.valid << '\n'
+                 << "invalid queries = " << summary.invalid << '\n'
+                 << "query cex = " << summary.cex << '\n';
+  }
+};
+} // namespace
+
+/// Evaluates the queries of all inputs and prints the results in input
+/// order. Nothing is printed (or evaluated after the first one) if there are
+/// parse errors.
+static bool EvaluateInputAST(const std::vector<Input> &inputs,
                              ExprBuilder *Builder) {
-  std::vector<Decl*> Decls;
-  Parser *P = Parser::Create(Filename, MB, Builder, ClearArrayAfterQuery);
-  P->SetMaxErrors(20);
-  while (Decl *D = P->ParseTopLevelDecl()) {
-    Decls.push_back(D);
+  ResultPrinter printer(inputs);
+  if (!printer.open())
+    return false;
+
+  std::unique_ptr<Solver> S = createSolver(0);
+  ParseErrors errors(inputs);
+  std::vector<std::pair<QueryRecord, std::string>> results;
+  forEachQuery(
+      inputs, Builder, [](std::uint64_t) { return false; },
+      [&](std::uint64_t index, unsigned file, unsigned query,
+          const QueryCommand &QC) {
+        if (!errors.empty())
+          return true;
+        std::string output;
+        const QueryRecord record =
+            evaluateQuery(*S, index, file, query, QC, output);
+        results.emplace_back(record, std::move(output));
+        return true;
+      },
+      [&](unsigned file, llvm::StringRef diagnostics) {
+        errors.add(file, diagnostics);
+      });
+
+  if (!errors.empty()) {
+    errors.print();
+    return false;
   }
+  for (const auto &result : results)
+    printer.print(result.first, result.second);
+  ResultPrinter::printSummary(getQuerySummary());
+  return true;
+}
+
+static bool writeAll(int fd, const void *data, std::size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size) {
+    const ssize_t written = ::write(fd, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+namespace {
+/// State shared by the worker processes
+struct SharedState {
+  /// Index of the next query to be claimed
+  std::atomic<std::uint64_t> next{0};
+  /// Set once a worker has found a parse error
+  std::atomic<bool> failed{false};
+};
+} // namespace
 
+/// Body of a worker process: claims the next unevaluated query from the
+/// shared counter, skips ahead to it and sends the result through `fd`.
+/// Every worker reads all inputs itself, which keeps the expressions of
+/// different workers (and their non-atomic reference counts) disjoint, but
+/// only parses the array declarations and the queries it claims, and sends
+/// the diagnostics of their parse errors.
+///
+/// Once any worker has found a parse error, nothing is evaluated anymore and
+/// every worker parses all remaining queries, as a query with errors may
+/// throw the counting of queries off. All parse errors are thus reported by
+/// some worker.
+///
+/// Which worker evaluates a query depends on timing. As every worker has its
+/// own counterexample cache, the counterexamples printed for a query may
+/// thus differ between runs and from a sequential run.
+static bool runWorker(unsigned worker, int fd, SharedState &shared,
+                      const std::vector<Input> &inputs, ExprBuilder *Builder) {
+  std::unique_ptr<Solver> S = createSolver(worker);
+  std::string output;
+  std::uint64_t claimed = shared.next.fetch_add(1);
   bool success = true;
-  if (unsigned N = P->GetNumErrors()) {
-    llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
-    success = false;
-  }  
+  forEachQuery(
+      inputs, Builder,
+      [&](std::uint64_t index) {
+        return index != claimed && !shared.failed;
+      },
+      [&](std::uint64_t index, unsigned file, unsigned query,
+          const QueryCommand &QC) {
+        if (index != claimed)
+          return true;
+        if (!shared.failed) {
+          const QueryRecord record =
+              evaluateQuery(*S, index, file, query, QC, output);
+          success = writeAll(fd, &record, sizeof(record)) &&
+                    writeAll(fd, output.data(), output.size());
+        }
+        claimed = shared.next.fetch_add(1);
+        return success;
+      },
+      [&](unsigned file, llvm::StringRef diagnostics) {
+        shared.failed = true;
+        QueryRecord record{};
+        record.index = ParseErrorIndex;
+        record.file = file;
+        record.length = diagnostics.size();
+        success = success && writeAll(fd, &record, sizeof(record)) &&
+                  writeAll(fd, diagnostics.data(), diagnostics.size());
+      });
+
+  const QuerySummary summary = getQuerySummary();
+  QueryRecord record{};
+  record.index = SummaryIndex;
+  record.length = sizeof(summary);
+  return success && writeAll(fd, &record, sizeof(record)) &&
+         writeAll(fd, &summary, sizeof(summary));
+}
 
-  if (!success)
+namespace {
+struct Worker {
+  pid_t pid;
+  int fd;
+  /// Received bytes that do not form a complete record yet
+  std::string buffer;
+};
+} // namespace
+
+/// Evaluates the queries of all inputs in `Jobs` worker processes and prints
+/// the results in input order, or only the parse errors if there are any.
+/// Processes rather than threads are used since expressions, statistics and
+/// the expression allocator are not thread-safe.
+static bool EvaluateInParallel(const std::vector<Input> &inputs,
+                               ExprBuilder *Builder) {
+  ResultPrinter printer(inputs);
+  if (!printer.open())
     return false;
 
-  std::unique_ptr<Solver> coreSolver = klee::createCoreSolver(CoreSolverToUse);
+  void *shared = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED) {
+    llvm::errs() << "Unable to map shared memory: " << strerror(errno) << "\n";
+    return false;
+  }
+  auto *state = new (shared) SharedState();
 
-  if (CoreSolverToUse != DUMMY_SOLVER) {
-    const time::Span maxCoreSolverTime(MaxCoreSolverTime);
-    if (maxCoreSolverTime) {
-      coreSolver->setCoreSolverTimeout(maxCoreSolverTime);
+  const unsigned jobs =
+      Jobs ? Jobs.getValue()
+           : std::max(1u, std::thread::hardware_concurrency());
+  llvm::outs().flush();
+  llvm::errs().flush();
+
+  std::vector<Worker> workers;
+  for (unsigned w = 0; w < jobs; ++w) {
+    int fds[2];
+    if (pipe(fds)) {
+      llvm::errs() << "Unable to create pipe: " << strerror(errno) << "\n";
+      break;
+    }
+    const pid_t pid = fork();
+    if (pid < 0) {
+      llvm::errs() << "Unable to fork worker: " << strerror(errno) << "\n";
+      close(fds[0]);
+      close(fds[1]);
+      break;
     }
+    if (pid == 0) {
+      close(fds[0]);
+      for (const Worker &other : workers)
+        close(other.fd);
+      const bool success = runWorker(w, fds[1], *state, inputs, Builder);
+      llvm::errs().flush();
+      _exit(success ? 0 : 1);
+    }
+    close(fds[1]);
+    workers.push_back({pid, fds[0], {}});
   }
 
-  std::unique_ptr<Solver> S = constructSolverChain(
-      std::move(coreSolver), getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
-      getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
-      getQueryLogPath(ALL_QUERIES_KQUERY_FILE_NAME),
-      getQueryLogPath(SOLVER_QUERIES_KQUERY_FILE_NAME));
+  std::map<std::uint64_t, std::pair<QueryRecord, std::string>> pending;
+  std::uint64_t nextIndex = 0;
+  // results are only printed once it is clear there are no parse errors
+  std::vector<std::pair<QueryRecord, std::string>> results;
+  ParseErrors errors(inputs);
+  QuerySummary summary;
+  bool success = !workers.empty();
 
-  unsigned Index = 0;
-  for (std::vector<Decl*>::iterator it = Decls.begin(),
-         ie = Decls.end(); it != ie; ++it) {
-    Decl *D = *it;
-    if (QueryCommand *QC = dyn_cast<QueryCommand>(D)) {
-      llvm::outs() << "Query " << Index << ":\t";
-
-      assert("FIXME: Support counterexample query commands!");
-      if (QC->Values.empty() && QC->Objects.empty()) {
-        bool result;
-        if (S->mustBeTrue(Query(ConstraintSet(QC->Constraints), QC->Query),
-                          result)) {
-          llvm::outs() << (result ? "VALID" : "INVALID");
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else if (!QC->Values.empty()) {
-        assert(QC->Objects.empty() && 
-               "FIXME: Support counterexamples for values and objects!");
-        assert(QC->Values.size() == 1 &&
-               "FIXME: Support counterexamples for multiple values!");
-        assert(QC->Query->isFalse() &&
-               "FIXME: Support counterexamples with non-trivial query!");
-        ref<ConstantExpr> result;
-        if (S->getValue(Query(ConstraintSet(QC->Constraints), QC->Values[0]),
-                        result)) {
-          llvm::outs() << "INVALID\n";
-          llvm::outs() << "\tExpr 0:\t" << result;
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
+  // read records until every worker has closed its pipe
+  std::vector<pollfd> fds;
+  for (const Worker &worker : workers)
+    fds.push_back({worker.fd, POLLIN, 0});
+  unsigned open = workers.size();
+  char chunk[1 << 16];
+  while (open) {
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      llvm::errs() << "poll failed: " << strerror(errno) << "\n";
+      success = false;
+      break;
+    }
+    for (unsigned w = 0; w < workers.size(); ++w) {
+      if (fds[w].fd < 0 || !fds[w].revents)
+        continue;
+      const ssize_t n = read(fds[w].fd, chunk, sizeof(chunk));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        close(fds[w].fd);
+        fds[w].fd = -1;
+        --open;
+        continue;
+      }
+
+      std::string &buffer = workers[w].buffer;
+      buffer.append(chunk, n);
+      std::size_t offset = 0;
+      while (buffer.size() - offset >= sizeof(QueryRecord)) {
+        QueryRecord record;
+        std::memcpy(&record, buffer.data() + offset, sizeof(record));
+        if (buffer.size() - offset - sizeof(record) < record.length)
+          break;
+        const char *payload = buffer.data() + offset + sizeof(record);
+        offset += sizeof(record) + record.length;
+
+        if (record.index == SummaryIndex) {
+          QuerySummary part;
+          std::memcpy(&part, payload, sizeof(part));
+          summary.queries += part.queries;
+          summary.queryConstructs += part.queryConstructs;
+          summary.valid += part.valid;
+          summary.invalid += part.invalid;
+          summary.cex += part.cex;
+          continue;
         }
-      } else {
-        std::vector< std::vector<unsigned char> > result;
-
-        if (S->getInitialValues(
-                Query(ConstraintSet(QC->Constraints), QC->Query), QC->Objects,
-                result)) {
-          llvm::outs() << "INVALID\n";
-
-          for (unsigned i = 0, e = result.size(); i != e; ++i) {
-            llvm::outs() << "\tArray " << i << ":\t"
-                       << QC->Objects[i]->name
-                       << "[";
-            for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
-              llvm::outs() << (unsigned) result[i][j];
-              if (j + 1 != QC->Objects[i]->size)
-                llvm::outs() << ", ";
-            }
-            llvm::outs() << "]";
-            if (i + 1 != e)
-              llvm::outs() << "\n";
-          }
-        } else {
-          SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
-          if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
-            llvm::outs() << " FAIL (reason: "
-                      << SolverImpl::getOperationStatusString(retCode)
-                      << ")";
-          }           
-          else {
-            llvm::outs() << "VALID (counterexample request ignored)";
-          }
+        if (record.index == ParseErrorIndex) {
+          errors.add(record.file, llvm::StringRef(payload, record.length));
+          continue;
         }
+        pending.emplace(record.index,
+                        std::make_pair(record,
+                                       std::string(payload, record.length)));
       }
+      buffer.erase(0, offset);
 
-      llvm::outs() << "\n";
-      ++Index;
+      for (auto it = pending.begin();
+           it != pending.end() && it->first == nextIndex;
+           it = pending.erase(it), ++nextIndex)
+        results.push_back(std::move(it->second));
     }
   }
 
-  for (std::vector<Decl*>::iterator it = Decls.begin(),
-         ie = Decls.end(); it != ie; ++it)
-    delete *it;
-  delete P;
-
-  if (uint64_t queries = *theStatisticManager->getStatisticByName("SolverQueries")) {
-    llvm::outs()
-      << "--\n"
-      << "total queries = " << queries << '\n'
-      << "total query constructs = "
-      << *theStatisticManager->getStatisticByName("QueryConstructs") << '\n'
-      << "valid queries = " 
-      << *theStatisticManager->getStatisticByName("QueriesValid") << '\n'
-      << "invalid queries = " 
-      << *theStatisticManager->getStatisticByName("QueriesInvalid") << '\n'
-      << "query cex = " 
-      << *theStatisticManager->getStatisticByName("QueriesCEX") << '\n';
+  for (const Worker &worker : workers) {
+    int status;
+    while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR)
+      ;
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+      llvm::errs() << "Worker process " << worker.pid
+                   << " terminated abnormally\n";
+      success = false;
+    }
   }
+  munmap(shared, sizeof(SharedState));
 
+  if (!errors.empty()) {
+    errors.print();
+    return false;
+  }
+  if (!pending.empty()) {
+    llvm::errs() << "Missing result for query " << nextIndex << "\n";
+    success = false;
+  }
+  for (const auto &result : results)
+    printer.print(result.first, result.second);
+  ResultPrinter::printSummary(summary);
   return success;
 }
 
@@ -391,15 +962,23 @@ int main(int argc, char **argv) {
   llvm::cl::ParseCommandLineOptions(argc, argv);
 
   std::string ErrorStr;
-  
-  auto MBResult = MemoryBuffer::getFileOrSTDIN(InputFile.c_str());
-  if (!MBResult) {
-    llvm::errs() << argv[0] << ": error: " << MBResult.getError().message()
-                 << "\n";
-    return 1;
+
+  if (InputFiles.empty())
+    InputFiles.push_back("-");
+  std::vector<Input> Inputs;
+  for (const std::string &InputFile : InputFiles) {
+    // inputs are never modified, so large ones are mapped rather than read
+    auto MBResult = MemoryBuffer::getFileOrSTDIN(
+        InputFile.c_str(), /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!MBResult) {
+      llvm::errs() << argv[0] << ": error: " << MBResult.getError().message()
+                   << "\n";
+      return 1;
+    }
+    Inputs.push_back({InputFile == "-" ? "<stdin>" : InputFile,
+                      std::move(*MBResult)});
   }
-  std::unique_ptr<MemoryBuffer> &MB = *MBResult;
-  
+
   ExprBuilder *Builder = 0;
   switch (BuilderKind) {
   case DefaultBuilder:
@@ -414,23 +993,31 @@ int main(int argc, char **argv) {
     Builder = createConstantFoldingExprBuilder(Builder);
     Builder = createSimplifyingExprBuilder(Builder);
     break;
+  case WordLevelBuilder:
+    Builder = createDefaultExprBuilder();
+    Builder = createConstantFoldingExprBuilder(Builder);
+    Builder = createWordLevelExprBuilder(Builder);
+    Builder = createSimplifyingExprBuilder(Builder);
+    break;
   }
   exprBuilder = Builder;
 
   switch (ToolAction) {
   case PrintTokens:
-    PrintInputTokens(MB.get());
+    for (const Input &I : Inputs)
+      PrintInputTokens(I.buffer.get());
     break;
   case PrintAST:
-    success = PrintInputAST(InputFile=="-" ? "<stdin>" : InputFile.c_str(), MB.get(),
-                            Builder);
+    for (const Input &I : Inputs)
+      success &= PrintInputAST(I.name.c_str(), I.buffer.get(), Builder);
     break;
   case Evaluate:
-    success = EvaluateInputAST(InputFile=="-" ? "<stdin>" : InputFile.c_str(),
-                               MB.get(), Builder);
+    success = Jobs == 1 ? EvaluateInputAST(Inputs, Builder)
+                        : EvaluateInParallel(Inputs, Builder);
     break;
   case PrintSMTLIBv2:
-    success = printInputAsSMTLIBv2(InputFile=="-"? "<stdin>" : InputFile.c_str(), MB.get(),Builder);
+    for (const Input &I : Inputs)
+      success &= printInputAsSMTLIBv2(I.name.c_str(), I.buffer.get(), Builder);
     break;
   default:
     llvm::errs() << argv[0] << ": error: Unknown program action!\n";
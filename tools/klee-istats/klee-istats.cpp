@@ -0,0 +1,82 @@
+//===-- klee-istats.cpp -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Statistics/BinaryIStats.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace klee;
+
+static void print_usage() {
+  std::cerr << "Usage: klee-istats [options] <run.istats.bin>\n\n"
+               "Converts binary instruction level statistics "
+               "(--istats-format=binary) to\n"
+               "callgrind format, as written to run.istats.\n\n"
+               "Options:\n"
+               "\t--snapshot=<n>  convert the n-th snapshot (1-based) instead "
+               "of the last one\n"
+               "\t--list          list the snapshots and their time stamps\n";
+}
+
+int main(int argc, char *argv[]) {
+  const char *path = nullptr;
+  unsigned snapshot = 0;
+  bool list = false;
+
+  for (int i = 1; i < argc; ++i) {
+    if (!strncmp(argv[i], "--snapshot=", 11)) {
+      char *end;
+      snapshot = strtoul(argv[i] + 11, &end, 10);
+      if (!snapshot || *end) {
+        std::cerr << "klee-istats: invalid snapshot '" << argv[i] + 11
+                  << "'\n";
+        return EXIT_FAILURE;
+      }
+    } else if (!strcmp(argv[i], "--list")) {
+      list = true;
+    } else if (argv[i][0] == '-' || path) {
+      print_usage();
+      return EXIT_FAILURE;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (!path) {
+    print_usage();
+    return EXIT_FAILURE;
+  }
+
+  BinaryIStatsReader reader;
+  std::string error;
+  if (!reader.open(path, error)) {
+    std::cerr << "klee-istats: " << path << ": " << error << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (list) {
+    while (reader.next())
+      std::cout << reader.getSnapshotCount() << ": "
+                << reader.getTime() / 1000000.0 << "s\n";
+    return EXIT_SUCCESS;
+  }
+
+  while ((!snapshot || reader.getSnapshotCount() < snapshot) && reader.next())
+    ;
+  if (!reader.getSnapshotCount() ||
+      (snapshot && reader.getSnapshotCount() != snapshot)) {
+    std::cerr << "klee-istats: " << path << ": no such snapshot\n";
+    return EXIT_FAILURE;
+  }
+
+  reader.printCallgrind(std::cout);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,264 @@
+//===-- main.cpp ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Converts binary query logs (--use-query-log=all:binary or solver:binary)
+// into the .kquery or .smt2 logs KLEE would have written directly.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Config/config.h"
+#include "klee/Config/Version.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/ExprBuilder.h"
+#include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/ExprSMTLIBPrinter.h"
+#include "klee/Solver/BinaryQueryLog.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+#include "klee/Support/PrintVersion.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace klee;
+using namespace klee::querylog;
+
+namespace {
+llvm::cl::OptionCategory QueryLogCat("Query log conversion options");
+
+llvm::cl::opt<std::string> InputFile(llvm::cl::desc("<binary query log>"),
+                                     llvm::cl::Positional, llvm::cl::init("-"),
+                                     llvm::cl::cat(QueryLogCat));
+
+enum OutputFormat { KQuery, SMTLIB };
+
+llvm::cl::opt<OutputFormat> Format(
+    "format", llvm::cl::desc("Format of the converted log (default=kquery)"),
+    llvm::cl::values(clEnumValN(KQuery, "kquery", "KQuery (.kquery)"),
+                     clEnumValN(SMTLIB, "smt2", "SMT-LIBv2 (.smt2)")),
+    llvm::cl::init(KQuery), llvm::cl::cat(QueryLogCat));
+
+llvm::cl::opt<std::string>
+    OutputFile("o", llvm::cl::desc("Output file (default=stdout)"),
+               llvm::cl::value_desc("filename"), llvm::cl::init("-"),
+               llvm::cl::cat(QueryLogCat));
+
+/// Size of the blocks the log is read in, which bounds the memory needed for
+/// logs of any size
+constexpr std::size_t BlockSize = 1 << 24;
+} // namespace
+
+/// Reads a log in blocks. The log may be compressed with
+/// --compress-query-log.
+class LogFile {
+#ifdef HAVE_ZLIB_H
+  gzFile file = nullptr;
+#else
+  std::FILE *file = nullptr;
+#endif
+
+public:
+  ~LogFile();
+
+  bool open(const std::string &path, std::string &error);
+  /// Appends up to `size` bytes to `data`. Returns the number of bytes read,
+  /// 0 at the end of the log and -1 on an error.
+  long read(std::string &data, std::size_t size, std::string &error);
+};
+
+LogFile::~LogFile() {
+#ifdef HAVE_ZLIB_H
+  if (file)
+    gzclose(file);
+#else
+  if (file && file != stdin)
+    std::fclose(file);
+#endif
+}
+
+bool LogFile::open(const std::string &path, std::string &error) {
+#ifdef HAVE_ZLIB_H
+  // reads uncompressed logs as they are
+  file = path == "-" ? gzdopen(dup(STDIN_FILENO), "rb")
+                     : gzopen(path.c_str(), "rb");
+#else
+  file = path == "-" ? stdin : std::fopen(path.c_str(), "rb");
+#endif
+  if (!file)
+    error = std::strerror(errno);
+  return file != nullptr;
+}
+
+long LogFile::read(std::string &data, std::size_t size, std::string &error) {
+  const std::size_t offset = data.size();
+  data.resize(offset + size);
+#ifdef HAVE_ZLIB_H
+  const int read = gzread(file, &data[offset], size);
+  if (read < 0) {
+    int code;
+    error = gzerror(file, &code);
+  }
+#else
+  const std::size_t count = std::fread(&data[offset], 1, size, file);
+  const long read = count || !std::ferror(file) ? long(count) : -1;
+  if (read < 0)
+    error = std::strerror(errno);
+#endif
+  data.resize(offset + (read > 0 ? read : 0));
+  return read;
+}
+
+/// Prints the query like the KQuery or SMT-LIB logging solver does
+static void printQuery(llvm::raw_ostream &os, const LoggedQuery &logged) {
+  const ConstraintSet constraints(logged.constraints);
+  const Query query(constraints, logged.expr);
+  const bool isValue = logged.type == QueryType::Value;
+  const Query printed = isValue ? query.withFalse() : query;
+
+  if (Format == SMTLIB) {
+    ExprSMTLIBPrinter printer;
+    printer.setOutput(os);
+    printer.setQuery(printed);
+    if (logged.type == QueryType::InitialValues)
+      printer.setArrayValuesToGet(logged.objects);
+    printer.generateOutput();
+    return;
+  }
+
+  std::unique_ptr<ExprPPrinter> printer(ExprPPrinter::create(os));
+  const ref<Expr> *evalExprsBegin = isValue ? &query.expr : nullptr;
+  const ref<Expr> *evalExprsEnd = isValue ? &query.expr + 1 : nullptr;
+  const Array *const *evalArraysBegin =
+      logged.objects.empty() ? nullptr : logged.objects.data();
+  const Array *const *evalArraysEnd =
+      logged.objects.empty() ? nullptr
+                             : logged.objects.data() + logged.objects.size();
+  printer->printQuery(os, printed.constraints, printed.expr, evalExprsBegin,
+                      evalExprsEnd, evalArraysBegin, evalArraysEnd);
+}
+
+static void printResult(llvm::raw_ostream &os, const char *comment,
+                        const LoggedQuery &logged) {
+  os << comment << "   " << (logged.success ? "OK" : "FAIL") << " -- "
+     << "Elapsed: " << logged.elapsed << "\n";
+  if (!logged.success) {
+    os << comment << "   Failure reason: "
+       << SolverImpl::getOperationStatusString(logged.status) << "\n\n";
+    return;
+  }
+
+  switch (logged.type) {
+  case QueryType::Truth:
+    os << comment << "   Is Valid: " << (logged.result ? "true" : "false")
+       << "\n";
+    break;
+  case QueryType::Validity:
+    os << comment << "   Validity: " << logged.result << "\n";
+    break;
+  case QueryType::Value:
+    os << comment << "   Result: " << logged.value << "\n";
+    break;
+  case QueryType::InitialValues:
+    os << comment << "   Solvable: " << (logged.result ? "true" : "false")
+       << "\n";
+    for (unsigned i = 0, e = logged.values.size(); i != e; ++i) {
+      const std::vector<unsigned char> &data = logged.values[i];
+      os << comment << "     " << logged.objects[i]->name << " = [";
+      for (unsigned j = 0; j < data.size(); j++) {
+        os << (int)data[j];
+        if (j + 1 < data.size())
+          os << ",";
+      }
+      os << "]\n";
+    }
+    break;
+  }
+  os << "\n";
+}
+
+int main(int argc, char **argv) {
+  KCommandLine::KeepOnlyCategories({&QueryLogCat});
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+  llvm::cl::SetVersionPrinter(klee::printVersion);
+  llvm::cl::ParseCommandLineOptions(
+      argc, argv, "Converts a binary query log to .kquery or .smt2\n");
+
+  std::string error;
+  LogFile file;
+  if (!file.open(InputFile, error)) {
+    llvm::errs() << argv[0] << ": error: " << InputFile << ": " << error
+                 << "\n";
+    return 1;
+  }
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(OutputFile, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << argv[0] << ": error: " << OutputFile << ": "
+                 << ec.message() << "\n";
+    return 1;
+  }
+
+  // the SMT-LIB printer negates query expressions like KLEE does
+  std::unique_ptr<ExprBuilder> builder(createSimplifyingExprBuilder(
+      createConstantFoldingExprBuilder(createDefaultExprBuilder())));
+  exprBuilder = builder.get();
+
+  const char *comment = Format == SMTLIB ? ";" : "#";
+  ArrayCache arrayCache;
+  Reader reader(arrayCache);
+  LoggedQuery logged;
+  unsigned queryCount = 0;
+  // the block being read, preceded by the part of a record that continues
+  // in it
+  std::string block;
+  for (bool last = false; !last;) {
+    const long read = file.read(block, BlockSize, error);
+    if (read < 0) {
+      llvm::errs() << argv[0] << ": error: " << InputFile << ": " << error
+                   << "\n";
+      return 1;
+    }
+    last = read == 0;
+
+    reader.feed(block.data(), block.size(), last);
+    for (; reader.next(logged); ++queryCount) {
+      os << comment << " Query " << queryCount << " -- "
+         << "Type: " << getQueryTypeName(logged.type) << ", "
+         << "Instructions: " << logged.instructions << "\n";
+      printQuery(os, logged);
+      if (logged.finished)
+        printResult(os, comment, logged);
+    }
+
+    if (!reader.getError().empty()) {
+      llvm::errs() << argv[0] << ": error: " << InputFile << ": "
+                   << reader.getError() << "\n";
+      return 1;
+    }
+    block.erase(0, block.size() - reader.getUnreadSize());
+  }
+  return 0;
+}
@@ -268,7 +268,7 @@ void ensure_capsyschroot(const char *executable) {
 
 static void usage(void) {
   fprintf(stderr,
-    "Usage: %s [option]... <executable> <ktest-file>...\n"
+    "Usage: %s [option]... <executable> <ktest-file|test-archive>...\n"
     "   or: %s --create-files-only <ktest-file>\n"
     "\n"
     "-r, --chroot-to-dir=DIR  use chroot jail, requires CAP_SYS_CHROOT\n"
@@ -283,6 +283,70 @@ static void usage(void) {
 
 int keep_temps = 0;
 
+/* Replays the test in `input` and releases it afterwards. */
+static void replay_input(char *executable, const char *program,
+                         const char *input_name) {
+  static int first = 1;
+  int prg_argc;
+  char ** prg_argv;
+  unsigned i;
+
+  obj_index = 0;
+  prg_argc = input->numArgs;
+  prg_argv = input->args;
+  free(prg_argv[0]);
+  prg_argv[0] = strdup(program);
+
+  klee_init_env(&prg_argc, &prg_argv);
+
+  if (!first)
+    fputc('\n', stderr);
+  first = 0;
+  fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
+                  "KLEE-REPLAY: NOTE: Arguments: ", input_name);
+  for (i=0; i != (unsigned) prg_argc; ++i) {
+    char *s = prg_argv[i];
+    if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
+    fprintf(stderr, "\"%s\" ", prg_argv[i]);
+  }
+  fputc('\n', stderr);
+
+  /* Create the input files, pipes, etc. */
+  replay_create_files(&__exe_fs);
+
+  /* Run the test case machinery in a subprocess, eventually this parent
+     process should be a script or something which shells out to the actual
+     execution tool. */
+
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    /* Run the executable */
+    run_monitored(executable, prg_argc, prg_argv);
+    _exit(0);
+  } else {
+    /* Wait for the executable to finish. */
+    int res, status;
+
+    do {
+      res = waitpid(pid, &status, 0);
+    } while (res < 0 && errno == EINTR);
+
+    // Delete all files in the replay directory
+    replay_delete_files();
+
+    if (res < 0) {
+      perror("waitpid");
+      _exit(66);
+    }
+
+    free(prg_argv);
+    kTest_free(input);
+  }
+}
+
 int main(int argc, char** argv) {
   int prg_argc;
   char ** prg_argv;
@@ -356,7 +420,30 @@ int main(int argc, char** argv) {
   int idx = 0;
   for (idx = optind + 1; idx != argc; ++idx) {
     char* input_fname = argv[idx];
-    unsigned i;
+
+    if (kTestArchive_isArchive(input_fname)) {
+      KTestArchive *archive = kTestArchive_open(input_fname);
+      unsigned i, n;
+      if (!archive) {
+        fprintf(stderr, "KLEE-REPLAY: ERROR: test archive %s not valid.\n",
+                input_fname);
+        exit(1);
+      }
+      for (i = 0, n = kTestArchive_numTests(archive); i != n; ++i) {
+        char test_name[PATH_MAX + 32];
+        input = kTestArchive_read(archive, i);
+        if (!input) {
+          fprintf(stderr, "KLEE-REPLAY: ERROR: test %u in %s not valid.\n",
+                  i, input_fname);
+          exit(1);
+        }
+        snprintf(test_name, sizeof(test_name), "%s:test%06u", input_fname,
+                 kTestArchive_getID(archive, i));
+        replay_input(executable, argv[optind], test_name);
+      }
+      kTestArchive_close(archive);
+      continue;
+    }
 
     input = kTest_fromFile(input_fname);
     if (!input) {
@@ -364,60 +451,7 @@ int main(int argc, char** argv) {
               input_fname);
       exit(1);
     }
-
-    obj_index = 0;
-    prg_argc = input->numArgs;
-    prg_argv = input->args;
-    free(prg_argv[0]);
-    prg_argv[0] = strdup(argv[optind]);
-
-    klee_init_env(&prg_argc, &prg_argv);
-
-    if (idx > 2)
-      fputc('\n', stderr);
-    fprintf(stderr, "KLEE-REPLAY: NOTE: Test file: %s\n"
-                    "KLEE-REPLAY: NOTE: Arguments: ", input_fname);
-    for (i=0; i != (unsigned) prg_argc; ++i) {
-      char *s = prg_argv[i];
-      if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
-      fprintf(stderr, "\"%s\" ", prg_argv[i]);
-    }
-    fputc('\n', stderr);
-
-    /* Create the input files, pipes, etc. */
-    replay_create_files(&__exe_fs);
-
-    /* Run the test case machinery in a subprocess, eventually this parent
-       process should be a script or something which shells out to the actual
-       execution tool. */
-
-    int pid = fork();
-    if (pid < 0) {
-      perror("fork");
-      _exit(66);
-    } else if (pid == 0) {
-      /* Run the executable */
-      run_monitored(executable, prg_argc, prg_argv);
-      _exit(0);
-    } else {
-      /* Wait for the executable to finish. */
-      int res, status;
-
-      do {
-        res = waitpid(pid, &status, 0);
-      } while (res < 0 && errno == EINTR);
-
-      // Delete all files in the replay directory
-      replay_delete_files();
-
-      if (res < 0) {
-        perror("waitpid");
-        _exit(66);
-      }
-
-      free(prg_argv);
-      kTest_free(input);
-    }
+    replay_input(executable, argv[optind], input_fname);
   }
 
   return 0;
@@ -0,0 +1,295 @@
+//===-- Printers.cpp --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Printers.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+
+namespace {
+
+using Cell = std::variant<std::monostate, std::string, Value>;
+using Column = std::vector<Cell>;
+
+std::string formatCell(const Cell &cell) {
+  if (const auto *text = std::get_if<std::string>(&cell))
+    return *text;
+  if (const auto *value = std::get_if<Value>(&cell)) {
+    char buffer[64];
+    if (value->integral)
+      std::snprintf(buffer, sizeof(buffer), "%lld",
+                    static_cast<long long>(std::llround(value->number)));
+    else
+      std::snprintf(buffer, sizeof(buffer), "%.2f", value->number);
+    return buffer;
+  }
+  return {};
+}
+
+bool startsWith(std::string_view s, std::string_view prefix) {
+  return s.substr(0, prefix.size()) == prefix;
+}
+
+bool endsWith(std::string_view s, std::string_view suffix) {
+  return s.size() >= suffix.size() &&
+         s.substr(s.size() - suffix.size()) == suffix;
+}
+
+/// summarise a column: averages and percentages are averaged over all runs,
+/// maxima are maximised, everything else is summed up
+Cell total(const std::string &header, const Column &column,
+           std::size_t runs) {
+  std::vector<Value> values;
+  for (const auto &cell : column) {
+    if (const auto *value = std::get_if<Value>(&cell))
+      values.push_back(*value);
+  }
+
+  if (startsWith(header, "Avg") || endsWith(header, "(%)")) {
+    double sum = 0;
+    for (const auto &value : values)
+      sum += value.number;
+    return Value{sum / runs, false};
+  }
+
+  if (startsWith(header, "Max")) {
+    if (values.empty())
+      return {};
+    return *std::max_element(values.begin(), values.end(),
+                             [](const Value &lhs, const Value &rhs) {
+                               return lhs.number < rhs.number;
+                             });
+  }
+
+  Value sum;
+  for (const auto &value : values) {
+    sum.number += value.number;
+    sum.integral &= value.integral;
+  }
+  return sum;
+}
+
+/// strip the longest common leading path components
+std::vector<std::string> stripCommonPrefix(const std::vector<Run> &runs) {
+  std::vector<std::vector<std::string>> components;
+  for (const auto &[path, record] : runs) {
+    components.emplace_back();
+    std::string_view rest = path;
+    for (;;) {
+      const auto pos = rest.find('/');
+      components.back().emplace_back(rest.substr(0, pos));
+      if (pos == std::string_view::npos)
+        break;
+      rest.remove_prefix(pos + 1);
+    }
+  }
+
+  std::size_t common = 0;
+  for (;; ++common) {
+    bool same = true;
+    for (const auto &c : components) {
+      if (common + 1 >= c.size() || c[common] != components[0][common]) {
+        same = false;
+        break;
+      }
+    }
+    if (!same)
+      break;
+  }
+
+  std::vector<std::string> paths;
+  for (const auto &c : components) {
+    std::string path;
+    for (std::size_t i = common; i < c.size(); ++i)
+      path += (i > common ? "/" : "") + c[i];
+    paths.push_back(path);
+  }
+  return paths;
+}
+
+std::string pad(const std::string &s, std::size_t width, char align) {
+  const std::size_t fill = width > s.size() ? width - s.size() : 0;
+  switch (align) {
+  case '<':
+    return s + std::string(fill, ' ');
+  case '>':
+    return std::string(fill, ' ') + s;
+  default:
+    return std::string(fill / 2, ' ') + s + std::string(fill - fill / 2, ' ');
+  }
+}
+
+} // namespace
+
+bool printTable(std::ostream &os, const std::vector<Run> &runs,
+                Selection selection,
+                const std::vector<std::string> &userColumns,
+                TableFormat format) {
+  std::unordered_map<std::string, std::string> headerNames;
+  for (const auto &entry : legend)
+    headerNames[entry.name] = entry.header;
+
+  // build the main body of the table
+  const auto paths = runs.size() > 1 ? stripCommonPrefix(runs)
+                                     : std::vector<std::string>{runs[0].first};
+  std::map<std::string, Column> table;
+  for (std::size_t i = 0; i < runs.size(); ++i) {
+    const auto record = selectColumns(deriveColumns(runs[i].second), selection);
+    table["Path"].resize(i + 1);
+    table["Path"][i] = paths[i];
+    for (const auto &[name, value] : record) {
+      const auto it = headerNames.find(name);
+      auto &column = table[it != headerNames.end() ? it->second : name];
+      column.resize(i + 1);
+      column[i] = value;
+    }
+  }
+  for (auto &[header, column] : table)
+    column.resize(runs.size());
+
+  // apply the column filter provided by the user
+  if (!userColumns.empty()) {
+    std::vector<std::string> missing;
+    for (const auto &column : userColumns) {
+      if (!table.count(column))
+        missing.push_back(column);
+    }
+    if (!missing.empty()) {
+      std::cerr << "Column(s) not found:";
+      for (std::size_t i = 0; i < missing.size(); ++i)
+        std::cerr << (i ? ", " : " ") << missing[i];
+      std::cerr << '\n';
+      return false;
+    }
+  }
+
+  // add a summary row
+  const bool hasTotal = runs.size() > 1 && format == TableFormat::Klee;
+  if (hasTotal) {
+    for (auto &[header, column] : table) {
+      if (header == "Path")
+        column.emplace_back("Total (" + std::to_string(runs.size()) + ")");
+      else
+        column.push_back(total(header, column, runs.size()));
+    }
+  }
+
+  // order the columns: user order, or as in the legend followed by the
+  // unknown columns in alphabetical order
+  std::vector<std::string> headers = userColumns;
+  if (headers.empty()) {
+    headers.emplace_back("Path");
+    std::set<std::string> available;
+    for (const auto &[header, column] : table)
+      if (header != "Path")
+        available.insert(header);
+    for (const auto &entry : legend) {
+      if (available.erase(entry.header))
+        headers.emplace_back(entry.header);
+    }
+    headers.insert(headers.end(), available.begin(), available.end());
+  }
+
+  // format all cells and determine widths and alignment
+  const std::size_t rows = runs.size() + (hasTotal ? 1 : 0);
+  std::vector<std::vector<std::string>> cells(headers.size());
+  std::vector<std::size_t> widths(headers.size());
+  std::vector<char> aligns(headers.size());
+  for (std::size_t c = 0; c < headers.size(); ++c) {
+    const auto &column = table[headers[c]];
+    bool numeric = false, text = false;
+    widths[c] = headers[c].size();
+    for (std::size_t r = 0; r < rows; ++r) {
+      numeric |= std::holds_alternative<Value>(column[r]);
+      text |= std::holds_alternative<std::string>(column[r]);
+      cells[c].push_back(formatCell(column[r]));
+      widths[c] = std::max(widths[c], cells[c].back().size());
+    }
+    if (numeric && !text)
+      aligns[c] = '>';
+    else
+      aligns[c] = format == TableFormat::Klee ? '^' : '<';
+  }
+
+  auto printRow = [&](auto &&get, const char *begin, const char *separator,
+                      const char *end) {
+    os << begin;
+    for (std::size_t c = 0; c < headers.size(); ++c) {
+      const std::string cell = get(c);
+      if (c)
+        os << separator;
+      os << (format == TableFormat::Csv ? cell
+                                        : pad(cell, widths[c], aligns[c]));
+    }
+    os << end << '\n';
+  };
+  auto header = [&](std::size_t c) { return headers[c]; };
+
+  if (format != TableFormat::Klee) {
+    printRow(header, "", ",", "");
+    for (std::size_t r = 0; r < rows; ++r)
+      printRow([&](std::size_t c) { return cells[c][r]; }, "", ",", "");
+    return true;
+  }
+
+  std::size_t lineWidth = headers.size() + 1;
+  for (const auto width : widths)
+    lineWidth += width;
+  const std::string line(lineWidth, '-');
+
+  os << line << '\n';
+  printRow(header, "|", "|", "|");
+  os << line << '\n';
+  for (std::size_t r = 0; r < rows; ++r) {
+    if (hasTotal && r + 1 == rows)
+      os << line << '\n';
+    printRow([&](std::size_t c) { return cells[c][r]; }, "|", "|", "|");
+  }
+  os << line << '\n';
+  return true;
+}
+
+void printMetrics(std::ostream &os, const std::vector<Run> &runs) {
+  // metric name -> (path, value)
+  std::map<std::string, std::vector<std::pair<std::string, Value>>> metrics;
+  for (const auto &[path, record] : runs) {
+    for (const auto &[name, value] : deriveColumns(record)) {
+      std::string metric = "klee_";
+      for (const char c : name)
+        metric += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+      metrics[metric].emplace_back(path, value);
+    }
+  }
+
+  for (const auto &[metric, samples] : metrics) {
+    os << "# TYPE " << metric << " gauge\n";
+    for (const auto &[path, value] : samples) {
+      os << metric << "{path=\"";
+      for (const char c : path) {
+        if (c == '\\' || c == '"')
+          os << '\\' << c;
+        else if (c == '\n')
+          os << "\\n";
+        else
+          os << c;
+      }
+      char buffer[64];
+      std::snprintf(buffer, sizeof(buffer), "%.17g", value.number);
+      os << "\"} " << buffer << '\n';
+    }
+  }
+}
@@ -0,0 +1,33 @@
+//===-- Printers.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "Stats.h"
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Statistics of one KLEE output directory: (display path, record)
+using Run = std::pair<std::string, Record>;
+
+enum class TableFormat { Klee, Csv, ReadableCsv };
+
+/// print the summary table of all runs, one row per run; the records must
+/// not be derived yet. Returns false (after printing an error) if one of the
+/// user-provided columns does not exist.
+bool printTable(std::ostream &os, const std::vector<Run> &runs,
+                Selection selection,
+                const std::vector<std::string> &userColumns,
+                TableFormat format);
+
+/// print all statistics of all runs in the Prometheus text exposition format
+void printMetrics(std::ostream &os, const std::vector<Run> &runs);
@@ -0,0 +1,243 @@
+//===-- Stats.cpp -----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+const std::vector<LegendEntry> legend{
+    LegendEntry{"Instrs", "number of executed instructions", "Instructions"},
+    LegendEntry{"Time(s)", "total wall time", "WallTime"},
+    LegendEntry{"ICov(%)", "instruction coverage in the LLVM bitcode", "ICov"},
+    LegendEntry{"BCov(%)", "conditional branch (br) coverage in the LLVM bitcode", "BCov"},
+    LegendEntry{"ICount", "total static instructions in the LLVM bitcode", "ICount"},
+    LegendEntry{"TSolver(%)", "relative time spent in the solver chain wrt wall time (incl. caches and constraint solver)", "RelSolverTime"},
+    LegendEntry{"ICovered", "total covered instructions in the LLVM bitcode", "CoveredInstructions"},
+    LegendEntry{"IUncovered", "total uncovered instructions in the LLVM bitcode", "UncoveredInstructions"},
+    LegendEntry{"Branches", "number of conditional branch (br) instructions in the LLVM bitcode", "NumBranches"},
+    LegendEntry{"FullBranches", "number of fully-explored conditional branch (br) instructions in the LLVM bitcode", "FullBranches"},
+    LegendEntry{"PartialBranches", "number of partially-explored conditional branch (br) instructions in the LLVM bitcode", "PartialBranches"},
+    LegendEntry{"ExternalCalls", "number of external calls", "ExternalCalls"},
+    LegendEntry{"TUser(s)", "total user time", "UserTime"},
+    LegendEntry{"TResolve(s)", "time spent in object resolution", "ResolveTime"},
+    LegendEntry{"TResolve(%)", "relative time spent in object resolution wrt wall time", "RelResolveTime"},
+    LegendEntry{"TCex(s)", "time spent in the counterexample caching code (incl. constraint solver)", "CexCacheTime"},
+    LegendEntry{"TCex(%)", "relative time spent in the counterexample caching code wrt wall time (incl. constraint solver)", "RelCexCacheTime"},
+    LegendEntry{"TQuery(s)", "time spent in the constraint solver", "QueryTime"},
+    LegendEntry{"TSolver(s)", "time spent in the solver chain (incl. caches and constraint solver)", "SolverTime"},
+    LegendEntry{"States", "number of created states", "States"},
+    LegendEntry{"ActiveStates", "number of currently active states (0 after successful termination)", "NumStates"},
+    LegendEntry{"MaxActiveStates", "maximum number of active states", "MaxStates"},
+    LegendEntry{"AvgActiveStates", "average number of active states", "AvgStates"},
+    LegendEntry{"InhibitedForks", "number of inhibited state forks due to e.g. memory pressure", "InhibitedForks"},
+    LegendEntry{"Queries", "number of queries issued to the solver chain", "Queries"},
+    LegendEntry{"SolverQueries", "number of queries issued to the constraint solver", "SolverQueries"},
+    LegendEntry{"SolverQueryConstructs", "number of query constructs for all queries send to the constraint solver", "NumQueryConstructs"},
+    LegendEntry{"AvgSolverQuerySize", "average number of query constructs per query issued to the constraint solver", "AvgQC"},
+    LegendEntry{"QCacheMisses", "Query cache misses", "QueryCacheMisses"},
+    LegendEntry{"QCacheHits", "Query cache hits", "QueryCacheHits"},
+    LegendEntry{"QCexCacheMisses", "Counterexample cache misses", "QueryCexCacheMisses"},
+    LegendEntry{"QCexCacheHits", "Counterexample cache hits", "QueryCexCacheHits"},
+    LegendEntry{"Z3CacheMisses", "Z3 construction cache misses", "Z3ConstructCacheMisses"},
+    LegendEntry{"Z3CacheHits", "Z3 construction cache hits", "Z3ConstructCacheHits"},
+    LegendEntry{"ExprOpts", "Applied expression rewrites", "ExO"},
+    LegendEntry{"ExprOpts1", "Utility stat for expression rewrites", "ExO1"},
+    LegendEntry{"ExprOpts2", "Utility stat for expression rewrites", "ExO2"},
+    LegendEntry{"ExprOpts3", "Utility stat for expression rewrites", "ExO3"},
+    LegendEntry{"ExprOpts4", "Utility stat for expression rewrites", "ExO4"},
+    LegendEntry{"ExprOpts5", "Utility stat for expression rewrites", "ExO5"},
+    LegendEntry{"ConstOpts", "Applied expression rewrites that produced a constant", "CnO"},
+    LegendEntry{"Allocations", "number of allocated heap objects of the program under test", "Allocations"},
+    LegendEntry{"Mem(MiB)", "mebibytes of memory currently used", "MallocUsage"},
+    LegendEntry{"MaxMem(MiB)", "maximum memory usage", "MaxMem"},
+    LegendEntry{"AvgMem(MiB)", "average memory usage", "AvgMem"},
+    LegendEntry{"ExprMem(MiB)", "mebibytes of memory held by live expression nodes", "ExprMemory"},
+    LegendEntry{"UNodeMem(MiB)", "mebibytes of memory held by live array update nodes", "UpdateNodeMemory"},
+    LegendEntry{"MinFaults", "number of page faults serviced without I/O", "MinorPageFaults"},
+    LegendEntry{"MajFaults", "number of page faults that required I/O", "MajorPageFaults"},
+    LegendEntry{"BrConditional", "number of forks caused by symbolic branch conditions (br)", "BranchesConditional"},
+    LegendEntry{"BrIndirect", "number of forks caused by indirect branches (indirectbr) with symbolic address", "BranchesIndirect"},
+    LegendEntry{"BrSwitch", "number of forks caused by switch with symbolic value", "BranchesSwitch"},
+    LegendEntry{"BrCall", "number of forks caused by symbolic function pointers", "BranchesCall"},
+    LegendEntry{"BrMemOp", "number of forks caused by memory operation with symbolic address", "BranchesMemOp"},
+    LegendEntry{"BrResolvePointer", "number of forks caused by symbolic pointers", "BranchesResolvePointer"},
+    LegendEntry{"BrAlloc", "number of forks caused by symbolic allocation size", "BranchesAlloc"},
+    LegendEntry{"BrRealloc", "number of forks caused by symbolic reallocation size", "BranchesRealloc"},
+    LegendEntry{"BrFree", "number of forks caused by freeing a symbolic pointer", "BranchesFree"},
+    LegendEntry{"BrGetVal", "number of forks caused by user-invoked concretization while seeding", "BranchesGetVal"},
+    LegendEntry{"TermExit", "number of states that reached end of execution path", "TerminationExit"},
+    LegendEntry{"TermEarly", "number of early terminated states (e.g. due to memory pressure, state limt)", "TerminationEarly"},
+    LegendEntry{"TermSolverErr", "number of states terminated due to solver errors", "TerminationSolverError"},
+    LegendEntry{"TermProgrErr", "number of states terminated due to program errors (e.g. division by zero)", "TerminationProgramError"},
+    LegendEntry{"TermUserErr", "number of states terminated due to user errors (e.g. misuse of KLEE API)", "TerminationUserError"},
+    LegendEntry{"TermExecErr", "number of states terminated due to execution errors (e.g. unsupported intrinsics)", "TerminationExecutionError"},
+    LegendEntry{"TermEarlyAlgo", "number of state terminations required by algorithm (e.g. state merging or replaying)", "TerminationEarlyAlgorithm"},
+    LegendEntry{"TermEarlyUser", "number of states terminated via klee_silent_exit()", "TerminationEarlyUser"},
+    LegendEntry{"QIndep", "queries reaching the independent-constraints layer (--solver-layer-stats)", "SolverIndependentQueries"},
+    LegendEntry{"HitIndep(%)", "queries answered by the independent-constraints layer without consulting the layer below", "SolverIndependentHitRate"},
+    LegendEntry{"TIndep(s)", "time spent in the independent-constraints layer incl. all layers below", "SolverIndependentTime"},
+    LegendEntry{"P50Indep(us)", "median query latency of the independent-constraints layer", "SolverIndependentP50"},
+    LegendEntry{"P99Indep(us)", "99th percentile query latency of the independent-constraints layer", "SolverIndependentP99"},
+    LegendEntry{"QCache", "queries reaching the branch cache layer (--solver-layer-stats)", "SolverCachingQueries"},
+    LegendEntry{"HitCache(%)", "queries answered by the branch cache layer without consulting the layer below", "SolverCachingHitRate"},
+    LegendEntry{"TCache(s)", "time spent in the branch cache layer incl. all layers below", "SolverCachingTime"},
+    LegendEntry{"P50Cache(us)", "median query latency of the branch cache layer", "SolverCachingP50"},
+    LegendEntry{"P99Cache(us)", "99th percentile query latency of the branch cache layer", "SolverCachingP99"},
+    LegendEntry{"QCexCache", "queries reaching the counterexample cache layer (--solver-layer-stats)", "SolverCexCachingQueries"},
+    LegendEntry{"HitCexCache(%)", "queries answered by the counterexample cache layer without consulting the layer below", "SolverCexCachingHitRate"},
+    LegendEntry{"TCexCache(s)", "time spent in the counterexample cache layer incl. all layers below", "SolverCexCachingTime"},
+    LegendEntry{"P50CexCache(us)", "median query latency of the counterexample cache layer", "SolverCexCachingP50"},
+    LegendEntry{"P99CexCache(us)", "99th percentile query latency of the counterexample cache layer", "SolverCexCachingP99"},
+    LegendEntry{"QFastCex", "queries reaching the fast counterexample layer (--solver-layer-stats)", "SolverFastCexQueries"},
+    LegendEntry{"HitFastCex(%)", "queries answered by the fast counterexample layer without consulting the layer below", "SolverFastCexHitRate"},
+    LegendEntry{"TFastCex(s)", "time spent in the fast counterexample layer incl. all layers below", "SolverFastCexTime"},
+    LegendEntry{"P50FastCex(us)", "median query latency of the fast counterexample layer", "SolverFastCexP50"},
+    LegendEntry{"P99FastCex(us)", "99th percentile query latency of the fast counterexample layer", "SolverFastCexP99"},
+    LegendEntry{"QCore", "queries reaching the core solver (--solver-layer-stats)", "SolverCoreQueries"},
+    LegendEntry{"TCore(s)", "time spent in the core solver incl. all layers below", "SolverCoreTime"},
+    LegendEntry{"P50Core(us)", "median query latency of the core solver", "SolverCoreP50"},
+    LegendEntry{"P99Core(us)", "99th percentile query latency of the core solver", "SolverCoreP99"},
+    LegendEntry{"TArrayHash(s)", "time spent hashing arrays (if KLEE_ARRAY_DEBUG enabled, otherwise -1)", "ArrayHashTime"},
+    LegendEntry{"TFork(s)", "time spent forking states", "ForkTime"},
+    LegendEntry{"TFork(%)", "relative time spent forking states wrt wall time", "RelForkTime"},
+    LegendEntry{"TUser(%)", "relative user time wrt wall time", "RelUserTime"},
+};
+
+namespace {
+Value real(double number) { return {number, false}; }
+
+/// monitored layers of the solver chain (see SOLVER_LAYERS in SolverStats.h)
+const char *const solverLayers[] = {"Independent", "Caching", "CexCaching",
+                                    "FastCex", "Core"};
+} // namespace
+
+Record deriveColumns(Record record) {
+  // convert recorded times from microseconds to seconds
+  for (const char *key : {"UserTime", "WallTime", "QueryTime", "SolverTime",
+                          "CexCacheTime", "ForkTime", "ResolveTime"}) {
+    if (auto it = record.find(key); it != record.end())
+      it->second = real(it->second.number / 1000000);
+  }
+  for (const char *layer : solverLayers) {
+    if (auto it = record.find(std::string("Solver") + layer + "Time");
+        it != record.end())
+      it->second = real(it->second.number / 1000000);
+  }
+
+  // hit rates of the solver chain layers (the core solver has none)
+  for (const std::string layer : solverLayers) {
+    if (layer == "Core")
+      continue;
+    auto queries = record.find("Solver" + layer + "Queries");
+    auto hits = record.find("Solver" + layer + "Hits");
+    if (queries != record.end() && hits != record.end())
+      record["Solver" + layer + "HitRate"] = real(
+          100 * hits->second.number / std::max(1.0, queries->second.number));
+  }
+
+  // convert memory from bytes to MiB
+  for (const char *key : {"MallocUsage", "ExprMemory", "UpdateNodeMemory"}) {
+    if (auto it = record.find(key); it != record.end())
+      it->second = real(it->second.number / (1024 * 1024));
+  }
+
+  // average query constructs per solver query (older databases record the
+  // number of solver queries as NumQueries)
+  auto queries = record.find("NumQueries");
+  if (queries == record.end())
+    queries = record.find("SolverQueries");
+  if (auto qc = record.find("NumQueryConstructs");
+      qc != record.end() && queries != record.end()) {
+    record["AvgQC"] = {std::trunc(qc->second.number /
+                                  std::max(1.0, queries->second.number)),
+                       true};
+  }
+
+  // total number of instructions and instruction coverage
+  auto covered = record.find("CoveredInstructions");
+  auto uncovered = record.find("UncoveredInstructions");
+  if (covered != record.end() && uncovered != record.end()) {
+    const double count = covered->second.number + uncovered->second.number;
+    record["ICount"] = {count, true};
+    record["ICov"] = real(count ? 100 * covered->second.number / count : 0);
+  }
+
+  // branch coverage
+  auto full = record.find("FullBranches");
+  auto partial = record.find("PartialBranches");
+  auto branches = record.find("NumBranches");
+  if (full != record.end() && partial != record.end() &&
+      branches != record.end()) {
+    double bcov = 100.0;
+    if (branches->second.number != 0)
+      bcov *= (2 * full->second.number + partial->second.number) /
+              (2 * branches->second.number);
+    record["BCov"] = real(bcov);
+  }
+
+  // relative times
+  if (auto wall = record.find("WallTime"); wall != record.end()) {
+    const double wallTime = wall->second.number;
+    for (const char *key :
+         {"SolverTime", "CexCacheTime", "ForkTime", "ResolveTime", "UserTime"}) {
+      if (auto it = record.find(key); it != record.end())
+        record[std::string("Rel") + key] =
+            real(wallTime ? 100 * it->second.number / wallTime : 0);
+    }
+  }
+
+  return record;
+}
+
+Record selectColumns(const Record &record, Selection selection) {
+  std::vector<std::string> columns;
+  switch (selection) {
+  case Selection::All:
+    return record;
+  case Selection::RelTimes:
+    columns = {"WallTime", "RelUserTime", "RelSolverTime", "RelCexCacheTime",
+               "RelForkTime", "RelResolveTime"};
+    break;
+  case Selection::AbsTimes:
+    columns = {"WallTime", "UserTime", "SolverTime", "CexCacheTime",
+               "ForkTime", "ResolveTime"};
+    break;
+  case Selection::More:
+    columns = {"Instructions", "WallTime",      "ICov",
+               "BCov",         "ICount",        "RelSolverTime",
+               "NumStates",    "MaxStates",     "MallocUsage",
+               "MaxMem"};
+    break;
+  case Selection::ExprOpts:
+    columns = {"Instructions", "WallTime", "RelSolverTime", "ExO", "ExO1",
+               "ExO2",         "ExO3",     "ExO4",          "ExO5", "CnO"};
+    break;
+  case Selection::SolverLayers:
+    columns = {"WallTime", "RelSolverTime"};
+    for (const std::string layer : solverLayers) {
+      for (const std::string column : {"Queries", "HitRate", "P50", "P99"}) {
+        if (layer != "Core" || column != "HitRate")
+          columns.push_back("Solver" + layer + column);
+      }
+    }
+    break;
+  case Selection::Default:
+    columns = {"Instructions", "WallTime", "ICov",
+               "BCov",         "ICount",   "RelSolverTime"};
+    break;
+  }
+
+  Record selected;
+  for (const auto &column : columns) {
+    if (auto it = record.find(column); it != record.end())
+      selected.insert(*it);
+  }
+  return selected;
+}
@@ -0,0 +1,51 @@
+//===-- Stats.h -------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+///@brief A single statistic; integers and reals are formatted differently
+struct Value final {
+  double number{0};
+  bool integral{true};
+};
+
+///@brief One row of statistics, keyed by internal (run.stats) column name
+using Record = std::map<std::string, Value>;
+
+///@brief Mapping of column head, explanation, and internal KLEE name
+struct LegendEntry final {
+  const char *header;
+  const char *description;
+  const char *name;
+};
+
+/// Same column heads as the Python klee-stats tool, in display order
+extern const std::vector<LegendEntry> legend;
+
+/// Column sets selectable on the command line
+enum class Selection {
+  Default,
+  All,
+  RelTimes,
+  AbsTimes,
+  ExprOpts,
+  More,
+  SolverLayers
+};
+
+/// Convert units (us to s, bytes to MiB) and add computed columns such as
+/// ICov, BCov, ICount, and relative times
+Record deriveColumns(Record record);
+
+/// Restrict a derived record to the columns of the given selection
+Record selectColumns(const Record &record, Selection selection);
@@ -0,0 +1,146 @@
+//===-- StatsReader.cpp -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StatsReader.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <utility>
+
+StatsReader::StatsReader(std::filesystem::path path) : path(std::move(path)) {
+  // run.stats uses WAL mode, which requires write access to the shared-memory
+  // index even for pure readers
+  if (sqlite3_open_v2(this->path.c_str(), &db, SQLITE_OPEN_READWRITE,
+                      nullptr) != SQLITE_OK) {
+    error = sqlite3_errmsg(db);
+    sqlite3_close(db);
+    db = nullptr;
+  }
+}
+
+StatsReader::~StatsReader() {
+  sqlite3_finalize(rowStmt);
+  sqlite3_finalize(tailStmt);
+  sqlite3_close(db);
+}
+
+bool StatsReader::prepare() {
+  if (tailStmt)
+    return true;
+  if (!db)
+    return false;
+
+  // the row statement also tells us which columns exist; if the table has
+  // not been created yet, try again on the next poll
+  if (sqlite3_prepare_v3(db, "SELECT * FROM stats WHERE rowid = ?1;", -1,
+                         SQLITE_PREPARE_PERSISTENT, &rowStmt,
+                         nullptr) != SQLITE_OK) {
+    error = sqlite3_errmsg(db);
+    rowStmt = nullptr;
+    return false;
+  }
+
+  // only fetch the columns needed for the aggregates from every new row
+  std::string query = "SELECT rowid";
+  int column = 1;
+  for (int i = 0, e = sqlite3_column_count(rowStmt); i < e; ++i) {
+    const std::string name = sqlite3_column_name(rowStmt, i);
+    if (name == "MallocUsage") {
+      mallocUsageColumn = column++;
+      query += ", MallocUsage";
+    } else if (name == "NumStates") {
+      numStatesColumn = column++;
+      query += ", NumStates";
+    }
+  }
+  query += " FROM stats WHERE rowid > ?1 ORDER BY rowid;";
+
+  if (sqlite3_prepare_v3(db, query.c_str(), -1, SQLITE_PREPARE_PERSISTENT,
+                         &tailStmt, nullptr) != SQLITE_OK) {
+    error = sqlite3_errmsg(db);
+    sqlite3_finalize(rowStmt);
+    rowStmt = tailStmt = nullptr;
+    mallocUsageColumn = numStatesColumn = -1;
+    return false;
+  }
+  error.clear();
+  return true;
+}
+
+std::uint64_t StatsReader::poll() {
+  if (!prepare())
+    return 0;
+
+  sqlite3_bind_int64(tailStmt, 1, lastRowID);
+  std::uint64_t newRows = 0;
+  int rc;
+  while ((rc = sqlite3_step(tailStmt)) == SQLITE_ROW) {
+    ++newRows;
+    lastRowID = sqlite3_column_int64(tailStmt, 0);
+
+    if (mallocUsageColumn >= 0) {
+      const double mem = sqlite3_column_double(tailStmt, mallocUsageColumn);
+      maxMem = std::max(maxMem, mem);
+      sumMem += mem;
+    }
+    if (numStatesColumn >= 0) {
+      const double states = sqlite3_column_double(tailStmt, numStatesColumn);
+      maxStates = std::max(maxStates, states);
+      sumStates += states;
+    }
+  }
+  if (rc != SQLITE_DONE)
+    error = sqlite3_errmsg(db);
+  sqlite3_reset(tailStmt);
+
+  if (!newRows)
+    return 0;
+  rows += newRows;
+
+  // only the most recent row is reported, so decode all its columns once
+  sqlite3_bind_int64(rowStmt, 1, lastRowID);
+  if (sqlite3_step(rowStmt) == SQLITE_ROW) {
+    lastRecord.clear();
+    for (int i = 0, e = sqlite3_column_count(rowStmt); i < e; ++i) {
+      const char *name = sqlite3_column_name(rowStmt, i);
+      switch (sqlite3_column_type(rowStmt, i)) {
+      case SQLITE_INTEGER:
+        lastRecord[name] = {
+            static_cast<double>(sqlite3_column_int64(rowStmt, i)), true};
+        break;
+      case SQLITE_FLOAT:
+        lastRecord[name] = {sqlite3_column_double(rowStmt, i), false};
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  sqlite3_reset(rowStmt);
+
+  return newRows;
+}
+
+Record StatsReader::getRecord() const {
+  Record record = lastRecord;
+  if (!rows)
+    return record;
+
+  const double mib = 1024 * 1024;
+  if (mallocUsageColumn >= 0) {
+    record["MaxMem"] = {maxMem / mib, false};
+    record["AvgMem"] = {sumMem / rows / mib, false};
+  }
+  if (numStatesColumn >= 0) {
+    record["MaxStates"] = {maxStates, true};
+    record["AvgStates"] = {sumStates / rows, false};
+  }
+  return record;
+}
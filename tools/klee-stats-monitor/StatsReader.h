@@ -0,0 +1,69 @@
+//===-- StatsReader.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "Stats.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+///@brief Incremental reader for the run.stats database of one KLEE run
+///
+/// The reader keeps its database connection open and remembers the rowid of
+/// the last row it has seen. Every poll() only fetches rows appended since the
+/// previous call (KLEE writes run.stats in WAL mode, so this is safe while
+/// KLEE is running) and folds them into running aggregates. Polling a large,
+/// unchanged database is therefore cheap.
+class StatsReader final {
+  std::filesystem::path path;
+  ::sqlite3 *db{nullptr};
+  ::sqlite3_stmt *tailStmt{nullptr};
+  ::sqlite3_stmt *rowStmt{nullptr};
+  std::int64_t lastRowID{0};
+
+  // columns of tailStmt holding the aggregated values (-1 if absent)
+  int mallocUsageColumn{-1};
+  int numStatesColumn{-1};
+
+  Record lastRecord;
+  std::uint64_t rows{0};
+  double maxMem{0}, sumMem{0};
+  double maxStates{0}, sumStates{0};
+
+  std::string error;
+
+  bool prepare();
+
+public:
+  /// Opens `path` (a run.stats file); the stats table does not have to exist
+  /// yet
+  explicit StatsReader(std::filesystem::path path);
+  ~StatsReader();
+  StatsReader(const StatsReader &) = delete;
+  StatsReader &operator=(const StatsReader &) = delete;
+
+  /// Reads all rows appended since the last call and returns their number
+  std::uint64_t poll();
+
+  /// Returns the most recent row, extended by the MaxMem, AvgMem, MaxStates,
+  /// and AvgStates aggregates over all rows read so far; empty if no row has
+  /// been read
+  Record getRecord() const;
+
+  /// Returns the total number of rows read
+  std::uint64_t getRowCount() const { return rows; }
+
+  /// Returns the last database error, if any
+  const std::string &getError() const { return error; }
+};
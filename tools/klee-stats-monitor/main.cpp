@@ -0,0 +1,360 @@
+//===-- main.cpp ------------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Printers.h"
+#include "StatsReader.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <csignal>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void print_usage() {
+  std::cout
+      << "Usage: klee-stats-monitor [options] <dir>...\n\n"
+         "Print statistics of KLEE output directories. Directories that are "
+         "not KLEE output\ndirectories are searched recursively.\n\n"
+         "Options:\n"
+         "\t--table-format=<klee|csv|readable-csv>  table format "
+         "(default: klee)\n"
+         "\t--print-all           print all available information\n"
+         "\t--print-rel-times     print only relative times\n"
+         "\t--print-abs-times     print only absolute times (in seconds)\n"
+         "\t--print-expr-opts     print only expression optimisation counts\n"
+         "\t--print-more          print extra information\n"
+         "\t--print-solver-layers print only per-layer statistics of the "
+         "solver chain\n"
+         "\t--print-columns=<c,..> print the given columns, e.g. "
+         "'Path,Time(s),ICov(%)'\n"
+         "\t--prometheus          print all statistics in the Prometheus "
+         "text format\n"
+         "\t--watch=<seconds>     re-read new rows and re-print periodically\n"
+         "\t--listen=<port>       serve Prometheus metrics over HTTP\n"
+         "\t--listen-host=<addr>  address to listen on (default: 127.0.0.1)\n"
+         "\t--jobs=<n>            number of directories read in parallel\n"
+         "\n";
+}
+
+struct Options {
+  std::vector<std::string> dirs;
+  TableFormat format{TableFormat::Klee};
+  Selection selection{Selection::Default};
+  std::vector<std::string> columns;
+  bool prometheus{false};
+  unsigned watch{0};
+  std::optional<std::uint16_t> port;
+  std::string host{"127.0.0.1"};
+  unsigned jobs{std::max(1u, std::thread::hardware_concurrency())};
+};
+
+[[noreturn]] void fail(const std::string &message) {
+  std::cerr << "klee-stats-monitor: " << message << '\n';
+  exit(EXIT_FAILURE);
+}
+
+unsigned parseNumber(const std::string &option, const std::string &value) {
+  char *end;
+  const unsigned long n = std::strtoul(value.c_str(), &end, 10);
+  if (value.empty() || *end || n > 65535)
+    fail("invalid value for " + option + ": '" + value + "'");
+  return static_cast<unsigned>(n);
+}
+
+Options parseOptions(int argc, char *argv[]) {
+  Options options;
+  unsigned selections = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg.size() < 2 || arg[0] != '-') {
+      options.dirs.push_back(arg);
+      continue;
+    }
+
+    // accept both --option=value and --option value
+    std::string value;
+    bool hasValue = false;
+    if (const auto eq = arg.find('='); eq != std::string::npos) {
+      value = arg.substr(eq + 1);
+      arg.resize(eq);
+      hasValue = true;
+    }
+    auto getValue = [&]() {
+      if (hasValue)
+        return value;
+      if (i + 1 >= argc)
+        fail("missing value for " + arg);
+      return std::string(argv[++i]);
+    };
+
+    if (arg == "-h" || arg == "--help") {
+      print_usage();
+      exit(EXIT_SUCCESS);
+    } else if (arg == "--table-format") {
+      const auto format = getValue();
+      if (format == "klee")
+        options.format = TableFormat::Klee;
+      else if (format == "csv")
+        options.format = TableFormat::Csv;
+      else if (format == "readable-csv")
+        options.format = TableFormat::ReadableCsv;
+      else
+        fail("unknown table format '" + format + "'");
+    } else if (arg == "--print-all") {
+      options.selection = Selection::All;
+      ++selections;
+    } else if (arg == "--print-rel-times") {
+      options.selection = Selection::RelTimes;
+      ++selections;
+    } else if (arg == "--print-abs-times") {
+      options.selection = Selection::AbsTimes;
+      ++selections;
+    } else if (arg == "--print-expr-opts") {
+      options.selection = Selection::ExprOpts;
+      ++selections;
+    } else if (arg == "--print-more") {
+      options.selection = Selection::More;
+      ++selections;
+    } else if (arg == "--print-solver-layers") {
+      options.selection = Selection::SolverLayers;
+      ++selections;
+    } else if (arg == "--print-columns") {
+      std::istringstream list(getValue());
+      for (std::string column; std::getline(list, column, ',');) {
+        column.erase(0, column.find_first_not_of(" \t"));
+        column.erase(column.find_last_not_of(" \t") + 1);
+        if (!column.empty())
+          options.columns.push_back(column);
+      }
+      if (options.columns.empty())
+        fail("no column name specified for --print-columns");
+      options.selection = Selection::All;
+      ++selections;
+    } else if (arg == "--prometheus") {
+      options.prometheus = true;
+    } else if (arg == "--watch") {
+      options.watch = parseNumber(arg, getValue());
+    } else if (arg == "--listen") {
+      options.port = static_cast<std::uint16_t>(parseNumber(arg, getValue()));
+    } else if (arg == "--listen-host") {
+      options.host = getValue();
+    } else if (arg == "--jobs") {
+      options.jobs = std::max(1u, parseNumber(arg, getValue()));
+    } else {
+      print_usage();
+      fail("unknown option '" + arg + "'");
+    }
+  }
+
+  if (selections > 1)
+    fail("the --print-* options are mutually exclusive");
+  if (options.dirs.empty()) {
+    print_usage();
+    exit(EXIT_FAILURE);
+  }
+  return options;
+}
+
+bool isKleeOutDir(const fs::path &dir) {
+  std::error_code ec;
+  return fs::exists(dir / "info", ec) && fs::exists(dir / "run.stats", ec);
+}
+
+/// @brief Incrementally maintained statistics of many KLEE output directories
+///
+/// Keeps one StatsReader (and thereby one read cursor) per output directory.
+/// Directories are rediscovered on every refresh, so runs that start while
+/// the tool is watching are picked up as well.
+class Monitor final {
+  const std::vector<std::string> &roots;
+  const unsigned jobs;
+  // in order of discovery
+  std::vector<std::pair<std::string, std::unique_ptr<StatsReader>>> readers;
+  std::set<std::string> known;
+
+  void discover() {
+    for (const auto &root : roots) {
+      if (isKleeOutDir(root)) {
+        add(root);
+        continue;
+      }
+      std::vector<std::string> found;
+      std::error_code ec;
+      for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end;
+           it.increment(ec)) {
+        if (it->is_directory(ec) && isKleeOutDir(it->path()))
+          found.push_back(it->path().string());
+      }
+      std::sort(found.begin(), found.end());
+      for (const auto &dir : found)
+        add(dir);
+    }
+  }
+
+  void add(const std::string &dir) {
+    if (known.insert(dir).second)
+      readers.emplace_back(
+          dir, std::make_unique<StatsReader>(fs::path(dir) / "run.stats"));
+  }
+
+public:
+  Monitor(const std::vector<std::string> &roots, unsigned jobs)
+      : roots(roots), jobs(jobs) {}
+
+  /// Picks up new directories and reads new rows from all of them
+  void refresh() {
+    discover();
+
+    std::vector<StatsReader *> work;
+    for (auto &[dir, reader] : readers)
+      work.push_back(reader.get());
+
+    // every reader has its own connection, so they can be polled in parallel
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]() {
+      for (std::size_t i; (i = next++) < work.size();)
+        work[i]->poll();
+    };
+    std::vector<std::thread> threads;
+    const auto n = std::min<std::size_t>(jobs, work.size());
+    for (std::size_t i = 1; i < n; ++i)
+      threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  std::vector<Run> getRuns() const {
+    std::vector<Run> runs;
+    for (const auto &[dir, reader] : readers)
+      runs.emplace_back(fs::path(dir).lexically_normal().string(),
+                        reader->getRecord());
+    return runs;
+  }
+
+  bool empty() const { return readers.empty(); }
+};
+
+/// Answers every HTTP request on host:port with the current metrics.
+/// Clients are served one at a time, so each of them only gets a few seconds
+/// to send its request and receive the response.
+[[noreturn]] void serve(Monitor &monitor, const Options &options) {
+  // a client closing the connection early must not terminate the monitor
+  std::signal(SIGPIPE, SIG_IGN);
+
+  const int server = socket(AF_INET, SOCK_STREAM, 0);
+  if (server < 0)
+    fail(std::string("cannot create socket: ") + std::strerror(errno));
+  const int yes = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(*options.port);
+  if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1)
+    fail("invalid listen address '" + options.host + "'");
+  if (bind(server, reinterpret_cast<sockaddr *>(&address), sizeof(address)) ||
+      listen(server, 16))
+    fail("cannot listen on " + options.host + ":" +
+         std::to_string(*options.port) + ": " + std::strerror(errno));
+  std::cerr << "klee-stats-monitor: serving metrics on http://" << options.host
+            << ':' << *options.port << "/metrics\n";
+
+  for (;;) {
+    const int client = accept(server, nullptr, nullptr);
+    if (client < 0)
+      continue;
+    timeval timeout{};
+    timeout.tv_sec = 5;
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // read (and ignore) the request header
+    char buffer[4096];
+    std::string request;
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           request.size() < 64 * 1024) {
+      const auto n = recv(client, buffer, sizeof(buffer), 0);
+      if (n <= 0)
+        break;
+      request.append(buffer, n);
+    }
+
+    monitor.refresh();
+    std::ostringstream body;
+    printMetrics(body, monitor.getRuns());
+    const std::string content = body.str();
+    const std::string response =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: " +
+        std::to_string(content.size()) + "\r\n\r\n" + content;
+    for (std::size_t sent = 0; sent < response.size();) {
+      const auto n = send(client, response.data() + sent,
+                          response.size() - sent, 0);
+      if (n <= 0)
+        break;
+      sent += n;
+    }
+    close(client);
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const Options options = parseOptions(argc, argv);
+
+  Monitor monitor(options.dirs, options.jobs);
+  monitor.refresh();
+  if (monitor.empty()) {
+    std::cerr << "No KLEE output directory found\n";
+    exit(EXIT_FAILURE);
+  }
+
+  if (options.port)
+    serve(monitor, options);
+
+  for (;;) {
+    const auto runs = monitor.getRuns();
+    if (options.prometheus)
+      printMetrics(std::cout, runs);
+    else if (!printTable(std::cout, runs, options.selection, options.columns,
+                         options.format))
+      exit(EXIT_FAILURE);
+    std::cout.flush();
+
+    if (!options.watch)
+      break;
+    std::this_thread::sleep_for(std::chrono::seconds(options.watch));
+    std::cout << '\n';
+    monitor.refresh();
+  }
+}
@@ -22,6 +22,7 @@
 #include "klee/Support/ModuleUtil.h"
 #include "klee/Support/OptionCategories.h"
 #include "klee/Support/PrintVersion.h"
+#include "klee/Support/Profiler.h"
 #include "klee/System/Time.h"
 
 #include "klee/Support/CompilerWarning.h"
@@ -55,11 +56,15 @@ DISABLE_WARNING_POP
 #include <unistd.h>
 
 #include <cerrno>
+#include <condition_variable>
 #include <ctime>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iterator>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 using namespace llvm;
 using namespace klee;
@@ -119,6 +124,40 @@ namespace {
                 cl::desc("Write .sym.path files for each test case (default=false)"),
                 cl::cat(TestCaseCat));
 
+  cl::opt<bool>
+  AsyncTestOutput("async-test-output",
+                  cl::desc("Write test case files on a background thread. "
+                           "Test cases are still solved on the interpreter "
+                           "thread (default=false)"),
+                  cl::init(false),
+                  cl::cat(TestCaseCat));
+
+  cl::opt<unsigned>
+  AsyncTestOutputQueue("async-test-output-queue",
+                       cl::desc("Maximum number of test cases waiting to be "
+                                "written with --async-test-output. The "
+                                "interpreter blocks while the queue is full "
+                                "(default=64)"),
+                       cl::init(64),
+                       cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  WriteKTestArchive("write-ktest-archive",
+                    cl::desc("Append all .ktest files to a single test "
+                             "archive (tests.ktests) in the output directory "
+                             "instead of writing one file per test "
+                             "(default=false)"),
+                    cl::init(false),
+                    cl::cat(TestCaseCat));
+
+  cl::opt<bool>
+  CompressKTestArchive("compress-ktest-archive",
+                       cl::desc("Compress the tests in the test archive "
+                                "written with --write-ktest-archive "
+                                "(default=false)"),
+                       cl::init(false),
+                       cl::cat(TestCaseCat));
+
 
   /*** Startup options ***/
 
@@ -233,7 +272,8 @@ namespace {
   
   cl::list<std::string>
   ReplayKTestFile("replay-ktest-file",
-                  cl::desc("Specify a .ktest file to use for replay"),
+                  cl::desc("Specify a .ktest file or test archive to use "
+                           "for replay"),
                   cl::value_desc(".ktest file"),
                   cl::cat(ReplayCat));
 
@@ -253,7 +293,7 @@ namespace {
 
   cl::list<std::string>
   SeedOutFile("seed-file",
-              cl::desc(".ktest file to be used as seed"),
+              cl::desc(".ktest file or test archive to be used as seed"),
               cl::cat(SeedingCat));
 
   cl::list<std::string>
@@ -295,11 +335,315 @@ class ExecutionState;
 
 /***/
 
+/// Writes the files that make up generated test cases, either immediately or
+/// on a background thread.
+///
+/// Only the output is handed over: test cases are solved and their
+/// constraints printed on the interpreter thread, as expressions and solvers
+/// are not thread-safe. In asynchronous mode, at most `queueSize` test cases
+/// wait to be written, and submit() blocks while the queue is full, which
+/// bounds the memory held by pending test cases.
+///
+/// Pending test cases are also written when KLEE exits early, e.g. through
+/// klee_error(), as the writer finishes from an exit handler.
+class TestCaseWriter {
+public:
+  struct TestCase {
+    unsigned id = 0;
+    /// Whether a .ktest file with `objects` should be written.
+    bool hasKTest = false;
+    std::vector<std::pair<std::string, std::vector<unsigned char>>> objects;
+    /// Additional files as (suffix, contents) pairs.
+    std::vector<std::pair<std::string, std::string>> files;
+    /// Whether an .info file should be written, reporting `generationTime`
+    /// plus the time it took to write the other files.
+    bool hasInfo = false;
+    time::Span generationTime;
+  };
+
+private:
+  std::string m_outputDirectory;
+  int m_argc;
+  char **m_argv;
+  std::size_t m_queueSize;
+  /// Archive receiving all .ktest files, if any
+  KTestArchive *m_archive = nullptr;
+
+  std::mutex m_mutex;
+  std::condition_variable m_changed;
+  std::deque<TestCase> m_pending;
+  bool m_busy = false;
+  bool m_done = false;
+  /// Problems encountered by the writer, reported by takeWarnings()
+  std::vector<std::string> m_warnings;
+  unsigned m_lostKTests = 0;
+  std::thread m_thread;
+
+  /// The writer finished by the exit handler
+  static TestCaseWriter *s_active;
+  static void finishOnExit();
+
+  void write(const TestCase &testCase, std::vector<std::string> &warnings,
+             unsigned &lostKTests) const;
+  void run();
+
+public:
+  TestCaseWriter(std::string outputDirectory, int argc, char **argv,
+                 bool async, std::size_t queueSize,
+                 const std::string &archivePath, bool compressArchive);
+  ~TestCaseWriter();
+
+  static std::string getTestFilename(const std::string &suffix, unsigned id);
+
+  /// Writes `testCase` or queues it for writing.
+  void submit(TestCase testCase);
+  /// Blocks until all submitted test cases have been written.
+  void flush();
+  /// Writes all submitted test cases, stops the background thread and closes
+  /// the test archive. Test cases must not be submitted afterwards.
+  void finish();
+  /// Moves the warnings collected so far into `warnings`.
+  /// \return the number of .ktest files that could not be written
+  unsigned takeWarnings(std::vector<std::string> &warnings);
+};
+
+TestCaseWriter::TestCaseWriter(std::string outputDirectory, int argc,
+                               char **argv, bool async, std::size_t queueSize,
+                               const std::string &archivePath,
+                               bool compressArchive)
+    : m_outputDirectory(std::move(outputDirectory)), m_argc(argc),
+      m_argv(argv), m_queueSize(std::max<std::size_t>(queueSize, 1)) {
+  if (!archivePath.empty()) {
+    m_archive = kTestArchive_openForAppend(archivePath.c_str(),
+                                           compressArchive);
+    if (!m_archive)
+      klee_error("cannot open test archive \"%s\"", archivePath.c_str());
+  }
+  if (async)
+    m_thread = std::thread(&TestCaseWriter::run, this);
+
+  static bool registered = false;
+  if (!registered) {
+    atexit(finishOnExit);
+    registered = true;
+  }
+  s_active = this;
+}
+
+TestCaseWriter::~TestCaseWriter() { finish(); }
+
+TestCaseWriter *TestCaseWriter::s_active = nullptr;
+
+void TestCaseWriter::finishOnExit() {
+  if (TestCaseWriter *writer = s_active) {
+    writer->finish();
+    std::vector<std::string> warnings;
+    writer->takeWarnings(warnings);
+    for (const auto &warning : warnings)
+      klee_warning("%s", warning.c_str());
+  }
+}
+
+void TestCaseWriter::finish() {
+  if (s_active == this)
+    s_active = nullptr;
+  if (m_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_done = true;
+    }
+    m_changed.notify_all();
+    m_thread.join();
+  }
+  if (m_archive && !kTestArchive_close(m_archive))
+    klee_warning("unable to write the index of the test archive");
+  m_archive = nullptr;
+}
+
+std::string TestCaseWriter::getTestFilename(const std::string &suffix,
+                                            unsigned id) {
+  std::stringstream filename;
+  filename << "test" << std::setfill('0') << std::setw(6) << id << '.' << suffix;
+  return filename.str();
+}
+
+void TestCaseWriter::write(const TestCase &testCase,
+                           std::vector<std::string> &warnings,
+                           unsigned &lostKTests) const {
+  const auto startTime = time::getWallTime();
+  auto getPath = [&](const std::string &suffix) {
+    SmallString<128> path(m_outputDirectory);
+    sys::path::append(path, getTestFilename(suffix, testCase.id));
+    return std::string(path.str());
+  };
+
+  if (testCase.hasKTest) {
+    KTest b;
+    b.numArgs = m_argc;
+    b.args = m_argv;
+    b.symArgvs = 0;
+    b.symArgvLen = 0;
+    b.numObjects = testCase.objects.size();
+    b.objects = new KTestObject[b.numObjects];
+    assert(b.objects);
+    for (unsigned i=0; i<b.numObjects; i++) {
+      KTestObject *o = &b.objects[i];
+      o->name = const_cast<char*>(testCase.objects[i].first.c_str());
+      o->numBytes = testCase.objects[i].second.size();
+      o->bytes = const_cast<unsigned char *>(testCase.objects[i].second.data());
+    }
+
+    if (m_archive ? !kTestArchive_append(m_archive, &b, testCase.id)
+                  : !kTest_toFile(&b, getPath("ktest").c_str())) {
+      warnings.emplace_back("unable to write output test case, losing it");
+      ++lostKTests;
+    }
+
+    delete[] b.objects;
+  }
+
+  auto openFile = [&](const std::string &suffix) {
+    std::string error;
+    std::string path = getPath(suffix);
+    auto f = klee_open_output_file(path, error);
+    if (!f)
+      warnings.emplace_back(
+          "error opening file \"" + path +
+          "\".  KLEE may have run out of file descriptors: try to increase "
+          "the maximum number of open file descriptors by using ulimit (" +
+          error + ").");
+    return f;
+  };
+
+  for (const auto &[suffix, contents] : testCase.files) {
+    if (auto f = openFile(suffix))
+      *f << contents;
+  }
+
+  if (testCase.hasInfo) {
+    if (auto f = openFile("info")) {
+      const time::Span elapsed(time::getWallTime() - startTime);
+      *f << "Time to generate test case: "
+         << testCase.generationTime + elapsed << '\n';
+    }
+  }
+}
+
+void TestCaseWriter::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  for (;;) {
+    m_changed.wait(lock, [this] { return m_done || !m_pending.empty(); });
+    if (m_pending.empty())
+      return;
+
+    TestCase testCase = std::move(m_pending.front());
+    m_pending.pop_front();
+    m_busy = true;
+    lock.unlock();
+    m_changed.notify_all();
+
+    std::vector<std::string> warnings;
+    unsigned lostKTests = 0;
+    write(testCase, warnings, lostKTests);
+
+    lock.lock();
+    m_busy = false;
+    m_warnings.insert(m_warnings.end(), warnings.begin(), warnings.end());
+    m_lostKTests += lostKTests;
+    m_changed.notify_all();
+  }
+}
+
+void TestCaseWriter::submit(TestCase testCase) {
+  if (!m_thread.joinable()) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write(testCase, m_warnings, m_lostKTests);
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this] { return m_pending.size() < m_queueSize; });
+    m_pending.emplace_back(std::move(testCase));
+  }
+  m_changed.notify_all();
+}
+
+void TestCaseWriter::flush() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_changed.wait(lock, [this] { return m_pending.empty() && !m_busy; });
+}
+
+unsigned TestCaseWriter::takeWarnings(std::vector<std::string> &warnings) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  warnings.insert(warnings.end(), m_warnings.begin(), m_warnings.end());
+  m_warnings.clear();
+  unsigned lostKTests = m_lostKTests;
+  m_lostKTests = 0;
+  return lostKTests;
+}
+
+/***/
+
+/// Tests read from .ktest files and test archives. Tests in archives are not
+/// copied: they refer to the memory-mapped archive, which stays open as long
+/// as the loader exists.
+class KTestLoader {
+  std::vector<KTest *> m_copies;
+  std::vector<KTestArchive *> m_archives;
+
+public:
+  std::vector<KTest *> tests;
+
+  KTestLoader() = default;
+  KTestLoader(const KTestLoader &) = delete;
+  KTestLoader &operator=(const KTestLoader &) = delete;
+  ~KTestLoader() {
+    for (KTest *test : m_copies)
+      kTest_free(test);
+    for (KTestArchive *archive : m_archives)
+      kTestArchive_close(archive);
+  }
+
+  /// Adds the test in the .ktest file `path` or all tests in the test
+  /// archive `path` to `tests`.
+  /// \return false if `path` cannot be read, in which case no test is added
+  bool load(const std::string &path) {
+    if (kTestArchive_isArchive(path.c_str())) {
+      KTestArchive *archive = kTestArchive_open(path.c_str());
+      if (!archive)
+        return false;
+      const auto numLoaded = tests.size();
+      for (unsigned i = 0, e = kTestArchive_numTests(archive); i != e; ++i) {
+        KTest *test = kTestArchive_view(archive, i);
+        if (!test) {
+          tests.resize(numLoaded);
+          kTestArchive_close(archive);
+          return false;
+        }
+        tests.push_back(test);
+      }
+      m_archives.push_back(archive);
+      return true;
+    }
+
+    KTest *test = kTest_fromFile(path.c_str());
+    if (!test)
+      return false;
+    m_copies.push_back(test);
+    tests.push_back(test);
+    return true;
+  }
+};
+
+/***/
+
 class KleeHandler : public InterpreterHandler {
 private:
   Interpreter *m_interpreter;
   TreeStreamWriter *m_pathWriter, *m_symPathWriter;
   std::unique_ptr<llvm::raw_ostream> m_infoFile;
+  std::unique_ptr<TestCaseWriter> m_testCaseWriter;
 
   SmallString<128> m_outputDirectory;
 
@@ -312,6 +656,9 @@ private:
   int m_argc;
   char **m_argv;
 
+  /// Reports problems of the test case writer and accounts for lost tests.
+  void reportTestCaseWarnings();
+
 public:
   KleeHandler(int argc, char **argv);
   ~KleeHandler();
@@ -331,10 +678,11 @@ public:
                        const char *errorMessage,
                        const char *errorSuffix);
 
+  /// Waits until all test cases have been written to disk.
+  void flushTestCases();
+
   std::string getOutputFilename(const std::string &filename);
   std::unique_ptr<llvm::raw_fd_ostream> openOutputFile(const std::string &filename);
-  std::string getTestFilename(const std::string &suffix, unsigned id);
-  std::unique_ptr<llvm::raw_fd_ostream> openTestFile(const std::string &suffix, unsigned id);
 
   // load a .path file
   static void loadPathFile(std::string name,
@@ -420,9 +768,16 @@ KleeHandler::KleeHandler(int argc, char **argv)
 
   // open info
   m_infoFile = openOutputFile("info");
+
+  m_testCaseWriter = std::make_unique<TestCaseWriter>(
+      m_outputDirectory.str().str(), m_argc, m_argv, AsyncTestOutput,
+      AsyncTestOutputQueue,
+      WriteKTestArchive ? getOutputFilename("tests.ktests") : "",
+      CompressKTestArchive);
 }
 
 KleeHandler::~KleeHandler() {
+  m_testCaseWriter.reset();
   delete m_pathWriter;
   delete m_symPathWriter;
   fclose(klee_warning_file);
@@ -466,25 +821,14 @@ KleeHandler::openOutputFile(const std::string &filename) {
   return f;
 }
 
-std::string KleeHandler::getTestFilename(const std::string &suffix, unsigned id) {
-  std::stringstream filename;
-  filename << "test" << std::setfill('0') << std::setw(6) << id << '.' << suffix;
-  return filename.str();
-}
-
-std::unique_ptr<llvm::raw_fd_ostream>
-KleeHandler::openTestFile(const std::string &suffix, unsigned id) {
-  return openOutputFile(getTestFilename(suffix, id));
-}
-
 
 /* Outputs all files (.ktest, .kquery, .cov etc.) describing a test case */
 void KleeHandler::processTestCase(const ExecutionState &state,
                                   const char *errorMessage,
                                   const char *errorSuffix) {
   if (!WriteNone) {
-    std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
-    bool success = m_interpreter->getSymbolicSolution(state, out);
+    TestCaseWriter::TestCase testCase;
+    bool success = m_interpreter->getSymbolicSolution(state, testCase.objects);
 
     if (!success)
       klee_warning("unable to get symbolic solution, losing test case");
@@ -492,60 +836,32 @@ void KleeHandler::processTestCase(const ExecutionState &state,
     const auto start_time = time::getWallTime();
 
     unsigned id = ++m_numTotalTests;
+    testCase.id = id;
 
     if (success) {
-      KTest b;
-      b.numArgs = m_argc;
-      b.args = m_argv;
-      b.symArgvs = 0;
-      b.symArgvLen = 0;
-      b.numObjects = out.size();
-      b.objects = new KTestObject[b.numObjects];
-      assert(b.objects);
-      for (unsigned i=0; i<b.numObjects; i++) {
-        KTestObject *o = &b.objects[i];
-        o->name = const_cast<char*>(out[i].first.c_str());
-        o->numBytes = out[i].second.size();
-        o->bytes = new unsigned char[o->numBytes];
-        assert(o->bytes);
-        std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
-      }
-
-      if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
-        klee_warning("unable to write output test case, losing it");
-      } else {
-        ++m_numGeneratedTests;
-      }
-
-      for (unsigned i=0; i<b.numObjects; i++)
-        delete[] b.objects[i].bytes;
-      delete[] b.objects;
+      testCase.hasKTest = true;
+      ++m_numGeneratedTests;
     }
 
-    if (errorMessage) {
-      auto f = openTestFile(errorSuffix, id);
-      if (f)
-        *f << errorMessage;
-    }
+    if (errorMessage)
+      testCase.files.emplace_back(errorSuffix, errorMessage);
 
     if (m_pathWriter) {
       std::vector<unsigned char> concreteBranches;
       m_pathWriter->readStream(m_interpreter->getPathStreamID(state),
                                concreteBranches);
-      auto f = openTestFile("path", id);
-      if (f) {
-        for (const auto &branch : concreteBranches) {
-          *f << branch << '\n';
-        }
+      std::string contents;
+      llvm::raw_string_ostream f(contents);
+      for (const auto &branch : concreteBranches) {
+        f << branch << '\n';
       }
+      testCase.files.emplace_back("path", f.str());
     }
 
     if (errorMessage || WriteKQueries) {
       std::string constraints;
       m_interpreter->getConstraintLog(state, constraints,Interpreter::KQUERY);
-      auto f = openTestFile("kquery", id);
-      if (f)
-        *f << constraints;
+      testCase.files.emplace_back("kquery", std::move(constraints));
     }
 
     if (WriteCVCs) {
@@ -553,61 +869,72 @@ void KleeHandler::processTestCase(const ExecutionState &state,
       // SMT-LIBv2 not CVC which is a bit confusing
       std::string constraints;
       m_interpreter->getConstraintLog(state, constraints, Interpreter::STP);
-      auto f = openTestFile("cvc", id);
-      if (f)
-        *f << constraints;
+      testCase.files.emplace_back("cvc", std::move(constraints));
     }
 
     if (WriteSMT2s) {
       std::string constraints;
         m_interpreter->getConstraintLog(state, constraints, Interpreter::SMTLIB2);
-        auto f = openTestFile("smt2", id);
-        if (f)
-          *f << constraints;
+        testCase.files.emplace_back("smt2", std::move(constraints));
     }
 
     if (m_symPathWriter) {
       std::vector<unsigned char> symbolicBranches;
       m_symPathWriter->readStream(m_interpreter->getSymbolicPathStreamID(state),
                                   symbolicBranches);
-      auto f = openTestFile("sym.path", id);
-      if (f) {
-        for (const auto &branch : symbolicBranches) {
-          *f << branch << '\n';
-        }
+      std::string contents;
+      llvm::raw_string_ostream f(contents);
+      for (const auto &branch : symbolicBranches) {
+        f << branch << '\n';
       }
+      testCase.files.emplace_back("sym.path", f.str());
     }
 
     if (WriteCov) {
       std::map<const std::string*, std::set<unsigned> > cov;
       m_interpreter->getCoveredLines(state, cov);
-      auto f = openTestFile("cov", id);
-      if (f) {
-        for (const auto &entry : cov) {
-          for (const auto &line : entry.second) {
-            *f << *entry.first << ':' << line << '\n';
-          }
+      std::string contents;
+      llvm::raw_string_ostream f(contents);
+      for (const auto &entry : cov) {
+        for (const auto &line : entry.second) {
+          f << *entry.first << ':' << line << '\n';
         }
       }
+      testCase.files.emplace_back("cov", f.str());
     }
 
-    if (m_numGeneratedTests == MaxTests)
-      m_interpreter->setHaltExecution(true);
-
+    // the writer adds the time it takes to write the files
     if (WriteTestInfo) {
-      time::Span elapsed_time(time::getWallTime() - start_time);
-      auto f = openTestFile("info", id);
-      if (f)
-        *f << "Time to generate test case: " << elapsed_time << '\n';
+      testCase.hasInfo = true;
+      testCase.generationTime = time::getWallTime() - start_time;
     }
+
+    m_testCaseWriter->submit(std::move(testCase));
+    reportTestCaseWarnings();
+
+    if (m_numGeneratedTests == MaxTests)
+      m_interpreter->setHaltExecution(true);
   } // if (!WriteNone)
 
   if (errorMessage && OptExitOnError) {
+    flushTestCases();
     m_interpreter->prepareForEarlyExit();
     klee_error("EXITING ON ERROR:\n%s\n", errorMessage);
   }
 }
 
+void KleeHandler::flushTestCases() {
+  m_testCaseWriter->flush();
+  reportTestCaseWarnings();
+}
+
+void KleeHandler::reportTestCaseWarnings() {
+  std::vector<std::string> warnings;
+  m_numGeneratedTests -= m_testCaseWriter->takeWarnings(warnings);
+  for (const auto &warning : warnings)
+    klee_warning("%s", warning.c_str());
+}
+
   // load a .path file
 void KleeHandler::loadPathFile(std::string name,
                                      std::vector<bool> &buffer) {
@@ -631,7 +958,8 @@ void KleeHandler::getKTestFilesInDir(std::string directoryPath,
   llvm::sys::fs::directory_iterator i(directoryPath, ec), e;
   for (; i != e && !ec; i.increment(ec)) {
     auto f = i->path();
-    if (f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") {
+    if ((f.size() >= 6 && f.substr(f.size()-6,f.size()) == ".ktest") ||
+        (f.size() >= 7 && f.substr(f.size()-7,f.size()) == ".ktests")) {
       results.push_back(f);
     }
   }
@@ -1430,6 +1758,8 @@ int main(int argc, char **argv, char **envp) {
     handler->getInfoStream().flush();
   }
 
+  profiler::start();
+
   if (!ReplayKTestDir.empty() || !ReplayKTestFile.empty()) {
     assert(SeedOutFile.empty());
     assert(SeedOutDir.empty());
@@ -1439,17 +1769,14 @@ int main(int argc, char **argv, char **envp) {
            it = ReplayKTestDir.begin(), ie = ReplayKTestDir.end();
          it != ie; ++it)
       KleeHandler::getKTestFilesInDir(*it, kTestFiles);
-    std::vector<KTest*> kTests;
+    KTestLoader loader;
     for (std::vector<std::string>::iterator
            it = kTestFiles.begin(), ie = kTestFiles.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (out) {
-        kTests.push_back(out);
-      } else {
+      if (!loader.load(*it))
         klee_warning("unable to open: %s\n", (*it).c_str());
-      }
     }
+    std::vector<KTest *> &kTests = loader.tests;
 
     if (RunInDir != "") {
       int res = chdir(RunInDir.c_str());
@@ -1467,26 +1794,20 @@ int main(int argc, char **argv, char **envp) {
       interpreter->setReplayKTest(out);
       llvm::errs() << "KLEE: replaying: " << *it << " (" << kTest_numBytes(out)
                    << " bytes)"
-                   << " (" << ++i << "/" << kTestFiles.size() << ")\n";
+                   << " (" << ++i << "/" << kTests.size() << ")\n";
       // XXX should put envp in .ktest ?
       interpreter->runFunctionAsMain(entryFn, out->numArgs, out->args, pEnvp);
       if (interrupted) break;
     }
     interpreter->setReplayKTest(0);
-    while (!kTests.empty()) {
-      kTest_free(kTests.back());
-      kTests.pop_back();
-    }
   } else {
-    std::vector<KTest *> seeds;
+    KTestLoader loader;
     for (std::vector<std::string>::iterator
            it = SeedOutFile.begin(), ie = SeedOutFile.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (!out) {
+      if (!loader.load(*it)) {
         klee_error("unable to open: %s\n", (*it).c_str());
       }
-      seeds.push_back(out);
     }
     for (std::vector<std::string>::iterator
            it = SeedOutDir.begin(), ie = SeedOutDir.end();
@@ -1496,17 +1817,16 @@ int main(int argc, char **argv, char **envp) {
       for (std::vector<std::string>::iterator
              it2 = kTestFiles.begin(), ie = kTestFiles.end();
            it2 != ie; ++it2) {
-        KTest *out = kTest_fromFile(it2->c_str());
-        if (!out) {
+        if (!loader.load(*it2)) {
           klee_error("unable to open: %s\n", (*it2).c_str());
         }
-        seeds.push_back(out);
       }
       if (kTestFiles.empty()) {
         klee_error("seeds directory is empty: %s\n", (*it).c_str());
       }
     }
 
+    std::vector<KTest *> &seeds = loader.tests;
     if (!seeds.empty()) {
       klee_message("KLEE: using %lu seeds\n", seeds.size());
       interpreter->useSeeds(&seeds);
@@ -1520,11 +1840,16 @@ int main(int argc, char **argv, char **envp) {
     }
 
     interpreter->runFunctionAsMain(entryFn, pArgc, pArgv, pEnvp);
+  }
 
-    while (!seeds.empty()) {
-      kTest_free(seeds.back());
-      seeds.pop_back();
-    }
+  handler->flushTestCases();
+
+  profiler::stop();
+  if (profiler::isEnabled()) {
+    if (auto f = handler->openOutputFile("profile.folded"))
+      profiler::writeFoldedStacks(*f);
+    if (auto f = handler->openOutputFile("profile.txt"))
+      profiler::writeSummary(*f);
   }
 
   auto endTime = std::time(nullptr);
@@ -42,6 +42,7 @@ void print_usage_and_exit(char *program_name) {
     "Usage: %s <arguments>\n"
     "       <arguments> are the command-line arguments of the program, with the following treated as special:\n"
     "       --bout-file <filename>      - Specifying the output file name for the ktest file (default: file.bout).\n"
+    "       --archive <filename>        - Append the test to the given test archive instead of writing a ktest file.\n"
     "       --sym-stdin <filename>      - Specifying a file that is the content of stdin (only once).\n"
     "       --sym-stdout <filename>     - Specifying a file that is the content of stdout (only once).\n"
     "       --sym-file <filename>       - Specifying a file that is the content of a file named A provided for the program (only once).\n"
@@ -58,6 +59,7 @@ int main(int argc, char *argv[]) {
   char *content_filenames_list[1024];
   char **argv_copy;
   char *bout_file = NULL;
+  char *archive_file = NULL;
 
   if (argc < 2)
     print_usage_and_exit(argv[0]);
@@ -110,6 +112,12 @@ int main(int argc, char *argv[]) {
         print_usage_and_exit(argv[0]);
 
       bout_file = argv[i];
+    } else if (strcmp(argv[i], "--archive") == 0 ||
+               strcmp(argv[i], "-archive") == 0) {
+      if (++i == (unsigned)argc)
+        print_usage_and_exit(argv[0]);
+
+      archive_file = argv[i];
     } else {
       long nbytes = strlen(argv[i]) + 1;
       static int total_args = 0;
@@ -292,7 +300,15 @@ int main(int argc, char *argv[]) {
   b.numArgs = argv_copy_idx;
   b.args = argv_copy;
 
-  if (!kTest_toFile(&b, bout_file ? bout_file : "file.bout"))
+  if (archive_file) {
+    KTestArchive *archive = kTestArchive_openForAppend(archive_file, 0);
+    if (!archive ||
+        !kTestArchive_append(archive, &b, kTestArchive_numTests(archive) + 1) ||
+        !kTestArchive_close(archive)) {
+      fprintf(stderr, "Could not append to test archive %s\n", archive_file);
+      return 1;
+    }
+  } else if (!kTest_toFile(&b, bout_file ? bout_file : "file.bout"))
     assert(0);
 
   for (int i = 0; i < (int)b.numObjects; ++i) {
@@ -2,6 +2,7 @@
 
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/CompiledExpr.h"
 #include "klee/Expr/ExprBuilder.h"
 
 #include <iostream>
@@ -36,3 +37,122 @@ TEST(AssignmentTest, FoldNotOptimized)
   ASSERT_TRUE(asConstant != NULL);
   ASSERT_EQ(asConstant->getZExtValue(), (unsigned) 128);
 }
+
+TEST(AssignmentTest, CompiledExpr)
+{
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", /*size=*/ 4);
+  std::vector<ref<ConstantExpr>> init = {ConstantExpr::alloc(3, Expr::Int8),
+                                          ConstantExpr::alloc(250, Expr::Int8)};
+  const Array *constArray =
+      ac.CreateArray("const", 2, init.data(), init.data() + init.size());
+
+  auto byte = [&](unsigned i) {
+    return ReadExpr::create(UpdateList(array, nullptr),
+                            ConstantExpr::alloc(i, Expr::Int32));
+  };
+  ref<Expr> x = ConcatExpr::create(byte(1), byte(0));
+  ref<Expr> y = SExtExpr::create(byte(2), Expr::Int16);
+  ref<Expr> index = ZExtExpr::create(byte(3), Expr::Int32);
+  UpdateList updated(array, nullptr);
+  updated.extend(ConstantExpr::alloc(0, Expr::Int32), byte(2));
+  updated.extend(index, ConstantExpr::alloc(42, Expr::Int8));
+
+  std::vector<ref<Expr>> exprs = {
+      AddExpr::create(x, y),
+      MulExpr::create(x, y),
+      UDivExpr::create(x, y),
+      SDivExpr::create(x, y),
+      SRemExpr::create(x, y),
+      URemExpr::create(x, ZExtExpr::create(byte(3), Expr::Int16)),
+      ShlExpr::create(x, ZExtExpr::create(byte(3), Expr::Int16)),
+      AShrExpr::create(y, ZExtExpr::create(byte(3), Expr::Int16)),
+      LShrExpr::create(x, ZExtExpr::create(byte(3), Expr::Int16)),
+      ExtractExpr::create(MulExpr::create(ZExtExpr::create(x, Expr::Int64),
+                                          ZExtExpr::create(y, Expr::Int64)),
+                          13, Expr::Int32),
+      SelectExpr::create(SltExpr::create(y, x), NotExpr::create(x), y),
+      SleExpr::create(x, y),
+      UgtExpr::create(x, y),
+      ReadExpr::create(UpdateList(constArray, nullptr), index),
+      ReadExpr::create(updated, ConstantExpr::alloc(0, Expr::Int32)),
+      ReadExpr::create(updated, ConstantExpr::alloc(1, Expr::Int32)),
+      ReadExpr::create(updated, index),
+      // too wide to be compiled
+      ZExtExpr::create(x, 128),
+  };
+  CompiledExpr compiled(exprs.begin(), exprs.end());
+
+  std::vector<std::vector<unsigned char>> inputs = {
+      {0, 0, 0, 0}, {1, 2, 3, 4}, {255, 255, 255, 255}, {0, 128, 255, 1},
+      {7, 0, 128, 16}, {200, 100, 0, 0}, {9, 9, 2}};
+  for (auto &input : inputs) {
+    std::vector<const Array *> objects = {array};
+    std::vector<std::vector<unsigned char>> values = {input};
+    for (bool allowFreeValues : {false, true}) {
+      Assignment assignment(objects, values, allowFreeValues);
+      for (unsigned i = 0; i < exprs.size(); ++i)
+        EXPECT_EQ(assignment.evaluate(exprs[i]),
+                  compiled.evaluate(assignment, i));
+    }
+  }
+
+  std::vector<const Array *> objects = {array};
+  std::vector<std::vector<unsigned char>> values = {{1, 2, 3, 4}};
+  Assignment assignment(objects, values);
+  std::vector<ref<Expr>> constraints = {
+      EqExpr::create(byte(0), ConstantExpr::alloc(1, Expr::Int8)),
+      UltExpr::create(x, ConstantExpr::alloc(1000, Expr::Int16))};
+  EXPECT_TRUE(CompiledExpr(constraints.begin(), constraints.end())
+                  .satisfies(assignment));
+  constraints.push_back(EqExpr::create(y, ConstantExpr::alloc(4, Expr::Int16)));
+  EXPECT_FALSE(CompiledExpr(constraints.begin(), constraints.end())
+                   .satisfies(assignment));
+}
+
+TEST(AssignmentTest, CompiledExprBatch)
+{
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", /*size=*/ 2);
+  ref<Expr> x = ReadExpr::create(UpdateList(array, nullptr),
+                                 ConstantExpr::alloc(0, Expr::Int32));
+  ref<Expr> y = ReadExpr::create(UpdateList(array, nullptr),
+                                 ConstantExpr::alloc(1, Expr::Int32));
+  std::vector<ref<Expr>> constraints = {
+      UltExpr::create(ConstantExpr::alloc(200, Expr::Int8), x),
+      EqExpr::create(ConstantExpr::alloc(3, Expr::Int8),
+                     URemExpr::create(x, y))};
+  CompiledExpr compiled(constraints.begin(), constraints.end());
+
+  // more assignments than lanes in a batch, some of them dividing by zero
+  std::vector<Assignment> assignments;
+  std::vector<const Array *> objects = {array};
+  for (unsigned i = 0; i < 150; ++i) {
+    std::vector<std::vector<unsigned char>> values = {
+        {static_cast<unsigned char>(i * 7 + 100),
+         static_cast<unsigned char>(i % 5)}};
+    assignments.emplace_back(objects, values, /*_allowFreeValues=*/true);
+  }
+  std::vector<const Assignment *> batch;
+  for (const auto &a : assignments)
+    batch.push_back(&a);
+
+  for (unsigned i = 0; i < constraints.size(); ++i) {
+    std::vector<ref<Expr>> results;
+    compiled.evaluate(batch, i, results);
+    ASSERT_EQ(batch.size(), results.size());
+    for (unsigned l = 0; l < batch.size(); ++l)
+      EXPECT_EQ(batch[l]->evaluate(constraints[i]), results[l]);
+  }
+
+  // the first satisfying assignment may be in any batch
+  for (std::size_t skip : {0, 60, 64, 130}) {
+    std::vector<const Assignment *> rest(batch.begin() + skip, batch.end());
+    std::size_t expected = 0;
+    while (expected < rest.size() &&
+           !assignments[skip + expected].satisfies(constraints.begin(),
+                                                   constraints.end()))
+      ++expected;
+    EXPECT_EQ(expected, compiled.findSatisfying(rest));
+  }
+}
@@ -18,10 +18,12 @@
 #include <llvm/Support/CommandLine.h>
 
 #include <iostream>
+#include <memory>
 
 using namespace klee;
 namespace klee {
 extern llvm::cl::opt<ArrayOptimizationType> OptimizeArray;
+extern llvm::cl::opt<unsigned> ArrayMuxTreeSize;
 }
 
 namespace {
@@ -75,4 +77,83 @@ TEST(ArrayExprTest, HashCollisions) {
   EXPECT_EQ(a->evaluate(oUpdatedRead), getConstant(42, Expr::Int8));
   EXPECT_EQ(a->evaluate(oFirstRead), getConstant(5, Expr::Int8));
 }
+
+/// Restores the options and the expression builder changed by a test
+class OptionsGuard {
+  ArrayOptimizationType optimizeArray = klee::OptimizeArray;
+  unsigned muxTreeSize = klee::ArrayMuxTreeSize;
+  ExprBuilder *builder = exprBuilder;
+
+public:
+  ~OptionsGuard() {
+    klee::OptimizeArray = optimizeArray;
+    klee::ArrayMuxTreeSize = muxTreeSize;
+    exprBuilder = builder;
+  }
+};
+
+/// Checks that a table with the given values is lowered with `encoding`, and
+/// that reads with every index from the optimised read give the table's values
+void checkLoweredReads(const std::vector<unsigned char> &table,
+                       TableEncoding encoding) {
+  ExprOptimizer opt;
+  std::vector<uint64_t> arrayValues(table.begin(), table.end());
+  EXPECT_EQ(opt.lowerTable(arrayValues).encoding, encoding);
+
+  std::vector<ref<ConstantExpr>> constVals;
+  for (unsigned char value : table)
+    constVals.push_back(exprBuilder->Constant(value, Expr::Int8));
+  const Array *array =
+      ac.CreateArray("table", table.size(), constVals.data(),
+                     constVals.data() + constVals.size(), Expr::Int32,
+                     Expr::Int8);
+  const Array *symArray = ac.CreateArray("tableIdx", 4);
+  ref<Expr> symIdx = Expr::createTempRead(symArray, Expr::Int32);
+  ref<Expr> read = ReadExpr::create(UpdateList(array, 0), symIdx);
+
+  ref<Expr> lowered = opt.optimizeExpr(read, true);
+  ASSERT_NE(lowered, read);
+  EXPECT_EQ(opt.optimizeExpr(read, true), lowered);
+
+  std::vector<const Array *> assignmentArrays = {symArray};
+  for (unsigned i = 0; i < table.size(); i++) {
+    std::vector<unsigned char> index = {
+        (unsigned char)i, (unsigned char)(i >> 8), 0, 0};
+    std::vector<std::vector<unsigned char>> values = {index};
+    Assignment a(assignmentArrays, values, /*_allowFreeValues=*/true);
+    EXPECT_EQ(a.evaluate(lowered), getConstant(table[i], Expr::Int8));
+  }
+}
+
+TEST(ArrayExprTest, LoweredTables) {
+  OptionsGuard guard;
+  std::unique_ptr<ExprBuilder> builder(createDefaultExprBuilder());
+  exprBuilder = builder.get();
+  klee::OptimizeArray = VALUE;
+
+  // Distinct values: only a mux tree applies
+  std::vector<unsigned char> sbox(256);
+  for (unsigned i = 0; i < sbox.size(); i++)
+    sbox[i] = (i * 7 + 3) & 0xff;
+  checkLoweredReads(sbox, TableEncoding::MuxTree);
+
+  // A size that is not a power of two
+  std::vector<unsigned char> small(100);
+  for (unsigned i = 0; i < small.size(); i++)
+    small[i] = i % 10 == 0 ? 1 : i % 3;
+  checkLoweredReads(small, TableEncoding::MuxTree);
+
+  // Long runs of a few values: the ranges are split
+  klee::ArrayMuxTreeSize = 0;
+  std::vector<unsigned char> classes(1000);
+  for (unsigned i = 0; i < classes.size(); i++)
+    classes[i] = i < 48 ? 0 : i < 58 ? 1 : i < 600 ? 2 : 3 + (i / 100) % 2;
+  checkLoweredReads(classes, TableEncoding::IntervalTree);
+
+  // Few single elements differ: their values are chained
+  std::vector<unsigned char> sparse(1000);
+  for (unsigned i = 0; i < sparse.size(); i++)
+    sparse[i] = i % 50 == 7;
+  checkLoweredReads(sparse, TableEncoding::ValueChain);
+}
 }
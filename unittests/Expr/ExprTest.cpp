@@ -8,9 +8,11 @@
 //===----------------------------------------------------------------------===//
 
 #include <iostream>
+#include <memory>
 #include "gtest/gtest.h"
 
 #include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprBuilder.h"
 
@@ -265,4 +267,156 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, AllocatorAccounting) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  uint64_t exprBytes = Expr::allocator.getLiveBytes();
+  uint64_t updateBytes = UpdateNode::allocator.getLiveBytes();
+
+  {
+    UpdateList ul(array, 0);
+    ul.extend(ConstantExpr::alloc(0, Expr::Int32),
+              ConstantExpr::alloc(1, Expr::Int8));
+    EXPECT_EQ(updateBytes + sizeof(UpdateNode),
+              UpdateNode::allocator.getLiveBytes());
+
+    ref<Expr> read = ReadExpr::create(ul, Expr::createTempRead(array, 32));
+    ref<Expr> add = AddExpr::create(read, read);
+    EXPECT_LT(exprBytes, Expr::allocator.getLiveBytes());
+    EXPECT_LE(sizeof(AddExpr), Expr::allocator.getLiveBytesForSize(
+                                   sizeof(AddExpr)));
+  }
+
+  // All nodes are released again once the last reference is dropped
+  EXPECT_EQ(exprBytes, Expr::allocator.getLiveBytes());
+  EXPECT_EQ(updateBytes, UpdateNode::allocator.getLiveBytes());
+}
+
+TEST(ExprTest, SimplifyWithConstraints) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 2);
+  ref<Expr> x = Expr::createTempRead(array, 8);
+  ref<Expr> y = ReadExpr::create(UpdateList(array, 0),
+                                 ConstantExpr::alloc(1, Expr::Int32));
+  ref<Expr> sum = AddExpr::create(x, y);
+  ref<Expr> bound = UltExpr::create(y, ConstantExpr::alloc(10, Expr::Int8));
+
+  ConstraintSet constraints;
+  EXPECT_EQ(sum, ConstraintManager::simplifyExpr(constraints, sum));
+
+  ConstraintManager(constraints)
+      .addConstraint(EqExpr::create(ConstantExpr::alloc(5, Expr::Int8), x));
+  ref<Expr> partial =
+      AddExpr::create(ConstantExpr::alloc(5, Expr::Int8), y);
+  EXPECT_EQ(partial, ConstraintManager::simplifyExpr(constraints, sum));
+
+  // a copy shares the simplification state until either side changes
+  ConstraintSet fork = constraints;
+  ConstraintManager(fork).addConstraint(bound);
+  ConstraintManager(fork).addConstraint(
+      EqExpr::create(ConstantExpr::alloc(7, Expr::Int8), y));
+  EXPECT_EQ(ref<Expr>(ConstantExpr::alloc(12, Expr::Int8)),
+            ConstraintManager::simplifyExpr(fork, sum));
+  EXPECT_EQ(partial, ConstraintManager::simplifyExpr(constraints, sum));
+  EXPECT_EQ(bound, ConstraintManager::simplifyExpr(constraints, bound));
+
+  ConstraintManager(constraints).addConstraint(bound);
+  EXPECT_TRUE(ConstraintManager::simplifyExpr(constraints, bound)->isTrue());
+  EXPECT_EQ(partial, ConstraintManager::simplifyExpr(constraints, sum));
+}
+TEST(ExprTest, RewriteEqualities) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 2);
+  ref<Expr> x = Expr::createTempRead(array, 8);
+  ref<Expr> y = ReadExpr::create(UpdateList(array, 0),
+                                 ConstantExpr::alloc(1, Expr::Int32));
+  ref<Expr> boundX = UltExpr::create(x, ConstantExpr::alloc(10, Expr::Int8));
+  ref<Expr> boundY = UltExpr::create(y, ConstantExpr::alloc(10, Expr::Int8));
+  ref<Expr> boundSum =
+      UltExpr::create(AddExpr::create(x, y), ConstantExpr::alloc(30, Expr::Int8));
+
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  cm.addConstraint(boundX);
+  cm.addConstraint(boundY);
+  cm.addConstraint(boundSum);
+  ASSERT_EQ(1u, constraints.getReads(boundY).size());
+  EXPECT_EQ(y, ref<Expr>(constraints.getReads(boundY).front()));
+  EXPECT_EQ(2u, constraints.getReads(boundSum).size());
+
+  // only the constraints reading `x` are rewritten, the others keep their
+  // position
+  ConstraintSet fork = constraints;
+  ref<Expr> eqX = EqExpr::create(ConstantExpr::alloc(5, Expr::Int8), x);
+  ConstraintManager(fork).addConstraint(eqX);
+  ref<Expr> rewritten = UltExpr::create(
+      AddExpr::create(ConstantExpr::alloc(5, Expr::Int8), y),
+      ConstantExpr::alloc(30, Expr::Int8));
+  EXPECT_EQ(ConstraintSet({boundY, rewritten, eqX}), fork);
+  EXPECT_EQ(1u, fork.getReads(rewritten).size());
+  EXPECT_EQ(ConstraintSet({boundX, boundY, boundSum}), constraints);
+
+  ref<Expr> eqY = EqExpr::create(ConstantExpr::alloc(7, Expr::Int8), y);
+  ConstraintManager(fork).addConstraint(eqY);
+  EXPECT_EQ(ConstraintSet({eqX, eqY}), fork);
+}
+
+TEST(ExprTest, WordLevelBuilder) {
+  std::unique_ptr<ExprBuilder> b(createWordLevelExprBuilder(
+      createConstantFoldingExprBuilder(createDefaultExprBuilder())));
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 8);
+  ref<Expr> bytes[4];
+  for (unsigned i = 0; i < 4; ++i)
+    bytes[i] = b->Read(UpdateList(array, 0), b->Constant(i, Expr::Int32));
+  ref<Expr> word = b->Concat(
+      bytes[3], b->Concat(bytes[2], b->Concat(bytes[1], bytes[0])));
+
+  // extracts select the bytes of a word and contiguous extracts are merged
+  EXPECT_EQ(b->Concat(bytes[2], bytes[1]), b->Extract(word, 8, 16));
+  ref<Expr> v = b->Add(word, b->Constant(1, Expr::Int32));
+  EXPECT_EQ(v, b->Concat(b->Extract(v, 24, 8),
+                         b->Concat(b->Extract(v, 16, 8),
+                                   b->Extract(v, 0, 16))));
+  EXPECT_EQ(b->Concat(b->Extract(v, 16, 16), bytes[0]),
+            b->Concat(b->Extract(v, 24, 8),
+                      b->Concat(b->Extract(v, 16, 8), bytes[0])));
+
+  // zero extension chains
+  ref<Expr> zext = b->ZExt(bytes[0], Expr::Int32);
+  EXPECT_EQ(zext, b->Concat(b->Constant(0, 24), bytes[0]));
+  EXPECT_EQ(zext, b->ZExt(b->ZExt(bytes[0], Expr::Int16), Expr::Int32));
+  EXPECT_EQ(zext, b->SExt(b->ZExt(bytes[0], Expr::Int16), Expr::Int32));
+  EXPECT_EQ(bytes[0], b->Extract(zext, 0, 8));
+  EXPECT_TRUE(b->Extract(zext, 16, 16)->isZero());
+
+  // word equalities drop the parts decided on their own
+  EXPECT_EQ(b->Eq(b->Constant(4, Expr::Int8), bytes[0]),
+            b->Eq(b->Constant(0x00000004, Expr::Int32), zext));
+  EXPECT_EQ(b->Eq(b->Constant(4, Expr::Int8), bytes[0]),
+            b->Eq(b->Constant(0x01020304, Expr::Int32),
+                  b->Concat(b->Constant(0x010203, 24), bytes[0])));
+  EXPECT_TRUE(b->Eq(b->Constant(0x01020304, Expr::Int32),
+                    b->Concat(b->Constant(0x010204, 24), bytes[0]))
+                  ->isFalse());
+  EXPECT_EQ(b->Eq(bytes[0], bytes[1]),
+            b->Eq(b->Concat(bytes[3], bytes[0]),
+                  b->Concat(bytes[3], bytes[1])));
+  EXPECT_EQ(Expr::Eq,
+            b->Eq(b->Constant(0x01020304, Expr::Int32), word)->getKind());
+
+  // comparisons decided by known bits and ranges
+  EXPECT_TRUE(b->Ult(zext, b->Constant(256, Expr::Int32))->isTrue());
+  EXPECT_TRUE(b->Ult(b->Constant(300, Expr::Int32), zext)->isFalse());
+  EXPECT_TRUE(b->Slt(zext, b->Constant(0, Expr::Int32))->isFalse());
+  EXPECT_TRUE(
+      b->Ule(b->URem(v, b->Constant(10, Expr::Int32)),
+             b->Constant(9, Expr::Int32))->isTrue());
+  ref<Expr> masked = b->And(v, b->Constant(0xF0, Expr::Int32));
+  EXPECT_TRUE(b->Eq(b->Constant(3, Expr::Int32), masked)->isFalse());
+  EXPECT_EQ(Expr::Ult, b->Ult(masked, b->Constant(16, Expr::Int32))->getKind());
+  EXPECT_EQ(zext, b->And(zext, b->Constant(0xFF, Expr::Int32)));
+  EXPECT_TRUE(b->And(zext, b->Constant(0xFF00, Expr::Int32))->isZero());
+}
 }
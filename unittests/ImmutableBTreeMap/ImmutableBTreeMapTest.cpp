@@ -0,0 +1,159 @@
+//===-- ImmutableBTreeMapTest.cpp -------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/ADT/ImmutableBTreeMap.h"
+#include "gtest/gtest.h"
+
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+// small nodes to exercise splits, merges and deep trees
+typedef ImmutableBTreeMap<int, std::shared_ptr<int>, std::less<int>, 4> Map;
+typedef std::map<int, int> Reference;
+
+void expectEqual(const Reference &expected, const Map &map) {
+  ASSERT_EQ(expected.size(), map.size());
+  ASSERT_EQ(expected.empty(), map.empty());
+
+  auto it = map.begin();
+  for (const auto &[key, value] : expected) {
+    ASSERT_NE(it, map.end());
+    EXPECT_EQ(key, it->first);
+    EXPECT_EQ(value, *it->second);
+    ++it;
+  }
+  EXPECT_EQ(it, map.end());
+
+  // backwards
+  for (auto rit = expected.rbegin(); rit != expected.rend(); ++rit) {
+    ASSERT_NE(it, map.begin());
+    --it;
+    EXPECT_EQ(rit->first, it->first);
+  }
+  EXPECT_EQ(it, map.begin());
+}
+
+} // namespace
+
+TEST(ImmutableBTreeMapTest, Empty) {
+  Map map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(0u, map.size());
+  EXPECT_EQ(map.begin(), map.end());
+  EXPECT_EQ(nullptr, map.lookup(1));
+  EXPECT_EQ(nullptr, map.lookup_previous(1));
+  EXPECT_EQ(map.end(), map.lower_bound(1));
+  EXPECT_EQ(map.end(), map.upper_bound(1));
+  map.removeInPlace(1);
+  EXPECT_TRUE(map.empty());
+}
+
+TEST(ImmutableBTreeMapTest, Lookups) {
+  Map map;
+  for (int i = 0; i < 200; ++i)
+    map.replaceInPlace({2 * i, std::make_shared<int>(i)});
+
+  EXPECT_EQ(0, map.min().first);
+  EXPECT_EQ(398, map.max().first);
+  for (int k = -1; k < 401; ++k) {
+    EXPECT_EQ(k >= 0 && k < 400 && k % 2 == 0 ? 1u : 0u, map.count(k));
+
+    auto previous = map.lookup_previous(k);
+    if (k < 0) {
+      EXPECT_EQ(nullptr, previous);
+    } else {
+      ASSERT_NE(nullptr, previous);
+      EXPECT_EQ(std::min(k, 398) & ~1, previous->first);
+    }
+
+    auto lower = map.lower_bound(k);
+    auto upper = map.upper_bound(k);
+    if (k >= 399) {
+      EXPECT_EQ(map.end(), lower);
+      EXPECT_EQ(map.end(), upper);
+      continue;
+    }
+    EXPECT_EQ(k < 0 ? 0 : (k + 1) & ~1, lower->first);
+    if (k >= 398)
+      EXPECT_EQ(map.end(), upper);
+    else
+      EXPECT_EQ(k < 0 ? 0 : (k + 2) & ~1, upper->first);
+  }
+}
+
+TEST(ImmutableBTreeMapTest, PersistentUpdates) {
+  Map map;
+  for (int i = 0; i < 100; ++i)
+    map = map.insert({i, std::make_shared<int>(i)});
+
+  Map copy = map;
+  Map replaced = map.replace({50, std::make_shared<int>(-50)});
+  Map removed = map.remove(50);
+  Map inserted = map.insert({50, std::make_shared<int>(-50)});
+
+  EXPECT_EQ(50, *map.lookup(50)->second);
+  EXPECT_EQ(50, *copy.lookup(50)->second);
+  EXPECT_EQ(-50, *replaced.lookup(50)->second);
+  EXPECT_EQ(nullptr, removed.lookup(50));
+  EXPECT_EQ(99u, removed.size());
+  EXPECT_EQ(50, *inserted.lookup(50)->second);
+
+  // iterators keep their version alive
+  auto it = copy.find(10);
+  copy.removeInPlace(10);
+  copy = Map();
+  EXPECT_EQ(10, it->first);
+  ++it;
+  EXPECT_EQ(11, it->first);
+}
+
+TEST(ImmutableBTreeMapTest, RandomOperations) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> keys(0, 999);
+  std::uniform_int_distribution<int> operations(0, 99);
+
+  // a family of maps that fork off each other, compared to std::map
+  std::vector<std::pair<Reference, Map>> versions(1);
+  for (unsigned step = 0; step < 20000; ++step) {
+    std::uniform_int_distribution<std::size_t> pick(0, versions.size() - 1);
+    auto &[expected, map] = versions[pick(rng)];
+    int key = keys(rng);
+    int operation = operations(rng);
+    if (operation < 55) {
+      expected[key] = step;
+      map.replaceInPlace({key, std::make_shared<int>(step)});
+    } else if (operation < 95) {
+      expected.erase(key);
+      map.removeInPlace(key);
+    } else if (versions.size() < 16) {
+      auto fork = versions[pick(rng)];
+      versions.push_back(fork);
+    }
+  }
+
+  for (const auto &[expected, map] : versions)
+    expectEqual(expected, map);
+
+  // drain one version completely
+  auto &[drainedExpected, drained] = versions.front();
+  while (!drainedExpected.empty()) {
+    auto key = drainedExpected.begin()->first;
+    drainedExpected.erase(key);
+    drained.removeInPlace(key);
+  }
+  expectEqual(drainedExpected, drained);
+  for (const auto &[expected, map] : versions)
+    expectEqual(expected, map);
+}
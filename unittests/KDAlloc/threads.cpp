@@ -0,0 +1,119 @@
+//===-- threads.cpp -------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/KDAlloc/kdalloc.h"
+#include "xoshiro.h"
+
+#if defined(USE_GTEST_INSTEAD_OF_MAIN)
+#include "gtest/gtest.h"
+#endif
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+/// Runs a pseudo-random sequence of allocations, deallocations and forks on
+/// the given allocator and returns the sequence of allocated addresses.
+std::vector<void *> run(klee::kdalloc::Allocator allocator,
+                        std::uint64_t const iterations) {
+  xoshiro512 rng(0x31337);
+  std::uniform_int_distribution<std::uint32_t> choice(0, 999);
+  std::geometric_distribution<std::size_t> sizeDistribution(0.01);
+
+  std::vector<void *> trace;
+  std::vector<std::pair<void *, std::size_t>> allocations;
+  for (std::uint64_t i = 0; i < iterations; ++i) {
+    auto chosen = choice(rng);
+    if (chosen < 600) {
+      auto size = sizeDistribution(rng) + 1;
+      if (chosen < 30) {
+        size += 4096;
+      }
+      allocations.emplace_back(allocator.allocate(size), size);
+      trace.emplace_back(allocations.back().first);
+    } else if (chosen < 990) {
+      if (!allocations.empty()) {
+        auto index = std::uniform_int_distribution<std::size_t>(
+            0, allocations.size() - 1)(rng);
+        allocator.free(allocations[index].first, allocations[index].second);
+        allocations[index] = allocations.back();
+        allocations.pop_back();
+      }
+    } else {
+      // fork: continue on a copy that shares all structure with the original
+      auto copy = allocator;
+      allocator = std::move(copy);
+    }
+  }
+  return trace;
+}
+} // namespace
+
+void threads_test() {
+  static const std::uint64_t iterations = 100'000;
+  static const unsigned threadCount = 8;
+
+  auto factory = klee::kdalloc::AllocatorFactory(
+      static_cast<std::size_t>(1) << 42, 8);
+  auto parent = factory.makeAllocator();
+  for (std::size_t i = 1; i < 4096; i *= 2) {
+    [[maybe_unused]] auto *ptr = parent.allocate(i);
+  }
+
+  auto const start = std::chrono::steady_clock::now();
+  auto const reference = run(parent, iterations);
+  auto const singleThreaded = std::chrono::steady_clock::now() - start;
+
+  // all threads start from allocators sharing their state with `parent`
+  std::vector<klee::kdalloc::Allocator> allocators(threadCount, parent);
+  std::vector<std::vector<void *>> traces(threadCount);
+  std::vector<std::thread> threads;
+  auto const parallelStart = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < threadCount; ++i) {
+    threads.emplace_back([&, i]() {
+      traces[i] = run(std::move(allocators[i]), iterations);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto const multiThreaded = std::chrono::steady_clock::now() - parallelStart;
+
+  // allocation remains deterministic, independent of the executing thread
+  for (auto const &trace : traces) {
+    assert(trace == reference);
+    static_cast<void>(trace);
+  }
+
+  using ms = std::chrono::milliseconds;
+  std::cout << "1 thread: "
+            << std::chrono::duration_cast<ms>(singleThreaded).count()
+            << " ms\n"
+            << threadCount << " threads: "
+            << std::chrono::duration_cast<ms>(multiThreaded).count()
+            << " ms\n";
+
+  std::exit(0);
+}
+
+#if defined(USE_GTEST_INSTEAD_OF_MAIN)
+TEST(KDAllocDeathTest, Threads) {
+  ASSERT_EXIT(threads_test(), ::testing::ExitedWithCode(0), "");
+}
+#else
+int main() { threads_test(); }
+#endif
@@ -0,0 +1,55 @@
+//===-- LatencyHistogramTest.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Statistics/LatencyHistogram.h"
+
+#include <cstdint>
+
+using namespace klee;
+
+namespace {
+
+TEST(LatencyHistogramTest, Buckets) {
+  // small values are exact
+  for (std::uint64_t v = 0; v < 16; ++v)
+    EXPECT_EQ(LatencyHistogram::getBucketLimit(LatencyHistogram::getBucket(v)),
+              v);
+
+  // every value lies in a bucket whose limit is at most 12.5% larger
+  for (std::uint64_t v = 1; v < (std::uint64_t(1) << 40); v = v * 3 + 1) {
+    const std::uint64_t limit =
+        LatencyHistogram::getBucketLimit(LatencyHistogram::getBucket(v));
+    EXPECT_GE(limit, v);
+    EXPECT_LE(limit - v, v / 8);
+  }
+
+  const std::uint64_t max = ~std::uint64_t(0);
+  EXPECT_EQ(LatencyHistogram::getBucketLimit(LatencyHistogram::getBucket(max)),
+            max);
+}
+
+TEST(LatencyHistogramTest, Percentiles) {
+  LatencyHistogram h;
+  EXPECT_EQ(h.getPercentile(50), 0u);
+
+  for (std::uint64_t v = 1; v <= 100; ++v)
+    h.record(v * 1000);
+  EXPECT_EQ(h.getCount(), 100u);
+  EXPECT_EQ(h.getMax(), 100000u);
+
+  const std::uint64_t p50 = h.getPercentile(50);
+  EXPECT_GE(p50, 50000u);
+  EXPECT_LE(p50, 50000u + 50000u / 8);
+  EXPECT_EQ(h.getPercentile(100), 100000u);
+  EXPECT_LE(h.getPercentile(0), 1000u + 1000u / 8);
+}
+
+} // namespace
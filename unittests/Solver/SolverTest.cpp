@@ -13,6 +13,7 @@
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprBuilder.h"
+#include "klee/Solver/BinaryQueryLog.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
 
@@ -168,4 +169,123 @@ TEST(SolverTest, Evaluation) {
   testOpcode<SgeExpr>(*solver);
 }
 
+
+TEST(SolverTest, BinaryQueryLogRoundTrip) {
+  using namespace klee::querylog;
+
+  const Array *array = ac.CreateArray("log", 4);
+  const ref<ConstantExpr> bytes[] = {ConstantExpr::create(1, Expr::Int8),
+                                     ConstantExpr::create(2, Expr::Int8)};
+  const Array *constant =
+      ac.CreateArray("table", 2, std::begin(bytes), std::end(bytes));
+
+  UpdateList ul(array, nullptr);
+  ul.extend(ConstantExpr::create(0, Expr::Int32),
+            ConstantExpr::create(7, Expr::Int8));
+  ul.extend(Expr::createTempRead(array, Expr::Int32),
+            ConstantExpr::create(9, Expr::Int8));
+  const ref<Expr> read = ReadExpr::create(ul, ConstantExpr::create(1, 32));
+  const ref<Expr> word = ConcatExpr::create(
+      read, ReadExpr::create(UpdateList(array, nullptr),
+                             ConstantExpr::create(2, Expr::Int32)));
+  const ref<Expr> wide =
+      ConstantExpr::alloc(llvm::APInt(128, "123456789abcdef0123", 16));
+  const ref<Expr> c1 = UltExpr::create(ZExtExpr::create(word, 128), wide);
+  const ref<Expr> c2 = EqExpr::create(
+      ExtractExpr::create(word, 4, Expr::Int8),
+      SelectExpr::create(c1, read,
+                         ReadExpr::create(UpdateList(constant, nullptr),
+                                          ZExtExpr::create(read, 32))));
+  const ConstraintSet constraints({c1, c2});
+
+  // the second query is dropped, the fourth one comes after a reset and the
+  // last one never finished
+  std::string log(Magic, sizeof(Magic) - 1);
+  Writer writer(8);
+  writer.writeQuery(log, QueryType::Truth, 42, Query(constraints, c2),
+                    nullptr);
+  writer.writeResult(log, true, SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE,
+                     time::microseconds(5), true, ref<Expr>(), nullptr);
+  writer.commit(log);
+  const std::size_t size = log.size();
+  writer.writeQuery(log, QueryType::Validity, 43,
+                    Query(constraints, NotExpr::create(word)), nullptr);
+  log.resize(size);
+  writer.discard();
+  writer.writeQuery(log, QueryType::Value, 44, Query(constraints, word),
+                    nullptr);
+  writer.writeResult(log, true, SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE,
+                     time::microseconds(6), 0,
+                     ConstantExpr::create(0x1234, Expr::Int16), nullptr);
+  writer.commit(log);
+  const std::vector<const Array *> objects = {array};
+  const std::vector<std::vector<unsigned char>> values = {{1, 2, 3, 4}};
+  writer.writeQuery(log, QueryType::InitialValues, 45,
+                    Query(constraints, ConstantExpr::create(0, Expr::Bool)),
+                    &objects);
+  writer.writeResult(log, true, SolverImpl::SOLVER_RUN_STATUS_SUCCESS_SOLVABLE,
+                     time::microseconds(7), true, ref<Expr>(), &values);
+  writer.commit(log);
+  writer.writeQuery(log, QueryType::Truth, 46, Query(constraints, c1),
+                    nullptr);
+
+  Reader reader(ac, log.data(), log.size());
+  LoggedQuery query;
+  ASSERT_TRUE(reader.next(query));
+  EXPECT_EQ(QueryType::Truth, query.type);
+  EXPECT_EQ(42u, query.instructions);
+  EXPECT_TRUE(query.finished);
+  ASSERT_EQ(2u, query.constraints.size());
+  EXPECT_EQ(c1, query.constraints[0]);
+  // reads of constant arrays refer to a copy of the array
+  const ReadExpr *copied = dyn_cast<ReadExpr>(
+      cast<SelectExpr>(query.expr->getKid(1))->falseExpr);
+  ASSERT_TRUE(copied);
+  EXPECT_EQ("table", copied->updates.root->name);
+  EXPECT_EQ(constant->constantValues, copied->updates.root->constantValues);
+  EXPECT_TRUE(query.success);
+  EXPECT_EQ(time::microseconds(5), query.elapsed);
+  EXPECT_EQ(1, query.result);
+
+  ASSERT_TRUE(reader.next(query));
+  EXPECT_EQ(QueryType::Value, query.type);
+  EXPECT_EQ(44u, query.instructions);
+  EXPECT_EQ(word, query.expr);
+  EXPECT_EQ(ref<Expr>(ConstantExpr::create(0x1234, Expr::Int16)),
+            query.value);
+
+  ASSERT_TRUE(reader.next(query));
+  EXPECT_EQ(QueryType::InitialValues, query.type);
+  EXPECT_EQ(c1, query.constraints[0]);
+  EXPECT_EQ(objects, query.objects);
+  EXPECT_EQ(values, query.values);
+
+  ASSERT_TRUE(reader.next(query));
+  EXPECT_EQ(46u, query.instructions);
+  EXPECT_EQ(c1, query.expr);
+  EXPECT_FALSE(query.finished);
+
+  EXPECT_FALSE(reader.next(query));
+  EXPECT_EQ("", reader.getError());
+
+  // records split across blocks are read once the next block arrives
+  Reader blocks(ac);
+  std::vector<LoggedQuery> queries;
+  std::string block;
+  for (std::size_t offset = 0; offset <= log.size(); offset += 3) {
+    block.append(log, offset, 3);
+    blocks.feed(block.data(), block.size(), offset + 3 > log.size());
+    while (blocks.next(query))
+      queries.push_back(query);
+    ASSERT_EQ("", blocks.getError());
+    block.erase(0, block.size() - blocks.getUnreadSize());
+  }
+  ASSERT_EQ(4u, queries.size());
+  EXPECT_EQ(42u, queries[0].instructions);
+  EXPECT_EQ(c1, queries[0].constraints[0]);
+  EXPECT_EQ(word, queries[1].expr);
+  EXPECT_EQ(values, queries[2].values);
+  EXPECT_FALSE(queries[3].finished);
+}
+
 }
@@ -9,6 +9,7 @@
 //===----------------------------------------------------------------------===//
 
 #include <algorithm>
+#include <cstdint>
 #include <iterator>
 #include <vector>
 
@@ -18,6 +19,7 @@
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverStats.h"
 
 #include <memory>
 
@@ -69,3 +71,38 @@ TEST_F(Z3SolverTest, GetConstraintLog) {
       std::strstr(ConstraintsString.c_str(), ExpectedArraySelection);
   ASSERT_STRNE(Occurence, nullptr);
 }
+
+TEST_F(Z3SolverTest, ConstructCacheAcrossQueries) {
+  const Array *Arr = AC.CreateArray("arr", 4);
+  UpdateList Updated(Arr, nullptr);
+  Updated.extend(ConstantExpr::alloc(0, Expr::Int32),
+                 ReadExpr::create(UpdateList(Arr, nullptr),
+                                  ConstantExpr::alloc(1, Expr::Int32)));
+  const ref<Expr> Index =
+      ZExtExpr::create(ReadExpr::create(UpdateList(Arr, nullptr),
+                                        ConstantExpr::alloc(2, Expr::Int32)),
+                       Expr::Int32);
+  const ref<Expr> Read = ReadExpr::create(Updated, Index);
+  const ref<Expr> Bound =
+      UltExpr::create(Read, ConstantExpr::alloc(10, Expr::Int8));
+
+  ConstraintSet Constraints;
+  ConstraintManager(Constraints).addConstraint(Bound);
+
+  bool Result;
+  ASSERT_TRUE(Z3Solver_->mustBeTrue(
+      Query(Constraints,
+            UltExpr::create(Read, ConstantExpr::alloc(20, Expr::Int8))),
+      Result));
+  EXPECT_TRUE(Result);
+
+  // only the new comparison is encoded, the encodings of the constraint and
+  // the updated array are reused
+  const std::uint64_t Misses = stats::z3ConstructCacheMisses;
+  ASSERT_TRUE(Z3Solver_->mustBeTrue(
+      Query(Constraints,
+            UltExpr::create(Read, ConstantExpr::alloc(5, Expr::Int8))),
+      Result));
+  EXPECT_FALSE(Result);
+  EXPECT_EQ(Misses + 1, stats::z3ConstructCacheMisses);
+}
@@ -1,6 +1,7 @@
 #include "klee/ADT/TreeStream.h"
 #include <vector>
 #include <cstring>
+#include <string>
 
 #include "gtest/gtest.h"
 
@@ -46,3 +47,38 @@ TEST(TreeStreamTest, WriteLargerThanBufferSize) {
   for (unsigned i=0; i<out.size(); i++)
     ASSERT_EQ('A', out[i]);
 }
+
+/* Forked streams see their ancestors' data up to the fork point, followed
+   by their own data, regardless of what the ancestors write afterwards. */
+TEST(TreeStreamTest, Forks) {
+  TreeStreamWriter tsw("tsw3.out");
+  ASSERT_TRUE(tsw.good());
+
+  TreeOStream root = tsw.open();
+  root << "ab";
+  TreeOStream left = tsw.open(root);
+  root << "c";
+  TreeOStream right = tsw.open(root);
+  left << "d";
+  right << "e";
+  root << "f";
+  TreeOStream leaf = tsw.open(left);
+  left << "g";
+  leaf << "h";
+  right << "i";
+
+  auto read = [&](const TreeOStream &os) {
+    std::vector<unsigned char> out;
+    tsw.readStream(os.getID(), out);
+    return std::string(out.begin(), out.end());
+  };
+  ASSERT_EQ("abcf", read(root));
+  ASSERT_EQ("abdg", read(left));
+  ASSERT_EQ("abcei", read(right));
+  ASSERT_EQ("abdh", read(leaf));
+
+  // Reading must not disturb later writes.
+  leaf << "j";
+  ASSERT_EQ("abdhj", read(leaf));
+  ASSERT_EQ("abdg", read(left));
+}